@@ -0,0 +1,513 @@
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace std;
+
+#include "assembler.hpp"
+#include "timer.hpp"
+
+/* Splits a line into its words */
+static vector<string> split(const string& s) {
+	vector<string> words;
+	stringstream in(s);
+	string w;
+	while (in >> w) {
+		words.push_back(w);
+	}
+	return words;
+}
+
+/* Returns true if s is an int, e.g. "-3", storing it in v */
+static bool toInt(const string& s, int& v) {
+	if (s.empty()) {
+		return false;
+	}
+	char* end;
+	long l = strtol(s.c_str(), &end, 10);
+	v = l;
+	return *end == '\0' && (isdigit(s[0]) || (s[0] == '-' && s.size() > 1));
+}
+
+/* Returns true if s is the name of a temporary, e.g. "t3", storing its number in name */
+static bool toTemp(const string& s, int& name) {
+	return s.size() > 1 && s[0] == 't' && isdigit(s[1]) && toInt(s.substr(1), name);
+}
+
+/* Splits an indexed operand, e.g. "t0[4]", into its base and index; returns false if s is not one */
+static bool toIndexed(const string& s, string& base, string& index) {
+	size_t open = s.find('[');
+	if (open == string::npos || open == 0 || s[s.size() - 1] != ']') {
+		return false;
+	}
+	base = s.substr(0, open);
+	index = s.substr(open + 1, s.size() - open - 2);
+	return true;
+}
+
+/* Returns the number of leading digits of s, after any whitespace, followed by the given char;
+ * the position right after that char is stored in rest */
+static bool labelled(const string& s, char after, int& label, size_t& rest) {
+	size_t i = s.find_first_not_of(" \t");
+	size_t j = i;
+	while (j < s.size() && isdigit(s[j])) {
+		j++;
+	}
+	if (i == string::npos || j == i || j >= s.size() || s[j] != after) {
+		return false;
+	}
+	label = atoi(s.c_str() + i);
+	rest = j + 1;
+	return true;
+}
+
+/* Returns the conditional jump testing relation s ("==" as eq1condJmpOpr), or UNKNOWNOpr */
+static oprEnum relationOp(const string& s) {
+	const oprEnum ops[] = { eq1condJmpOpr, neCondJmpOpr, ltCondJmpOpr, leCondJmpOpr, gtCondJmpOpr, geCondJmpOpr };
+	for (size_t k = 0; k < sizeof(ops) / sizeof(ops[0]); k++) {
+		if (s == TacInstr::relationOf(ops[k])) {
+			return ops[k];
+		}
+	}
+	return UNKNOWNOpr;
+}
+
+/* Orders the variables of the symbol table by offset */
+static bool byOffset(const pair<int, TacAssembler::Line>& a, const pair<int, TacAssembler::Line>& b) {
+	return a.first < b.first;
+}
+
+void TacAssembler::fail(int line, const string& why) {
+	if (error.empty()) {
+		stringstream s;
+		s << "line " << line << ": " << why;
+		error = s.str();
+	}
+}
+
+void TacAssembler::putVars() {
+	/* the symbol table, in order of offset, then the declarations, in order */
+	vector<pair<int, Line> > vars;
+
+	for (size_t i = 0; i < symbols.size(); i++) {
+		int index, offset;
+		char lexeme;
+		char type[16];
+		if (sscanf(symbols[i].text.c_str(), "%d) : %c (%15[a-z]) - offset = %d", &index, &lexeme, type, &offset) != 4) {
+			fail(symbols[i].number, "invalid symbol table entry");
+			return;
+		}
+		Line l = symbols[i];
+		l.text = string(type) + " " + lexeme;
+		vars.push_back(make_pair(offset, l));
+	}
+	stable_sort(vars.begin(), vars.end(), byOffset);
+
+	for (size_t i = 0; i < decls.size(); i++) {
+		// "fraction f, g;" declares "fraction f" and "fraction g"
+		string text = decls[i].text;
+		replace(text.begin(), text.end(), ',', ' ');
+		replace(text.begin(), text.end(), ';', ' ');
+		vector<string> words = split(text);
+
+		for (size_t w = 1; w < words.size(); w++) {
+			Line l = decls[i];
+			l.text = words[0] + " " + words[w];
+			vars.push_back(make_pair(-1, l));
+		}
+	}
+
+	for (size_t i = 0; i < vars.size() && error.empty(); i++) {
+		vector<string> words = split(vars[i].second.text);
+		int line = vars[i].second.number;
+
+		typeName type;
+		if (words[0] == "int") {
+			type = intType;
+		} else if (words[0] == "float") {
+			type = floatType;
+		} else if (words[0] == "fraction") {
+			type = fractionType;
+		} else {
+			fail(line, "unknown type " + words[0]);
+			return;
+		}
+
+		if (words[1].size() != 1 || !islower(words[1][0])) {
+			fail(line, "invalid variable name " + words[1]);
+			return;
+		}
+		char lexeme = words[1][0];
+		if (sym->get(lexeme) != NULL) {
+			fail(line, "variable " + words[1] + " declared twice");
+			return;
+		}
+
+		sym->put(lexeme, type);
+		if (vars[i].first >= 0 && sym->get(lexeme)->getOffset() != vars[i].first) {
+			fail(line, "the offset of " + words[1] + " does not follow the layout of the variables");
+			return;
+		}
+	}
+}
+
+void TacAssembler::placeTemps() {
+	/* the name of the temporary at each byte, or -1 */
+	vector<int> cells;
+
+	for (size_t r = 0; r < dump.size() && error.empty(); r++) {
+		const string& s = dump[r].text;
+		size_t p = s.find_first_not_of(" \t");
+		int base = strtol(s.substr(p, 4).c_str(), NULL, 16);
+		p += 4;
+
+		for (int k = 0; ; k++) {
+			p = s.find_first_not_of(" \t", p);
+			if (p == string::npos) {
+				break;
+			}
+
+			int name = -1;
+			if (s.compare(p, 2, "--") == 0) {
+				p += 2;
+			} else if (s[p] == 't' && p + 1 < s.size() && isdigit(s[p + 1])) {
+				// names may run into each other, as in "t9t10t10"
+				name = atoi(s.c_str() + p + 1);
+				p++;
+				while (p < s.size() && isdigit(s[p])) {
+					p++;
+				}
+			} else if (islower(s[p])) {
+				p++;		// a variable: already laid out
+			} else {
+				fail(dump[r].number, "invalid memory dump");
+				return;
+			}
+
+			if ((int)cells.size() <= base + k) {
+				cells.resize(base + k + 1, -1);
+			}
+			cells[base + k] = name;
+		}
+	}
+
+	Memory& mem = Memory::getInstance();
+	for (size_t i = 0; i < cells.size() && error.empty(); i++) {
+		int name = cells[i];
+		if (name < 0 || (i > 0 && cells[i - 1] == name)) {
+			continue;
+		}
+
+		size_t width = 1;
+		while (i + width < cells.size() && cells[i + width] == name) {
+			width++;
+		}
+		if (temps.count(name) || (width != 4 && width != 8)) {
+			fail(dump[0].number, "invalid memory dump");
+			return;
+		}
+
+		temps[name] = mem.restoreTemp(i, width, name, true);
+		dumped[name] = true;
+	}
+}
+
+TempAddress* TacAssembler::getTemp(int name, bool wide) {
+	if (!temps.count(name)) {
+		Memory& mem = Memory::getInstance();
+		temps[name] = mem.restoreTemp(mem.getUsed(), wide ? 8 : 4, name, true);
+	}
+	return temps[name];
+}
+
+bool TacAssembler::isFraction(const string& s) {
+	int name;
+	if (toTemp(s, name)) {
+		return temps.count(name) && temps[name]->getWidth() == 8;
+	}
+	if (s.size() == 1 && islower(s[0])) {
+		return sym->get(s[0]) != NULL && sym->get(s[0])->getType() == fractionType;
+	}
+	return s.find('|') != string::npos;
+}
+
+Address* TacAssembler::getOperand(int line, const string& s, int& vn, bool wide) {
+	int i, name;
+
+	vn = -1;
+	if (s.size() > 2 && s[0] == '(' && s[s.size() - 1] == ')' && toInt(s.substr(1, s.size() - 2), vn) && vn >= 0) {
+		// resolved once the whole code has been assembled
+		return NULL;
+	}
+	vn = -1;
+
+	if (toTemp(s, name)) {
+		return getTemp(name, wide);
+	}
+
+	if (toInt(s, i)) {
+		return new ConstAddress(i);
+	}
+
+	size_t bar = s.find('|');
+	fraction f;
+	if (bar != string::npos && toInt(s.substr(0, bar), f.num) && toInt(s.substr(bar + 1), f.denom)) {
+		if (f.denom == 0) {
+			fail(line, "fraction with a zero denominator: " + s);
+			return NULL;
+		}
+		// the comparisons of fractions rely on a positive denominator
+		if (f.denom < 0) {
+			f.num = (int)(0u - f.num);
+			f.denom = (int)(0u - f.denom);
+		}
+		return new ConstAddress(f);
+	}
+
+	char* end;
+	float x = strtof(s.c_str(), &end);
+	if (!s.empty() && (isdigit(s[0]) || s[0] == '-') && *end == '\0') {
+		return new ConstAddress(x);
+	}
+
+	if (!s.empty() && islower(s[0]) && (s.size() == 1 || s.substr(1) == ".num" || s.substr(1) == ".den")) {
+		VarAddress* v = sym->get(s[0]);
+		if (v == NULL) {
+			fail(line, "variable " + s.substr(0, 1) + " not declared");
+			return NULL;
+		}
+		if (s.size() == 1) {
+			return v;
+		}
+		if (v->getType() != fractionType) {
+			fail(line, "variable " + s.substr(0, 1) + " is not a fraction");
+			return NULL;
+		}
+		return v->getField(s.substr(1) == ".num" ? 0 : 4);
+	}
+
+	fail(line, "invalid operand " + s);
+	return NULL;
+}
+
+void TacAssembler::assemble(TargetCode* code) {
+	/* references to instructions, resolved once all of them have been generated:
+	 * the instruction, the operand (1, 2, or 0 for the destination of a jump), the line */
+	class Ref {
+	public:
+		int instr, operand, vn, line;
+	};
+	vector<Ref> refs;
+
+	/* the valuenumbers read by some instruction, e.g. 12 for "g = (12)" */
+	map<int, bool> read;
+	for (size_t n = 0; n < instrs.size(); n++) {
+		vector<string> w = split(instrs[n].text);
+		for (size_t k = 0; k < w.size(); k++) {
+			int vn;
+			if (w[k].size() > 2 && w[k][0] == '(' && toInt(w[k].substr(1, w[k].size() - 2), vn)) {
+				read[vn] = true;
+			}
+		}
+	}
+
+	for (size_t n = 0; n < instrs.size() && error.empty(); n++) {
+		int line = instrs[n].number;
+		vector<string> w = split(instrs[n].text);
+		int label = code->getNextInstr();
+
+		int vn[2] = { -1, -1 };
+		int dest = -1;
+		string base, index;
+
+		if (w.size() == 1 && w[0] == "HALT") {
+			code->gen(haltOpr, NULL, NULL);
+		} else if (w.size() == 1 && w[0] == "stat") {
+			code->gen(fakeOpr, NULL, NULL);
+		} else if (w.size() == 2 && w[0] == "goto" && toInt(w[1], dest)) {
+			code->gen(jmpOpr, NULL, NULL, NULL);
+		} else if (w.size() == 6 && w[0] == "goto" && toIndexed(w[1], base, index) && base == "table"
+				&& w[2] == "of" && w[4] == "else" && toInt(w[5], dest)) {
+			int size;
+			if (!toInt(w[3], size) || size < 0) {
+				fail(line, "invalid size of jump table " + w[3]);
+				return;
+			}
+			code->gen(jmpTableOpr, getOperand(line, index, vn[0]), new ConstAddress(size), NULL);
+		} else if (w.size() == 6 && w[0] == "if" && relationOp(w[2]) != UNKNOWNOpr && w[4] == "goto" && toInt(w[5], dest)) {
+			Address* a = getOperand(line, w[1], vn[0]);
+			Address* b = getOperand(line, w[3], vn[1]);
+			code->gen(relationOp(w[2]), a, b, NULL);
+		} else if (w.size() == 2 && w[0] == "read") {
+			Address* x = getOperand(line, w[1], vn[0]);
+			if (dynamic_cast<VarAddress*>(x) == NULL) {
+				fail(line, "only a variable can be read");
+				return;
+			}
+			code->gen(readOpr, x, NULL);
+		} else if (w.size() == 2 && w[0] == "print") {
+			code->gen(printOpr, getOperand(line, w[1], vn[0]), NULL);
+		} else if (w.size() == 3 && w[1] == "=" && toIndexed(w[0], base, index)) {
+			/* t[k] = x */
+			int name;
+			if (!toTemp(base, name)) {
+				fail(line, "only a temporary can be indexed on the left of =");
+				return;
+			}
+			Address* k = getOperand(line, index, vn[0]);
+			Address* x = getOperand(line, w[2], vn[1]);
+			code->gen(indexCopyOpr, k, x, getTemp(name, true));
+		} else if (w.size() == 3 && w[1] == "=" && toIndexed(w[2], base, index)) {
+			/* t = x[k] */
+			int name;
+			if (!toTemp(w[0], name)) {
+				fail(line, "the result of an indexed read must be a temporary");
+				return;
+			}
+			Address* x = getOperand(line, base, vn[0]);
+			Address* k = getOperand(line, index, vn[1]);
+			code->gen(offsetOpr, x, k, getTemp(name, false));
+		} else if (w.size() == 3 && w[1] == "=") {
+			int name;
+			if (toTemp(w[0], name) && name == label && (read.count(name) || !dumped.count(name))) {
+				// the copy into the valuenumber of this instruction
+				code->gen(copyOpr, getOperand(line, w[2], vn[0]), NULL);
+			} else {
+				Address* x = getOperand(line, w[0], vn[0], isFraction(w[2]));
+				Address* y = getOperand(line, w[2], vn[1]);
+				if (dynamic_cast<VarAddress*>(x) == NULL && dynamic_cast<TempAddress*>(x) == NULL) {
+					fail(line, "cannot assign to " + w[0]);
+					return;
+				}
+				code->gen(copyOpr, x, y);
+			}
+		} else if (w.size() == 5 && w[1] == "=" && (w[3] == "+" || w[3] == "*" || w[3] == "/")) {
+			int name;
+			if (!toTemp(w[0], name)) {
+				fail(line, "the result of " + w[3] + " must be a temporary");
+				return;
+			}
+			oprEnum op = w[3] == "+" ? addOpr : (w[3] == "*" ? mulOpr : divOpr);
+			bool wide = isFraction(w[2]) || isFraction(w[4]);
+			Address* a = getOperand(line, w[2], vn[0]);
+			Address* b = getOperand(line, w[4], vn[1]);
+			code->gen(op, a, b, getTemp(name, wide));
+		} else {
+			fail(line, "invalid instruction");
+			return;
+		}
+
+		for (int k = 0; k < 2; k++) {
+			if (vn[k] >= 0) {
+				Ref r = { label, k + 1, vn[k], line };
+				refs.push_back(r);
+			}
+		}
+		if (dest >= 0) {
+			Ref r = { label, 0, dest, line };
+			refs.push_back(r);
+		}
+	}
+
+	for (size_t n = 0; n < instrs.size() && error.empty(); n++) {
+		int size = code->getInstr(n)->tableSize();
+		for (int k = 1; k <= size && error.empty(); k++) {
+			if (n + k >= instrs.size() || code->getInstr(n + k)->getOp() != jmpOpr) {
+				fail(instrs[n].number, "a jump table must be followed by its gotos");
+			}
+		}
+	}
+
+	for (size_t r = 0; r < refs.size() && error.empty(); r++) {
+		if (refs[r].vn >= code->getNextInstr()) {
+			fail(refs[r].line, "reference to a missing instruction");
+			return;
+		}
+
+		TacInstr* instr = code->getInstr(refs[r].instr);
+		TacInstr* target = code->getInstr(refs[r].vn);
+		switch (refs[r].operand) {
+			case 0:
+				instr->patch(target);
+				break;
+			case 1:
+				instr->setOperand1(target->getValueNumber());
+				break;
+			default:
+				instr->setOperand2(target->getValueNumber());
+				break;
+		}
+	}
+}
+
+TacAssembler::TacAssembler(const char* path, TargetCode* code, SimpleArraySymTbl* sym) {
+	TimeScope t("assemble");
+	this->sym = sym;
+
+	ifstream in(path);
+	if (!in) {
+		error = "cannot read the file";
+		return;
+	}
+
+	/* classify the lines by their shape */
+	string s;
+	for (int number = 1; getline(in, s); number++) {
+		if (s.find("//") != string::npos) {
+			s.erase(s.find("//"));
+		}
+
+		Line l;
+		l.number = number;
+		l.text = s;
+
+		vector<string> words = split(s);
+		int label;
+		size_t rest;
+
+		if (labelled(s, ':', label, rest)) {
+			if (label != (int)instrs.size()) {
+				fail(number, "instructions must be numbered from 0, in order");
+				return;
+			}
+			l.text = s.substr(rest);
+			instrs.push_back(l);
+		} else if (labelled(s, ')', label, rest)) {
+			symbols.push_back(l);
+		} else if (!words.empty() && (words[0] == "int" || words[0] == "float" || words[0] == "fraction")
+				&& s[s.find_last_not_of(" \t")] == ';') {
+			decls.push_back(l);
+		} else if (!words.empty() && words[0].size() == 4 && isxdigit(words[0][0]) && isxdigit(words[0][1])
+				&& isxdigit(words[0][2]) && isxdigit(words[0][3]) && words.size() > 1) {
+			dump.push_back(l);
+		}
+	}
+
+	if (instrs.empty()) {
+		error = "no instructions";
+		return;
+	}
+
+	putVars();
+	if (error.empty()) {
+		placeTemps();
+	}
+	if (error.empty()) {
+		assemble(code);
+	}
+}
+
+bool TacAssembler::ok() const {
+	return error.empty();
+}
+
+const string& TacAssembler::getError() const {
+	return error;
+}
@@ -0,0 +1,100 @@
+#ifndef ASSEMBLER_HPP_
+#define ASSEMBLER_HPP_
+
+/**
+* @file assembler.hpp
+* @brief This header file contains the 3-address code assembler of tinycomp:
+* it reads a program written directly in 3-address code, in the format printed
+* by the compiler, and rebuilds it as if it had just been parsed (see --tac).
+*
+* The whole output of printout() is accepted as is, so that the listing of a
+* program can be fed back to the compiler; any line that is not one of the
+* following is ignored:
+* - a symbol table entry, e.g. "8) : i (int)   - offset = 0";
+* - a declaration, as in the source language, e.g. "fraction f, g;";
+* - a row of the memory dump, e.g. "  0010   g  g  g  g t0 t0 t0 t0";
+* - an instruction, e.g. "   3: t1 = a + b", "   5: if a == c goto 9" or "   6: read x"
+*   or "   7: print t1", or a jump table "   8: goto table[t2] of 3 else 14", which
+*   must be followed by its 3 gotos.
+*
+* Variables are laid out in order of offset, then in order of declaration;
+* the offsets of the symbol table, if given, must match that layout.
+* Temporaries are placed where the memory dump shows them. Any other one is
+* allocated after them, when it is first met: 8 bytes wide if it holds a
+* fraction (i.e. it is written with t[k] = x, or it is the result of an
+* operation on a fraction), 4 bytes otherwise.
+*
+* The format has two ambiguities, which are resolved as follows:
+* - "t5 = x" at instruction 5 is the copy of x into the valuenumber of the
+*   instruction (printed as "t" and the valuenumber) if some instruction
+*   reads "(5)", or if the memory dump shows no temporary t5;
+* - "if a == b goto n" is the comparison of the values of a and b; for
+*   fractions this is equality as rational numbers.
+*
+* The other relations ("if a < b goto n", with "!=", "<=", ">" and ">=")
+* are read as printed.
+*/
+
+#include <map>
+#include <string>
+#include <vector>
+#include "tinycomp.hpp"
+
+using namespace std;
+
+/** Reads a program written in 3-address code.
+ */
+class TacAssembler {
+public:
+	/** A line of the input, as classified by its shape */
+	class Line {
+	public:
+		int number;
+		string text;
+	};
+
+private:
+	SimpleArraySymTbl* sym;
+
+	/* the reason why the program is not valid, if it is not */
+	string error;
+
+	vector<Line> symbols, decls, dump, instrs;
+
+	/* the temporaries met so far, by name, and those placed by the memory dump */
+	map<int, TempAddress*> temps;
+	map<int, bool> dumped;
+
+	/* Records an error at the given line; only the first one is kept */
+	void fail(int line, const string& why);
+
+	/* Puts the variables of the symbol table and of the declarations */
+	void putVars();
+
+	/* Places the temporaries shown by the memory dump */
+	void placeTemps();
+
+	/* Returns the temporary with the given name, allocating it (8 bytes wide if wide) if needed */
+	TempAddress* getTemp(int name, bool wide);
+
+	/* Returns true if an operand (as written) holds a fraction */
+	bool isFraction(const string& s);
+
+	/* Decodes an operand; a valuenumber "(n)" is returned as NULL, with its index in vn */
+	Address* getOperand(int line, const string& s, int& vn, bool wide = false);
+
+	/* Assembles the instructions */
+	void assemble(TargetCode* code);
+
+public:
+	/** Constructor: reads the file into code, sym and Memory, which must all be empty */
+	TacAssembler(const char* path, TargetCode* code, SimpleArraySymTbl* sym);
+
+	/** Returns true if the program has been read */
+	bool ok() const;
+
+	/** Returns the reason why the program could not be read */
+	const string& getError() const;
+};
+
+#endif //ASSEMBLER_HPP_
@@ -0,0 +1,774 @@
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include <climits>
+#include <string.h>
+
+#include <immintrin.h>
+
+using namespace std;
+
+#include "tinycomp.hpp"
+#include "interpreter.hpp"
+#include "batch.hpp"
+#include "timer.hpp"
+
+const int BatchInterpreter::lanes;
+
+static const int lanes = BatchInterpreter::lanes;
+
+/* The same conversion as the interpreter's: truncated, and INT_MIN if it does not fit */
+static int truncate(float f) {
+	return f > -2147483904.0f && f < 2147483648.0f ? (int)f : INT_MIN;
+}
+
+static float asFloat(int bits) {
+	float f;
+	memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+
+static int asInt(float f) {
+	int bits;
+	memcpy(&bits, &f, sizeof(bits));
+	return bits;
+}
+
+/***********/
+/* KERNELS */
+/***********/
+
+/* Each kernel works on the lanes of its cells, and only writes the lanes whose mask is -1
+ * (the others are 0); the comparisons set the mask of the lanes taking the jump in t, and
+ * return how many they are */
+class GenericKernels {
+public:
+	static void mov(int* d, const int* a, const int* m) {
+		for (int l = 0; l < lanes; l++) {
+			if (m[l]) {
+				d[l] = a[l];
+			}
+		}
+	}
+
+	static void intToFloat(int* d, const int* a, const int* m) {
+		for (int l = 0; l < lanes; l++) {
+			if (m[l]) {
+				d[l] = asInt((float)a[l]);
+			}
+		}
+	}
+
+	static void floatToInt(int* d, const int* a, const int* m) {
+		for (int l = 0; l < lanes; l++) {
+			if (m[l]) {
+				d[l] = truncate(asFloat(a[l]));
+			}
+		}
+	}
+
+	static void addInt(int* d, const int* a, const int* b, const int* m) {
+		for (int l = 0; l < lanes; l++) {
+			if (m[l]) {
+				d[l] = (int)((unsigned)a[l] + (unsigned)b[l]);
+			}
+		}
+	}
+
+	static void mulInt(int* d, const int* a, const int* b, const int* m) {
+		for (int l = 0; l < lanes; l++) {
+			if (m[l]) {
+				d[l] = (int)((unsigned)a[l] * (unsigned)b[l]);
+			}
+		}
+	}
+
+	static void addFloat(int* d, const int* a, const int* b, const int* m) {
+		for (int l = 0; l < lanes; l++) {
+			if (m[l]) {
+				d[l] = asInt(asFloat(a[l]) + asFloat(b[l]));
+			}
+		}
+	}
+
+	static void mulFloat(int* d, const int* a, const int* b, const int* m) {
+		for (int l = 0; l < lanes; l++) {
+			if (m[l]) {
+				d[l] = asInt(asFloat(a[l]) * asFloat(b[l]));
+			}
+		}
+	}
+
+	static void divFloat(int* d, const int* a, const int* b, const int* m) {
+		for (int l = 0; l < lanes; l++) {
+			if (m[l]) {
+				d[l] = asInt(asFloat(a[l]) / asFloat(b[l]));
+			}
+		}
+	}
+
+	static int eqInt(int* t, const int* a, const int* b, const int* m) {
+		int taken = 0;
+		for (int l = 0; l < lanes; l++) {
+			t[l] = m[l] && a[l] == b[l] ? -1 : 0;
+			taken -= t[l];
+		}
+		return taken;
+	}
+
+	static int eqFloat(int* t, const int* a, const int* b, const int* m) {
+		int taken = 0;
+		for (int l = 0; l < lanes; l++) {
+			t[l] = m[l] && asFloat(a[l]) == asFloat(b[l]) ? -1 : 0;
+			taken -= t[l];
+		}
+		return taken;
+	}
+
+	/* a1 and b1 are the second fields of a and b */
+	static int eqFields(int* t, const int* a, const int* a1, const int* b, const int* b1, const int* m) {
+		int taken = 0;
+		for (int l = 0; l < lanes; l++) {
+			t[l] = m[l] && a[l] == b[l] && a1[l] == b1[l] ? -1 : 0;
+			taken -= t[l];
+		}
+		return taken;
+	}
+
+	static int eqRational(int* t, const int* a, const int* a1, const int* b, const int* b1, const int* m) {
+		int taken = 0;
+		for (int l = 0; l < lanes; l++) {
+			t[l] = m[l] && (long long)a[l] * b1[l] == (long long)b[l] * a1[l] ? -1 : 0;
+			taken -= t[l];
+		}
+		return taken;
+	}
+
+	static int neInt(int* t, const int* a, const int* b, const int* m) {
+		int taken = 0;
+		for (int l = 0; l < lanes; l++) {
+			t[l] = m[l] && a[l] != b[l] ? -1 : 0;
+			taken -= t[l];
+		}
+		return taken;
+	}
+
+	static int neFloat(int* t, const int* a, const int* b, const int* m) {
+		int taken = 0;
+		for (int l = 0; l < lanes; l++) {
+			t[l] = m[l] && asFloat(a[l]) != asFloat(b[l]) ? -1 : 0;
+			taken -= t[l];
+		}
+		return taken;
+	}
+
+	static int neRational(int* t, const int* a, const int* a1, const int* b, const int* b1, const int* m) {
+		int taken = 0;
+		for (int l = 0; l < lanes; l++) {
+			t[l] = m[l] && (long long)a[l] * b1[l] != (long long)b[l] * a1[l] ? -1 : 0;
+			taken -= t[l];
+		}
+		return taken;
+	}
+
+	static int ltInt(int* t, const int* a, const int* b, const int* m) {
+		int taken = 0;
+		for (int l = 0; l < lanes; l++) {
+			t[l] = m[l] && a[l] < b[l] ? -1 : 0;
+			taken -= t[l];
+		}
+		return taken;
+	}
+
+	static int ltFloat(int* t, const int* a, const int* b, const int* m) {
+		int taken = 0;
+		for (int l = 0; l < lanes; l++) {
+			t[l] = m[l] && asFloat(a[l]) < asFloat(b[l]) ? -1 : 0;
+			taken -= t[l];
+		}
+		return taken;
+	}
+
+	static int ltRational(int* t, const int* a, const int* a1, const int* b, const int* b1, const int* m) {
+		int taken = 0;
+		for (int l = 0; l < lanes; l++) {
+			t[l] = m[l] && (long long)a[l] * b1[l] < (long long)b[l] * a1[l] ? -1 : 0;
+			taken -= t[l];
+		}
+		return taken;
+	}
+
+	static int leInt(int* t, const int* a, const int* b, const int* m) {
+		int taken = 0;
+		for (int l = 0; l < lanes; l++) {
+			t[l] = m[l] && a[l] <= b[l] ? -1 : 0;
+			taken -= t[l];
+		}
+		return taken;
+	}
+
+	static int leFloat(int* t, const int* a, const int* b, const int* m) {
+		int taken = 0;
+		for (int l = 0; l < lanes; l++) {
+			t[l] = m[l] && asFloat(a[l]) <= asFloat(b[l]) ? -1 : 0;
+			taken -= t[l];
+		}
+		return taken;
+	}
+
+	static int leRational(int* t, const int* a, const int* a1, const int* b, const int* b1, const int* m) {
+		int taken = 0;
+		for (int l = 0; l < lanes; l++) {
+			t[l] = m[l] && (long long)a[l] * b1[l] <= (long long)b[l] * a1[l] ? -1 : 0;
+			taken -= t[l];
+		}
+		return taken;
+	}
+};
+
+#define AVX2 __attribute__((target("avx2")))
+
+/* The same, 8 lanes at a time; the results are blended into the cells under the mask */
+class Avx2Kernels {
+private:
+	static AVX2 __m256i load(const int* p) {
+		return _mm256_loadu_si256((const __m256i*)p);
+	}
+
+	static AVX2 void store(int* d, __m256i v, __m256i m) {
+		_mm256_storeu_si256((__m256i*)d, _mm256_blendv_epi8(load(d), v, m));
+	}
+
+	static AVX2 int count(__m256i t) {
+		return __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(t)));
+	}
+
+	/* Stores the lanes taking the jump in t; returns how many they are */
+	static AVX2 int taken(int* t, __m256i r) {
+		_mm256_storeu_si256((__m256i*)t, r);
+		return count(r);
+	}
+
+	/* The lanes where a and b compare as the predicate of vcmpps says */
+	template <int predicate>
+	static AVX2 __m256i floatCompare(const int* a, const int* b) {
+		return _mm256_castps_si256(_mm256_cmp_ps(_mm256_castsi256_ps(load(a)), _mm256_castsi256_ps(load(b)), predicate));
+	}
+
+	/* The lanes where n1 * d2 == n2 * d1 in 64 bits: the even lanes, then the odd ones shifted down onto them */
+	static AVX2 __m256i crossEqual(__m256i n1, __m256i d1, __m256i n2, __m256i d2) {
+		__m256i even = _mm256_cmpeq_epi64(_mm256_mul_epi32(n1, d2), _mm256_mul_epi32(n2, d1));
+		__m256i odd = _mm256_cmpeq_epi64(
+			_mm256_mul_epi32(_mm256_srli_epi64(n1, 32), _mm256_srli_epi64(d2, 32)),
+			_mm256_mul_epi32(_mm256_srli_epi64(n2, 32), _mm256_srli_epi64(d1, 32)));
+		return _mm256_blend_epi32(even, odd, 0xAA);
+	}
+
+	/* The lanes where n1 * d2 < n2 * d1 in 64 bits, as above */
+	static AVX2 __m256i crossLess(__m256i n1, __m256i d1, __m256i n2, __m256i d2) {
+		__m256i even = _mm256_cmpgt_epi64(_mm256_mul_epi32(n2, d1), _mm256_mul_epi32(n1, d2));
+		__m256i odd = _mm256_cmpgt_epi64(
+			_mm256_mul_epi32(_mm256_srli_epi64(n2, 32), _mm256_srli_epi64(d1, 32)),
+			_mm256_mul_epi32(_mm256_srli_epi64(n1, 32), _mm256_srli_epi64(d2, 32)));
+		return _mm256_blend_epi32(even, odd, 0xAA);
+	}
+
+public:
+	static AVX2 void mov(int* d, const int* a, const int* m) {
+		for (int l = 0; l < lanes; l += 8) {
+			store(d + l, load(a + l), load(m + l));
+		}
+	}
+
+	static AVX2 void intToFloat(int* d, const int* a, const int* m) {
+		for (int l = 0; l < lanes; l += 8) {
+			store(d + l, _mm256_castps_si256(_mm256_cvtepi32_ps(load(a + l))), load(m + l));
+		}
+	}
+
+	static AVX2 void floatToInt(int* d, const int* a, const int* m) {
+		// cvttps2dq gives INT_MIN for what does not fit, as cvttss2si does
+		for (int l = 0; l < lanes; l += 8) {
+			store(d + l, _mm256_cvttps_epi32(_mm256_castsi256_ps(load(a + l))), load(m + l));
+		}
+	}
+
+	static AVX2 void addInt(int* d, const int* a, const int* b, const int* m) {
+		for (int l = 0; l < lanes; l += 8) {
+			store(d + l, _mm256_add_epi32(load(a + l), load(b + l)), load(m + l));
+		}
+	}
+
+	static AVX2 void mulInt(int* d, const int* a, const int* b, const int* m) {
+		for (int l = 0; l < lanes; l += 8) {
+			store(d + l, _mm256_mullo_epi32(load(a + l), load(b + l)), load(m + l));
+		}
+	}
+
+	static AVX2 void addFloat(int* d, const int* a, const int* b, const int* m) {
+		for (int l = 0; l < lanes; l += 8) {
+			__m256 r = _mm256_add_ps(_mm256_castsi256_ps(load(a + l)), _mm256_castsi256_ps(load(b + l)));
+			store(d + l, _mm256_castps_si256(r), load(m + l));
+		}
+	}
+
+	static AVX2 void mulFloat(int* d, const int* a, const int* b, const int* m) {
+		for (int l = 0; l < lanes; l += 8) {
+			__m256 r = _mm256_mul_ps(_mm256_castsi256_ps(load(a + l)), _mm256_castsi256_ps(load(b + l)));
+			store(d + l, _mm256_castps_si256(r), load(m + l));
+		}
+	}
+
+	static AVX2 void divFloat(int* d, const int* a, const int* b, const int* m) {
+		for (int l = 0; l < lanes; l += 8) {
+			__m256 r = _mm256_div_ps(_mm256_castsi256_ps(load(a + l)), _mm256_castsi256_ps(load(b + l)));
+			store(d + l, _mm256_castps_si256(r), load(m + l));
+		}
+	}
+
+	static AVX2 int eqInt(int* t, const int* a, const int* b, const int* m) {
+		int taken = 0;
+		for (int l = 0; l < lanes; l += 8) {
+			__m256i r = _mm256_and_si256(_mm256_cmpeq_epi32(load(a + l), load(b + l)), load(m + l));
+			_mm256_storeu_si256((__m256i*)(t + l), r);
+			taken += count(r);
+		}
+		return taken;
+	}
+
+	static AVX2 int eqFloat(int* t, const int* a, const int* b, const int* m) {
+		int taken = 0;
+		for (int l = 0; l < lanes; l += 8) {
+			// ordered: NaN is not equal to anything
+			__m256 eq = _mm256_cmp_ps(_mm256_castsi256_ps(load(a + l)), _mm256_castsi256_ps(load(b + l)), _CMP_EQ_OQ);
+			__m256i r = _mm256_and_si256(_mm256_castps_si256(eq), load(m + l));
+			_mm256_storeu_si256((__m256i*)(t + l), r);
+			taken += count(r);
+		}
+		return taken;
+	}
+
+	static AVX2 int eqFields(int* t, const int* a, const int* a1, const int* b, const int* b1, const int* m) {
+		int taken = 0;
+		for (int l = 0; l < lanes; l += 8) {
+			__m256i r = _mm256_and_si256(_mm256_cmpeq_epi32(load(a + l), load(b + l)),
+				_mm256_cmpeq_epi32(load(a1 + l), load(b1 + l)));
+			r = _mm256_and_si256(r, load(m + l));
+			_mm256_storeu_si256((__m256i*)(t + l), r);
+			taken += count(r);
+		}
+		return taken;
+	}
+
+	static AVX2 int eqRational(int* t, const int* a, const int* a1, const int* b, const int* b1, const int* m) {
+		int n = 0;
+		for (int l = 0; l < lanes; l += 8) {
+			__m256i r = crossEqual(load(a + l), load(a1 + l), load(b + l), load(b1 + l));
+			n += taken(t + l, _mm256_and_si256(r, load(m + l)));
+		}
+		return n;
+	}
+
+	static AVX2 int neInt(int* t, const int* a, const int* b, const int* m) {
+		int n = 0;
+		for (int l = 0; l < lanes; l += 8) {
+			n += taken(t + l, _mm256_andnot_si256(_mm256_cmpeq_epi32(load(a + l), load(b + l)), load(m + l)));
+		}
+		return n;
+	}
+
+	static AVX2 int neFloat(int* t, const int* a, const int* b, const int* m) {
+		int n = 0;
+		for (int l = 0; l < lanes; l += 8) {
+			// unordered: NaN is not equal to anything
+			n += taken(t + l, _mm256_and_si256(floatCompare<_CMP_NEQ_UQ>(a + l, b + l), load(m + l)));
+		}
+		return n;
+	}
+
+	static AVX2 int neRational(int* t, const int* a, const int* a1, const int* b, const int* b1, const int* m) {
+		int n = 0;
+		for (int l = 0; l < lanes; l += 8) {
+			__m256i r = crossEqual(load(a + l), load(a1 + l), load(b + l), load(b1 + l));
+			n += taken(t + l, _mm256_andnot_si256(r, load(m + l)));
+		}
+		return n;
+	}
+
+	static AVX2 int ltInt(int* t, const int* a, const int* b, const int* m) {
+		int n = 0;
+		for (int l = 0; l < lanes; l += 8) {
+			n += taken(t + l, _mm256_and_si256(_mm256_cmpgt_epi32(load(b + l), load(a + l)), load(m + l)));
+		}
+		return n;
+	}
+
+	static AVX2 int ltFloat(int* t, const int* a, const int* b, const int* m) {
+		int n = 0;
+		for (int l = 0; l < lanes; l += 8) {
+			n += taken(t + l, _mm256_and_si256(floatCompare<_CMP_LT_OQ>(a + l, b + l), load(m + l)));
+		}
+		return n;
+	}
+
+	static AVX2 int ltRational(int* t, const int* a, const int* a1, const int* b, const int* b1, const int* m) {
+		int n = 0;
+		for (int l = 0; l < lanes; l += 8) {
+			__m256i r = crossLess(load(a + l), load(a1 + l), load(b + l), load(b1 + l));
+			n += taken(t + l, _mm256_and_si256(r, load(m + l)));
+		}
+		return n;
+	}
+
+	static AVX2 int leInt(int* t, const int* a, const int* b, const int* m) {
+		int n = 0;
+		for (int l = 0; l < lanes; l += 8) {
+			n += taken(t + l, _mm256_andnot_si256(_mm256_cmpgt_epi32(load(a + l), load(b + l)), load(m + l)));
+		}
+		return n;
+	}
+
+	static AVX2 int leFloat(int* t, const int* a, const int* b, const int* m) {
+		int n = 0;
+		for (int l = 0; l < lanes; l += 8) {
+			n += taken(t + l, _mm256_and_si256(floatCompare<_CMP_LE_OQ>(a + l, b + l), load(m + l)));
+		}
+		return n;
+	}
+
+	static AVX2 int leRational(int* t, const int* a, const int* a1, const int* b, const int* b1, const int* m) {
+		int n = 0;
+		for (int l = 0; l < lanes; l += 8) {
+			// not n2 * d1 < n1 * d2
+			__m256i r = crossLess(load(b + l), load(b1 + l), load(a + l), load(a1 + l));
+			n += taken(t + l, _mm256_andnot_si256(r, load(m + l)));
+		}
+		return n;
+	}
+};
+
+/*************/
+/* EXECUTION */
+/*************/
+
+BatchInterpreter::BatchInterpreter(Interpreter& interpreter, bool simd) : interpreter(interpreter) {
+	avx2 = simd && __builtin_cpu_supports("avx2");
+	instances = sparseInstances = 0;
+	batchMillis = scalarMillis = 0;
+}
+
+bool BatchInterpreter::usesAvx2() const {
+	return avx2;
+}
+
+int BatchInterpreter::imageCells() const {
+	return interpreter.memCells;
+}
+
+/* The lanes set in a mask */
+static int countLanes(const vector<int>& mask) {
+	int n = 0;
+	for (int l = 0; l < lanes; l++) {
+		n -= mask[l];
+	}
+	return n;
+}
+
+/* Adds the lanes of from to into, which may still be empty */
+static void merge(vector<int>& into, const vector<int>& from) {
+	if (into.empty()) {
+		into = from;
+		return;
+	}
+	for (int l = 0; l < lanes; l++) {
+		into[l] |= from[l];
+	}
+}
+
+void BatchInterpreter::runLanes(vector<int>& soa, const vector<int>& mask, int pc, int* status) {
+	int cells = interpreter.initial.size();
+	vector<int> cell(cells);
+
+	for (int l = 0; l < lanes; l++) {
+		if (!mask[l]) {
+			continue;
+		}
+		for (int c = 0; c < cells; c++) {
+			cell[c] = soa[c * lanes + l];
+		}
+		status[l] = interpreter.execute<false, false>(&cell[0], pc);
+		for (int c = 0; c < interpreter.memCells; c++) {
+			soa[c * lanes + l] = cell[c];
+		}
+		sparseInstances++;
+	}
+}
+
+/* Runs count (up to lanes) instances: the lanes of mask, active of them, are at operation pc;
+ * those a branch has sent elsewhere wait in pending, by operation. The lowest operation always
+ * runs first, so that the lanes leaving a loop wait after it for the others, and lanes reaching
+ * an operation where others wait run on together. When fewer than sparseLanes lanes, and fewer
+ * than the group started with, are left at an operation, they go on one by one instead */
+template <class Kernels>
+void BatchInterpreter::runGroup(int* images, int* status, int count) {
+	const vector<Interpreter::Op>& ops = interpreter.ops;
+	const vector<int>& initial = interpreter.initial;
+	int memCells = interpreter.memCells;
+	int cells = initial.size();
+
+	// cell c of lane l is soa[c * lanes + l]; the lanes past count do not run at all
+	vector<int> soa(cells * lanes);
+	for (int c = 0; c < cells; c++) {
+		for (int l = 0; l < lanes; l++) {
+			soa[c * lanes + l] = c < memCells && l < count ? images[l * memCells + c] : initial[c];
+		}
+	}
+
+	vector<int> mask(lanes, 0);
+	vector<int> taken(lanes, 0);
+	for (int l = 0; l < count; l++) {
+		mask[l] = -1;
+		status[l] = 0;
+	}
+	int active = count;
+	map< int, vector<int> > pending;
+	int pc = 0;
+	int fewest = min(count, (int)sparseLanes);
+
+	for (;;) {
+		// a vector operation costs the same for any number of lanes, and each split and join of
+		// the lanes costs a few of them: once a branch or a loop exit leaves too few lanes
+		// running together, going on one by one is faster
+		if (active > 0 && active < fewest) {
+			runLanes(soa, mask, pc, status);
+			mask.assign(lanes, 0);
+			active = 0;
+		}
+		if (active == 0) {
+			if (pending.empty()) {
+				break;
+			}
+			map< int, vector<int> >::iterator w = pending.begin();
+			pc = w->first;
+			mask.swap(w->second);
+			pending.erase(w);
+			active = countLanes(mask);
+			continue;
+		}
+
+		const Interpreter::Op& o = ops[pc];
+		int* m = &mask[0];
+		int* d = &soa[o.dst * lanes];
+		const int* a = &soa[o.a * lanes];
+		const int* b = &soa[o.b * lanes];
+		int next = pc + 1;
+
+		switch (o.kind) {
+			case Interpreter::nopKind:
+				break;
+			case Interpreter::haltKind:
+				// the lanes retire
+				active = 0;
+				break;
+			case Interpreter::jmpKind:
+				next = o.dst;
+				break;
+			case Interpreter::movKind:
+				Kernels::mov(d, a, m);
+				break;
+			case Interpreter::mov2Kind:
+				Kernels::mov(d, a, m);
+				Kernels::mov(d + lanes, a + lanes, m);
+				break;
+			case Interpreter::intToFloatKind:
+				Kernels::intToFloat(d, a, m);
+				break;
+			case Interpreter::floatToIntKind:
+				Kernels::floatToInt(d, a, m);
+				break;
+			case Interpreter::addIntKind:
+				Kernels::addInt(d, a, b, m);
+				break;
+			case Interpreter::mulIntKind:
+				Kernels::mulInt(d, a, b, m);
+				break;
+			case Interpreter::divIntKind:
+				// no vector division of ints: lane by lane, retiring the lanes dividing by zero
+				for (int l = 0; l < lanes; l++) {
+					if (!m[l]) {
+						continue;
+					}
+					if (b[l] == 0) {
+						status[l] = 1;
+						m[l] = 0;
+						active--;
+					} else {
+						d[l] = b[l] == -1 ? (int)(0u - (unsigned)a[l]) : a[l] / b[l];
+					}
+				}
+				break;
+			case Interpreter::addFloatKind:
+				Kernels::addFloat(d, a, b, m);
+				break;
+			case Interpreter::mulFloatKind:
+				Kernels::mulFloat(d, a, b, m);
+				break;
+			case Interpreter::divFloatKind:
+				Kernels::divFloat(d, a, b, m);
+				break;
+			case Interpreter::tableKind: {
+				// lane by lane: each goes to its own goto, or to the target
+				map< int, vector<int> > to;
+				for (int l = 0; l < lanes; l++) {
+					if (m[l]) {
+						int target = (unsigned)a[l] < (unsigned)b[l] ? pc + 1 + a[l] : o.dst;
+						vector<int>& lanesTo = to[target];
+						lanesTo.resize(lanes, 0);
+						lanesTo[l] = -1;
+					}
+				}
+
+				if (to.size() == 1) {
+					next = to.begin()->first;
+				} else {
+					// the lanes part ways: all of them wait at their targets
+					for (map< int, vector<int> >::iterator t = to.begin(); t != to.end(); ++t) {
+						merge(pending[t->first], t->second);
+					}
+					mask.assign(lanes, 0);
+					active = 0;
+				}
+				break;
+			}
+			default: {
+				int n;
+				int* t = &taken[0];
+				switch (o.kind) {
+					case Interpreter::eqIntKind:
+						n = Kernels::eqInt(t, a, b, m);
+						break;
+					case Interpreter::eqFloatKind:
+						n = Kernels::eqFloat(t, a, b, m);
+						break;
+					case Interpreter::eqFieldsKind:
+						n = Kernels::eqFields(t, a, a + lanes, b, b + lanes, m);
+						break;
+					case Interpreter::eqRationalKind:
+						n = Kernels::eqRational(t, a, a + lanes, b, b + lanes, m);
+						break;
+					case Interpreter::neIntKind:
+						n = Kernels::neInt(t, a, b, m);
+						break;
+					case Interpreter::neFloatKind:
+						n = Kernels::neFloat(t, a, b, m);
+						break;
+					case Interpreter::neRationalKind:
+						n = Kernels::neRational(t, a, a + lanes, b, b + lanes, m);
+						break;
+					case Interpreter::ltIntKind:
+						n = Kernels::ltInt(t, a, b, m);
+						break;
+					case Interpreter::ltFloatKind:
+						n = Kernels::ltFloat(t, a, b, m);
+						break;
+					case Interpreter::ltRationalKind:
+						n = Kernels::ltRational(t, a, a + lanes, b, b + lanes, m);
+						break;
+					case Interpreter::leIntKind:
+						n = Kernels::leInt(t, a, b, m);
+						break;
+					case Interpreter::leFloatKind:
+						n = Kernels::leFloat(t, a, b, m);
+						break;
+					default:
+						n = Kernels::leRational(t, a, a + lanes, b, b + lanes, m);
+						break;
+				}
+
+				if (n == active) {
+					next = o.dst;
+				} else if (n > 0) {
+					// the lanes part ways: those jumping wait at the target
+					merge(pending[o.dst], taken);
+					for (int l = 0; l < lanes; l++) {
+						m[l] &= ~taken[l];
+					}
+					active -= n;
+				}
+				break;
+			}
+		}
+
+		if (active > 0 && !pending.empty() && pending.begin()->first <= next) {
+			// lanes wait at a lower operation, which goes first, or at next, where they join
+			map< int, vector<int> >::iterator w = pending.begin();
+			if (w->first < next) {
+				merge(pending[next], mask);
+				mask.swap(w->second);
+			} else {
+				merge(mask, w->second);
+			}
+			pc = w->first;
+			pending.erase(w);
+			active = countLanes(mask);
+		} else {
+			pc = next;
+		}
+	}
+
+	for (int l = 0; l < count; l++) {
+		for (int c = 0; c < memCells; c++) {
+			images[l * memCells + c] = soa[c * lanes + l];
+		}
+	}
+}
+
+void BatchInterpreter::run(vector<int>& images, vector<int>& status) {
+	int memCells = interpreter.memCells;
+	instances = images.size() / memCells;
+	sparseInstances = 0;
+	status.assign(instances, 0);
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for (int first = 0; first < instances; first += lanes) {
+		int count = min(lanes, instances - first);
+		if (avx2) {
+			runGroup<Avx2Kernels>(&images[first * memCells], &status[first], count);
+		} else {
+			runGroup<GenericKernels>(&images[first * memCells], &status[first], count);
+		}
+	}
+	batchMillis = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+void BatchInterpreter::runScalar(vector<int>& images, vector<int>& status) {
+	int memCells = interpreter.memCells;
+	instances = images.size() / memCells;
+	status.assign(instances, 0);
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	vector<int> cell;
+	for (int k = 0; k < instances; k++) {
+		cell = interpreter.initial;
+		memcpy(&cell[0], &images[k * memCells], 4 * memCells);
+		status[k] = interpreter.execute<false, false>(&cell[0]);
+		memcpy(&images[k * memCells], &cell[0], 4 * memCells);
+	}
+	scalarMillis = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+/* Instances per second, from a run of ms milliseconds */
+static double rate(int instances, double ms) {
+	return ms > 0 ? instances * 1000.0 / ms : 0;
+}
+
+void BatchInterpreter::printReport(ostream& out) const {
+	out << "batch: " << instances << " instances, " << lanes << " lanes per group, "
+		<< (avx2 ? "AVX2" : "generic") << " kernels, run in " << batchMillis << " ms ("
+		<< (long long)rate(instances, batchMillis) << " instances/s), " << sparseInstances
+		<< " finished one by one" << endl;
+	out << "scalar: run in " << scalarMillis << " ms (" << (long long)rate(instances, scalarMillis)
+		<< " instances/s), batch speedup " << (batchMillis > 0 ? scalarMillis / batchMillis : 0) << "x" << endl;
+}
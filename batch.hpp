@@ -0,0 +1,87 @@
+#ifndef BATCH_HPP_
+#define BATCH_HPP_
+
+/**
+* @file batch.hpp
+* @brief This header file contains the batch interpreter of tinycomp, which runs
+* the same program over many instances of its input at once (see --batch).
+*
+* Every instance is a Memory image of its own. The instances run in groups of
+* lanes: the cells of a group (those of the interpreter, see interpreter.hpp)
+* are stored in structure-of-arrays form, the lanes of each cell side by side,
+* so that one operation of the decoded code runs across all the lanes of the
+* group with vector instructions. The arithmetic and the comparisons have AVX2
+* kernels, used when the processor has it, and plain loops otherwise; integer
+* division, which AVX2 does not have, goes lane by lane.
+*
+* The lanes start together, and stay together as long as every branch goes the
+* same way for all of them. A branch taken by some lanes only splits the group:
+* from then on, the lanes at the lowest operation run first, under a mask, the
+* others waiting, until they all meet again at the same operation (usually as
+* the last of them leaves a loop). A lane retires on HALT, or on a division by
+* zero, while the others go on. When so few lanes run together that most of
+* each vector operation would be wasted, they leave the group and go on to the
+* end one by one, with the plain interpreter.
+*
+* The instances take their values from their images only: a program with
+* "read" cannot run in a batch.
+*/
+
+#include <iostream>
+#include <vector>
+#include "interpreter.hpp"
+
+using namespace std;
+
+/** Runs the 3-addr code over many Memory images, a group of lanes at a time.
+ */
+class BatchInterpreter {
+private:
+	Interpreter& interpreter;
+	bool avx2;
+
+	/* the last runs: instances, how many of them left their group, and how long each way took */
+	int instances;
+	int sparseInstances;
+	double batchMillis;
+	double scalarMillis;
+
+	template <class Kernels> void runGroup(int* images, int* status, int count);
+
+	/* Runs the lanes of mask, which are at operation pc, to the end one by one */
+	void runLanes(vector<int>& soa, const vector<int>& mask, int pc, int* status);
+
+	// Stop the compiler from generating methods of copy the object
+	BatchInterpreter(BatchInterpreter const& copy);            // Not to be implemented
+	BatchInterpreter& operator=(BatchInterpreter const& copy); // Not to be implemented
+
+public:
+	/** The lanes of a group */
+	static const int lanes = 256;
+
+	/** The fewest lanes running together in a group once it has split; fewer go on one by one */
+	static const int sparseLanes = lanes * 3 / 4;
+
+	/** Constructor: runs the code decoded by interpreter, with the AVX2 kernels if simd
+	 *  is true and the processor has AVX2 */
+	BatchInterpreter(Interpreter& interpreter, bool simd);
+
+	/** Returns true if the AVX2 kernels are used */
+	bool usesAvx2() const;
+
+	/** Returns the number of cells of a Memory image */
+	int imageCells() const;
+
+	/** Runs the program once per instance: images holds the Memory images the instances start
+	 *  from, imageCells() cells each, and receives their final values; status receives 0, or 1
+	 *  on a division by zero, for each instance */
+	void run(vector<int>& images, vector<int>& status);
+
+	/** The same, one instance after the other, with the plain interpreter */
+	void runScalar(vector<int>& images, vector<int>& status);
+
+	/** Prints the throughput of the last runs, in instances per second */
+	void printReport(ostream& out) const;
+};
+
+#endif //BATCH_HPP_
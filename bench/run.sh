@@ -0,0 +1,171 @@
+#!/bin/bash
+# Compile-throughput benchmark of tinycomp (see "make bench").
+#
+# Generates a corpus of synthetic programs with tcgen, compiles each one and
+# reports lines/sec, 3-addr instructions/sec and the peak RSS of the compiler,
+# against the figures stored in the baseline. A case is a regression when its
+# throughput drops below MIN_SPEED of the baseline, or its peak RSS grows past
+# MAX_RSS of it; the script then exits with status 1.
+#
+# usage: bench/run.sh [--update]     (--update rewrites the baseline)
+#
+# Environment:
+#   BENCH_SIZES     statement counts compiled at -O0 (default: 1000 10000 100000;
+#                   up to 10000000, which needs ~10 GB of memory)
+#   BENCH_O2_SIZES  statement counts compiled at -O2 (default: 250 1000 4000, empty for none; the
+#                   dataflow analyses of the optimizer grow with blocks times cells, and take tens
+#                   of seconds past 10000)
+#   BENCH_RUNS      runs per program, the fastest one counts (default: 3)
+#   BENCH_BASELINE  the baseline file (default: bench/baseline)
+#   BENCH_COUNTERS  if set, each program is also compiled and run natively once with --counters,
+#                   and the IPC and misses per 1000 instructions of lexing, parsing (with code
+#                   generation), optimization and execution are printed under its line; the
+#                   counters do not take part in the comparison against the baseline
+
+TINYCOMP=${TINYCOMP:-./tinycomp}
+TCGEN=${TCGEN:-bench/tcgen}
+SIZES=${BENCH_SIZES:-"1000 10000 100000"}
+O2_SIZES=${BENCH_O2_SIZES-"250 1000 4000"}
+RUNS=${BENCH_RUNS:-3}
+BASELINE=${BENCH_BASELINE:-bench/baseline}
+
+MIN_SPEED=0.8
+MAX_RSS=1.25
+
+# the shapes of the corpus: a name, and the options of tcgen
+CASES="mixed:-d 3 -o 3
+flat:-d 0
+deep:-d 6 -b 4
+orchain:-d 2 -o 8
+fraction:-d 2 -m 20,20,60"
+
+update=0
+if [[ "$1" == "--update" ]]; then
+	update=1
+elif [[ -n "$1" ]]; then
+	echo "usage: $0 [--update]" >&2
+	exit 2
+fi
+
+if [[ ! -x $TINYCOMP || ! -x $TCGEN ]]; then
+	echo "$0: build $TINYCOMP and $TCGEN first (make compiler bench/tcgen)" >&2
+	exit 2
+fi
+
+corpus=$(mktemp -d)
+trap 'rm -rf "$corpus"' EXIT
+
+results=$corpus/results
+regressions=0
+
+# prints the hardware counters of the phases of a --counters JSON report, or why there are none
+counters() {
+	awk '
+	function value(key) {
+		return match($0, "\"" key "\": [0-9]+") ? substr($0, RSTART + length(key) + 4, RLENGTH - length(key) - 4) : ""
+	}
+	function perKilo(key) {
+		return value(key) == "" ? "-" : sprintf("%.2f", 1000 * value(key) / value("instructions"))
+	}
+	/"counters_error"/ {
+		match($0, /"counters_error": "[^"]*"/)
+		print "    hardware counters unavailable: " substr($0, RSTART + 19, RLENGTH - 20)
+		exit 1
+	}
+	/"counters"/ {
+		match($0, /"name": "[^"]*"/)
+		name = substr($0, RSTART + 9, RLENGTH - 10)
+		if ((name == "lex" || name == "parse" || name == "optimize" || name == "run") && !(name in seen) \
+				&& value("instructions") > 0) {
+			seen[name] = 1
+			printf "    %-9s IPC %5.2f  br-miss/ki %7s  L1d-miss/ki %7s  LLC-miss/ki %7s\n", name,
+				value("instructions") / value("cycles"), perKilo("branch_misses"), perKilo("l1d_misses"),
+				perKilo("llc_misses")
+		}
+	}' "$1"
+}
+
+printf "%-9s %9s %4s %10s %10s %10s %12s %12s %10s  %s\n" case statements opt lines instrs "time (ms)" \
+	lines/s instrs/s "RSS (KB)" "vs baseline"
+
+while IFS=: read -r name options; do
+	for size in $(echo $SIZES $O2_SIZES | tr ' ' '\n' | sort -nu); do
+		program=$corpus/$name-$size.tc
+		$TCGEN -n $size $options > $program || exit 2
+		lines=$(wc -l < $program)
+
+		opts=""
+		if [[ " $SIZES " == *" $size "* ]]; then
+			opts="-O0"
+		fi
+		if [[ " $O2_SIZES " == *" $size "* ]]; then
+			opts="$opts -O2"
+		fi
+
+		for opt in $opts; do
+			best=""
+			rss=0
+			for ((r = 0; r < RUNS; r++)); do
+				if ! $TINYCOMP $opt --time-report=json < $program > $corpus/listing 2> $corpus/report; then
+					echo "$name/$size $opt: compilation failed" >&2
+					head -3 $corpus/report >&2
+					exit 2
+				fi
+
+				# the root of the report, after the messages of the passes:
+				# {"name": "total", "ms": ..., "peak_rss_kb": ..., ...
+				read -r ms kb < <(sed -n '/^{"name": "total"/s/.*"ms": \([0-9.]*\).*"peak_rss_kb": \([0-9]*\).*/\1 \2/p' \
+					$corpus/report)
+				if [[ -z "$best" ]] || awk "BEGIN { exit !($ms < $best) }"; then
+					best=$ms
+				fi
+				if ((kb > rss)); then
+					rss=$kb
+				fi
+			done
+
+			instrs=$(grep -cE '^ *[0-9]+: ' $corpus/listing)
+			read -r lps ips < <(awk "BEGIN { printf \"%d %d\", $lines * 1000 / $best, $instrs * 1000 / $best }")
+			echo "$name $size $opt $lps $ips $rss" >> $results
+
+			verdict="-"
+			base=$(grep -s "^$name $size $opt " $BASELINE)
+			if [[ -n "$base" ]]; then
+				read -r _ _ _ blps bips brss <<< "$base"
+				verdict=$(awk "BEGIN {
+					s = $lps / $blps; m = $rss / $brss;
+					printf \"%.2fx speed, %.2fx RSS\", s, m;
+					if (s < $MIN_SPEED || $ips / $bips < $MIN_SPEED) printf \"  REGRESSION (speed)\";
+					if (m > $MAX_RSS) printf \"  REGRESSION (RSS)\";
+				}")
+				if [[ "$verdict" == *REGRESSION* ]]; then
+					regressions=$((regressions + 1))
+				fi
+			fi
+
+			printf "%-9s %9d %4s %10d %10d %10.1f %12d %12d %10d  %s\n" $name $size $opt $lines $instrs \
+				$best $lps $ips $rss "$verdict"
+
+			if [[ -n "$BENCH_COUNTERS" ]]; then
+				$TINYCOMP $opt --native --time-report=json --counters < $program > /dev/null 2> $corpus/report
+				# no counters here, no counters for the other programs either
+				counters $corpus/report || BENCH_COUNTERS=
+			fi
+		done
+	done
+done <<< "$CASES"
+
+if ((update)); then
+	{
+		echo "# tinycomp compile-throughput baseline, written by bench/run.sh --update"
+		echo "# case statements opt lines/s instrs/s peak-RSS(KB)"
+		cat $results
+	} > $BASELINE
+	echo "baseline written to $BASELINE"
+	exit 0
+fi
+
+if ((regressions > 0)); then
+	echo "$regressions regression(s) against $BASELINE"
+	exit 1
+fi
@@ -0,0 +1,281 @@
+/**
+* @file tcgen.cpp
+* @brief A generator of synthetic tinycomp programs, for benchmarking the
+* compiler on programs of any size (see "make bench").
+*
+* The programs use every construct the compiler handles but "read", which would
+* need an input: assignments of int, float and fraction expressions, "print",
+* "while", "if" (with or without "else", and with "likely" or "unlikely" hints)
+* and "switch" statements nested up to a given depth, conditions comparing ints,
+* floats and fractions with all the relational operators and "=", combined
+* with "true", "false", "!", "&&", parentheses and chains of "||".
+* Every loop terminates: the loop at depth k counts its iterations in a
+* variable of its own, and ends after a fixed number of them; the inner
+* loops run again at each iteration of the outer ones, so the running time
+* of a program grows as iterations^depth.
+*
+* Variables are fixed: a-f are ints, g-l the loop counters, m-p floats, q-t
+* fractions, u-z the loop flags.
+*
+* Usage: tcgen [-n statements] [-d depth] [-o or-chain] [-m int,float,fraction]
+*              [-b block] [-i iterations] [-s seed]
+*/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace std;
+
+/* The options */
+long numStmts = 1000;		/* -n: the number of statements, control statements included */
+int maxDepth = 2;			/* -d: the maximum nesting of "while", "if" and "switch" (at most 6) */
+int orChain = 1;			/* -o: the maximum number of terms joined by "||" in a condition */
+int mix[3] = { 70, 15, 15 };	/* -m: the weights of int, float and fraction assignments */
+int blockLen = 8;			/* -b: the average number of statements in a block */
+int iterations = 3;			/* -i: the number of iterations of each loop */
+
+/* the statements still to be generated */
+long budget;
+
+/* Returns a random number in [0, n) */
+static int rnd(int n) {
+	return rand() % n;
+}
+
+/* Returns a variable of the given kind, by its first letter and the number of them */
+static char var(char first, int count) {
+	return first + rnd(count);
+}
+
+static char intVar() { return var('a', 6); }
+static char floatVar() { return var('m', 4); }
+static char fractionVar() { return var('q', 4); }
+
+/* Returns an int operand: a variable or a small constant */
+static string intOperand() {
+	stringstream s;
+	if (rnd(3) == 0) {
+		s << rnd(10);
+	} else {
+		s << intVar();
+	}
+	return s.str();
+}
+
+/* Returns the right-hand side of an assignment to a variable of the given type */
+static string expr(int type) {
+	stringstream s;
+
+	switch (type) {
+		case 0: {
+			// sums of products of ints: "+" and "*" are what ints support
+			s << intOperand();
+			int terms = rnd(3);
+			for (int t = 0; t < terms; t++) {
+				s << (rnd(2) == 0 ? " + " : " * ") << intOperand();
+			}
+			break;
+		}
+		case 1:
+			// floats support "*" only, with floats on both sides
+			switch (rnd(3)) {
+				case 0: s << floatVar() << " * " << floatVar(); break;
+				case 1: s << floatVar() << " * " << rnd(3) << "." << 5; break;
+				default: s << intVar(); break;
+			}
+			break;
+		default:
+			switch (rnd(4)) {
+				case 0: s << fractionVar() << " * " << fractionVar(); break;
+				case 1: s << fractionVar() << " * " << 1 + rnd(4) << "|" << 1 + rnd(4); break;
+				case 2: s << fractionVar() << " * " << intVar(); break;
+				default: s << 1 + rnd(9) << "|" << 1 + rnd(9); break;
+			}
+			break;
+	}
+
+	return s.str();
+}
+
+/* Returns a comparison of two values of the same type */
+static string compare() {
+	static const char* ops[] = { "==", "!=", "<", "<=", ">", ">=" };
+	stringstream s;
+
+	switch (rnd(8)) {
+		case 0: s << floatVar() << " " << ops[rnd(6)] << " " << floatVar(); break;
+		case 1: s << fractionVar() << " " << ops[rnd(6)] << " " << fractionVar(); break;
+		case 2: s << intVar() << " = " << intOperand(); break;
+		default: s << intVar() << " " << ops[rnd(6)] << " " << intOperand(); break;
+	}
+
+	return s.str();
+}
+
+/* Returns a condition made of up to orChain terms: comparisons, constants, negations
+ * and conjunctions */
+static string cond() {
+	stringstream s;
+	int n = 1 + rnd(orChain);
+
+	for (int c = 0; c < n; c++) {
+		if (c > 0) {
+			s << " || ";
+		}
+		switch (rnd(12)) {
+			case 0: s << (rnd(2) == 0 ? "true" : "false"); break;
+			case 1: s << "!(" << compare() << ")"; break;
+			case 2: s << compare() << " && " << compare(); break;
+			case 3: s << "(" << compare() << " || " << compare() << ") && " << compare(); break;
+			default: s << compare(); break;
+		}
+	}
+
+	return s.str();
+}
+
+/* Returns the hint of an "if", if any */
+static string hint() {
+	switch (rnd(6)) {
+		case 0: return "likely ";
+		case 1: return "unlikely ";
+		default: return "";
+	}
+}
+
+/* Returns an indentation */
+static string indent(int depth) {
+	return string(2 * depth, ' ');
+}
+
+static void block(int depth);
+
+/* Generates a statement at the given depth */
+static void stmt(int depth) {
+	budget--;
+
+	// a block opens once in blockLen statements, when there is room for it
+	if (depth < maxDepth && budget > 2 && rnd(blockLen) == 0) {
+		int kind = rnd(5);
+
+		if (kind < 2) {
+			char counter = 'g' + depth;
+			char flag = 'u' + depth;
+			cout << indent(depth) << counter << " := 0;" << endl;
+			cout << indent(depth) << flag << " := 0;" << endl;
+			cout << indent(depth) << "while (" << flag << " == 0) {" << endl;
+			block(depth + 1);
+			cout << indent(depth + 1) << counter << " := " << counter << " + 1;" << endl;
+			cout << indent(depth + 1) << "if (" << counter << " == " << iterations << ") then {" << endl;
+			cout << indent(depth + 2) << flag << " := 1;" << endl;
+			cout << indent(depth + 1) << "};" << endl;
+			cout << indent(depth) << "};" << endl;
+			budget -= 5;
+		} else if (kind < 4) {
+			cout << indent(depth) << "if " << hint() << "(" << cond() << ") then {" << endl;
+			block(depth + 1);
+			if (rnd(2) == 0) {
+				cout << indent(depth) << "} else {" << endl;
+				block(depth + 1);
+			}
+			cout << indent(depth) << "};" << endl;
+		} else {
+			// runs of consecutive cases (dispatched by a jump table) with gaps between them
+			int cases = 1 + rnd(6);
+			int value = rnd(4);
+
+			cout << indent(depth) << "switch (" << (rnd(2) == 0 ? string(1, intVar()) : expr(0)) << ") {" << endl;
+			for (int c = 0; c < cases; c++) {
+				cout << indent(depth) << "case " << value << ":" << endl;
+				block(depth + 1);
+				value += rnd(4) == 0 ? 2 + rnd(20) : 1;
+			}
+			if (rnd(2) == 0) {
+				cout << indent(depth) << "default:" << endl;
+				block(depth + 1);
+			}
+			cout << indent(depth) << "};" << endl;
+		}
+		return;
+	}
+
+	int pick = rnd(mix[0] + mix[1] + mix[2]);
+	int type = pick < mix[0] ? 0 : (pick < mix[0] + mix[1] ? 1 : 2);
+
+	// now and then, print the value instead of assigning it
+	if (rnd(16) == 0) {
+		cout << indent(depth) << "print " << expr(type) << ";" << endl;
+		return;
+	}
+
+	char target = type == 0 ? intVar() : (type == 1 ? floatVar() : fractionVar());
+	cout << indent(depth) << target << " := " << expr(type) << ";" << endl;
+}
+
+/* Generates the statements of a block: about blockLen of them, and at least one */
+static void block(int depth) {
+	do {
+		stmt(depth);
+	} while (budget > 0 && rnd(blockLen) != 0);
+}
+
+int main(int argc, char** argv) {
+	unsigned int seed = 1;
+
+	for (int i = 1; i < argc; i++) {
+		const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+
+		if (strcmp(argv[i], "-n") == 0 && value != NULL) {
+			numStmts = atol(value);
+		} else if (strcmp(argv[i], "-d") == 0 && value != NULL) {
+			maxDepth = atoi(value);
+		} else if (strcmp(argv[i], "-o") == 0 && value != NULL) {
+			orChain = atoi(value);
+		} else if (strcmp(argv[i], "-m") == 0 && value != NULL) {
+			if (sscanf(value, "%d,%d,%d", &mix[0], &mix[1], &mix[2]) != 3) {
+				value = NULL;
+			}
+		} else if (strcmp(argv[i], "-b") == 0 && value != NULL) {
+			blockLen = atoi(value);
+		} else if (strcmp(argv[i], "-i") == 0 && value != NULL) {
+			iterations = atoi(value);
+		} else if (strcmp(argv[i], "-s") == 0 && value != NULL) {
+			seed = atoi(value);
+		} else {
+			value = NULL;
+		}
+
+		if (value == NULL || numStmts < 1 || maxDepth < 0 || maxDepth > 6 || orChain < 1 || blockLen < 1
+				|| iterations < 1 || mix[0] < 0 || mix[1] < 0 || mix[2] < 0 || mix[0] + mix[1] + mix[2] == 0) {
+			cerr << "Usage: " << argv[0] << " [-n statements] [-d depth (0-6)] [-o or-chain] "
+				<< "[-m int,float,fraction] [-b block] [-i iterations] [-s seed]" << endl;
+			return 1;
+		}
+		i++;
+	}
+
+	srand(seed);
+	budget = numStmts;
+
+	cout << "// generated by: tcgen -n " << numStmts << " -d " << maxDepth << " -o " << orChain << " -m "
+		<< mix[0] << "," << mix[1] << "," << mix[2] << " -b " << blockLen << " -i " << iterations
+		<< " -s " << seed << endl;
+	cout << "int a, b, c, d, e, f, g, h, i, j, k, l, u, v, w, x, y, z;" << endl;
+	cout << "float m, n, o, p;" << endl;
+	cout << "fraction q, r, s, t;" << endl;
+
+	// start from values that keep the expressions away from zero
+	cout << "a := 1;" << endl << "b := 2;" << endl << "m := 1.5;" << endl << "n := 0.5;" << endl;
+	cout << "q := 1|2;" << endl << "r := 3|4;" << endl;
+
+	while (budget > 0) {
+		stmt(0);
+	}
+
+	return 0;
+}
@@ -0,0 +1,267 @@
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+#include <elf.h>
+
+using namespace std;
+
+#include "elf.hpp"
+
+/* The sections of the object, in the order of their headers */
+enum { secNull, secText, secRelaText, secData, secBss, secRodata, secNoteStack,
+	secSymtab, secStrtab, secShstrtab, numSections };
+
+/* The symbols of the object: the sections the relocations refer to, then the globals */
+enum { symNull, symText, symData, symBss, symRodata, symMain, symPrintf, numSymbols };
+
+ElfObject::ElfObject(TargetCode* code, SimpleArraySymTbl* sym, bool allocate, bool select) {
+	NativeCode native(code, allocate, select);
+
+	text = native.getBytes();
+	while (text.size() % 16 != 0) {
+		text.push_back(0xCC);	// int3
+	}
+	mainOffset = text.size();
+
+	Memory& mem = Memory::getInstance();
+	unsigned char* image = (unsigned char*)mem.retrieve(0);
+	data.assign(image, image + mem.getUsed());
+
+	bssSize = 8 * (code->getNextInstr() + 1);
+
+	genMain(sym);
+}
+
+int ElfObject::addString(const string& s) {
+	int offset = rodata.size();
+	rodata.insert(rodata.end(), s.begin(), s.end());
+	rodata.push_back(0);
+	return offset;
+}
+
+void ElfObject::relocate(const X86Encoder& as, int sym, int type, int offset) {
+	Reloc r;
+	r.offset = mainOffset + as.size() - 4;
+	r.sym = sym;
+	r.type = type;
+	// the displacement is relative to the end of the instruction, i.e. of the rel32
+	r.addend = offset - 4;
+	relocs.push_back(r);
+}
+
+void ElfObject::genMain(SimpleArraySymTbl* sym) {
+	X86Encoder as;
+
+	/* status = program(memory, slots); rbx is callee-saved, and pushing it aligns the stack */
+	as.push(X86Encoder::rbx);
+	as.lea(X86Encoder::rdi, Operand::rip(0));
+	relocate(as, symData, R_X86_64_PC32, 0);
+	as.lea(X86Encoder::rsi, Operand::rip(0));
+	relocate(as, symBss, R_X86_64_PC32, 0);
+	as.callRel32();
+	relocate(as, symText, R_X86_64_PC32, 0);
+	as.mov(Operand::r(X86Encoder::rbx), Operand::r(X86Encoder::rax));
+
+	/* print the variables as SimpleArraySymTbl::printValues() does; al holds the number of
+	 * vector registers used by the variadic call */
+	for (char c = 'a'; c <= 'z'; c++) {
+		VarAddress* v = sym->get(c);
+		if (v == NULL) {
+			continue;
+		}
+
+		string name = v->toString();
+		int offset = v->getOffset();
+
+		switch (v->getType()) {
+			case intType:
+				as.lea(X86Encoder::rdi, Operand::rip(0));
+				relocate(as, symRodata, R_X86_64_PC32, addString(name + " = %d\n"));
+				as.mov(Operand::r(X86Encoder::rsi), Operand::rip(0));
+				relocate(as, symData, R_X86_64_PC32, offset);
+				as.mov(Operand::r(X86Encoder::rax), Operand::imm(0));
+				break;
+			case floatType:
+				as.lea(X86Encoder::rdi, Operand::rip(0));
+				relocate(as, symRodata, R_X86_64_PC32, addString(name + " = %2.2f\n"));
+				as.cvtss2sd(0, Operand::rip(0));
+				relocate(as, symData, R_X86_64_PC32, offset);
+				as.mov(Operand::r(X86Encoder::rax), Operand::imm(1));
+				break;
+			default:
+				as.lea(X86Encoder::rdi, Operand::rip(0));
+				relocate(as, symRodata, R_X86_64_PC32, addString(name + " = %d|%d\n"));
+				as.mov(Operand::r(X86Encoder::rsi), Operand::rip(0));
+				relocate(as, symData, R_X86_64_PC32, offset);
+				as.mov(Operand::r(X86Encoder::rdx), Operand::rip(0));
+				relocate(as, symData, R_X86_64_PC32, offset + 4);
+				as.mov(Operand::r(X86Encoder::rax), Operand::imm(0));
+				break;
+		}
+		as.callRel32();
+		relocate(as, symPrintf, R_X86_64_PLT32, 0);
+	}
+
+	int done = as.newLabel();
+	as.test(X86Encoder::rbx, X86Encoder::rbx);
+	as.jcc(X86Encoder::condE, done);
+	as.lea(X86Encoder::rdi, Operand::rip(0));
+	relocate(as, symRodata, R_X86_64_PC32, addString("stopped: division by zero\n"));
+	as.mov(Operand::r(X86Encoder::rax), Operand::imm(0));
+	as.callRel32();
+	relocate(as, symPrintf, R_X86_64_PLT32, 0);
+	as.bind(done);
+
+	as.mov(Operand::r(X86Encoder::rax), Operand::r(X86Encoder::rbx));
+	as.pop(X86Encoder::rbx);
+	as.ret();
+	as.finish();
+
+	text.insert(text.end(), as.getBytes().begin(), as.getBytes().end());
+}
+
+/* Appends the bytes of a value to a buffer */
+template <class T>
+static void append(vector<unsigned char>& out, const T& value) {
+	const unsigned char* p = (const unsigned char*)&value;
+	out.insert(out.end(), p, p + sizeof(T));
+}
+
+/* Pads a buffer with zeroes to a multiple of align, returning the new size */
+static size_t alignTo(vector<unsigned char>& out, size_t align) {
+	while (out.size() % align != 0) {
+		out.push_back(0);
+	}
+	return out.size();
+}
+
+/* Adds a name to a string table, returning its offset */
+static int addName(vector<unsigned char>& table, const char* name) {
+	int offset = table.size();
+	table.insert(table.end(), name, name + strlen(name) + 1);
+	return offset;
+}
+
+bool ElfObject::write(const char* path) const {
+	/* String tables */
+	vector<unsigned char> strtab(1, 0);
+	int mainName = addName(strtab, "main");
+	int printfName = addName(strtab, "printf");
+
+	vector<unsigned char> shstrtab(1, 0);
+	const char* names[numSections] = { "", ".text", ".rela.text", ".data", ".bss", ".rodata",
+		".note.GNU-stack", ".symtab", ".strtab", ".shstrtab" };
+	int nameOffset[numSections];
+	for (int s = 0; s < numSections; s++) {
+		nameOffset[s] = s == secNull ? 0 : addName(shstrtab, names[s]);
+	}
+
+	/* Symbols: the locals (the section symbols) come before the globals */
+	vector<unsigned char> symtab;
+	for (int i = 0; i < numSymbols; i++) {
+		Elf64_Sym s;
+		memset(&s, 0, sizeof(s));
+
+		switch (i) {
+			case symText:
+			case symData:
+			case symBss:
+			case symRodata: {
+				static const int sections[] = { 0, secText, secData, secBss, secRodata };
+				s.st_info = ELF64_ST_INFO(STB_LOCAL, STT_SECTION);
+				s.st_shndx = sections[i];
+				break;
+			}
+			case symMain:
+				s.st_name = mainName;
+				s.st_info = ELF64_ST_INFO(STB_GLOBAL, STT_FUNC);
+				s.st_shndx = secText;
+				s.st_value = mainOffset;
+				s.st_size = text.size() - mainOffset;
+				break;
+			case symPrintf:
+				s.st_name = printfName;
+				s.st_info = ELF64_ST_INFO(STB_GLOBAL, STT_NOTYPE);
+				s.st_shndx = SHN_UNDEF;
+				break;
+			default:
+				break;
+		}
+		append(symtab, s);
+	}
+
+	vector<unsigned char> rela;
+	for (size_t r = 0; r < relocs.size(); r++) {
+		Elf64_Rela e;
+		e.r_offset = relocs[r].offset;
+		e.r_info = ELF64_R_INFO(relocs[r].sym, relocs[r].type);
+		e.r_addend = relocs[r].addend;
+		append(rela, e);
+	}
+
+	/* Section headers; the contents follow the ELF header, in the order of the headers */
+	Elf64_Shdr sh[numSections];
+	memset(sh, 0, sizeof(sh));
+
+	const vector<unsigned char>* contents[numSections] = { NULL, &text, &rela, &data, NULL, &rodata,
+		NULL, &symtab, &strtab, &shstrtab };
+	const int types[numSections] = { SHT_NULL, SHT_PROGBITS, SHT_RELA, SHT_PROGBITS, SHT_NOBITS,
+		SHT_PROGBITS, SHT_PROGBITS, SHT_SYMTAB, SHT_STRTAB, SHT_STRTAB };
+	const int flags[numSections] = { 0, SHF_ALLOC | SHF_EXECINSTR, SHF_INFO_LINK, SHF_ALLOC | SHF_WRITE,
+		SHF_ALLOC | SHF_WRITE, SHF_ALLOC, 0, 0, 0, 0 };
+	const int aligns[numSections] = { 0, 16, 8, 16, 8, 1, 1, 8, 1, 1 };
+
+	vector<unsigned char> file(sizeof(Elf64_Ehdr), 0);
+	for (int s = 1; s < numSections; s++) {
+		sh[s].sh_name = nameOffset[s];
+		sh[s].sh_type = types[s];
+		sh[s].sh_flags = flags[s];
+		sh[s].sh_addralign = aligns[s];
+		sh[s].sh_offset = alignTo(file, aligns[s]);
+
+		if (contents[s] != NULL) {
+			sh[s].sh_size = contents[s]->size();
+			file.insert(file.end(), contents[s]->begin(), contents[s]->end());
+		}
+	}
+	sh[secBss].sh_size = bssSize;
+
+	sh[secRelaText].sh_link = secSymtab;
+	sh[secRelaText].sh_info = secText;
+	sh[secRelaText].sh_entsize = sizeof(Elf64_Rela);
+	sh[secSymtab].sh_link = secStrtab;
+	sh[secSymtab].sh_info = symMain;	// the first global symbol
+	sh[secSymtab].sh_entsize = sizeof(Elf64_Sym);
+
+	size_t shoff = alignTo(file, 8);
+	for (int s = 0; s < numSections; s++) {
+		append(file, sh[s]);
+	}
+
+	/* ELF header */
+	Elf64_Ehdr eh;
+	memset(&eh, 0, sizeof(eh));
+	memcpy(eh.e_ident, ELFMAG, SELFMAG);
+	eh.e_ident[EI_CLASS] = ELFCLASS64;
+	eh.e_ident[EI_DATA] = ELFDATA2LSB;
+	eh.e_ident[EI_VERSION] = EV_CURRENT;
+	eh.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+	eh.e_type = ET_REL;
+	eh.e_machine = EM_X86_64;
+	eh.e_version = EV_CURRENT;
+	eh.e_shoff = shoff;
+	eh.e_ehsize = sizeof(Elf64_Ehdr);
+	eh.e_shentsize = sizeof(Elf64_Shdr);
+	eh.e_shnum = numSections;
+	eh.e_shstrndx = secShstrtab;
+	memcpy(&file[0], &eh, sizeof(eh));
+
+	FILE* f = fopen(path, "wb");
+	if (f == NULL) {
+		return false;
+	}
+	bool ok = fwrite(&file[0], 1, file.size(), f) == file.size();
+	return fclose(f) == 0 && ok;
+}
@@ -0,0 +1,68 @@
+#ifndef ELF_HPP_
+#define ELF_HPP_
+
+/**
+* @file elf.hpp
+* @brief This header file contains the object file writer of tinycomp:
+* it turns the code compiled by the native backend into a relocatable
+* x86-64 ELF object, which the system linker links into an executable.
+*
+* The object holds:
+* - .text: the compiled program, followed by main(), which runs it on the
+*   Memory image and prints the final value of each variable with printf,
+*   as --native does; main() returns 1 if the program stops because of a
+*   division by zero, 0 otherwise;
+* - .data: the Memory image, as left by the compiler (variables and temporaries);
+* - .bss: the valuenumber slots;
+* - .rodata: the printf formats.
+* The only external symbol is printf, e.g. "cc prog.o -o prog" links it.
+*/
+
+#include <string>
+#include <vector>
+#include "tinycomp.hpp"
+#include "native.hpp"
+
+using namespace std;
+
+/** A relocatable x86-64 ELF object for a compiled program.
+ */
+class ElfObject {
+private:
+	/* the contents of the sections */
+	vector<unsigned char> text;
+	vector<unsigned char> data;
+	vector<unsigned char> rodata;
+	int bssSize;
+
+	/* the offset of main() in .text */
+	int mainOffset;
+
+	/* a relocation of .text: the 4 bytes at offset refer to sym + addend */
+	class Reloc {
+	public:
+		int offset;
+		int sym;
+		int type;
+		long addend;
+	};
+	vector<Reloc> relocs;
+
+	/* Adds a string to .rodata, returning its offset */
+	int addString(const string& s);
+
+	/* Relocates the rel32 just emitted at the end of the encoder, to sym + offset */
+	void relocate(const X86Encoder& as, int sym, int type, int offset);
+
+	/* Generates main() */
+	void genMain(SimpleArraySymTbl* sym);
+
+public:
+	/** Constructor: compiles the code; allocate and select are as for NativeCode */
+	ElfObject(TargetCode* code, SimpleArraySymTbl* sym, bool allocate, bool select);
+
+	/** Writes the object to a file; returns false if it cannot be written */
+	bool write(const char* path) const;
+};
+
+#endif //ELF_HPP_
@@ -0,0 +1,788 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <climits>
+#include <string.h>
+
+#include <assert.h>
+
+using namespace std;
+
+#include "tinycomp.hpp"
+#include "optimizer.hpp"
+#include "interpreter.hpp"
+#include "runtime.hpp"
+#include "timer.hpp"
+
+/* The names of the operators, for the opcode mix */
+static const char* opNames[] = {
+	"UNKNOWN", "halt", "copy", "add", "mul", "div", "indexCopy", "offset", "jmp",
+	"eq1condJmp", "eq2condJmp", "neCondJmp", "ltCondJmp", "leCondJmp", "gtCondJmp", "geCondJmp",
+	"jmpTable", "read", "print", "fake"
+};
+
+/* Returns the constant int index of x[i] or x[i] = y, or -1 if it is not a constant */
+static int fieldIndex(Address* a) {
+	ConstAddress* c = dynamic_cast<ConstAddress*>(a);
+	if (c != NULL && c->getType() == intType) {
+		return c->getIntVal();
+	}
+	return -1;
+}
+
+static float getFloat(const int* cell, int c) {
+	float f;
+	memcpy(&f, &cell[c], sizeof(f));
+	return f;
+}
+
+static void setFloat(int* cell, int c, float f) {
+	memcpy(&cell[c], &f, sizeof(f));
+}
+
+/* A float converted to int as cvttss2si does: truncated, and INT_MIN if it does not fit */
+static int truncate(float f) {
+	return f > -2147483904.0f && f < 2147483648.0f ? (int)f : INT_MIN;
+}
+
+/************/
+/* DECODING */
+/************/
+
+Interpreter::Interpreter(TargetCode* code) : types(code) {
+	TimeScope t("decode");
+	this->code = code;
+
+	int n = code->getNextInstr();
+
+	vnRead.assign(n, false);
+	for (int i = 0; i < n; i++) {
+		TacInstr* instr = code->getInstr(i);
+		Address* ops[2] = { instr->getOperand1(), instr->getOperand2() };
+
+		for (int k = 0; k < 2; k++) {
+			if (InstrAddress* ia = dynamic_cast<InstrAddress*>(ops[k])) {
+				vnRead[ia->getIndex()] = true;
+			}
+		}
+	}
+
+	/* two scalars, then two fractions whose denominator is always 1: enough for the
+	 * conversions of the operands of any instruction */
+	memCells = (Memory::getInstance().getUsed() + 3) / 4;
+	vnBase = memCells;
+	scratch = vnBase + 2 * n;
+	initial.assign(scratch + 6, 0);
+	initial[scratch + 3] = 1;
+	initial[scratch + 5] = 1;
+
+	for (int i = 0; i < n; i++) {
+		firstOp.push_back(ops.size());
+		decode(i);
+	}
+	firstOp.push_back(ops.size());
+
+	/* jumps go to the first operation of their destination */
+	for (size_t k = 0; k < ops.size(); k++) {
+		if (ops[k].kind == jmpKind || ops[k].kind >= eqIntKind) {
+			ops[k].dst = firstOp[ops[k].dst];
+		}
+	}
+
+	counts.assign(ops.size(), 0);
+	cycles.assign(ops.size(), 0);
+	totalCycles = 0;
+
+	osrThreshold = 0;
+	osrOp = osrEntry = -1;
+	jitBytes = 0;
+	jitMillis = 0;
+}
+
+int Interpreter::size() const {
+	return ops.size();
+}
+
+typeName Interpreter::typeOf(Address* a) const {
+	typeName t;
+	if (types.typeOf(a, t)) {
+		return t;
+	}
+	// a temporary never written
+	TempAddress* tmp = dynamic_cast<TempAddress*>(a);
+	return tmp != NULL && tmp->getWidth() == 8 ? fractionType : intType;
+}
+
+int Interpreter::constCell(int value) {
+	map<int, int>::iterator it = constCells.find(value);
+	if (it != constCells.end()) {
+		return it->second;
+	}
+
+	initial.push_back(value);
+	constCells[value] = initial.size() - 1;
+	return initial.size() - 1;
+}
+
+int Interpreter::constPair(int num, int denom) {
+	pair<int, int> key(num, denom);
+	map< pair<int, int>, int >::iterator it = pairCells.find(key);
+	if (it != pairCells.end()) {
+		return it->second;
+	}
+
+	initial.push_back(num);
+	initial.push_back(denom);
+	pairCells[key] = initial.size() - 2;
+	return initial.size() - 2;
+}
+
+/* Returns the cell of the 4-byte field (0 or 4) of a value */
+int Interpreter::cellOf(Address* a, int field) {
+	if (ConstAddress* c = dynamic_cast<ConstAddress*>(a)) {
+		switch (c->getType()) {
+			case intType:
+				return constCell(c->getIntVal());
+			case floatType: {
+				float f = c->getFloatVal();
+				int bits;
+				memcpy(&bits, &f, sizeof(bits));
+				return constCell(bits);
+			}
+			default:
+				return constPair(c->getFractionVal().num, c->getFractionVal().denom) + field / 4;
+		}
+	}
+	if (InstrAddress* ia = dynamic_cast<InstrAddress*>(a)) {
+		return vnBase + 2 * ia->getIndex() + field / 4;
+	}
+	if (VarAddress* v = dynamic_cast<VarAddress*>(a)) {
+		assert(field < v->getWidth());
+		return (v->getOffset() + field) / 4;
+	}
+
+	TempAddress* t = dynamic_cast<TempAddress*>(a);
+	assert(t != NULL && field < t->getWidth());
+	return (t->getOffset() + field) / 4;
+}
+
+void Interpreter::emit(int kind, int dst, int a, int b) {
+	Op op;
+	op.kind = kind;
+	op.dst = dst;
+	op.a = a;
+	op.b = b;
+	op.instr = firstOp.size() - 1;
+	ops.push_back(op);
+}
+
+/* Returns the cell holding a value converted to int; into is used if it must be computed */
+int Interpreter::toInt(Address* a, int into) {
+	if (typeOf(a) != floatType) {
+		// a fraction yields its numerator
+		return cellOf(a, 0);
+	}
+	emit(floatToIntKind, into, cellOf(a, 0), 0);
+	return into;
+}
+
+/* Returns the cell holding a value converted to float; into is used if it must be computed */
+int Interpreter::toFloat(Address* a, int into) {
+	if (typeOf(a) == floatType) {
+		return cellOf(a, 0);
+	}
+	emit(intToFloatKind, into, cellOf(a, 0), 0);
+	return into;
+}
+
+/* Returns the first of the two cells holding a value converted to fraction; into is used,
+ * with the cell after it holding 1, if it must be computed */
+int Interpreter::toFraction(Address* a, int into) {
+	if (typeOf(a) == fractionType) {
+		return cellOf(a, 0);
+	}
+	if (typeOf(a) == floatType) {
+		emit(floatToIntKind, into, cellOf(a, 0), 0);
+	} else {
+		emit(movKind, into, cellOf(a, 0), 0);
+	}
+	return into;
+}
+
+/* dst = src, converting src to the type of dst */
+void Interpreter::decodeCopy(Address* dst, Address* src) {
+	int d = cellOf(dst, 0);
+
+	switch (typeOf(dst)) {
+		case floatType:
+			emit(typeOf(src) == floatType ? movKind : intToFloatKind, d, cellOf(src, 0), 0);
+			break;
+		case intType:
+			emit(typeOf(src) == floatType ? floatToIntKind : movKind, d, cellOf(src, 0), 0);
+			break;
+		case fractionType:
+			if (typeOf(src) == fractionType) {
+				emit(mov2Kind, d, cellOf(src, 0), 0);
+			} else {
+				emit(typeOf(src) == floatType ? floatToIntKind : movKind, d, cellOf(src, 0), 0);
+				emit(movKind, d + 1, constCell(1), 0);
+			}
+			break;
+	}
+}
+
+void Interpreter::decode(int i) {
+	TacInstr* instr = code->getInstr(i);
+	Address* op1 = instr->getOperand1();
+	Address* op2 = instr->getOperand2();
+	InstrAddress* vn = instr->getValueNumber();
+	size_t start = ops.size();
+
+	switch (instr->getOp()) {
+		case copyOpr:
+			if (op2 != NULL) {
+				decodeCopy(op1, op2);
+			}
+			if (vnRead[i]) {
+				decodeCopy(vn, op1);
+			}
+			break;
+		case addOpr:
+		case mulOpr:
+		case divOpr: {
+			int d = cellOf(instr->getTemp(), 0);
+			int kind = instr->getOp() == addOpr ? addIntKind : (instr->getOp() == mulOpr ? mulIntKind : divIntKind);
+
+			if (typeOf(op1) == floatType || typeOf(op2) == floatType) {
+				int a = toFloat(op1, scratch);
+				int b = toFloat(op2, scratch + 1);
+				emit(kind - addIntKind + addFloatKind, d, a, b);
+			} else {
+				int a = toInt(op1, scratch);
+				int b = toInt(op2, scratch + 1);
+				emit(kind, d, a, b);
+			}
+			if (vnRead[i]) {
+				emit(movKind, cellOf(vn, 0), d, 0);
+			}
+			break;
+		}
+		case offsetOpr: { /* temp = op1[k] */
+			int k = fieldIndex(op2);
+			// the front end only generates constant field offsets
+			assert(k == 0 || k == 4);
+
+			int d = cellOf(instr->getTemp(), 0);
+			emit(movKind, d, cellOf(op1, k), 0);
+			if (vnRead[i]) {
+				emit(movKind, cellOf(vn, 0), d, 0);
+			}
+			break;
+		}
+		case indexCopyOpr: { /* temp[k] = op2 */
+			int k = fieldIndex(op1);
+			assert(k == 0 || k == 4);
+
+			int d = cellOf(instr->getTemp(), k);
+			emit(typeOf(op2) == floatType ? floatToIntKind : movKind, d, cellOf(op2, 0), 0);
+			break;
+		}
+		case jmpOpr:
+			emit(jmpKind, instr->getDestInstr()->getIndex(), 0, 0);
+			break;
+		case eq1condJmpOpr:
+		case eq2condJmpOpr: {
+			int target = instr->getDestInstr()->getIndex();
+			typeName t1 = typeOf(op1);
+			typeName t2 = typeOf(op2);
+
+			if (t1 == fractionType || t2 == fractionType) {
+				int a = toFraction(op1, scratch + 2);
+				int b = toFraction(op2, scratch + 4);
+				emit(instr->getOp() == eq2condJmpOpr ? eqFieldsKind : eqRationalKind, target, a, b);
+			} else if (t1 == floatType || t2 == floatType) {
+				int a = toFloat(op1, scratch);
+				int b = toFloat(op2, scratch + 1);
+				emit(eqFloatKind, target, a, b);
+			} else {
+				emit(eqIntKind, target, cellOf(op1, 0), cellOf(op2, 0));
+			}
+			break;
+		}
+		case neCondJmpOpr:
+		case ltCondJmpOpr:
+		case leCondJmpOpr:
+		case gtCondJmpOpr:
+		case geCondJmpOpr: {
+			int target = instr->getDestInstr()->getIndex();
+			oprEnum op = instr->getOp();
+			typeName t1 = typeOf(op1);
+			typeName t2 = typeOf(op2);
+
+			// a > b is b < a, and a >= b is b <= a
+			if (op == gtCondJmpOpr || op == geCondJmpOpr) {
+				swap(op1, op2);
+				swap(t1, t2);
+				op = op == gtCondJmpOpr ? ltCondJmpOpr : leCondJmpOpr;
+			}
+			int kind = op == neCondJmpOpr ? neIntKind : (op == ltCondJmpOpr ? ltIntKind : leIntKind);
+
+			// the kinds of each relation go int, float, fraction
+			if (t1 == fractionType || t2 == fractionType) {
+				int a = toFraction(op1, scratch + 2);
+				int b = toFraction(op2, scratch + 4);
+				emit(kind + 2, target, a, b);
+			} else if (t1 == floatType || t2 == floatType) {
+				int a = toFloat(op1, scratch);
+				int b = toFloat(op2, scratch + 1);
+				emit(kind + 1, target, a, b);
+			} else {
+				emit(kind, target, cellOf(op1, 0), cellOf(op2, 0));
+			}
+			break;
+		}
+		case jmpTableOpr:
+			// each of the gotos that follow is a single jmp
+			emit(tableKind, instr->getDestInstr()->getIndex(), toInt(op1, scratch), constCell(instr->tableSize()));
+			break;
+		case readOpr: {
+			typeName t = typeOf(op1);
+			emit(t == intType ? readIntKind : (t == floatType ? readFloatKind : readFractionKind), cellOf(op1, 0), 0, 0);
+			break;
+		}
+		case printOpr: {
+			typeName t = typeOf(op1);
+			emit(t == intType ? printIntKind : (t == floatType ? printFloatKind : printFractionKind), 0, cellOf(op1, 0), 0);
+			break;
+		}
+		case haltOpr:
+			emit(haltKind, 0, 0, 0);
+			break;
+		default:
+			// "stat" does nothing
+			break;
+	}
+
+	// every instruction is executed, and counted, even when there is nothing to do
+	if (ops.size() == start) {
+		emit(nopKind, 0, 0, 0);
+	}
+}
+
+/*************/
+/* EXECUTION */
+/*************/
+
+/* The dispatch loop; the profiling one charges each operation with the cycles
+ * elapsed until the next one starts, the tiered one stops at the header of a hot loop */
+template <bool profiling, bool tiered>
+int Interpreter::execute(int* cell, int pc) {
+	const Op* op = &ops[0];
+	int status = 0;
+	int from = -1;
+
+	unsigned long long start = 0, last = 0;
+	int prev = -1;
+	if (profiling) {
+		start = last = PhaseTimer::now();
+	}
+
+	for (;;) {
+		// pc only goes back through a jump, to the header of a loop
+		if (tiered) {
+			if (pc <= from && ++backEdges[pc] >= osrThreshold) {
+				osrOp = pc;
+				status = osrStatus;
+				goto done;
+			}
+			from = pc;
+		}
+
+		const Op& o = op[pc];
+
+		if (profiling) {
+			unsigned long long now = PhaseTimer::now();
+			if (prev >= 0) {
+				cycles[prev] += now - last;
+			}
+			last = now;
+			prev = pc;
+			counts[pc]++;
+		}
+
+		switch (o.kind) {
+			case nopKind:
+				pc++;
+				break;
+			case haltKind:
+				goto done;
+			case jmpKind:
+				pc = o.dst;
+				break;
+			case movKind:
+				cell[o.dst] = cell[o.a];
+				pc++;
+				break;
+			case mov2Kind:
+				cell[o.dst] = cell[o.a];
+				cell[o.dst + 1] = cell[o.a + 1];
+				pc++;
+				break;
+			case intToFloatKind:
+				setFloat(cell, o.dst, (float)cell[o.a]);
+				pc++;
+				break;
+			case floatToIntKind:
+				cell[o.dst] = truncate(getFloat(cell, o.a));
+				pc++;
+				break;
+			case addIntKind:
+				// wrapping around, as the machine does
+				cell[o.dst] = (int)((unsigned)cell[o.a] + (unsigned)cell[o.b]);
+				pc++;
+				break;
+			case mulIntKind:
+				cell[o.dst] = (int)((unsigned)cell[o.a] * (unsigned)cell[o.b]);
+				pc++;
+				break;
+			case divIntKind:
+				if (cell[o.b] == 0) {
+					status = 1;
+					goto done;
+				}
+				// x / -1 is a negation (INT_MIN / -1 would trap)
+				cell[o.dst] = cell[o.b] == -1 ? (int)(0u - (unsigned)cell[o.a]) : cell[o.a] / cell[o.b];
+				pc++;
+				break;
+			case addFloatKind:
+				setFloat(cell, o.dst, getFloat(cell, o.a) + getFloat(cell, o.b));
+				pc++;
+				break;
+			case mulFloatKind:
+				setFloat(cell, o.dst, getFloat(cell, o.a) * getFloat(cell, o.b));
+				pc++;
+				break;
+			case divFloatKind:
+				setFloat(cell, o.dst, getFloat(cell, o.a) / getFloat(cell, o.b));
+				pc++;
+				break;
+			case readIntKind:
+				InputReader::readInt(&cell[o.dst]);
+				pc++;
+				break;
+			case readFloatKind:
+				InputReader::readFloat(&cell[o.dst]);
+				pc++;
+				break;
+			case readFractionKind:
+				InputReader::readFraction(&cell[o.dst]);
+				pc++;
+				break;
+			case printIntKind:
+				OutputWriter::printInt(cell[o.a]);
+				pc++;
+				break;
+			case printFloatKind:
+				OutputWriter::printFloat(getFloat(cell, o.a));
+				pc++;
+				break;
+			case printFractionKind:
+				OutputWriter::printFraction(cell[o.a], cell[o.a + 1]);
+				pc++;
+				break;
+			case eqIntKind:
+				pc = cell[o.a] == cell[o.b] ? o.dst : pc + 1;
+				break;
+			case eqFloatKind:
+				// unordered (NaN) operands are not equal
+				pc = getFloat(cell, o.a) == getFloat(cell, o.b) ? o.dst : pc + 1;
+				break;
+			case eqFieldsKind:
+				pc = cell[o.a] == cell[o.b] && cell[o.a + 1] == cell[o.b + 1] ? o.dst : pc + 1;
+				break;
+			case eqRationalKind:
+				// n1 * d2 == n2 * d1, in 64 bits
+				pc = (long long)cell[o.a] * cell[o.b + 1] == (long long)cell[o.b] * cell[o.a + 1] ? o.dst : pc + 1;
+				break;
+			case neIntKind:
+				pc = cell[o.a] != cell[o.b] ? o.dst : pc + 1;
+				break;
+			case neFloatKind:
+				// unordered (NaN) operands are not equal
+				pc = getFloat(cell, o.a) != getFloat(cell, o.b) ? o.dst : pc + 1;
+				break;
+			case neRationalKind:
+				pc = (long long)cell[o.a] * cell[o.b + 1] != (long long)cell[o.b] * cell[o.a + 1] ? o.dst : pc + 1;
+				break;
+			case ltIntKind:
+				pc = cell[o.a] < cell[o.b] ? o.dst : pc + 1;
+				break;
+			case ltFloatKind:
+				// unordered (NaN) operands are neither smaller nor larger
+				pc = getFloat(cell, o.a) < getFloat(cell, o.b) ? o.dst : pc + 1;
+				break;
+			case ltRationalKind:
+				// n1 * d2 < n2 * d1, in 64 bits: the order of the fractions if their denominators are positive
+				pc = (long long)cell[o.a] * cell[o.b + 1] < (long long)cell[o.b] * cell[o.a + 1] ? o.dst : pc + 1;
+				break;
+			case leIntKind:
+				pc = cell[o.a] <= cell[o.b] ? o.dst : pc + 1;
+				break;
+			case leFloatKind:
+				pc = getFloat(cell, o.a) <= getFloat(cell, o.b) ? o.dst : pc + 1;
+				break;
+			case leRationalKind:
+				pc = (long long)cell[o.a] * cell[o.b + 1] <= (long long)cell[o.b] * cell[o.a + 1] ? o.dst : pc + 1;
+				break;
+			case tableKind:
+				// through the goto, so that the profile counts the case taken
+				pc = (unsigned)cell[o.a] < (unsigned)cell[o.b] ? pc + 1 + cell[o.a] : o.dst;
+				break;
+		}
+	}
+
+done:
+	if (profiling) {
+		unsigned long long now = PhaseTimer::now();
+		cycles[prev] += now - last;
+		totalCycles += now - start;
+	}
+	return status;
+}
+
+// the batch interpreter runs the plain loop too, instance by instance
+template int Interpreter::execute<false, false>(int* cell, int pc);
+
+int Interpreter::run(bool profiling) {
+	Memory& mem = Memory::getInstance();
+
+	vector<int> cell(initial);
+	memcpy(&cell[0], mem.retrieve(0), mem.getUsed());
+
+	int status = profiling ? execute<true, false>(&cell[0]) : execute<false, false>(&cell[0]);
+
+	memcpy(mem.retrieve(0), &cell[0], mem.getUsed());
+	return status;
+}
+
+int Interpreter::runTiered(int threshold, bool allocate, bool select) {
+	Memory& mem = Memory::getInstance();
+
+	vector<int> cell(initial);
+	memcpy(&cell[0], mem.retrieve(0), mem.getUsed());
+
+	backEdges.assign(ops.size(), 0);
+	osrThreshold = threshold;
+	int status = execute<false, true>(&cell[0]);
+
+	memcpy(mem.retrieve(0), &cell[0], mem.getUsed());
+	if (status != osrStatus) {
+		return status;
+	}
+
+	osrEntry = ops[osrOp].instr;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	NativeCode* native;
+	{
+		TimeScope t("jit");
+		native = new NativeCode(code, allocate, select, osrEntry);
+	}
+	jitMillis = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	jitBytes = native->getBytes().size();
+
+	// the code cannot run: the interpreter goes on from the loop header
+	if (!native->ok()) {
+		jitError = native->getError();
+		delete native;
+		status = execute<false, false>(&cell[0], osrOp);
+		memcpy(mem.retrieve(0), &cell[0], mem.getUsed());
+		return status;
+	}
+
+	// the valuenumber cells of the interpreter have the layout of the native slots
+	int n = code->getNextInstr();
+	vector<long long> slots(n + 1);
+	memcpy(&slots[0], &cell[vnBase], 8 * n);
+
+	status = native->runFrom(&slots[0]);
+	delete native;
+	return status;
+}
+
+void Interpreter::printTierReport(ostream& out) const {
+	if (osrEntry < 0) {
+		out << "tiered: no loop reached " << osrThreshold << " iterations, nothing compiled" << endl;
+		return;
+	}
+
+	out << "tiered: loop at " << osrEntry;
+	int location = code->getInstr(osrEntry)->getLocation();
+	if (location >= 0) {
+		out << " (line " << code->getRange(location).firstLine << ")";
+	}
+	out << " hot after " << osrThreshold << " iterations, " << jitBytes << " bytes compiled in " << jitMillis << " ms, ";
+	if (jitError.empty()) {
+		out << "entered natively" << endl;
+	} else {
+		out << "not entered (" << jitError << "), interpreted" << endl;
+	}
+}
+
+/***********/
+/* PROFILE */
+/***********/
+
+/* Orders (cycles, index) pairs by decreasing cycles, then by index */
+static bool hotter(const pair<unsigned long long, int>& a, const pair<unsigned long long, int>& b) {
+	return a.first != b.first ? a.first > b.first : a.second < b.second;
+}
+
+static double percent(unsigned long long part, unsigned long long total) {
+	return total > 0 ? 100.0 * part / total : 0;
+}
+
+void Interpreter::printHotInstrs(ostream& out, int top) const {
+	vector< pair<unsigned long long, int> > hot;
+	for (int i = 0; i < code->getNextInstr(); i++) {
+		unsigned long long c = 0;
+		for (int k = firstOp[i]; k < firstOp[i + 1]; k++) {
+			c += cycles[k];
+		}
+		if (counts[firstOp[i]] > 0) {
+			hot.push_back(make_pair(c, i));
+		}
+	}
+	sort(hot.begin(), hot.end(), hotter);
+
+	out << "hottest instructions:" << endl;
+	out << right << setw(12) << "count" << setw(14) << "cycles" << setw(8) << "%" << "  instruction" << endl;
+	for (int h = 0; h < (int)hot.size() && h < top; h++) {
+		int i = hot[h].second;
+		out << setw(12) << counts[firstOp[i]] << setw(14) << hot[h].first << fixed << setprecision(1)
+			<< setw(8) << percent(hot[h].first, totalCycles) << "  " << code->getInstr(i) << endl;
+	}
+}
+
+void Interpreter::printHotLoops(ostream& out, int top) const {
+	int n = code->getNextInstr();
+
+	/* a loop is the target of a backward jump, up to the last jump back to it; a jump back
+	 * across HALT only returns from a cold block moved after it (see BlockLayout) */
+	int halt = 0;
+	while (halt < n && code->getInstr(halt)->getOp() != haltOpr) {
+		halt++;
+	}
+
+	vector<int> end(n, -1);
+	for (int j = 0; j < n; j++) {
+		TacInstr* instr = code->getInstr(j);
+		if (instr->isJump() && instr->getDestInstr()->getIndex() <= j
+				&& (instr->getDestInstr()->getIndex() > halt || j < halt)) {
+			int h = instr->getDestInstr()->getIndex();
+			end[h] = max(end[h], j);
+		}
+	}
+
+	vector< pair<unsigned long long, int> > hot;
+	for (int h = 0; h < n; h++) {
+		if (end[h] >= 0 && counts[firstOp[h]] > 0) {
+			unsigned long long c = 0;
+			for (int k = firstOp[h]; k < firstOp[end[h] + 1]; k++) {
+				c += cycles[k];
+			}
+			hot.push_back(make_pair(c, h));
+		}
+	}
+	sort(hot.begin(), hot.end(), hotter);
+
+	out << "hottest loops:" << endl;
+	out << right << setw(12) << "header runs" << setw(14) << "cycles" << setw(8) << "%" << "  instructions" << endl;
+	for (int l = 0; l < (int)hot.size() && l < top; l++) {
+		int h = hot[l].second;
+		out << setw(12) << counts[firstOp[h]] << setw(14) << hot[l].first << fixed << setprecision(1)
+			<< setw(8) << percent(hot[l].first, totalCycles) << "  " << h << "-" << end[h] << endl;
+	}
+}
+
+void Interpreter::printOpcodeMix(ostream& out) const {
+	const int numOps = fakeOpr + 1;
+	vector<long long> opCount(numOps, 0);
+	vector<unsigned long long> opCycles(numOps, 0);
+	long long total = 0;
+
+	for (int i = 0; i < code->getNextInstr(); i++) {
+		int op = code->getInstr(i)->getOp();
+		opCount[op] += counts[firstOp[i]];
+		total += counts[firstOp[i]];
+		for (int k = firstOp[i]; k < firstOp[i + 1]; k++) {
+			opCycles[op] += cycles[k];
+		}
+	}
+
+	out << "opcode mix:" << endl;
+	out << left << setw(12) << "opcode" << right << setw(12) << "count" << setw(8) << "%" << setw(14) << "cycles"
+		<< setw(8) << "%" << endl;
+	for (int op = 0; op < numOps; op++) {
+		if (opCount[op] == 0) {
+			continue;
+		}
+		double share = percent(opCount[op], total);
+		out << left << setw(12) << opNames[op] << right << setw(12) << opCount[op] << fixed << setprecision(1)
+			<< setw(8) << share << setw(14) << opCycles[op] << setw(8) << percent(opCycles[op], totalCycles)
+			<< "  " << string((int)(share / 2.5 + 0.5), '#') << endl;
+	}
+}
+
+void Interpreter::printProfile(ostream& out, int top) const {
+	long long executed = 0;
+	for (int i = 0; i < code->getNextInstr(); i++) {
+		executed += counts[firstOp[i]];
+	}
+
+	out << "===== Execution profile =====" << endl;
+	out << executed << " instructions executed, " << totalCycles << " cycles" << endl;
+	out << endl;
+	printHotInstrs(out, top);
+	out << endl;
+	printHotLoops(out, top);
+	out << endl;
+	printOpcodeMix(out);
+}
+
+void Interpreter::printSourceProfile(ostream& out, const vector<string>& lines) const {
+	int numLines = lines.size();
+	vector<long long> lineCount(numLines + 1, -1);
+	vector<unsigned long long> lineCycles(numLines + 1, 0);
+
+	for (int i = 0; i < code->getNextInstr(); i++) {
+		int location = code->getInstr(i)->getLocation();
+		if (location < 0) {
+			continue;
+		}
+		int line = code->getRange(location).firstLine;
+		if (line < 1 || line > numLines) {
+			continue;
+		}
+		lineCount[line] = max(lineCount[line], counts[firstOp[i]]);
+		for (int k = firstOp[i]; k < firstOp[i + 1]; k++) {
+			lineCycles[line] += cycles[k];
+		}
+	}
+
+	out << "===== Source profile =====" << endl;
+	out << right << setw(12) << "count" << setw(14) << "cycles" << setw(8) << "%" << "  line" << endl;
+	for (int line = 1; line <= numLines; line++) {
+		if (lineCount[line] < 0) {
+			out << setw(34) << "";
+		} else {
+			out << setw(12) << lineCount[line] << setw(14) << lineCycles[line] << fixed << setprecision(1)
+				<< setw(8) << percent(lineCycles[line], totalCycles);
+		}
+		out << setw(6) << line << "  " << lines[line - 1] << endl;
+	}
+}
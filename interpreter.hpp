@@ -0,0 +1,181 @@
+#ifndef INTERPRETER_HPP_
+#define INTERPRETER_HPP_
+
+/**
+* @file interpreter.hpp
+* @brief This header file contains the interpreter of tinycomp, which runs the
+* 3-addr code directly (see --interpret), and its instruction-level profiler
+* (see --profile).
+*
+* The interpreter implements the same semantics as the native backend (see
+* native.hpp), so that both produce the same values. The code is first decoded
+* into a compact form, where the type of every operand has been resolved:
+* operands are indices into a single array of 4-byte cells (the Memory image,
+* then an 8-byte slot per valuenumber, then the constants) and each
+* instruction becomes one or more operations that no longer need to look at
+* types, conversions included.
+*
+* Profiling runs a separate copy of the dispatch loop, which counts how many
+* times each operation is executed and the time stamp counter ticks ("cycles")
+* spent in it, i.e. until the next operation starts; the plain loop has no
+* instrumentation at all.
+*
+* Tiered execution (see --tiered) runs a third copy, which counts the backward
+* jumps reaching each operation, i.e. the iterations of the loop it heads.
+* Once a loop reaches the threshold, the whole code is compiled by the native
+* backend, with an entry at that header: the values are already in Memory at
+* the same offsets, the valuenumbers are handed over in the native slots, and
+* the program goes on natively from the header, until HALT (on-stack
+* replacement). A program with no hot loop never pays for the compilation.
+*
+* The batch interpreter (see batch.hpp) runs the same decoded operations over
+* many instances of the program at once.
+*/
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "tinycomp.hpp"
+#include "optimizer.hpp"
+#include "native.hpp"
+
+using namespace std;
+
+/** Runs the 3-addr code, optionally profiling it.
+ */
+class Interpreter {
+private:
+	friend class BatchInterpreter;
+
+	/* The decoded operations; conversions have their own, so that arithmetic and
+	 * comparisons always find their operands in the right type */
+	enum Kind {
+		nopKind,		// "stat"
+		haltKind,
+		jmpKind,		// goto target
+		movKind,		// dst = a (4 bytes)
+		mov2Kind,		// dst = a (8 bytes, a fraction)
+		intToFloatKind,	// dst = (float)a
+		floatToIntKind,	// dst = (int)a, truncated
+		addIntKind,		// dst = a op b, on ints
+		mulIntKind,
+		divIntKind,
+		addFloatKind,	// dst = a op b, on floats
+		mulFloatKind,
+		divFloatKind,
+		readIntKind,	// dst = the next value of the input (see InputReader), as an int
+		readFloatKind,	// ... as a float
+		readFractionKind,	// ... as a fraction
+		printIntKind,	// print a (see OutputWriter), an int
+		printFloatKind,	// ... a float
+		printFractionKind,	// ... a fraction
+		eqIntKind,		// if a == b goto target, on ints
+		eqFloatKind,	// ... on floats
+		eqFieldsKind,	// ... on the fields of two fractions
+		eqRationalKind,	// ... on two fractions, as rational numbers
+		neIntKind,		// if a != b goto target, on ints
+		neFloatKind,	// ... on floats
+		neRationalKind,	// ... on two fractions, as rational numbers
+		ltIntKind,		// if a < b goto target, on ints (a > b has the operands swapped)
+		ltFloatKind,	// ... on floats
+		ltRationalKind,	// ... on two fractions, cross-multiplied
+		leIntKind,		// if a <= b goto target, on ints (a >= b has the operands swapped)
+		leFloatKind,	// ... on floats
+		leRationalKind,	// ... on two fractions, cross-multiplied
+		tableKind		// if 0 <= a < b goto the jmp a + 1 operations ahead, else goto target
+	};
+
+	class Op {
+	public:
+		int kind;
+		int dst;		// the cell written, or the target operation of a jump
+		int a;
+		int b;
+		int instr;		// the instruction the operation belongs to
+	};
+
+	TargetCode* code;
+	TypeMap types;
+
+	vector<Op> ops;
+	vector<int> firstOp;	// firstOp[i]: the first operation of instruction i
+
+	/* vnRead[i] is true if the valuenumber of instruction i is read by some instruction */
+	vector<bool> vnRead;
+
+	/* the cells: Memory, the valuenumber slots, the scratch cells, then the constants */
+	vector<int> initial;
+	int memCells;
+	int vnBase;
+	int scratch;
+	map<int, int> constCells;
+	map< pair<int, int>, int > pairCells;
+
+	/* the profile: executions and cycles of each operation, and of the whole run */
+	vector<long long> counts;
+	vector<unsigned long long> cycles;
+	unsigned long long totalCycles;
+
+	/* tiered execution: the backward jumps to each operation, the threshold of a hot loop,
+	 * the operation where the interpreter stopped, and what then happened */
+	static const int osrStatus = 2;
+	vector<int> backEdges;
+	int osrThreshold;
+	int osrOp;
+	int osrEntry;
+	int jitBytes;
+	double jitMillis;
+	string jitError;
+
+	typeName typeOf(Address* a) const;
+	int cellOf(Address* a, int field);
+	int constCell(int value);
+	int constPair(int num, int denom);
+
+	void emit(int kind, int dst, int a, int b);
+	int toInt(Address* a, int into);
+	int toFloat(Address* a, int into);
+	int toFraction(Address* a, int into);
+	void decodeCopy(Address* dst, Address* src);
+	void decode(int i);
+
+	/* Runs the operations from pc on the cells; returns as run(), or osrStatus */
+	template <bool profiling, bool tiered> int execute(int* cell, int pc = 0);
+
+	void printHotInstrs(ostream& out, int top) const;
+	void printHotLoops(ostream& out, int top) const;
+	void printOpcodeMix(ostream& out) const;
+
+public:
+	/** Constructor: decodes the code, which must not change afterwards */
+	Interpreter(TargetCode* code);
+
+	/** Returns the number of decoded operations */
+	int size() const;
+
+	/** Runs the program on Memory, profiling it if requested; returns 0 on success,
+	 *  1 on a division by zero */
+	int run(bool profiling);
+
+	/** Runs the program on Memory, going on natively from the header of the first loop
+	 *  iterated threshold times, compiled as requested (see NativeCode); returns as run() */
+	int runTiered(int threshold, bool allocate, bool select);
+
+	/** Prints what tiered execution did: the loop compiled, if any, and the cost of compiling */
+	void printTierReport(ostream& out) const;
+
+	/** Prints the profile of the last profiled run: the instructions and the loops
+	 *  (the targets of backward jumps, with the instructions up to the last such jump)
+	 *  taking most cycles, and the number of executions and cycles of each operator.
+	 */
+	void printProfile(ostream& out, int top = 10) const;
+
+	/** Prints the source of the program, given line by line, with the executions and cycles
+	 *  of the instructions that each line starts (see the line table of TargetCode);
+	 *  the executions of a line are those of its most executed instruction.
+	 */
+	void printSourceProfile(ostream& out, const vector<string>& lines) const;
+};
+
+#endif //INTERPRETER_HPP_
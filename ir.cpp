@@ -0,0 +1,523 @@
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+#include "ir.hpp"
+#include "timer.hpp"
+
+/* The kinds of operand, in the low bits of an operand */
+enum { noOperand, constOperand, varOperand, tempOperand, instrOperand };
+static const int kindBits = 3;
+
+static const char magic[4] = { 'T', 'C', 'I', 'R' };
+
+/*
+ * IrWriter
+ */
+void IrWriter::putByte(int b) {
+	bytes.push_back(b);
+}
+
+void IrWriter::putVarint(unsigned int v) {
+	while (v >= 0x80) {
+		putByte((v & 0x7f) | 0x80);
+		v >>= 7;
+	}
+	putByte(v);
+}
+
+void IrWriter::putSigned(int v) {
+	putVarint(((unsigned int)v << 1) ^ (unsigned int)(v >> 31));
+}
+
+int IrWriter::constIndex(ConstAddress* c) {
+	for (size_t i = 0; i < consts.size(); i++) {
+		ConstAddress* k = consts[i];
+		if (k->getType() != c->getType()) {
+			continue;
+		}
+		switch (c->getType()) {
+			case intType:
+				if (k->getIntVal() == c->getIntVal()) {
+					return i;
+				}
+				break;
+			case floatType: {
+				// compare the bits, so that e.g. 0.0 and -0.0 stay distinct
+				float a = k->getFloatVal(), b = c->getFloatVal();
+				if (memcmp(&a, &b, sizeof(float)) == 0) {
+					return i;
+				}
+				break;
+			}
+			default:
+				if (k->getFractionVal().num == c->getFractionVal().num
+						&& k->getFractionVal().denom == c->getFractionVal().denom) {
+					return i;
+				}
+				break;
+		}
+	}
+
+	consts.push_back(c);
+	return consts.size() - 1;
+}
+
+void IrWriter::putOperand(Address* a) {
+	if (a == NULL) {
+		putVarint(noOperand);
+	} else if (ConstAddress* c = dynamic_cast<ConstAddress*>(a)) {
+		putVarint(constOperand | constIndex(c) << kindBits);
+	} else if (VarAddress* v = dynamic_cast<VarAddress*>(a)) {
+		// the fields of a fraction print as e.g. "x.num": the first char is the lexeme
+		char lexeme = v->toString()[0];
+		VarAddress* whole = sym->get(lexeme);
+		int field = v == whole ? 0 : (v->getOffset() == whole->getOffset() ? 1 : 2);
+		putVarint(varOperand | (3 * (lexeme - 'a') + field) << kindBits);
+	} else if (TempAddress* t = dynamic_cast<TempAddress*>(a)) {
+		putVarint(tempOperand | temps[t] << kindBits);
+	} else {
+		putVarint(instrOperand | ((InstrAddress*)a)->getIndex() << kindBits);
+	}
+}
+
+IrWriter::IrWriter(TargetCode* code, SimpleArraySymTbl* sym) {
+	this->sym = sym;
+	Memory& mem = Memory::getInstance();
+
+	bytes.insert(bytes.end(), magic, magic + sizeof(magic));
+	putVarint(irVersion);
+
+	/* Memory image */
+	int size = mem.getUsed();
+	putVarint(size);
+	unsigned char* image = (unsigned char*)mem.retrieve(0);
+	bytes.insert(bytes.end(), image, image + size);
+
+	/* Symbol table, in order of offset: loading puts the variables back in this order */
+	vector<pair<int, VarAddress*> > vars;
+	for (char c = 'a'; c <= 'z'; c++) {
+		if (sym->get(c) != NULL) {
+			vars.push_back(make_pair(sym->get(c)->getOffset(), sym->get(c)));
+		}
+	}
+	sort(vars.begin(), vars.end());
+
+	putVarint(vars.size());
+	for (size_t i = 0; i < vars.size(); i++) {
+		putByte(vars[i].second->toString()[0]);
+		putByte(vars[i].second->getType());
+		putVarint(vars[i].first);
+	}
+
+	/* Temporaries: those shown by the memory dump first, then any other one used by the code */
+	vector<TempAddress*> order;
+	const list<TempAddress*>& listed = mem.getTemps();
+	for (list<TempAddress*>::const_iterator it = listed.begin(); it != listed.end(); ++it) {
+		if (!temps.count(*it)) {
+			temps[*it] = order.size();
+			order.push_back(*it);
+		}
+	}
+	int numListed = order.size();
+
+	for (int i = 0; i < code->getNextInstr(); i++) {
+		TacInstr* instr = code->getInstr(i);
+		Address* ops[3] = { instr->getOperand1(), instr->getOperand2(), instr->getTemp() };
+
+		for (int k = 0; k < 3; k++) {
+			if (TempAddress* t = dynamic_cast<TempAddress*>(ops[k])) {
+				if (!temps.count(t)) {
+					temps[t] = order.size();
+					order.push_back(t);
+				}
+			} else if (ConstAddress* c = dynamic_cast<ConstAddress*>(ops[k])) {
+				constIndex(c);
+			}
+		}
+	}
+
+	putVarint(order.size());
+	for (size_t i = 0; i < order.size(); i++) {
+		putVarint(order[i]->getOffset());
+		putVarint(order[i]->getWidth());
+		putVarint(order[i]->getName());
+		putByte((int)i < numListed);
+	}
+
+	/* Constant pool */
+	putVarint(consts.size());
+	for (size_t i = 0; i < consts.size(); i++) {
+		putByte(consts[i]->getType());
+		switch (consts[i]->getType()) {
+			case intType:
+				putSigned(consts[i]->getIntVal());
+				break;
+			case floatType: {
+				float f = consts[i]->getFloatVal();
+				unsigned char* p = (unsigned char*)&f;
+				bytes.insert(bytes.end(), p, p + sizeof(float));
+				break;
+			}
+			default:
+				putSigned(consts[i]->getFractionVal().num);
+				putSigned(consts[i]->getFractionVal().denom);
+				break;
+		}
+	}
+
+	/* Code */
+	putVarint(code->getNextInstr());
+	for (int i = 0; i < code->getNextInstr(); i++) {
+		TacInstr* instr = code->getInstr(i);
+
+		putVarint(2 * instr->getOp() + instr->isCold());
+		putOperand(instr->getOperand1());
+		putOperand(instr->getOperand2());
+		putOperand(instr->getTemp());
+		putOperand(instr->getDestInstr());
+	}
+}
+
+bool IrWriter::write(const char* path) const {
+	FILE* f = fopen(path, "wb");
+	if (f == NULL) {
+		return false;
+	}
+	bool ok = fwrite(&bytes[0], 1, bytes.size(), f) == bytes.size();
+	return fclose(f) == 0 && ok;
+}
+
+/*
+ * IrReader
+ */
+void IrReader::fail(const string& why) {
+	if (error.empty()) {
+		error = why;
+	}
+	pos = end;
+}
+
+int IrReader::getByte() {
+	if (pos == end) {
+		fail("truncated file");
+		return 0;
+	}
+	return *pos++;
+}
+
+unsigned int IrReader::getVarint() {
+	unsigned int v = 0;
+	for (int shift = 0; shift < 35; shift += 7) {
+		int b = getByte();
+		v |= (unsigned int)(b & 0x7f) << shift;
+		if ((b & 0x80) == 0) {
+			return v;
+		}
+	}
+	fail("malformed number");
+	return 0;
+}
+
+int IrReader::getSigned() {
+	unsigned int v = getVarint();
+	return (int)(v >> 1) ^ -(int)(v & 1);
+}
+
+int IrReader::getIndex(unsigned int limit, const char* what) {
+	unsigned int v = getVarint();
+	if (v >= limit) {
+		fail(string("invalid ") + what);
+		return 0;
+	}
+	return v;
+}
+
+Address* IrReader::getOperand(int& vn) {
+	unsigned int tag = getVarint();
+	unsigned int index = tag >> kindBits;
+
+	vn = -1;
+	switch (tag & ((1 << kindBits) - 1)) {
+		case noOperand:
+			return NULL;
+		case constOperand:
+			if (index < consts.size()) {
+				return consts[index];
+			}
+			break;
+		case varOperand: {
+			VarAddress* v = index < 3 * 26 ? sym->get((char)('a' + index / 3)) : NULL;
+			if (v != NULL && index % 3 == 0) {
+				return v;
+			}
+			if (v != NULL && v->getType() == fractionType) {
+				return v->getField(4 * (index % 3 - 1));
+			}
+			break;
+		}
+		case tempOperand:
+			if (index < temps.size()) {
+				return temps[index];
+			}
+			break;
+		case instrOperand:
+			// resolved once the whole code has been read
+			vn = index;
+			return NULL;
+		default:
+			break;
+	}
+
+	fail("invalid operand");
+	return NULL;
+}
+
+void IrReader::decode(TargetCode* code) {
+	Memory& mem = Memory::getInstance();
+
+	if (end - pos < (long)sizeof(magic) || memcmp(pos, magic, sizeof(magic)) != 0) {
+		fail("not a tinycomp IR file");
+		return;
+	}
+	pos += sizeof(magic);
+	if (getVarint() != (unsigned int)irVersion) {
+		fail("unsupported version");
+		return;
+	}
+
+	/* Memory image: it is copied once variables and temporaries have been put back */
+	unsigned int size = getVarint();
+	if (size > (unsigned long)(end - pos)) {
+		fail("truncated file");
+		return;
+	}
+	const unsigned char* image = pos;
+	pos += size;
+
+	/* Symbol table: putting the variables in order of offset lays them out as they were */
+	int numVars = getIndex(27, "symbol table");
+	for (int i = 0; i < numVars && error.empty(); i++) {
+		char lexeme = getByte();
+		int type = getByte();
+		unsigned int offset = getVarint();
+
+		if (lexeme < 'a' || lexeme > 'z' || sym->get(lexeme) != NULL || type > fractionType) {
+			fail("invalid symbol table");
+			return;
+		}
+		sym->put(lexeme, (typeName)type);
+		if (sym->get(lexeme)->getOffset() != (int)offset
+				|| offset + sym->get(lexeme)->getWidth() > size) {
+			fail("symbol table does not match the memory image");
+			return;
+		}
+	}
+
+	/* Temporaries */
+	unsigned int numTemps = getVarint();
+	for (unsigned int i = 0; i < numTemps && error.empty(); i++) {
+		unsigned int offset = getVarint();
+		unsigned int width = getVarint();
+		unsigned int name = getVarint();
+		bool listed = getByte() != 0;
+
+		if ((width != 4 && width != 8) || offset + width > size || name > 0xffffff) {
+			fail("invalid temporary");
+			return;
+		}
+		temps.push_back(mem.restoreTemp(offset, width, name, listed));
+	}
+
+	mem.restore(image, size);
+
+	/* Constant pool */
+	unsigned int numConsts = getVarint();
+	for (unsigned int i = 0; i < numConsts && error.empty(); i++) {
+		switch (getByte()) {
+			case intType:
+				consts.push_back(new ConstAddress(getSigned()));
+				break;
+			case floatType: {
+				float f;
+				unsigned char* p = (unsigned char*)&f;
+				for (size_t b = 0; b < sizeof(float); b++) {
+					p[b] = getByte();
+				}
+				consts.push_back(new ConstAddress(f));
+				break;
+			}
+			case fractionType: {
+				fraction f;
+				f.num = getSigned();
+				f.denom = getSigned();
+				consts.push_back(new ConstAddress(f));
+				break;
+			}
+			default:
+				fail("invalid constant");
+				return;
+		}
+	}
+
+	/* Code: references to instructions are resolved after all of them have been generated */
+	// an instruction takes at least 5 bytes
+	int numInstrs = getIndex((end - pos) / 5 + 1, "code size");
+	vector<int> refs(4 * numInstrs, -1);
+
+	for (int i = 0; i < numInstrs && error.empty(); i++) {
+		int opCode = getIndex(2 * (fakeOpr + 1), "operator");
+		oprEnum op = (oprEnum)(opCode / 2);
+
+		Address* ops[4];
+		for (int k = 0; k < 4; k++) {
+			ops[k] = getOperand(refs[4 * i + k]);
+		}
+
+		bool given[4];
+		for (int k = 0; k < 4; k++) {
+			given[k] = ops[k] != NULL || refs[4 * i + k] >= 0;
+		}
+
+		bool jump = op == jmpOpr || (op >= eq1condJmpOpr && op <= jmpTableOpr);
+		bool valid = (!given[2] || dynamic_cast<TempAddress*>(ops[2]) != NULL)
+				&& ops[3] == NULL && given[3] == jump;
+
+		// the operands each operator is printed, optimized and compiled with
+		switch (op) {
+			case copyOpr:
+				valid = valid && given[0] && !given[2];
+				break;
+			case addOpr:
+			case mulOpr:
+			case divOpr:
+			case indexCopyOpr:
+			case offsetOpr:
+				valid = valid && given[0] && given[1] && given[2];
+				break;
+			case eq1condJmpOpr:
+			case eq2condJmpOpr:
+			case neCondJmpOpr:
+			case ltCondJmpOpr:
+			case leCondJmpOpr:
+			case gtCondJmpOpr:
+			case geCondJmpOpr:
+				valid = valid && given[0] && given[1];
+				break;
+			case jmpTableOpr: {
+				// the size of the table is a constant, and the gotos follow
+				ConstAddress* n = dynamic_cast<ConstAddress*>(ops[1]);
+				valid = valid && given[0] && n != NULL && n->getType() == intType && n->getIntVal() >= 0
+						&& n->getIntVal() < numInstrs - i && !given[2];
+				break;
+			}
+			case readOpr:
+				valid = valid && dynamic_cast<VarAddress*>(ops[0]) != NULL && !given[1] && !given[2];
+				break;
+			case printOpr:
+				valid = valid && given[0] && !given[1] && !given[2];
+				break;
+			default:
+				break;
+		}
+
+		if (!valid) {
+			fail("invalid instruction");
+			return;
+		}
+		code->gen(op, ops[0], ops[1], ops[2])->setCold(opCode % 2 == 1);
+	}
+
+	for (int i = 0; i < numInstrs && error.empty(); i++) {
+		TacInstr* instr = code->getInstr(i);
+		for (int k = 0; k < 4; k++) {
+			int vn = refs[4 * i + k];
+			if (vn < 0) {
+				continue;
+			}
+			if (vn >= numInstrs) {
+				fail("invalid instruction reference");
+				return;
+			}
+
+			switch (k) {
+				case 0:
+					instr->setOperand1(code->getInstr(vn)->getValueNumber());
+					break;
+				case 1:
+					instr->setOperand2(code->getInstr(vn)->getValueNumber());
+					break;
+				default:
+					instr->patch(code->getInstr(vn));
+					break;
+			}
+		}
+	}
+
+	for (int i = 0; i < numInstrs && error.empty(); i++) {
+		for (int k = 1; k <= code->getInstr(i)->tableSize(); k++) {
+			if (code->getInstr(i + k)->getOp() != jmpOpr) {
+				fail("invalid jump table");
+				return;
+			}
+		}
+	}
+
+	if (error.empty() && pos != end) {
+		fail("trailing data");
+	}
+}
+
+IrReader::IrReader(const char* path, TargetCode* code, SimpleArraySymTbl* sym) {
+	TimeScope t("load");
+	this->sym = sym;
+	pos = end = NULL;
+
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		error = "cannot read the file";
+		if (fd >= 0) {
+			close(fd);
+		}
+		return;
+	}
+
+	if (st.st_size == 0) {
+		error = "not a tinycomp IR file";
+		close(fd);
+		return;
+	}
+
+	void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		error = "cannot read the file";
+		return;
+	}
+
+	pos = (const unsigned char*)map;
+	end = pos + st.st_size;
+	decode(code);
+
+	munmap(map, st.st_size);
+	pos = end = NULL;
+}
+
+bool IrReader::ok() const {
+	return error.empty();
+}
+
+const string& IrReader::getError() const {
+	return error;
+}
@@ -0,0 +1,122 @@
+#ifndef IR_HPP_
+#define IR_HPP_
+
+/**
+* @file ir.hpp
+* @brief This header file contains the binary IR format of tinycomp:
+* a compiled (and possibly optimized) program is saved with --emit-ir, and
+* loaded back with --load, which optimizes, prints, runs or writes it as an
+* object exactly as if it had just been parsed, without running the parser.
+*
+* A file holds, in this order (all numbers are unsigned LEB128 varints, and
+* signed ones are zigzag-encoded first):
+* - the magic "TCIR" and the format version;
+* - the Memory image: its size, then its bytes;
+* - the symbol table: the number of variables, then for each of them, in
+*   order of offset, its lexeme (a byte), its type (a byte) and its offset;
+* - the temporaries: their number, then for each of them its offset, width,
+*   name (e.g. 3 for t3) and whether it is shown in the memory dump;
+* - the constant pool: the number of constants, then for each of them its
+*   type (a byte) and its value: a signed varint for an int, the 4 bytes of
+*   a float, two signed varints for a fraction;
+* - the code: the number of instructions, then for each of them its operator
+*   (twice its value, plus 1 if the instruction is cold) and four operands:
+*   operand1, operand2, the temporary and the destination of a jump.
+*
+* An operand is a varint holding its kind in the low 3 bits, and an index
+* above them: into the constant pool, the temporaries or the code, or for a
+* variable 3 times its position in the alphabet, plus 1 for the numerator
+* and 2 for the denominator field of a fraction.
+*
+* The format holds the in-memory IR as is, so a file can only be loaded by
+* a tinycomp built for the same byte order, and with the same version.
+*/
+
+#include <map>
+#include <string>
+#include <vector>
+#include "tinycomp.hpp"
+
+using namespace std;
+
+/** The version of the format written by IrWriter, and the only one accepted by IrReader
+ *  (2: the operators include "read", 3: and "print", 4: and the relations "!=", "<", "<=", ">", ">=",
+ *  5: the instructions are marked cold or not, 6: and jump tables) */
+const int irVersion = 6;
+
+/** Writes a compiled program in the binary IR format.
+ */
+class IrWriter {
+private:
+	vector<unsigned char> bytes;
+
+	/* the pools: each temporary and constant is written once, and referred to by its index */
+	map<TempAddress*, int> temps;
+	vector<ConstAddress*> consts;
+
+	SimpleArraySymTbl* sym;
+
+	void putByte(int b);
+	void putVarint(unsigned int v);
+	void putSigned(int v);
+
+	/* Returns the index of a constant in the pool, adding it if needed */
+	int constIndex(ConstAddress* c);
+
+	/* Writes an operand (NULL included) */
+	void putOperand(Address* a);
+
+public:
+	/** Constructor: encodes the code, the symbol table and the current Memory */
+	IrWriter(TargetCode* code, SimpleArraySymTbl* sym);
+
+	/** Writes the program to a file; returns false if it cannot be written */
+	bool write(const char* path) const;
+};
+
+/** Loads a program written by IrWriter.
+ *  The file is mapped in memory, and decoded in place.
+ */
+class IrReader {
+private:
+	/* the part of the mapped file still to be decoded */
+	const unsigned char* pos;
+	const unsigned char* end;
+
+	/* the reason why the file is not valid, if it is not */
+	string error;
+
+	vector<TempAddress*> temps;
+	vector<ConstAddress*> consts;
+
+	SimpleArraySymTbl* sym;
+
+	/* Record a decoding error; the readers then return 0 until the end */
+	void fail(const string& why);
+
+	int getByte();
+	unsigned int getVarint();
+	int getSigned();
+
+	/* Reads a varint that must be below limit */
+	int getIndex(unsigned int limit, const char* what);
+
+	/* Reads an operand; instruction operands are returned as their index in vn, as they
+	 * may refer to instructions that have not been read yet */
+	Address* getOperand(int& vn);
+
+	/* Decodes the whole file */
+	void decode(TargetCode* code);
+
+public:
+	/** Constructor: loads the file into code, sym and Memory, which must all be empty */
+	IrReader(const char* path, TargetCode* code, SimpleArraySymTbl* sym);
+
+	/** Returns true if the program has been loaded */
+	bool ok() const;
+
+	/** Returns the reason why the program could not be loaded */
+	const string& getError() const;
+};
+
+#endif //IR_HPP_
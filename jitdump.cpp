@@ -0,0 +1,230 @@
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+using namespace std;
+
+#include "jitdump.hpp"
+#include "optimizer.hpp"
+
+/* The jitdump format, as read by perf (see tools/perf/util/jitdump.h in the kernel sources) */
+static const unsigned int jitMagic = 0x4A695444;	// "JiTD"
+static const unsigned int jitVersion = 1;
+static const unsigned int jitHeaderSize = 40;
+static const unsigned int emX86_64 = 62;			// e_machine of x86-64 ELF files
+
+enum JitRecord {
+	jitCodeLoad = 0,
+	jitCodeDebugInfo = 2,
+	jitCodeClose = 3
+};
+
+/* Returns the time of the records: perf matches it with CLOCK_MONOTONIC (perf record -k 1) */
+static unsigned long long timestamp() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void put32(vector<unsigned char>& out, unsigned int v) {
+	for (int k = 0; k < 4; k++) {
+		out.push_back((v >> (8 * k)) & 0xFF);
+	}
+}
+
+static void put64(vector<unsigned char>& out, unsigned long long v) {
+	for (int k = 0; k < 8; k++) {
+		out.push_back((v >> (8 * k)) & 0xFF);
+	}
+}
+
+static void putString(vector<unsigned char>& out, const string& s) {
+	out.insert(out.end(), s.begin(), s.end());
+	out.push_back(0);
+}
+
+/* Starts a record: id, total size (patched by endRecord) and timestamp */
+static void beginRecord(vector<unsigned char>& out, JitRecord id) {
+	out.clear();
+	put32(out, id);
+	put32(out, 0);
+	put64(out, timestamp());
+}
+
+static bool endRecord(vector<unsigned char>& out, int fd) {
+	unsigned int size = out.size();
+	memcpy(&out[4], &size, 4);
+	return write(fd, &out[0], size) == (ssize_t)size;
+}
+
+PerfSymbols::PerfSymbols(TargetCode* code, const NativeCode& native) : native(native) {
+	this->code = code;
+	marker = NULL;
+	markerSize = 0;
+
+	int n = code->getNextInstr();
+	FlowGraph fg(code);
+
+	vector<bool> header(fg.numBlocks(), false);
+	vector<Loop> loops = fg.findLoops();
+	for (size_t l = 0; l < loops.size(); l++) {
+		header[loops[l].header] = true;
+	}
+
+	add("tc_entry", 0, native.offsetOf(0), -1, -1);
+
+	map<string, int> given;
+	for (int b = 0; b < fg.numBlocks(); b++) {
+		const BasicBlock& block = fg.getBlock(b);
+		TacInstr* first = code->getInstr(block.first);
+		TacInstr* last = code->getInstr(block.last);
+
+		ostringstream name;
+		if (first->getLocation() >= 0) {
+			name << "tc_L" << code->getRange(first->getLocation()).firstLine;
+		} else {
+			name << "tc_I" << block.first;
+		}
+		if (header[b]) {
+			name << "_while";
+		} else if (last->isCondJump()) {
+			name << "_cond";
+		} else if (last->getOp() == jmpTableOpr) {
+			name << "_switch";
+		} else {
+			name << "_block";
+		}
+
+		int times = ++given[name.str()];
+		if (times > 1) {
+			name << "." << times;
+		}
+		add(name.str(), native.offsetOf(block.first), native.offsetOf(block.last + 1), block.first, block.last);
+	}
+
+	add("tc_exit", native.offsetOf(n), native.getBytes().size(), -1, -1);
+}
+
+PerfSymbols::~PerfSymbols() {
+	if (marker != NULL) {
+		munmap(marker, markerSize);
+	}
+}
+
+void PerfSymbols::add(const string& name, int start, int end, int first, int last) {
+	// a block whose instructions are all folded into the next one has no code of its own
+	if (end > start) {
+		Symbol s;
+		s.name = name;
+		s.start = start;
+		s.size = end - start;
+		s.first = first;
+		s.last = last;
+		symbols.push_back(s);
+	}
+}
+
+int PerfSymbols::size() const {
+	return symbols.size();
+}
+
+string PerfSymbols::writePerfMap() const {
+	ostringstream path;
+	path << "/tmp/perf-" << getpid() << ".map";
+
+	FILE* f = fopen(path.str().c_str(), "a");
+	if (f == NULL) {
+		return "";
+	}
+	for (size_t s = 0; s < symbols.size(); s++) {
+		fprintf(f, "%llx %x %s\n", (unsigned long long)(native.getEntry() + symbols[s].start), symbols[s].size,
+			symbols[s].name.c_str());
+	}
+	return fclose(f) == 0 ? path.str() : "";
+}
+
+string PerfSymbols::writeJitDump(const string& source) {
+	const char* dir = getenv("JITDUMPDIR");
+	ostringstream path;
+	path << (dir != NULL && dir[0] != 0 ? dir : "/tmp") << "/jit-" << getpid() << ".dump";
+
+	int fd = open(path.str().c_str(), O_CREAT | O_TRUNC | O_RDWR, 0666);
+	if (fd < 0) {
+		return "";
+	}
+
+	vector<unsigned char> out;
+	put32(out, jitMagic);
+	put32(out, jitVersion);
+	put32(out, jitHeaderSize);
+	put32(out, emX86_64);
+	put32(out, 0);
+	put32(out, getpid());
+	put64(out, timestamp());
+	put64(out, 0);
+	bool ok = write(fd, &out[0], out.size()) == (ssize_t)out.size();
+
+	// perf record notices the dump by this executable mapping of it
+	markerSize = sysconf(_SC_PAGESIZE);
+	marker = mmap(NULL, markerSize, PROT_READ | PROT_EXEC, MAP_PRIVATE, fd, 0);
+	if (marker == MAP_FAILED) {
+		marker = NULL;
+		ok = false;
+	}
+
+	const unsigned char* entry = native.getEntry();
+	for (size_t s = 0; s < symbols.size() && ok; s++) {
+		const Symbol& sym = symbols[s];
+		unsigned long long addr = (unsigned long long)(entry + sym.start);
+
+		// the lines come first, then the code they describe
+		vector<unsigned char> lines;
+		int count = 0;
+		int previous = -1;
+		for (int i = sym.first; i >= 0 && i <= sym.last; i++) {
+			int location = code->getInstr(i)->getLocation();
+			if (location >= 0 && code->getRange(location).firstLine != previous) {
+				previous = code->getRange(location).firstLine;
+				put64(lines, (unsigned long long)(entry + native.offsetOf(i)));
+				put32(lines, previous);
+				put32(lines, 0);
+				putString(lines, source);
+				count++;
+			}
+		}
+		if (count > 0) {
+			beginRecord(out, jitCodeDebugInfo);
+			put64(out, addr);
+			put64(out, count);
+			out.insert(out.end(), lines.begin(), lines.end());
+			ok = endRecord(out, fd);
+		}
+
+		beginRecord(out, jitCodeLoad);
+		put32(out, getpid());
+		put32(out, getpid());
+		put64(out, addr);
+		put64(out, addr);
+		put64(out, sym.size);
+		put64(out, s);
+		putString(out, sym.name);
+		out.insert(out.end(), entry + sym.start, entry + sym.start + sym.size);
+		ok = ok && endRecord(out, fd);
+	}
+
+	if (ok) {
+		beginRecord(out, jitCodeClose);
+		ok = endRecord(out, fd);
+	}
+	close(fd);
+	return ok ? path.str() : "";
+}
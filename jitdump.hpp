@@ -0,0 +1,91 @@
+#ifndef JITDUMP_HPP_
+#define JITDUMP_HPP_
+
+/**
+* @file jitdump.hpp
+* @brief This header file contains the symbols of the native code of tinycomp
+* for the Linux perf tools (see --perf-map and --jitdump), which would
+* otherwise show the samples taken in it as anonymous memory.
+*
+* Every basic block of the code becomes a symbol, named after the source line
+* its first instruction comes from (see the line table of TargetCode) and its
+* role in the control flow:
+* - tc_L12_while: the header of a loop;
+* - tc_L14_cond: a block ending with a conditional jump;
+* - tc_L16_switch: a block ending with the jump table of a switch;
+* - tc_L13_block: any other block.
+* Code with no line table (see --load and --tac) gets tc_I<instruction> names
+* instead, after the first instruction of the block; the code before the first
+* block and after the last one is tc_entry and tc_exit. A name given twice gets
+* a .2, .3, ... suffix.
+*
+* The symbols are written in either of the two formats perf reads:
+* - a perf map, /tmp/perf-<pid>.map: one "start size name" line per symbol,
+*   which perf report picks up as it is;
+* - a jitdump, jit-<pid>.dump (in $JITDUMPDIR, or /tmp), with the machine code
+*   of each symbol and the source line of each of its instructions, so that
+*   perf annotate can show both. The file is mapped as executable while the
+*   program runs, which is how perf record notices it; the samples are then
+*   merged with "perf inject --jit", e.g.
+* @code
+*   perf record -k 1 ./tinycomp --native --jitdump prog.tc
+*   perf inject --jit -i perf.data -o perf.jit.data
+*   perf report -i perf.jit.data
+* @endcode
+*/
+
+#include <string>
+#include <vector>
+#include "tinycomp.hpp"
+#include "native.hpp"
+
+using namespace std;
+
+/** The symbols of the machine code compiled by the native backend.
+ */
+class PerfSymbols {
+private:
+	/* a symbol: the instructions [first, last] of the code, at [start, start + size) in the machine code */
+	class Symbol {
+	public:
+		string name;
+		int start;
+		int size;
+		int first;
+		int last;
+	};
+
+	TargetCode* code;
+	const NativeCode& native;
+	vector<Symbol> symbols;
+
+	/* the jitdump, mapped while the object lives */
+	void* marker;
+	size_t markerSize;
+
+	void add(const string& name, int start, int end, int first, int last);
+
+	// Stop the compiler from generating methods of copy the object
+	PerfSymbols(PerfSymbols const& copy);            // Not to be implemented
+	PerfSymbols& operator=(PerfSymbols const& copy); // Not to be implemented
+
+public:
+	/** Constructor: names the basic blocks of the code, as compiled by native */
+	PerfSymbols(TargetCode* code, const NativeCode& native);
+
+	~PerfSymbols();
+
+	/** Returns the number of symbols */
+	int size() const;
+
+	/** Appends the symbols to /tmp/perf-<pid>.map; returns the name of the file,
+	 *  or an empty string if it cannot be written */
+	string writePerfMap() const;
+
+	/** Writes the symbols, their code and their lines as a jitdump, with source
+	 *  as the name of the source file; returns the name of the dump, or an empty
+	 *  string if it cannot be written */
+	string writeJitDump(const string& source);
+};
+
+#endif //JITDUMP_HPP_
@@ -378,8 +378,8 @@ static void yy_fatal_error (yyconst char msg[]  );
 	*yy_cp = '\0'; \
 	(yy_c_buf_p) = yy_cp;
 
-#define YY_NUM_RULES 28
-#define YY_END_OF_BUFFER 29
+#define YY_NUM_RULES 34
+#define YY_END_OF_BUFFER 35
 /* This struct is not used in this scanner,
    but its presence is necessary. */
 struct yy_trans_info
@@ -387,17 +387,21 @@ struct yy_trans_info
 	flex_int32_t yy_verify;
 	flex_int32_t yy_nxt;
 	};
-static yyconst flex_int16_t yy_accept[82] =
+static yyconst flex_int16_t yy_accept[116] =
     {   0,
-        0,    0,   29,   27,   26,   26,   27,   27,   24,   24,
-       21,   21,   27,   24,   12,   24,   20,   20,   20,   20,
-       20,   20,   20,   20,   27,   26,    8,   11,   25,   22,
-        0,   21,    9,    6,    7,    5,    0,    0,    0,    0,
-       14,    0,    0,    0,    0,    0,    0,   10,   25,   22,
-       23,   23,    0,    0,    0,    0,    1,    0,    0,    0,
-        0,    0,   23,   15,    0,    0,    0,    0,    3,   17,
-       18,    0,   19,    2,    0,   16,   13,    0,    0,    4,
-        0
+        0,    0,   35,   33,   32,   32,   30,   33,   30,   30,
+       27,   27,   30,   30,   12,   30,   26,   26,   26,   26,
+       26,   26,   26,   26,   26,   26,   26,   26,   26,   33,
+       32,    8,   11,   31,   28,    0,   27,    9,    6,    7,
+        5,    0,    0,    0,    0,    0,    0,   14,    0,    0,
+        0,    0,    0,    0,    0,    0,    0,    0,   10,   31,
+       28,   29,   29,    0,    0,    0,    0,    0,    0,    1,
+        0,    0,    0,    0,    0,    0,    0,    0,    0,   29,
+       22,    0,   15,    0,    0,    0,    0,    0,   17,    3,
+        0,   18,   24,    0,    0,    0,   25,    2,    0,    0,
+
+       16,    0,    0,   13,    0,    0,   19,   21,    0,   23,
+        0,    0,    4,   20,    0
     } ;
 
 static yyconst YY_CHAR yy_ec[256] =
@@ -411,11 +415,11 @@ static yyconst YY_CHAR yy_ec[256] =
        13,   14,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
-        1,    1,    1,    1,    1,    1,   15,   16,   17,   16,
+        1,    1,    1,    1,    1,    1,   15,   16,   17,   18,
 
-       18,   19,   16,   20,   21,   16,   16,   22,   16,   23,
-       24,   25,   16,   26,   27,   28,   29,   16,   30,   16,
-       16,   16,    6,   31,    6,    1,    1,    1,    1,    1,
+       19,   20,   16,   21,   22,   16,   23,   24,   16,   25,
+       26,   27,   16,   28,   29,   30,   31,   16,   32,   16,
+       33,   16,    6,   34,    6,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
@@ -432,78 +436,122 @@ static yyconst YY_CHAR yy_ec[256] =
         1,    1,    1,    1,    1
     } ;
 
-static yyconst YY_CHAR yy_meta[32] =
+static yyconst YY_CHAR yy_meta[35] =
     {   0,
-        1,    1,    2,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
-        1
+        1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
+        1,    1,    1,    1
     } ;
 
-static yyconst flex_uint16_t yy_base[83] =
+static yyconst flex_uint16_t yy_base[116] =
     {   0,
-        0,    0,  105,  106,   30,   32,   91,   98,  106,   94,
-       29,   30,   88,   87,   86,   85,  106,   75,   23,   23,
-       70,   67,   21,   74,   62,   41,  106,  106,    0,   41,
-       43,   47,  106,  106,  106,  106,   65,   69,   66,   74,
-      106,   60,   66,   71,   67,   55,   62,  106,    0,   49,
-      106,   53,   64,   54,   65,   62,  106,   54,   48,   52,
-       56,   51,   55,  106,   54,   43,   42,   41,  106,  106,
-      106,   50,  106,  106,   46,  106,  106,   42,   32,  106,
-      106,   47
+        1,   35,  237,  237,   68,   70,   61,   70,  237,   68,
+       70,   71,   66,   69,   70,   71,  237,   70,   67,   63,
+       73,   69,   68,   63,   73,   63,   75,   73,   78,   66,
+      104,  237,  237,  107,  133,  135,  139,  237,  237,  237,
+      237,   73,   90,  118,  126,  125,  137,  237,  123,  131,
+      133,  141,  142,  136,  140,  129,  137,  140,  237,  170,
+      154,  237,  156,  148,  153,  150,  141,  190,  189,  237,
+      188,  183,  191,  180,  181,  187,  194,  192,  191,  207,
+      237,  187,  237,  200,  190,  191,  198,  193,  237,  237,
+      207,  237,  237,  202,  207,  203,  237,  237,  206,  196,
+
+      237,  209,  212,  237,  202,  207,  237,  237,  210,  237,
+      210,  203,  237,  237,  237
     } ;
 
-static yyconst flex_int16_t yy_def[83] =
+static yyconst flex_int16_t yy_def[116] =
     {   0,
-       81,    1,   81,   81,   81,   81,   81,   81,   81,   81,
-       81,   81,   81,   81,   81,   81,   81,   81,   81,   81,
-       81,   81,   81,   81,   81,   81,   81,   81,   82,   81,
-       81,   81,   81,   81,   81,   81,   81,   81,   81,   81,
-       81,   81,   81,   81,   81,   81,   81,   81,   82,   81,
-       81,   81,   81,   81,   81,   81,   81,   81,   81,   81,
-       81,   81,   81,   81,   81,   81,   81,   81,   81,   81,
-       81,   81,   81,   81,   81,   81,   81,   81,   81,   81,
-        0,   81
+      115,  115,  115,  115,  115,  115,  115,  115,  115,  115,
+      115,  115,  115,  115,  115,  115,  115,  115,  115,  115,
+      115,  115,  115,  115,  115,  115,  115,  115,  115,  115,
+      115,  115,  115,  115,  115,  115,  115,  115,  115,  115,
+      115,  115,  115,  115,  115,  115,  115,  115,  115,  115,
+      115,  115,  115,  115,  115,  115,  115,  115,  115,  115,
+      115,  115,  115,  115,  115,  115,  115,  115,  115,  115,
+      115,  115,  115,  115,  115,  115,  115,  115,  115,  115,
+      115,  115,  115,  115,  115,  115,  115,  115,  115,  115,
+      115,  115,  115,  115,  115,  115,  115,  115,  115,  115,
+
+      115,  115,  115,  115,  115,  115,  115,  115,  115,  115,
+      115,  115,  115,  115,    0
     } ;
 
-static yyconst flex_uint16_t yy_nxt[138] =
+static yyconst flex_uint16_t yy_nxt[272] =
     {   0,
-        4,    5,    6,    7,    8,    9,    9,   10,   11,   12,
-       13,   14,   15,   16,   17,   17,   17,   18,   19,   17,
-       20,   17,   17,   17,   21,   17,   22,   23,   17,   24,
-       25,   26,   26,   26,   26,   30,   30,   38,   32,   32,
-       45,   41,   26,   26,   39,   42,   46,   49,   40,   50,
-       50,   51,   52,   30,   80,   32,   32,   50,   50,   31,
-       31,   63,   63,   63,   63,   79,   78,   77,   76,   75,
-       74,   73,   72,   71,   70,   69,   68,   31,   67,   66,
-       65,   64,   62,   61,   60,   59,   58,   57,   56,   55,
-       54,   53,   48,   47,   44,   43,   37,   36,   35,   34,
-
-       33,   29,   28,   27,   81,    3,   81,   81,   81,   81,
-       81,   81,   81,   81,   81,   81,   81,   81,   81,   81,
-       81,   81,   81,   81,   81,   81,   81,   81,   81,   81,
-       81,   81,   81,   81,   81,   81,   81
+        0,    4,    5,    6,    7,    8,    9,    9,   10,   11,
+       12,   13,   14,   15,   16,   17,   17,   18,   19,   20,
+       21,   17,   22,   17,   23,   17,   17,   24,   25,   26,
+       27,   28,   29,   17,   30,    4,    5,    6,    7,    8,
+        9,    9,   10,   11,   12,   13,   14,   15,   16,   17,
+       17,   18,   19,   20,   21,   17,   22,   17,   23,   17,
+       17,   24,   25,   26,   27,   28,   29,   17,   30,   31,
+       31,   31,   31,   32,   33,   34,   35,   35,   38,   37,
+       37,   39,   40,   41,   42,   43,   44,   45,   48,   50,
+       51,   52,   53,   49,   54,   55,   46,   57,   58,   59,
+
+       47,   64,   56,   36,   36,   31,   31,   60,   60,   65,
+       60,   60,   60,   60,   60,   60,   60,   60,   60,   60,
+       60,   60,   60,   60,   60,   60,   60,   60,   60,   60,
+       60,   60,   60,   60,   60,   60,   60,   60,   60,   60,
+       60,   61,   61,   62,   63,   35,   66,   37,   37,   67,
+       68,   69,   70,   71,   72,   73,   74,   75,   76,   77,
+       78,   79,   61,   61,   80,   80,   81,   82,   83,   84,
+       60,   60,   36,   60,   60,   60,   60,   60,   60,   60,
+       60,   60,   60,   60,   60,   60,   60,   60,   60,   60,
+       60,   60,   60,   60,   60,   60,   60,   60,   60,   60,
+
+       60,   60,   60,   60,   85,   86,   87,   88,   89,   90,
+       91,   92,   93,   94,   95,   80,   80,   96,   97,   98,
+       99,  100,  101,  102,  103,  104,  105,  106,  107,  108,
+      109,  110,  111,  112,  113,  114,    3,  115,  115,  115,
+      115,  115,  115,  115,  115,  115,  115,  115,  115,  115,
+      115,  115,  115,  115,  115,  115,  115,  115,  115,  115,
+      115,  115,  115,  115,  115,  115,  115,  115,  115,  115,
+      115
     } ;
 
-static yyconst flex_int16_t yy_chk[138] =
+static yyconst flex_int16_t yy_chk[272] =
     {   0,
+        0,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
-        1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
-        1,    5,    5,    6,    6,   11,   12,   19,   12,   12,
-       23,   20,   26,   26,   19,   20,   23,   82,   19,   30,
-       30,   31,   31,   32,   79,   32,   32,   50,   50,   11,
-       12,   52,   52,   63,   63,   78,   75,   72,   68,   67,
-       66,   65,   62,   61,   60,   59,   58,   32,   56,   55,
-       54,   53,   47,   46,   45,   44,   43,   42,   40,   39,
-       38,   37,   25,   24,   22,   21,   18,   16,   15,   14,
-
-       13,   10,    8,    7,    3,   81,   81,   81,   81,   81,
-       81,   81,   81,   81,   81,   81,   81,   81,   81,   81,
-       81,   81,   81,   81,   81,   81,   81,   81,   81,   81,
-       81,   81,   81,   81,   81,   81,   81
+        1,    1,    1,    1,    1,    2,    2,    2,    2,    2,
+        2,    2,    2,    2,    2,    2,    2,    2,    2,    2,
+        2,    2,    2,    2,    2,    2,    2,    2,    2,    2,
+        2,    2,    2,    2,    2,    2,    2,    2,    2,    5,
+        5,    6,    6,    7,    8,   10,   11,   12,   13,   12,
+       12,   14,   15,   16,   18,   19,   20,   21,   22,   23,
+       24,   25,   26,   22,   26,   27,   21,   28,   29,   30,
+
+       21,   42,   27,   11,   12,   31,   31,   34,   34,   43,
+       34,   34,   34,   34,   34,   34,   34,   34,   34,   34,
+       34,   34,   34,   34,   34,   34,   34,   34,   34,   34,
+       34,   34,   34,   34,   34,   34,   34,   34,   34,   34,
+       34,   35,   35,   36,   36,   37,   44,   37,   37,   45,
+       46,   47,   49,   50,   51,   52,   53,   54,   55,   56,
+       57,   58,   61,   61,   63,   63,   64,   65,   66,   67,
+       60,   60,   37,   60,   60,   60,   60,   60,   60,   60,
+       60,   60,   60,   60,   60,   60,   60,   60,   60,   60,
+       60,   60,   60,   60,   60,   60,   60,   60,   60,   60,
+
+       60,   60,   60,   60,   68,   69,   71,   72,   73,   74,
+       75,   76,   77,   78,   79,   80,   80,   82,   84,   85,
+       86,   87,   88,   91,   94,   95,   96,   99,  100,  102,
+      103,  105,  106,  109,  111,  112,  115,  115,  115,  115,
+      115,  115,  115,  115,  115,  115,  115,  115,  115,  115,
+      115,  115,  115,  115,  115,  115,  115,  115,  115,  115,
+      115,  115,  115,  115,  115,  115,  115,  115,  115,  115,
+      115
     } ;
 
+/* Table of booleans, true if rule could match eol. */
+static yyconst flex_int32_t yy_rule_can_match_eol[35] =
+    {   0,
+0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1     };
+
 static yy_state_type yy_last_accepting_state;
 static char *yy_last_accepting_cpos;
 
@@ -525,8 +573,20 @@ char *yytext;
 #include "tinycomp.tab.h"
 
 void yyerror(const char *);
+
+/* The column of the next character; yylineno gives the line. Every token
+ * records its range in yylloc, for the line table of the code (see TargetCode) */
+static int yycolumn = 1;
+
+#define YY_USER_ACTION \
+	yylloc.first_line = yylloc.last_line = yylineno; \
+	yylloc.first_column = yycolumn; \
+	for (yy_size_t i = 0; i < yyleng; i++) { \
+		yycolumn = (yytext[i] == '\n') ? 1 : yycolumn + 1; \
+	} \
+	yylloc.last_column = yycolumn - 1;
 /* regular definitions */
-#line 530 "lex.yy.c"
+#line 590 "lex.yy.c"
 
 #define INITIAL 0
 
@@ -744,10 +804,10 @@ YY_DECL
 		}
 
 	{
-#line 15 "tinycomp.l"
+#line 28 "tinycomp.l"
 
 
-#line 751 "lex.yy.c"
+#line 811 "lex.yy.c"
 
 	while ( /*CONSTCOND*/1 )		/* loops until end-of-file is reached */
 		{
@@ -774,13 +834,13 @@ yy_match:
 			while ( yy_chk[yy_base[yy_current_state] + yy_c] != yy_current_state )
 				{
 				yy_current_state = (int) yy_def[yy_current_state];
-				if ( yy_current_state >= 82 )
+				if ( yy_current_state >= 116 )
 					yy_c = yy_meta[(unsigned int) yy_c];
 				}
 			yy_current_state = yy_nxt[yy_base[yy_current_state] + (unsigned int) yy_c];
 			++yy_cp;
 			}
-		while ( yy_base[yy_current_state] != 106 );
+		while ( yy_base[yy_current_state] != 237 );
 
 yy_find_action:
 		yy_act = yy_accept[yy_current_state];
@@ -793,6 +853,16 @@ yy_find_action:
 
 		YY_DO_BEFORE_ACTION;
 
+		if ( yy_act != YY_END_OF_BUFFER && yy_rule_can_match_eol[yy_act] )
+			{
+			yy_size_t yyl;
+			for ( yyl = 0; yyl < yyleng; ++yyl )
+				if ( yytext[yyl] == '\n' )
+					   
+    yylineno++;
+;
+			}
+
 do_action:	/* This label is used only to access EOF actions. */
 
 		switch ( yy_act )
@@ -806,7 +876,7 @@ do_action:	/* This label is used only to access EOF actions. */
 
 case 1:
 YY_RULE_SETUP
-#line 17 "tinycomp.l"
+#line 30 "tinycomp.l"
 {
                 yylval.typeLexeme = intType;
                 return TYPE;
@@ -815,7 +885,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 2:
 YY_RULE_SETUP
-#line 23 "tinycomp.l"
+#line 36 "tinycomp.l"
 {
                 yylval.typeLexeme = floatType;
                 return TYPE;
@@ -824,14 +894,14 @@ YY_RULE_SETUP
 	YY_BREAK
 case 3:
 YY_RULE_SETUP
-#line 29 "tinycomp.l"
+#line 42 "tinycomp.l"
 {
                 return STAT;
             }
 	YY_BREAK
 case 4:
 YY_RULE_SETUP
-#line 33 "tinycomp.l"
+#line 46 "tinycomp.l"
 {
                 yylval.typeLexeme = fractionType;
                 return TYPE;
@@ -839,143 +909,173 @@ YY_RULE_SETUP
 	YY_BREAK
 case 5:
 YY_RULE_SETUP
-#line 38 "tinycomp.l"
+#line 51 "tinycomp.l"
 return GE;
 	YY_BREAK
 case 6:
 YY_RULE_SETUP
-#line 39 "tinycomp.l"
+#line 52 "tinycomp.l"
 return LE;
 	YY_BREAK
 case 7:
 YY_RULE_SETUP
-#line 40 "tinycomp.l"
+#line 53 "tinycomp.l"
 return EQ;
 	YY_BREAK
 case 8:
 YY_RULE_SETUP
-#line 41 "tinycomp.l"
+#line 54 "tinycomp.l"
 return NE;
 	YY_BREAK
 case 9:
 YY_RULE_SETUP
-#line 42 "tinycomp.l"
+#line 55 "tinycomp.l"
 return assign;
 	YY_BREAK
 case 10:
 YY_RULE_SETUP
-#line 43 "tinycomp.l"
+#line 56 "tinycomp.l"
 return OR;
 	YY_BREAK
 case 11:
 YY_RULE_SETUP
-#line 44 "tinycomp.l"
+#line 57 "tinycomp.l"
 return AND;
 	YY_BREAK
 case 12:
 YY_RULE_SETUP
-#line 45 "tinycomp.l"
+#line 58 "tinycomp.l"
 return EXACT;
 	YY_BREAK
 case 13:
 YY_RULE_SETUP
-#line 48 "tinycomp.l"
+#line 61 "tinycomp.l"
 return WHILE;
 	YY_BREAK
 case 14:
 YY_RULE_SETUP
-#line 49 "tinycomp.l"
+#line 62 "tinycomp.l"
 return IF;
 	YY_BREAK
 case 15:
 YY_RULE_SETUP
-#line 50 "tinycomp.l"
+#line 63 "tinycomp.l"
 return ELSE;
 	YY_BREAK
 case 16:
 YY_RULE_SETUP
-#line 51 "tinycomp.l"
+#line 64 "tinycomp.l"
 return PRINT;
 	YY_BREAK
 case 17:
 YY_RULE_SETUP
-#line 52 "tinycomp.l"
-return THEN;
+#line 65 "tinycomp.l"
+return READ;
 	YY_BREAK
 case 18:
 YY_RULE_SETUP
-#line 54 "tinycomp.l"
-return TRUE;
+#line 66 "tinycomp.l"
+return THEN;
 	YY_BREAK
 case 19:
 YY_RULE_SETUP
-#line 55 "tinycomp.l"
-return FALSE;
+#line 67 "tinycomp.l"
+return LIKELY;
 	YY_BREAK
 case 20:
 YY_RULE_SETUP
-#line 57 "tinycomp.l"
+#line 68 "tinycomp.l"
+return UNLIKELY;
+	YY_BREAK
+case 21:
+YY_RULE_SETUP
+#line 69 "tinycomp.l"
+return SWITCH;
+	YY_BREAK
+case 22:
+YY_RULE_SETUP
+#line 70 "tinycomp.l"
+return CASE;
+	YY_BREAK
+case 23:
+YY_RULE_SETUP
+#line 71 "tinycomp.l"
+return DEFAULT;
+	YY_BREAK
+case 24:
+YY_RULE_SETUP
+#line 73 "tinycomp.l"
+return TRUE;
+	YY_BREAK
+case 25:
+YY_RULE_SETUP
+#line 74 "tinycomp.l"
+return FALSE;
+	YY_BREAK
+case 26:
+YY_RULE_SETUP
+#line 76 "tinycomp.l"
 {
                 yylval.idLexeme = yytext[0];
                 return ID;
             }
 	YY_BREAK
-case 21:
+case 27:
 YY_RULE_SETUP
-#line 62 "tinycomp.l"
+#line 81 "tinycomp.l"
 {
                 yylval.iValue = atoi(yytext);
                 return INTEGER;
             }
 	YY_BREAK
-case 22:
+case 28:
 YY_RULE_SETUP
-#line 67 "tinycomp.l"
+#line 86 "tinycomp.l"
 {
                 yylval.fValue = atof(yytext);
                 return FLOAT;
             }
 	YY_BREAK
-case 23:
+case 29:
 YY_RULE_SETUP
-#line 72 "tinycomp.l"
+#line 91 "tinycomp.l"
 {
                             sscanf(yytext, "%d|%d", &yylval.fracValue.num, &yylval.fracValue.denom);
                             return FRACTION;
                         }
 	YY_BREAK
-case 24:
+case 30:
 YY_RULE_SETUP
-#line 77 "tinycomp.l"
+#line 96 "tinycomp.l"
 {
                 return *yytext;
              }
 	YY_BREAK
-case 25:
+case 31:
 YY_RULE_SETUP
-#line 81 "tinycomp.l"
+#line 100 "tinycomp.l"
 { /* Skip 1-line comments */ }
 	YY_BREAK
-case 26:
-/* rule 26 can match eol */
+case 32:
+/* rule 32 can match eol */
 YY_RULE_SETUP
-#line 83 "tinycomp.l"
+#line 102 "tinycomp.l"
 ;       /* ignore whitespace */
 	YY_BREAK
-case 27:
+case 33:
 YY_RULE_SETUP
-#line 85 "tinycomp.l"
+#line 104 "tinycomp.l"
 {
                     const char* err = "Unknown character";
                     yyerror(err);
                 }
 	YY_BREAK
-case 28:
+case 34:
 YY_RULE_SETUP
-#line 90 "tinycomp.l"
+#line 109 "tinycomp.l"
 ECHO;
 	YY_BREAK
-#line 979 "lex.yy.c"
+#line 1079 "lex.yy.c"
 case YY_STATE_EOF(INITIAL):
 	yyterminate();
 
@@ -1268,7 +1368,7 @@ static int yy_get_next_buffer (void)
 		while ( yy_chk[yy_base[yy_current_state] + yy_c] != yy_current_state )
 			{
 			yy_current_state = (int) yy_def[yy_current_state];
-			if ( yy_current_state >= 82 )
+			if ( yy_current_state >= 116 )
 				yy_c = yy_meta[(unsigned int) yy_c];
 			}
 		yy_current_state = yy_nxt[yy_base[yy_current_state] + (unsigned int) yy_c];
@@ -1296,11 +1396,11 @@ static int yy_get_next_buffer (void)
 	while ( yy_chk[yy_base[yy_current_state] + yy_c] != yy_current_state )
 		{
 		yy_current_state = (int) yy_def[yy_current_state];
-		if ( yy_current_state >= 82 )
+		if ( yy_current_state >= 116 )
 			yy_c = yy_meta[(unsigned int) yy_c];
 		}
 	yy_current_state = yy_nxt[yy_base[yy_current_state] + (unsigned int) yy_c];
-	yy_is_jam = (yy_current_state == 81);
+	yy_is_jam = (yy_current_state == 115);
 
 		return yy_is_jam ? 0 : yy_current_state;
 }
@@ -1339,6 +1439,10 @@ static int yy_get_next_buffer (void)
 
 	*--yy_cp = (char) c;
 
+    if ( c == '\n' ){
+        --yylineno;
+    }
+
 	(yytext_ptr) = yy_bp;
 	(yy_hold_char) = *yy_cp;
 	(yy_c_buf_p) = yy_cp;
@@ -1416,6 +1520,11 @@ static int yy_get_next_buffer (void)
 	*(yy_c_buf_p) = '\0';	/* preserve yytext */
 	(yy_hold_char) = *++(yy_c_buf_p);
 
+	if ( c == '\n' )
+		   
+    yylineno++;
+;
+
 	return c;
 }
 #endif	/* ifndef YY_NO_INPUT */
@@ -1976,7 +2085,7 @@ void yyfree (void * ptr )
 
 #define YYTABLES_NAME "yytables"
 
-#line 90 "tinycomp.l"
+#line 109 "tinycomp.l"
 
 
 
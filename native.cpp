@@ -0,0 +1,2068 @@
+#include <iostream>
+#include <algorithm>
+#include <climits>
+#include <vector>
+
+#include <string.h>
+#include <assert.h>
+#include <sys/mman.h>
+
+using namespace std;
+
+#include "native.hpp"
+#include "runtime.hpp"
+#include "timer.hpp"
+
+/***********/
+/* ENCODER */
+/***********/
+
+Operand Operand::r(int reg) {
+	Operand o;
+	o.kind = regKind;
+	o.reg = reg;
+	o.disp = 0;
+	return o;
+}
+
+Operand Operand::m(int base, int disp) {
+	Operand o;
+	o.kind = memKind;
+	o.reg = base;
+	o.disp = disp;
+	return o;
+}
+
+Operand Operand::rip(int disp) {
+	Operand o;
+	o.kind = ripKind;
+	o.reg = -1;
+	o.disp = disp;
+	return o;
+}
+
+Operand Operand::imm(int value) {
+	Operand o;
+	o.kind = immKind;
+	o.reg = -1;
+	o.disp = value;
+	return o;
+}
+
+bool Operand::isReg() const {
+	return kind == regKind;
+}
+
+bool Operand::isMem() const {
+	return kind == memKind || kind == ripKind;
+}
+
+bool Operand::isImm() const {
+	return kind == immKind;
+}
+
+void X86Encoder::byte(int b) {
+	bytes.push_back((unsigned char)b);
+}
+
+void X86Encoder::dword(int d) {
+	for (int k = 0; k < 4; k++) {
+		byte((d >> (8 * k)) & 0xFF);
+	}
+}
+
+void X86Encoder::emit(int prefix, bool wide, int opcode, int opcode2, int reg, const Operand& rm) {
+	assert(!rm.isImm());
+
+	if (prefix != 0) {
+		byte(prefix);
+	}
+
+	int rex = (wide ? 8 : 0) | ((reg & 8) ? 4 : 0) | (rm.kind != Operand::ripKind && (rm.reg & 8) ? 1 : 0);
+	if (rex != 0) {
+		byte(0x40 | rex);
+	}
+
+	byte(opcode);
+	if (opcode2 >= 0) {
+		byte(opcode2);
+	}
+
+	if (rm.isReg()) {
+		byte(0xC0 | (reg & 7) << 3 | (rm.reg & 7));
+	} else if (rm.kind == Operand::ripKind) {
+		byte((reg & 7) << 3 | 5);
+		dword(rm.disp);
+	} else {
+		// always [base + disp32]; rsp and r12 as a base need a SIB byte
+		byte(0x80 | (reg & 7) << 3 | (rm.reg & 7));
+		if ((rm.reg & 7) == 4) {
+			byte(0x24);
+		}
+		dword(rm.disp);
+	}
+}
+
+const vector<unsigned char>& X86Encoder::getBytes() const {
+	return bytes;
+}
+
+int X86Encoder::size() const {
+	return bytes.size();
+}
+
+int X86Encoder::newLabel() {
+	labels.push_back(-1);
+	return labels.size() - 1;
+}
+
+void X86Encoder::bind(int label) {
+	labels[label] = bytes.size();
+}
+
+int X86Encoder::labelPos(int label) const {
+	return labels[label];
+}
+
+void X86Encoder::finish() {
+	for (size_t f = 0; f < fixups.size(); f++) {
+		int pos = fixups[f].first;
+		int target = labels[fixups[f].second];
+		assert(target >= 0);
+
+		int rel = target - (pos + 4);
+		for (int k = 0; k < 4; k++) {
+			bytes[pos + k] = (rel >> (8 * k)) & 0xFF;
+		}
+	}
+	fixups.clear();
+
+	for (size_t e = 0; e < entries.size(); e++) {
+		int pos = entries[e].first;
+		int target = labels[entries[e].second.first];
+		assert(target >= 0);
+
+		int rel = target - labels[entries[e].second.second];
+		for (int k = 0; k < 4; k++) {
+			bytes[pos + k] = (rel >> (8 * k)) & 0xFF;
+		}
+	}
+	entries.clear();
+}
+
+void X86Encoder::mov(const Operand& dst, const Operand& src) {
+	if (dst.isReg() && src.isImm()) {
+		if (dst.reg & 8) {
+			byte(0x41);
+		}
+		byte(0xB8 + (dst.reg & 7));
+		dword(src.disp);
+	} else if (dst.isReg()) {
+		emit(0, false, 0x8B, -1, dst.reg, src);
+	} else if (src.isImm()) {
+		emit(0, false, 0xC7, -1, 0, dst);
+		dword(src.disp);
+	} else {
+		assert(src.isReg());
+		emit(0, false, 0x89, -1, src.reg, dst);
+	}
+}
+
+/* Returns true if an immediate fits in the sign-extended imm8 forms */
+static bool isImm8(int value) {
+	return value >= -128 && value <= 127;
+}
+
+/* Emits the group-1 instruction "ext" (0 = add, 7 = cmp) of an immediate to rm */
+void X86Encoder::group1(int ext, const Operand& rm, int value) {
+	if (isImm8(value)) {
+		emit(0, false, 0x83, -1, ext, rm);
+		byte(value);
+	} else {
+		emit(0, false, 0x81, -1, ext, rm);
+		dword(value);
+	}
+}
+
+void X86Encoder::add(int reg, const Operand& src) {
+	if (src.isImm()) {
+		group1(0, Operand::r(reg), src.disp);
+	} else {
+		emit(0, false, 0x03, -1, reg, src);
+	}
+}
+
+void X86Encoder::add(const Operand& dst, const Operand& src) {
+	if (dst.isReg()) {
+		add(dst.reg, src);
+	} else if (src.isImm()) {
+		group1(0, dst, src.disp);
+	} else {
+		assert(src.isReg());
+		emit(0, false, 0x01, -1, src.reg, dst);
+	}
+}
+
+void X86Encoder::imul(int reg, const Operand& src) {
+	if (src.isImm()) {
+		imul(reg, Operand::r(reg), src.disp);
+	} else {
+		emit(0, false, 0x0F, 0xAF, reg, src);
+	}
+}
+
+void X86Encoder::imul(int reg, const Operand& src, int value) {
+	if (isImm8(value)) {
+		emit(0, false, 0x6B, -1, reg, src);
+		byte(value);
+	} else {
+		emit(0, false, 0x69, -1, reg, src);
+		dword(value);
+	}
+}
+
+void X86Encoder::cmp(const Operand& a, const Operand& b) {
+	if (b.isImm()) {
+		group1(7, a, b.disp);
+	} else if (a.isReg()) {
+		emit(0, false, 0x3B, -1, a.reg, b);
+	} else {
+		assert(b.isReg());
+		emit(0, false, 0x39, -1, b.reg, a);
+	}
+}
+
+void X86Encoder::cdq() {
+	byte(0x99);
+}
+
+void X86Encoder::idiv(int reg) {
+	emit(0, false, 0xF7, -1, 7, Operand::r(reg));
+}
+
+void X86Encoder::neg(int reg) {
+	emit(0, false, 0xF7, -1, 3, Operand::r(reg));
+}
+
+void X86Encoder::test(int reg1, int reg2) {
+	emit(0, false, 0x85, -1, reg2, Operand::r(reg1));
+}
+
+void X86Encoder::lea(int reg, const Operand& src) {
+	emit(0, true, 0x8D, -1, reg, src);
+}
+
+void X86Encoder::movsxd(int reg, int src) {
+	emit(0, true, 0x63, -1, reg, Operand::r(src));
+}
+
+void X86Encoder::imul64(int reg, int src) {
+	emit(0, true, 0x0F, 0xAF, reg, Operand::r(src));
+}
+
+void X86Encoder::cmp64(int reg1, int reg2) {
+	emit(0, true, 0x3B, -1, reg1, Operand::r(reg2));
+}
+
+void X86Encoder::mov64(int dst, int src) {
+	emit(0, true, 0x8B, -1, dst, Operand::r(src));
+}
+
+void X86Encoder::movabs(int reg, long long value) {
+	byte(0x48 | (reg & 8 ? 1 : 0));
+	byte(0xB8 + (reg & 7));
+	dword((int)value);
+	dword((int)(value >> 32));
+}
+
+void X86Encoder::push(int reg) {
+	if (reg & 8) {
+		byte(0x41);
+	}
+	byte(0x50 + (reg & 7));
+}
+
+void X86Encoder::pop(int reg) {
+	if (reg & 8) {
+		byte(0x41);
+	}
+	byte(0x58 + (reg & 7));
+}
+
+void X86Encoder::movss(const Operand& dst, const Operand& src) {
+	if (dst.isReg()) {
+		emit(0xF3, false, 0x0F, 0x10, dst.reg, src);
+	} else {
+		assert(src.isReg());
+		emit(0xF3, false, 0x0F, 0x11, src.reg, dst);
+	}
+}
+
+void X86Encoder::addss(int xmm, const Operand& src) {
+	emit(0xF3, false, 0x0F, 0x58, xmm, src);
+}
+
+void X86Encoder::mulss(int xmm, const Operand& src) {
+	emit(0xF3, false, 0x0F, 0x59, xmm, src);
+}
+
+void X86Encoder::divss(int xmm, const Operand& src) {
+	emit(0xF3, false, 0x0F, 0x5E, xmm, src);
+}
+
+void X86Encoder::ucomiss(int xmm, const Operand& src) {
+	emit(0, false, 0x0F, 0x2E, xmm, src);
+}
+
+void X86Encoder::cvtsi2ss(int xmm, const Operand& src) {
+	emit(0xF3, false, 0x0F, 0x2A, xmm, src);
+}
+
+void X86Encoder::cvttss2si(int reg, const Operand& src) {
+	emit(0xF3, false, 0x0F, 0x2C, reg, src);
+}
+
+void X86Encoder::movdToXmm(int xmm, int reg) {
+	emit(0x66, false, 0x0F, 0x6E, xmm, Operand::r(reg));
+}
+
+void X86Encoder::cvtss2sd(int xmm, const Operand& src) {
+	emit(0xF3, false, 0x0F, 0x5A, xmm, src);
+}
+
+void X86Encoder::jmp(int label) {
+	byte(0xE9);
+	fixups.push_back(make_pair((int)bytes.size(), label));
+	dword(0);
+}
+
+void X86Encoder::jcc(Cond cond, int label) {
+	byte(0x0F);
+	byte(0x80 | cond);
+	fixups.push_back(make_pair((int)bytes.size(), label));
+	dword(0);
+}
+
+void X86Encoder::call(int label) {
+	byte(0xE8);
+	fixups.push_back(make_pair((int)bytes.size(), label));
+	dword(0);
+}
+
+void X86Encoder::callRel32() {
+	byte(0xE8);
+	dword(0);
+}
+
+void X86Encoder::callReg(int reg) {
+	emit(0, false, 0xFF, -1, 2, Operand::r(reg));
+}
+
+void X86Encoder::jmpTable(int reg, const vector<int>& targets) {
+	int table = newLabel();
+
+	// lea rcx, [rip + table]
+	byte(0x48);
+	byte(0x8D);
+	byte(0x0D);
+	fixups.push_back(make_pair((int)bytes.size(), table));
+	dword(0);
+
+	// movsxd reg, dword [rcx + reg * 4]; add reg, rcx; jmp reg
+	byte(0x48 | (reg & 8 ? 6 : 0));
+	byte(0x63);
+	byte((reg & 7) << 3 | 4);
+	byte(0x80 | (reg & 7) << 3 | rcx);
+	emit(0, true, 0x01, -1, rcx, Operand::r(reg));
+	emit(0, false, 0xFF, -1, 4, Operand::r(reg));
+
+	bind(table);
+	for (size_t k = 0; k < targets.size(); k++) {
+		entries.push_back(make_pair((int)bytes.size(), make_pair(targets[k], table)));
+		dword(0);
+	}
+}
+
+void X86Encoder::ret() {
+	byte(0xC3);
+}
+
+/*************************/
+/* INSTRUCTION SELECTION */
+/*************************/
+
+/* Returns the constant int index of x[i] or x[i] = y, or -1 if it is not a constant */
+static int fieldIndex(Address* a) {
+	ConstAddress* c = dynamic_cast<ConstAddress*>(a);
+	if (c != NULL && c->getType() == intType) {
+		return c->getIntVal();
+	}
+	return -1;
+}
+
+/* The scratch registers a tree can use, besides the destination of its root:
+ * rax, rcx, rdx and xmm15, xmm14 (r11 is left to moveXMM, for float immediates) */
+static const int gpScratch[] = { X86Encoder::rdx, X86Encoder::rcx, X86Encoder::rax };
+static const int xmmScratch[] = { 14, 15 };
+static const int numScratch[2] = { 3, 2 };
+
+/* The cost of a goal which cannot be reached */
+static const int noCost = 1000;
+
+/* Sethi-Ullman number of a binary node */
+static int combineNeed(int a, int b) {
+	return a == b ? a + 1 : max(a, b);
+}
+
+ExprNode::ExprNode(Kind kind, bool isFloat, bool asFloat) {
+	this->kind = kind;
+	this->isFloat = isFloat;
+	this->asFloat = asFloat;
+	addr = NULL;
+	field = 0;
+	kids[0] = kids[1] = NULL;
+	for (int g = 0; g < numGoals; g++) {
+		cost[g] = noCost;
+	}
+	rule = ruleLeftFirst;
+	need = 1;
+}
+
+ExprNode::~ExprNode() {
+	delete kids[0];
+	delete kids[1];
+}
+
+bool ExprNode::isLeaf() const {
+	return kind == leafNode || kind == fieldNode;
+}
+
+TreeBuilder::TreeBuilder(TargetCode* code, const CellMap& cells, const TypeMap& types, bool enabled) {
+	TimeScope t("isel");
+	this->code = code;
+	this->cells = &cells;
+	this->types = &types;
+
+	int n = code->getNextInstr();
+	rootClass.assign(n, -1);
+	into.assign(n, -1);
+	kids.assign(2 * n, -1);
+	folded = trees = 0;
+
+	if (!enabled) {
+		return;
+	}
+
+	for (int j = 0; j < n; j++) {
+		rootClass[j] = classOf(code->getInstr(j));
+	}
+
+	FlowGraph fg(code);
+	Liveness live(code, fg, cells);
+
+	/* how many times each valuenumber is read */
+	vector<int> vnReads(n, 0);
+	for (int i = 0; i < n; i++) {
+		for (int p = 1; p <= 2; p++) {
+			if (InstrAddress* ia = dynamic_cast<InstrAddress*>(operand(code->getInstr(i), p))) {
+				vnReads[ia->getIndex()]++;
+			}
+		}
+	}
+
+	/* Producers come before their consumers, so trees grow bottom-up */
+	for (int j = 0; j < n; j++) {
+		if (rootClass[j] < 0) {
+			continue;
+		}
+
+		bool isTree = false;
+		for (int p = 1; p <= 2; p++) {
+			if (!isValueOperand(code->getInstr(j), p)) {
+				continue;
+			}
+
+			int i = producerOf(j, p, fg);
+			if (i < 0 || into[i] >= 0 || producerClass(i) != rootClass[j]
+					|| !singleUse(i, fg, live, vnReads) || !stable(i, j)) {
+				continue;
+			}
+
+			kids[2 * j + p - 1] = i;
+			if (treeNeed(j) > numScratch[rootClass[j]]) {
+				kids[2 * j + p - 1] = -1;
+				continue;
+			}
+			into[i] = j;
+			folded++;
+			isTree = true;
+		}
+
+		if (isTree) {
+			trees++;
+		}
+	}
+}
+
+/* Returns the operand p (1 or 2) of an instruction */
+Address* TreeBuilder::operand(TacInstr* instr, int p) const {
+	return p == 1 ? instr->getOperand1() : instr->getOperand2();
+}
+
+/* Returns 0 for int values, 1 for float values, -1 for fractions and unknown types */
+int TreeBuilder::scalarClass(Address* a) const {
+	typeName t;
+	if (a == NULL || !types->typeOf(a, t)) {
+		return -1;
+	}
+	return t == intType ? 0 : (t == floatType ? 1 : -1);
+}
+
+/* Returns the class of the values computed by a root, or -1 if the instruction is no root */
+int TreeBuilder::classOf(TacInstr* instr) const {
+	int c1 = scalarClass(instr->getOperand1());
+	int c2 = scalarClass(instr->getOperand2());
+
+	switch (instr->getOp()) {
+		case copyOpr: /* op1 = op2, converted to the type of op1 */
+			return c2 >= 0 ? c1 : -1;
+		case addOpr:
+		case mulOpr:
+			if (c1 < 0 || c2 < 0 || scalarClass(instr->getTemp()) != max(c1, c2)) {
+				return -1;
+			}
+			return max(c1, c2);
+		case indexCopyOpr: { /* temp[k] = op2, converted to int */
+			int k = fieldIndex(instr->getOperand1());
+			return (k == 0 || k == 4) && c2 >= 0 ? 0 : -1;
+		}
+		case eq1condJmpOpr:
+		case eq2condJmpOpr:
+		case neCondJmpOpr:
+		case ltCondJmpOpr:
+		case leCondJmpOpr:
+		case gtCondJmpOpr:
+		case geCondJmpOpr:
+			return c1 >= 0 && c2 >= 0 ? max(c1, c2) : -1;
+		default:
+			return -1;
+	}
+}
+
+/* Returns the class of the value computed by instruction i, if it can be folded, or -1 */
+int TreeBuilder::producerClass(int i) const {
+	TacInstr* instr = code->getInstr(i);
+
+	switch (instr->getOp()) {
+		case offsetOpr: {
+			int k = fieldIndex(instr->getOperand2());
+			bool isConst = dynamic_cast<ConstAddress*>(instr->getOperand1()) != NULL;
+			return (k == 0 || k == 4) && !isConst ? 0 : -1;
+		}
+		case addOpr:
+		case mulOpr:
+			return rootClass[i];
+		case copyOpr: {
+			// a copy into a temporary converting nothing
+			TempAddress* tmp = dynamic_cast<TempAddress*>(instr->getOperand1());
+			if (tmp == NULL || rootClass[i] < 0 || scalarClass(instr->getOperand2()) != rootClass[i]) {
+				return -1;
+			}
+			return rootClass[i];
+		}
+		default:
+			return -1;
+	}
+}
+
+/* Returns true if operand p of a root is a value, i.e. it can be replaced by a tree */
+bool TreeBuilder::isValueOperand(TacInstr* instr, int p) const {
+	switch (instr->getOp()) {
+		case copyOpr:
+		case indexCopyOpr:
+			return p == 2;
+		default:
+			return true;
+	}
+}
+
+/* Returns the instruction computing operand p of j in the same block, or -1 */
+int TreeBuilder::producerOf(int j, int p, const FlowGraph& fg) const {
+	Address* a = operand(code->getInstr(j), p);
+	int first = fg.getBlock(fg.getBlockOf(j)).first;
+
+	if (InstrAddress* ia = dynamic_cast<InstrAddress*>(a)) {
+		int i = ia->getIndex();
+		return i >= first && i < j ? i : -1;
+	}
+
+	TempAddress* tmp = dynamic_cast<TempAddress*>(a);
+	if (tmp == NULL || tmp->getWidth() != 4) {
+		return -1;
+	}
+
+	/* the definition reaching j */
+	int cell = cells->memCell(tmp->getOffset());
+	for (int i = j - 1; i >= first; i--) {
+		vector<int> d;
+		cells->defs(code->getInstr(i), d);
+		if (find(d.begin(), d.end(), cell) != d.end()) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/* Returns true if the result of instruction i is read exactly once, in its own block */
+bool TreeBuilder::singleUse(int i, const FlowGraph& fg, const Liveness& live, const vector<int>& vnReads) const {
+	TacInstr* instr = code->getInstr(i);
+	TempAddress* tmp = instr->getOp() == copyOpr ? dynamic_cast<TempAddress*>(instr->getOperand1()) : instr->getTemp();
+	int cell = cells->memCell(tmp->getOffset());
+	int b = fg.getBlockOf(i);
+
+	int reads = vnReads[i];
+	for (int k = i + 1; k <= fg.getBlock(b).last; k++) {
+		vector<int> u, d;
+		cells->uses(code->getInstr(k), u);
+		cells->defs(code->getInstr(k), d);
+
+		reads += count(u.begin(), u.end(), cell);
+		if (find(d.begin(), d.end(), cell) != d.end()) {
+			return reads == 1;
+		}
+	}
+	return reads == 1 && !live.isLiveOut(b, cell);
+}
+
+/* Appends to out the cells read by the tree of instruction i */
+void TreeBuilder::leafCells(int i, vector<int>& out) const {
+	TacInstr* instr = code->getInstr(i);
+
+	if (instr->getOp() == offsetOpr) {
+		vector<int> bc;
+		cells->cellsOf(instr->getOperand1(), bc);
+		// a fraction valuenumber has a single cell
+		out.push_back(bc.size() == 1 ? bc[0] : bc[fieldIndex(instr->getOperand2()) / 4]);
+		return;
+	}
+
+	for (int p = 1; p <= 2; p++) {
+		if (!isValueOperand(instr, p)) {
+			continue;
+		}
+		if (kids[2 * i + p - 1] >= 0) {
+			leafCells(kids[2 * i + p - 1], out);
+		} else {
+			cells->cellsOf(operand(instr, p), out);
+		}
+	}
+}
+
+/* Returns true if the operands of the tree of i keep their values until j */
+bool TreeBuilder::stable(int i, int j) const {
+	vector<int> leaves;
+	leafCells(i, leaves);
+
+	for (int k = i + 1; k < j; k++) {
+		TacInstr* instr = code->getInstr(k);
+		vector<int> d;
+		cells->defs(instr, d);
+		if (instr->getOp() == indexCopyOpr && fieldIndex(instr->getOperand1()) < 0) {
+			// a field with a variable index may be any of them
+			cells->cellsOf(instr->getTemp(), d);
+		}
+
+		for (size_t c = 0; c < d.size(); c++) {
+			if (find(leaves.begin(), leaves.end(), d[c]) != leaves.end()) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/* Returns the registers needed to compute operand p of j */
+int TreeBuilder::operandNeed(int j, int p) const {
+	int i = kids[2 * j + p - 1];
+	return i >= 0 ? treeNeed(i) : 1;
+}
+
+/* Returns the registers needed to compute the tree of j */
+int TreeBuilder::treeNeed(int j) const {
+	switch (code->getInstr(j)->getOp()) {
+		case addOpr:
+		case mulOpr:
+		case eq1condJmpOpr:
+		case eq2condJmpOpr:
+		case neCondJmpOpr:
+		case ltCondJmpOpr:
+		case leCondJmpOpr:
+		case gtCondJmpOpr:
+		case geCondJmpOpr:
+			return combineNeed(operandNeed(j, 1), operandNeed(j, 2));
+		case copyOpr:
+		case indexCopyOpr:
+			return operandNeed(j, 2);
+		default:
+			return 1;
+	}
+}
+
+int TreeBuilder::getRootClass(int j) const {
+	return rootClass[j];
+}
+
+int TreeBuilder::foldedInto(int i) const {
+	return into[i];
+}
+
+int TreeBuilder::kidOf(int j, int p) const {
+	return kids[2 * j + p - 1];
+}
+
+void TreeBuilder::printReport() const {
+	cerr << "isel: " << folded << " instructions folded into " << trees << " trees" << endl;
+}
+
+/***********************/
+/* REGISTER ALLOCATION */
+/***********************/
+
+/* The registers given to the allocator; the others are reserved:
+ * rax, rcx, rdx, r11 and xmm14, xmm15 are scratch registers of the code generator,
+ * r14 and r15 hold the addresses of the valuenumber slots and of Memory */
+static const int gpRegs[] = {
+	X86Encoder::rbx, X86Encoder::rbp, X86Encoder::rsi, X86Encoder::rdi, X86Encoder::r8,
+	X86Encoder::r9, X86Encoder::r10, X86Encoder::r12, X86Encoder::r13
+};
+static const int numGpRegs = sizeof(gpRegs) / sizeof(gpRegs[0]);
+static const int numXmmRegs = 14;
+
+/* Merges the class of a new occurrence into the class of a cell (-1 is "not seen yet") */
+static void mergeClass(vector<int>& cellClass, int cell, int cls) {
+	if (cellClass[cell] == -1) {
+		cellClass[cell] = cls;
+	} else if (cellClass[cell] != cls) {
+		cellClass[cell] = RegisterAllocator::noClass;
+	}
+}
+
+void RegisterAllocator::classify(TargetCode* code, const CellMap& cells, const TypeMap& types) {
+	cellClass.assign(cells.count(), -1);
+
+	for (int i = 0; i < code->getNextInstr(); i++) {
+		TacInstr* instr = code->getInstr(i);
+		Address* ops[3] = { instr->getOperand1(), instr->getOperand2(), instr->getTemp() };
+
+		for (int k = 0; k < 3; k++) {
+			Address* a = ops[k];
+			typeName t;
+			bool known = types.typeOf(a, t);
+
+			if (VarAddress* v = dynamic_cast<VarAddress*>(a)) {
+				int cls = v->getType() == floatType ? xmmClass : gpClass;
+				for (int off = 0; off < v->getWidth(); off += 4) {
+					mergeClass(cellClass, cells.memCell(v->getOffset() + off), cls);
+				}
+			} else if (TempAddress* tmp = dynamic_cast<TempAddress*>(a)) {
+				int cls = noClass;
+				if (tmp->getWidth() == 8 || (known && t == intType)) {
+					cls = gpClass;
+				} else if (known && t == floatType) {
+					cls = xmmClass;
+				}
+				for (int off = 0; off < tmp->getWidth(); off += 4) {
+					mergeClass(cellClass, cells.memCell(tmp->getOffset() + off), cls);
+				}
+			} else if (InstrAddress* ia = dynamic_cast<InstrAddress*>(a)) {
+				// fraction valuenumbers stay in their 8-byte slot
+				int cls = !known || t == fractionType ? noClass : (t == floatType ? xmmClass : gpClass);
+				mergeClass(cellClass, cells.vnCell(ia->getIndex()), cls);
+			}
+		}
+
+		/* fields accessed with a variable index must stay in memory */
+		Address* base = NULL;
+		if (instr->getOp() == offsetOpr && fieldIndex(instr->getOperand2()) < 0) {
+			base = instr->getOperand1();
+		} else if (instr->getOp() == indexCopyOpr && fieldIndex(instr->getOperand1()) < 0) {
+			base = instr->getTemp();
+		}
+
+		vector<int> bc;
+		cells.cellsOf(base, bc);
+		for (size_t c = 0; c < bc.size(); c++) {
+			cellClass[bc[c]] = noClass;
+		}
+	}
+}
+
+RegisterAllocator::RegisterAllocator(TargetCode* code, const CellMap& cells, const TypeMap& types,
+		const TreeBuilder& trees, bool enabled) {
+	TimeScope t("regalloc");
+	int nc = cells.count();
+
+	reg.assign(nc, -1);
+	start.assign(nc, -1);
+	end.assign(nc, -1);
+	values = spilled = gpUsed = xmmUsed = 0;
+
+	classify(code, cells, types);
+
+	vector<int> candidates;
+	for (int c = 0; c < nc; c++) {
+		if (cellClass[c] != -1) {
+			values++;
+		}
+		if (cellClass[c] == gpClass || cellClass[c] == xmmClass) {
+			candidates.push_back(c);
+		}
+	}
+
+	if (!enabled) {
+		return;
+	}
+
+	/* Live intervals: the first and the last position where each cell is live (or written) */
+	FlowGraph fg(code);
+	Liveness live(code, fg, cells);
+
+	start.assign(nc, INT_MAX);
+
+	/* the results of folded instructions never leave the tree computing them */
+	vector< vector<int> > hidden(code->getNextInstr());
+	for (int i = 0; i < code->getNextInstr(); i++) {
+		if (trees.foldedInto(i) >= 0) {
+			cells.defs(code->getInstr(i), hidden[trees.foldedInto(i)]);
+		}
+	}
+
+	for (int b = 0; b < fg.numBlocks(); b++) {
+		const BasicBlock& bb = fg.getBlock(b);
+
+		for (size_t k = 0; k < candidates.size(); k++) {
+			int c = candidates[k];
+			if (live.isLiveIn(b, c)) {
+				start[c] = min(start[c], bb.first);
+				end[c] = max(end[c], bb.first);
+			}
+			if (live.isLiveOut(b, c)) {
+				start[c] = min(start[c], bb.last);
+				end[c] = max(end[c], bb.last);
+			}
+		}
+
+		for (int i = bb.first; i <= bb.last; i++) {
+			/* a folded instruction reads its operands where its tree is computed, at the root */
+			int at = i;
+			while (trees.foldedInto(at) >= 0) {
+				at = trees.foldedInto(at);
+			}
+
+			vector<int> touched;
+			if (at == i) {
+				cells.defs(code->getInstr(i), touched);
+			}
+			size_t defs = touched.size();
+			cells.uses(code->getInstr(i), touched);
+
+			for (size_t k = 0; k < touched.size(); k++) {
+				// a root may write a cell its tree hides, e.g. t2 = a + (t2 = b * a): that write is real
+				if (k >= defs && find(hidden[i].begin(), hidden[i].end(), touched[k]) != hidden[i].end()) {
+					continue;
+				}
+				start[touched[k]] = min(start[touched[k]], at);
+				end[touched[k]] = max(end[touched[k]], at);
+			}
+		}
+	}
+
+	vector< pair<int, int> > order;
+	for (size_t k = 0; k < candidates.size(); k++) {
+		if (end[candidates[k]] >= 0) {
+			order.push_back(make_pair(start[candidates[k]], candidates[k]));
+		}
+	}
+	sort(order.begin(), order.end());
+
+	/* Linear scan */
+	vector<int> freeRegs[3];
+	for (int r = numGpRegs - 1; r >= 0; r--) {
+		freeRegs[gpClass].push_back(gpRegs[r]);
+	}
+	for (int r = numXmmRegs - 1; r >= 0; r--) {
+		freeRegs[xmmClass].push_back(xmmBase + r);
+	}
+
+	vector<int> active;		// the intervals holding a register, by increasing end
+
+	for (size_t k = 0; k < order.size(); k++) {
+		int c = order[k].second;
+		int cls = cellClass[c];
+
+		// an interval ending where this one starts is still needed by that instruction
+		while (!active.empty() && end[active[0]] < start[c]) {
+			freeRegs[cellClass[active[0]]].push_back(reg[active[0]]);
+			active.erase(active.begin());
+		}
+
+		int victim = -1;
+		if (freeRegs[cls].empty()) {
+			for (int a = active.size() - 1; a >= 0 && victim < 0; a--) {
+				if (cellClass[active[a]] == cls && end[active[a]] > end[c]) {
+					victim = active[a];
+				}
+			}
+			spilled++;
+
+			if (victim < 0) {
+				continue;
+			}
+			reg[c] = reg[victim];
+			reg[victim] = -1;
+			active.erase(find(active.begin(), active.end(), victim));
+		} else {
+			reg[c] = freeRegs[cls].back();
+			freeRegs[cls].pop_back();
+		}
+
+		size_t pos = 0;
+		while (pos < active.size() && end[active[pos]] <= end[c]) {
+			pos++;
+		}
+		active.insert(active.begin() + pos, c);
+	}
+
+	for (int c = 0; c < nc; c++) {
+		if (reg[c] >= xmmBase) {
+			xmmUsed++;
+		} else if (reg[c] >= 0) {
+			gpUsed++;
+		}
+		if (start[c] == INT_MAX) {
+			start[c] = -1;
+		}
+	}
+}
+
+int RegisterAllocator::regOf(int cell) const {
+	return reg[cell];
+}
+
+int RegisterAllocator::startOf(int cell) const {
+	return start[cell];
+}
+
+int RegisterAllocator::endOf(int cell) const {
+	return end[cell];
+}
+
+void RegisterAllocator::printReport() const {
+	cerr << "regalloc: " << values << " values, " << gpUsed << " in general purpose registers, "
+		<< xmmUsed << " in XMM registers, " << spilled << " spilled" << endl;
+}
+
+/******************/
+/* CODE GENERATOR */
+/******************/
+
+NativeCode::NativeCode(TargetCode* code, bool allocate, bool select, int osrEntry)
+		: cells(code), types(code), trees(code, cells, types, select), regs(code, cells, types, trees, allocate) {
+	TimeScope t("encode");
+	this->code = code;
+	this->allocate = allocate;
+	this->select = select;
+
+	int n = code->getNextInstr();
+
+	vnRead.assign(n, false);
+	for (int i = 0; i < n; i++) {
+		TacInstr* instr = code->getInstr(i);
+		Address* ops[2] = { instr->getOperand1(), instr->getOperand2() };
+
+		for (int k = 0; k < 2; k++) {
+			if (InstrAddress* ia = dynamic_cast<InstrAddress*>(ops[k])) {
+				vnRead[ia->getIndex()] = true;
+			}
+		}
+	}
+
+	for (int i = 0; i < n; i++) {
+		instrLabel.push_back(as.newLabel());
+	}
+	divZeroLabel = as.newLabel();
+	exitLabel = as.newLabel();
+	osrLabel = -1;
+
+	/* Prologue */
+	genEntry(0);
+
+	for (int i = 0; i < n; i++) {
+		genInstr(i);
+	}
+
+	/* Epilogue */
+	as.bind(divZeroLabel);
+	as.mov(Operand::r(X86Encoder::rax), Operand::imm(1));
+	as.bind(exitLabel);
+	as.pop(X86Encoder::r15);
+	as.pop(X86Encoder::r14);
+	as.pop(X86Encoder::r13);
+	as.pop(X86Encoder::r12);
+	as.pop(X86Encoder::rbp);
+	as.pop(X86Encoder::rbx);
+	as.ret();
+
+	/* Divisions by zero stop the program with its variables in Memory, as HALT does */
+	for (size_t k = 0; k < divZeroStops.size(); k++) {
+		as.bind(divZeroStops[k].first);
+		genStoreBack(divZeroStops[k].second);
+		as.jmp(divZeroLabel);
+	}
+
+	/* The entry at the loop header, which shares the epilogue */
+	if (osrEntry >= 0) {
+		osrLabel = as.newLabel();
+		as.bind(osrLabel);
+		genEntry(osrEntry);
+		as.jmp(instrLabel[osrEntry]);
+	}
+
+	as.finish();
+
+	/* copy the code to executable memory */
+	execSize = as.getBytes().size();
+	exec = mmap(NULL, execSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (exec == MAP_FAILED) {
+		exec = NULL;
+		error = "cannot allocate memory for the code";
+		return;
+	}
+	memcpy(exec, &as.getBytes()[0], execSize);
+	// a hardened kernel may refuse to make writable pages executable
+	if (mprotect(exec, execSize, PROT_READ | PROT_EXEC) != 0) {
+		munmap(exec, execSize);
+		exec = NULL;
+		error = "cannot make the code executable";
+	}
+}
+
+void NativeCode::printReport() const {
+	if (select) {
+		trees.printReport();
+	}
+	if (allocate) {
+		regs.printReport();
+	}
+}
+
+NativeCode::~NativeCode() {
+	if (exec != NULL) {
+		munmap(exec, execSize);
+	}
+}
+
+bool NativeCode::ok() const {
+	return exec != NULL;
+}
+
+const string& NativeCode::getError() const {
+	return error;
+}
+
+const vector<unsigned char>& NativeCode::getBytes() const {
+	return as.getBytes();
+}
+
+const unsigned char* NativeCode::getEntry() const {
+	return (const unsigned char*)exec;
+}
+
+int NativeCode::offsetOf(int i) const {
+	return i < (int)instrLabel.size() ? as.labelPos(instrLabel[i]) : as.labelPos(divZeroLabel);
+}
+
+int NativeCode::runFrom(long long* slots) {
+	assert(osrLabel >= 0 && exec != NULL);
+	unsigned char* memory = (unsigned char*)Memory::getInstance().retrieve(0);
+
+	unsigned char* entry = (unsigned char*)exec + as.labelPos(osrLabel);
+	int (*f)(unsigned char*, long long*) = (int (*)(unsigned char*, long long*))entry;
+	return f(memory, slots);
+}
+
+int NativeCode::run() {
+	assert(exec != NULL);
+	unsigned char* memory = (unsigned char*)Memory::getInstance().retrieve(0);
+	vector<long long> slots(code->getNextInstr() + 1);
+
+	int (*f)(unsigned char*, long long*) = (int (*)(unsigned char*, long long*))exec;
+	return f(memory, &slots[0]);
+}
+
+typeName NativeCode::typeOf(Address* a) const {
+	typeName t;
+	if (types.typeOf(a, t)) {
+		return t;
+	}
+	// a temporary never written
+	TempAddress* tmp = dynamic_cast<TempAddress*>(a);
+	return tmp != NULL && tmp->getWidth() == 8 ? fractionType : intType;
+}
+
+Operand NativeCode::homeOf(int cell) const {
+	if (cell >= cells.vnCell(0)) {
+		return Operand::m(X86Encoder::r14, 8 * (cell - cells.vnCell(0)));
+	}
+	return Operand::m(X86Encoder::r15, 4 * cell);
+}
+
+/* Returns where the 4-byte field (0 or 4) of a value is found */
+Operand NativeCode::locOf(Address* a, int field) const {
+	if (ConstAddress* c = dynamic_cast<ConstAddress*>(a)) {
+		switch (c->getType()) {
+			case intType:
+				return Operand::imm(c->getIntVal());
+			case floatType: {
+				float f = c->getFloatVal();
+				int bits;
+				memcpy(&bits, &f, sizeof(bits));
+				return Operand::imm(bits);
+			}
+			default:
+				return Operand::imm(field == 0 ? c->getFractionVal().num : c->getFractionVal().denom);
+		}
+	}
+
+	int cell;
+	if (InstrAddress* ia = dynamic_cast<InstrAddress*>(a)) {
+		cell = cells.vnCell(ia->getIndex());
+		if (field != 0) {
+			// only scalar valuenumbers live in registers
+			return Operand::m(X86Encoder::r14, 8 * ia->getIndex() + field);
+		}
+	} else {
+		vector<int> ac;
+		cells.cellsOf(a, ac);
+		assert(field / 4 < (int)ac.size());
+		cell = ac[field / 4];
+	}
+
+	int r = regs.regOf(cell);
+	if (r >= RegisterAllocator::xmmBase) {
+		return Operand::r(r - RegisterAllocator::xmmBase);
+	}
+	if (r >= 0) {
+		return Operand::r(r);
+	}
+	return homeOf(cell);
+}
+
+/* Moves 4 bytes between general purpose registers, memory and immediates */
+void NativeCode::moveGP(const Operand& dst, const Operand& src) {
+	if (dst.isReg() && src.isReg() && dst.reg == src.reg) {
+		return;
+	}
+	if (dst.isMem() && src.isMem()) {
+		as.mov(Operand::r(X86Encoder::rax), src);
+		as.mov(dst, Operand::r(X86Encoder::rax));
+	} else {
+		as.mov(dst, src);
+	}
+}
+
+/* Moves a float between XMM registers, memory and immediates */
+void NativeCode::moveXMM(const Operand& dst, const Operand& src) {
+	if (dst.isReg() && src.isReg() && dst.reg == src.reg) {
+		return;
+	}
+	if (src.isImm()) {
+		if (dst.isMem()) {
+			as.mov(dst, src);
+		} else {
+			as.mov(Operand::r(X86Encoder::r11), src);
+			as.movdToXmm(dst.reg, X86Encoder::r11);
+		}
+	} else if (dst.isMem() && src.isMem()) {
+		as.movss(Operand::r(15), src);
+		as.movss(dst, Operand::r(15));
+	} else {
+		as.movss(dst, src);
+	}
+}
+
+/* Loads a value, converted to int, into a general purpose register */
+void NativeCode::toGP(int reg, Address* a) {
+	Operand src = locOf(a, 0);
+
+	if (typeOf(a) != floatType) {
+		moveGP(Operand::r(reg), src);
+	} else if (src.isImm()) {
+		float f;
+		memcpy(&f, &src.disp, sizeof(f));
+		as.mov(Operand::r(reg), Operand::imm((int)f));
+	} else {
+		as.cvttss2si(reg, src);
+	}
+}
+
+/* Loads a value, converted to float, into an XMM register */
+void NativeCode::toXMM(int xmm, Address* a) {
+	Operand src = locOf(a, 0);
+
+	if (typeOf(a) == floatType) {
+		moveXMM(Operand::r(xmm), src);
+	} else if (src.isImm()) {
+		float f = (float)src.disp;
+		int bits;
+		memcpy(&bits, &f, sizeof(bits));
+		moveXMM(Operand::r(xmm), Operand::imm(bits));
+	} else {
+		as.cvtsi2ss(xmm, src);
+	}
+}
+
+/* Returns field 0 or 4 of a value seen as a fraction; reg is used if it must be computed */
+Operand NativeCode::fractionField(int reg, Address* a, int field) {
+	if (typeOf(a) == fractionType) {
+		return locOf(a, field);
+	}
+	if (field == 4) {
+		return Operand::imm(1);
+	}
+	if (typeOf(a) == intType) {
+		return locOf(a, 0);
+	}
+	toGP(reg, a);
+	return Operand::r(reg);
+}
+
+/* dst = src, converting src to the type of dst */
+void NativeCode::genCopy(Address* dst, Address* src) {
+	switch (typeOf(dst)) {
+		case floatType: {
+			Operand d = locOf(dst, 0);
+			if (typeOf(src) == floatType) {
+				moveXMM(d, locOf(src, 0));
+			} else if (d.isReg()) {
+				toXMM(d.reg, src);
+			} else {
+				toXMM(15, src);
+				moveXMM(d, Operand::r(15));
+			}
+			break;
+		}
+		case intType: {
+			Operand d = locOf(dst, 0);
+			if (d.isReg()) {
+				toGP(d.reg, src);
+			} else if (typeOf(src) != floatType) {
+				moveGP(d, locOf(src, 0));
+			} else {
+				toGP(X86Encoder::rax, src);
+				moveGP(d, Operand::r(X86Encoder::rax));
+			}
+			break;
+		}
+		case fractionType:
+			for (int field = 0; field <= 4; field += 4) {
+				moveGP(locOf(dst, field), fractionField(X86Encoder::rax, src, field));
+			}
+			break;
+	}
+}
+
+void NativeCode::genArith(TacInstr* instr) {
+	Address* op1 = instr->getOperand1();
+	Address* op2 = instr->getOperand2();
+	TempAddress* dst = instr->getTemp();
+
+	bool isFloat = typeOf(op1) == floatType || typeOf(op2) == floatType;
+	Operand d = locOf(dst, 0);
+	Operand b = locOf(op2, 0);
+
+	if (isFloat) {
+		bool bInXmm = typeOf(op2) == floatType && !b.isImm();
+
+		// compute straight into the destination register, unless it holds the second operand
+		int w = d.isReg() && !(bInXmm && b.isReg() && b.reg == d.reg) ? d.reg : 15;
+		toXMM(w, op1);
+
+		if (!bInXmm) {
+			toXMM(14, op2);
+			b = Operand::r(14);
+		}
+
+		switch (instr->getOp()) {
+			case addOpr:
+				as.addss(w, b);
+				break;
+			case mulOpr:
+				as.mulss(w, b);
+				break;
+			default:
+				as.divss(w, b);
+				break;
+		}
+
+		moveXMM(d, Operand::r(w));
+		if (vnRead[instr->getValueNumber()->getIndex()]) {
+			moveXMM(locOf(instr->getValueNumber(), 0), Operand::r(w));
+		}
+		return;
+	}
+
+	int w;
+	if (instr->getOp() == divOpr) {
+		toGP(X86Encoder::rax, op1);
+		toGP(X86Encoder::rcx, op2);
+
+		/* x / 0 stops the program, x / -1 is a negation (idiv would trap on INT_MIN / -1) */
+		int divide = as.newLabel();
+		int done = as.newLabel();
+
+		// the variables held in registers go back to Memory first, see the constructor
+		int stop = as.newLabel();
+		divZeroStops.push_back(make_pair(stop, instr->getValueNumber()->getIndex()));
+		as.test(X86Encoder::rcx, X86Encoder::rcx);
+		as.jcc(X86Encoder::condE, stop);
+		as.cmp(Operand::r(X86Encoder::rcx), Operand::imm(-1));
+		as.jcc(X86Encoder::condNE, divide);
+		as.neg(X86Encoder::rax);
+		as.jmp(done);
+		as.bind(divide);
+		as.cdq();
+		as.idiv(X86Encoder::rcx);
+		as.bind(done);
+
+		w = X86Encoder::rax;
+	} else {
+		bool bInGP = typeOf(op2) != floatType;
+
+		w = d.isReg() && !(bInGP && b.isReg() && b.reg == d.reg) ? d.reg : X86Encoder::rax;
+		toGP(w, op1);
+
+		if (!bInGP) {
+			toGP(X86Encoder::rcx, op2);
+			b = Operand::r(X86Encoder::rcx);
+		}
+
+		if (instr->getOp() == addOpr) {
+			as.add(w, b);
+		} else {
+			as.imul(w, b);
+		}
+	}
+
+	moveGP(d, Operand::r(w));
+	if (vnRead[instr->getValueNumber()->getIndex()]) {
+		moveGP(locOf(instr->getValueNumber(), 0), Operand::r(w));
+	}
+}
+
+/* Returns the relation with the operands swapped: a < b is b > a */
+static oprEnum mirrored(oprEnum relation) {
+	switch (relation) {
+		case ltCondJmpOpr:
+			return gtCondJmpOpr;
+		case leCondJmpOpr:
+			return geCondJmpOpr;
+		case gtCondJmpOpr:
+			return ltCondJmpOpr;
+		case geCondJmpOpr:
+			return leCondJmpOpr;
+		default:
+			return relation;
+	}
+}
+
+/* Jumps to target if the operands just compared (by cmp, or ucomiss if isFloat) are in the relation */
+void NativeCode::genBranch(oprEnum relation, bool isFloat, int target) {
+	if (!isFloat) {
+		const X86Encoder::Cond signedCond[] = {
+			X86Encoder::condNE, X86Encoder::condL, X86Encoder::condLE, X86Encoder::condG, X86Encoder::condGE
+		};
+		as.jcc(relation == eq1condJmpOpr || relation == eq2condJmpOpr ? X86Encoder::condE : signedCond[relation - neCondJmpOpr], target);
+		return;
+	}
+
+	/* unordered (NaN) operands set ZF, PF and CF: they are not equal, and neither smaller
+	 * nor larger, so only ">" and ">=" (CF and ZF clear, CF clear) need no parity test */
+	int unordered = as.newLabel();
+	switch (relation) {
+		case neCondJmpOpr:
+			as.jcc(X86Encoder::condP, target);
+			as.jcc(X86Encoder::condNE, target);
+			break;
+		case gtCondJmpOpr:
+			as.jcc(X86Encoder::condA, target);
+			break;
+		case geCondJmpOpr:
+			as.jcc(X86Encoder::condAE, target);
+			break;
+		default:
+			as.jcc(X86Encoder::condP, unordered);
+			as.jcc(relation == ltCondJmpOpr ? X86Encoder::condB : (relation == leCondJmpOpr ? X86Encoder::condBE : X86Encoder::condE), target);
+			break;
+	}
+	as.bind(unordered);
+}
+
+void NativeCode::genCondJump(TacInstr* instr, int target) {
+	Address* op1 = instr->getOperand1();
+	Address* op2 = instr->getOperand2();
+	typeName t1 = typeOf(op1);
+	typeName t2 = typeOf(op2);
+	oprEnum relation = instr->getOp();
+
+	if (t1 == fractionType || t2 == fractionType) {
+		as.mov(Operand::r(X86Encoder::rax), fractionField(X86Encoder::rax, op1, 0));
+		as.mov(Operand::r(X86Encoder::rcx), fractionField(X86Encoder::rcx, op1, 4));
+		as.mov(Operand::r(X86Encoder::rdx), fractionField(X86Encoder::rdx, op2, 0));
+		as.mov(Operand::r(X86Encoder::r11), fractionField(X86Encoder::r11, op2, 4));
+
+		if (relation == eq2condJmpOpr) {
+			// same fields
+			int differ = as.newLabel();
+			as.cmp(Operand::r(X86Encoder::rax), Operand::r(X86Encoder::rdx));
+			as.jcc(X86Encoder::condNE, differ);
+			as.cmp(Operand::r(X86Encoder::rcx), Operand::r(X86Encoder::r11));
+			as.jcc(X86Encoder::condE, target);
+			as.bind(differ);
+		} else {
+			// as rational numbers: n1 * d2 against n2 * d1, in 64 bits
+			as.movsxd(X86Encoder::rax, X86Encoder::rax);
+			as.movsxd(X86Encoder::rcx, X86Encoder::rcx);
+			as.movsxd(X86Encoder::rdx, X86Encoder::rdx);
+			as.movsxd(X86Encoder::r11, X86Encoder::r11);
+			as.imul64(X86Encoder::rax, X86Encoder::r11);
+			as.imul64(X86Encoder::rdx, X86Encoder::rcx);
+			as.cmp64(X86Encoder::rax, X86Encoder::rdx);
+			genBranch(relation, false, target);
+		}
+	} else if (t1 == floatType || t2 == floatType) {
+		Operand b = locOf(op2, 0);
+		toXMM(15, op1);
+		if (t2 != floatType || b.isImm()) {
+			toXMM(14, op2);
+			b = Operand::r(14);
+		}
+
+		as.ucomiss(15, b);
+		genBranch(relation, true, target);
+	} else {
+		Operand a = locOf(op1, 0);
+		Operand b = locOf(op2, 0);
+
+		if (!a.isReg()) {
+			moveGP(Operand::r(X86Encoder::rax), a);
+			a = Operand::r(X86Encoder::rax);
+		}
+		as.cmp(a, b);
+		genBranch(relation, false, target);
+	}
+}
+
+/* Saves the callee-saved registers, then loads the values live at instruction "at" into their registers */
+void NativeCode::genEntry(int at) {
+	as.push(X86Encoder::rbx);
+	as.push(X86Encoder::rbp);
+	as.push(X86Encoder::r12);
+	as.push(X86Encoder::r13);
+	as.push(X86Encoder::r14);
+	as.push(X86Encoder::r15);
+	as.mov64(X86Encoder::r15, X86Encoder::rdi);
+	as.mov64(X86Encoder::r14, X86Encoder::rsi);
+
+	for (int c = 0; c < cells.count(); c++) {
+		int r = regs.regOf(c);
+		bool live = regs.startOf(c) >= 0 && regs.startOf(c) <= at && regs.endOf(c) >= at;
+		if (r >= RegisterAllocator::xmmBase && live) {
+			as.movss(Operand::r(r - RegisterAllocator::xmmBase), homeOf(c));
+		} else if (r >= 0 && live) {
+			as.mov(Operand::r(r), homeOf(c));
+		}
+	}
+}
+
+/* Stores the variables held in registers at instruction "at" (all of them if -1) back to Memory */
+void NativeCode::genStoreBack(int at) {
+	for (int c = 0; c < cells.vnCell(0); c++) {
+		int r = regs.regOf(c);
+		bool held = cells.isVarCell(c) && r >= 0 && (at < 0 || (regs.startOf(c) <= at && regs.endOf(c) >= at));
+		if (held && r >= RegisterAllocator::xmmBase) {
+			as.movss(homeOf(c), Operand::r(r - RegisterAllocator::xmmBase));
+		} else if (held) {
+			as.mov(homeOf(c), Operand::r(r));
+		}
+	}
+}
+
+/* Saves the values live at instruction i held in registers not preserved across calls
+ * (the callee-saved rbx, rbp, r12 and r13 are left alone) in their homes */
+void NativeCode::genSaveLive(int i, vector<int>& saved) {
+	for (int c = 0; c < cells.count(); c++) {
+		int r = regs.regOf(c);
+		bool live = regs.startOf(c) >= 0 && regs.startOf(c) <= i && regs.endOf(c) >= i;
+		bool preserved = r == X86Encoder::rbx || r == X86Encoder::rbp || r == X86Encoder::r12 || r == X86Encoder::r13;
+		if (r >= 0 && live && !preserved) {
+			saved.push_back(c);
+		}
+	}
+
+	for (size_t k = 0; k < saved.size(); k++) {
+		int r = regs.regOf(saved[k]);
+		if (r >= RegisterAllocator::xmmBase) {
+			as.movss(homeOf(saved[k]), Operand::r(r - RegisterAllocator::xmmBase));
+		} else {
+			as.mov(homeOf(saved[k]), Operand::r(r));
+		}
+	}
+}
+
+/* Loads the given cells back into their registers, from their homes */
+void NativeCode::genReload(const vector<int>& cellList) {
+	for (size_t k = 0; k < cellList.size(); k++) {
+		int r = regs.regOf(cellList[k]);
+		if (r >= RegisterAllocator::xmmBase) {
+			as.movss(Operand::r(r - RegisterAllocator::xmmBase), homeOf(cellList[k]));
+		} else if (r >= 0) {
+			as.mov(Operand::r(r), homeOf(cellList[k]));
+		}
+	}
+}
+
+/* Calls a function of the runtime (see runtime.hpp), its arguments already in place;
+ * the prologue leaves the stack 8 bytes off the 16-byte alignment a call needs */
+void NativeCode::genCall(long long function) {
+	as.movabs(X86Encoder::rax, function);
+	as.push(X86Encoder::rax);
+	as.callReg(X86Encoder::rax);
+	as.pop(X86Encoder::rcx);
+}
+
+/* "read x" at instruction i: InputReader stores the value in the home of x */
+void NativeCode::genRead(int i) {
+	VarAddress* x = (VarAddress*)code->getInstr(i)->getOperand1();
+
+	vector<int> saved;
+	genSaveLive(i, saved);
+
+	void (*read)(int*) = x->getType() == intType ? InputReader::readInt
+		: (x->getType() == floatType ? InputReader::readFloat : InputReader::readFraction);
+
+	as.lea(X86Encoder::rdi, Operand::m(X86Encoder::r15, x->getOffset()));
+	genCall((long long)read);
+	genReload(saved);
+
+	/* then x, wherever it is held */
+	vector<int> xc;
+	cells.cellsOf(x, xc);
+	genReload(xc);
+}
+
+/* "print e" at instruction i: the value goes to OutputWriter in edi, xmm0 or edi and esi */
+void NativeCode::genPrint(int i) {
+	Address* a = code->getInstr(i)->getOperand1();
+
+	vector<int> saved;
+	genSaveLive(i, saved);
+
+	switch (typeOf(a)) {
+		case intType:
+			toGP(X86Encoder::rdi, a);
+			genCall((long long)OutputWriter::printInt);
+			break;
+		case floatType:
+			toXMM(0, a);
+			genCall((long long)OutputWriter::printFloat);
+			break;
+		case fractionType:
+			// through scratch registers, as the fields may be held in edi and esi
+			moveGP(Operand::r(X86Encoder::rax), locOf(a, 0));
+			moveGP(Operand::r(X86Encoder::rcx), locOf(a, 4));
+			as.mov(Operand::r(X86Encoder::rdi), Operand::r(X86Encoder::rax));
+			as.mov(Operand::r(X86Encoder::rsi), Operand::r(X86Encoder::rcx));
+			genCall((long long)OutputWriter::printFraction);
+			break;
+	}
+
+	genReload(saved);
+}
+
+/* Builds the tree of operand p of instruction j, used as a float if asFloat is true */
+ExprNode* NativeCode::buildTree(int j, int p, bool asFloat) {
+	TacInstr* instr = code->getInstr(j);
+	Address* a = p == 1 ? instr->getOperand1() : instr->getOperand2();
+	int i = trees.kidOf(j, p);
+
+	if (i < 0) {
+		ExprNode* n = new ExprNode(ExprNode::leafNode, typeOf(a) == floatType, asFloat);
+		n->addr = a;
+		return n;
+	}
+
+	TacInstr* kid = code->getInstr(i);
+	switch (kid->getOp()) {
+		case offsetOpr: {
+			ExprNode* n = new ExprNode(ExprNode::fieldNode, false, asFloat);
+			n->addr = kid->getOperand1();
+			n->field = fieldIndex(kid->getOperand2());
+			return n;
+		}
+		case copyOpr:
+			return buildTree(i, 2, asFloat);
+		default: {
+			ExprNode* n = new ExprNode(kid->getOp() == addOpr ? ExprNode::addNode : ExprNode::mulNode, asFloat, asFloat);
+			n->kids[0] = buildTree(i, 1, asFloat);
+			n->kids[1] = buildTree(i, 2, asFloat);
+			return n;
+		}
+	}
+}
+
+/* Labels a tree bottom-up with the cheapest way of reducing each node to each goal:
+ *   imm <- constant                    (0, int constants only)
+ *   rm  <- leaf | field                (0, if no conversion is needed)
+ *   reg <- constant                    (1: mov; 2 for a float, through r11)
+ *   reg <- leaf | field                (1: mov, movss, or a conversion)
+ *   reg <- op(reg, rm | imm | reg)     (1 + the costs of the kids, in either order)
+ *   reg <- mul(rm, imm)                (1: imul reg, rm, imm)
+ *   rm  <- reg                         (the cost of reg, for inner nodes)
+ */
+void NativeCode::label(ExprNode* n) {
+	if (n->isLeaf()) {
+		bool isConst = n->kind == ExprNode::leafNode && dynamic_cast<ConstAddress*>(n->addr) != NULL;
+		if (isConst) {
+			n->cost[ExprNode::goalImm] = n->asFloat ? noCost : 0;
+			n->cost[ExprNode::goalReg] = n->asFloat ? 2 : 1;
+		} else {
+			n->cost[ExprNode::goalRM] = n->isFloat == n->asFloat ? 0 : noCost;
+			n->cost[ExprNode::goalReg] = 1;
+		}
+		return;
+	}
+
+	label(n->kids[0]);
+	label(n->kids[1]);
+	n->need = combineNeed(n->kids[0]->need, n->kids[1]->need);
+
+	int best = noCost;
+	for (int order = 0; order < 2; order++) {
+		ExprNode* first = n->kids[order];
+		ExprNode* second = n->kids[1 - order];
+
+		// the kid computed second must fit in the registers left by the first one
+		if (!second->isLeaf() && first->need < second->need) {
+			continue;
+		}
+
+		int operandCost = min(second->cost[ExprNode::goalReg],
+			min(second->cost[ExprNode::goalRM], second->cost[ExprNode::goalImm]));
+		int c = first->cost[ExprNode::goalReg] + operandCost + 1;
+		if (c < best) {
+			best = c;
+			n->rule = order == 0 ? ExprNode::ruleLeftFirst : ExprNode::ruleRightFirst;
+		}
+
+		if (n->kind == ExprNode::mulNode && !n->asFloat && second->cost[ExprNode::goalImm] == 0) {
+			c = min(first->cost[ExprNode::goalRM], first->cost[ExprNode::goalReg]) + 1;
+			if (c < best) {
+				best = c;
+				n->rule = order == 0 ? ExprNode::ruleMulImmLeft : ExprNode::ruleMulImmRight;
+			}
+		}
+	}
+
+	n->cost[ExprNode::goalReg] = best;
+	n->cost[ExprNode::goalRM] = best;
+}
+
+/* Returns the location of a leaf, or its value as an immediate of its own type */
+Operand NativeCode::leafOperand(ExprNode* n) const {
+	if (n->kind == ExprNode::fieldNode) {
+		return locOf(n->addr, n->field);
+	}
+	return locOf(n->addr, 0);
+}
+
+/* Returns the value of a constant leaf used as an int */
+int NativeCode::immValue(ExprNode* n) const {
+	ConstAddress* c = dynamic_cast<ConstAddress*>(n->addr);
+	return c->getType() == floatType ? (int)c->getFloatVal() : c->getIntVal();
+}
+
+/* Returns true if a tree reads a register of the given class */
+bool NativeCode::readsReg(ExprNode* n, int reg, bool isFloat) const {
+	if (!n->isLeaf()) {
+		return readsReg(n->kids[0], reg, isFloat) || readsReg(n->kids[1], reg, isFloat);
+	}
+	Operand o = leafOperand(n);
+	return o.isReg() && o.reg == reg && n->isFloat == isFloat;
+}
+
+/* Returns true if a tree can be computed straight into reg, i.e. no operand
+ * is read from reg once reg has been written */
+bool NativeCode::safeTarget(ExprNode* n, int reg) const {
+	if (n->isLeaf()) {
+		return true;
+	}
+	ExprNode* first = n->kids[n->rule & 1];
+	ExprNode* second = n->kids[1 - (n->rule & 1)];
+
+	if (n->rule >= ExprNode::ruleMulImmLeft) {
+		return safeTarget(first, reg);
+	}
+	return safeTarget(first, reg) && !readsReg(second, reg, n->asFloat);
+}
+
+int NativeCode::takeScratch(bool isFloat) {
+	assert(!scratch[isFloat].empty());
+	int r = scratch[isFloat].back();
+	scratch[isFloat].pop_back();
+	return r;
+}
+
+/* Computes a tree into a register of its class */
+void NativeCode::reduceToReg(ExprNode* n, int reg) {
+	if (n->kind == ExprNode::fieldNode) {
+		Operand src = leafOperand(n);
+		if (n->asFloat) {
+			as.cvtsi2ss(reg, src);
+		} else {
+			moveGP(Operand::r(reg), src);
+		}
+		return;
+	}
+	if (n->kind == ExprNode::leafNode) {
+		if (n->asFloat) {
+			toXMM(reg, n->addr);
+		} else {
+			toGP(reg, n->addr);
+		}
+		return;
+	}
+
+	ExprNode* first = n->kids[n->rule & 1];
+	ExprNode* second = n->kids[1 - (n->rule & 1)];
+
+	if (n->rule >= ExprNode::ruleMulImmLeft) {
+		Operand src = Operand::r(reg);
+		if (first->cost[ExprNode::goalRM] == 0 && first->isLeaf()) {
+			src = leafOperand(first);
+		} else {
+			reduceToReg(first, reg);
+		}
+		as.imul(reg, src, immValue(second));
+		return;
+	}
+
+	reduceToReg(first, reg);
+
+	int taken;
+	Operand b = reduceToOperand(second, taken);
+
+	if (n->asFloat) {
+		if (n->kind == ExprNode::addNode) {
+			as.addss(reg, b);
+		} else {
+			as.mulss(reg, b);
+		}
+	} else if (n->kind == ExprNode::addNode) {
+		as.add(reg, b);
+	} else {
+		as.imul(reg, b);
+	}
+
+	if (taken >= 0) {
+		scratch[n->asFloat].push_back(taken);
+	}
+}
+
+/* Returns a tree as an operand: an immediate, a location, or a scratch register (returned in
+ * taken, -1 if none) which the caller gives back */
+Operand NativeCode::reduceToOperand(ExprNode* n, int& taken) {
+	taken = -1;
+	if (n->cost[ExprNode::goalImm] == 0) {
+		return Operand::imm(immValue(n));
+	}
+	if (n->isLeaf() && n->cost[ExprNode::goalRM] == 0) {
+		return leafOperand(n);
+	}
+	taken = takeScratch(n->asFloat);
+	reduceToReg(n, taken);
+	return Operand::r(taken);
+}
+
+/* dst = tree; vn, if not NULL, gets the value too */
+void NativeCode::genAssign(const Operand& dst, ExprNode* tree, Address* vn) {
+	bool isFloat = tree->asFloat;
+	Operand value = dst;
+
+	if (tree->cost[ExprNode::goalImm] == 0) {
+		value = Operand::imm(immValue(tree));
+		moveGP(dst, value);
+	} else if (tree->isLeaf() && tree->isFloat == isFloat) {
+		/* a plain move, converting nothing */
+		value = leafOperand(tree);
+		if (tree->kind == ExprNode::leafNode && dynamic_cast<ConstAddress*>(tree->addr) != NULL) {
+			// a float immediate
+			value = locOf(tree->addr, 0);
+		}
+		if (isFloat) {
+			moveXMM(dst, value);
+		} else {
+			moveGP(dst, value);
+		}
+	} else if (!isFloat && dst.isMem() && tree->kind == ExprNode::addNode) {
+		/* read-modify-write: x = x + y becomes "add [x], y" */
+		int same = -1;
+		for (int k = 0; k < 2 && same < 0; k++) {
+			ExprNode* kid = tree->kids[k];
+			Operand o = kid->isLeaf() && kid->cost[ExprNode::goalRM] == 0 ? leafOperand(kid) : Operand::imm(0);
+			if (o.isMem() && o.reg == dst.reg && o.disp == dst.disp) {
+				same = k;
+			}
+		}
+
+		if (same >= 0) {
+			ExprNode* other = tree->kids[1 - same];
+			int taken;
+			Operand b = reduceToOperand(other, taken);
+			if (b.isMem()) {
+				taken = takeScratch(false);
+				moveGP(Operand::r(taken), b);
+				b = Operand::r(taken);
+			}
+			as.add(dst, b);
+			if (taken >= 0) {
+				scratch[0].push_back(taken);
+			}
+		} else {
+			int r = takeScratch(false);
+			reduceToReg(tree, r);
+			value = Operand::r(r);
+			moveGP(dst, value);
+		}
+	} else {
+		/* compute straight into the destination register, if no operand is read from it later */
+		bool direct = dst.isReg() && safeTarget(tree, dst.reg);
+		if (dst.isReg() && !direct && tree->rule <= ExprNode::ruleRightFirst && !tree->isLeaf()) {
+			tree->rule ^= 1;
+			ExprNode* second = tree->kids[1 - (tree->rule & 1)];
+			direct = safeTarget(tree, dst.reg) && (second->isLeaf() || tree->kids[tree->rule & 1]->need >= second->need);
+			if (!direct) {
+				tree->rule ^= 1;
+			}
+		}
+
+		int r = direct ? dst.reg : takeScratch(isFloat);
+		reduceToReg(tree, r);
+		value = Operand::r(r);
+		if (isFloat) {
+			moveXMM(dst, value);
+		} else {
+			moveGP(dst, value);
+		}
+	}
+
+	if (vn != NULL) {
+		if (isFloat) {
+			moveXMM(locOf(vn, 0), value);
+		} else {
+			moveGP(locOf(vn, 0), value);
+		}
+	}
+}
+
+/* if a == b goto target, for scalars of the class of the trees */
+void NativeCode::genCompare(oprEnum relation, ExprNode* a, ExprNode* b, int target) {
+	bool isFloat = a->asFloat;
+
+	/* the first operand must be in a register: prefer one which already is */
+	bool aInReg = a->isLeaf() && a->cost[ExprNode::goalRM] == 0 && leafOperand(a).isReg();
+	bool bInReg = b->isLeaf() && b->cost[ExprNode::goalRM] == 0 && leafOperand(b).isReg();
+	if (a->cost[ExprNode::goalImm] == 0 || (!aInReg && bInReg)
+			|| (!aInReg && !b->isLeaf() && (a->isLeaf() || b->need > a->need))) {
+		swap(a, b);
+		swap(aInReg, bInReg);
+		relation = mirrored(relation);
+	}
+
+	Operand x;
+	if (aInReg) {
+		x = leafOperand(a);
+	} else if (!isFloat && a->isLeaf() && a->cost[ExprNode::goalRM] == 0 && b->cost[ExprNode::goalImm] == 0) {
+		// cmp [mem], imm
+		x = leafOperand(a);
+	} else {
+		int r = takeScratch(isFloat);
+		reduceToReg(a, r);
+		x = Operand::r(r);
+	}
+
+	int taken;
+	Operand y = reduceToOperand(b, taken);
+
+	if (isFloat) {
+		// "<" and "<=" need a parity test which ">" and ">=" do not: turn them around if y is a register
+		if ((relation == ltCondJmpOpr || relation == leCondJmpOpr) && y.isReg()) {
+			swap(x, y);
+			relation = mirrored(relation);
+		}
+		as.ucomiss(x.reg, y);
+	} else {
+		if (x.isMem() && y.isMem()) {
+			moveGP(Operand::r(X86Encoder::rax), x);
+			x = Operand::r(X86Encoder::rax);
+		}
+		as.cmp(x, y);
+	}
+	genBranch(relation, isFloat, target);
+}
+
+/* Generates a root and the instructions folded into it */
+void NativeCode::genTree(int j) {
+	TacInstr* instr = code->getInstr(j);
+	bool isFloat = trees.getRootClass(j) == 1;
+
+	scratch[0].assign(gpScratch, gpScratch + numScratch[0]);
+	scratch[1].assign(xmmScratch, xmmScratch + numScratch[1]);
+
+	switch (instr->getOp()) {
+		case copyOpr: {
+			ExprNode* tree = buildTree(j, 2, isFloat);
+			label(tree);
+			genAssign(locOf(instr->getOperand1(), 0), tree, NULL);
+			delete tree;
+			if (vnRead[j]) {
+				genCopy(instr->getValueNumber(), instr->getOperand1());
+			}
+			break;
+		}
+		case addOpr:
+		case mulOpr: {
+			ExprNode* tree = new ExprNode(instr->getOp() == addOpr ? ExprNode::addNode : ExprNode::mulNode, isFloat, isFloat);
+			tree->kids[0] = buildTree(j, 1, isFloat);
+			tree->kids[1] = buildTree(j, 2, isFloat);
+			label(tree);
+			genAssign(locOf(instr->getTemp(), 0), tree, vnRead[j] ? instr->getValueNumber() : NULL);
+			delete tree;
+			break;
+		}
+		case indexCopyOpr: {
+			ExprNode* tree = buildTree(j, 2, false);
+			label(tree);
+			genAssign(locOf(instr->getTemp(), fieldIndex(instr->getOperand1())), tree, NULL);
+			delete tree;
+			break;
+		}
+		default: { /* the conditional jumps */
+			ExprNode* a = buildTree(j, 1, isFloat);
+			ExprNode* b = buildTree(j, 2, isFloat);
+			label(a);
+			label(b);
+			genCompare(instr->getOp(), a, b, instrLabel[instr->getDestInstr()->getIndex()]);
+			delete a;
+			delete b;
+			break;
+		}
+	}
+}
+
+void NativeCode::genInstr(int i) {
+	TacInstr* instr = code->getInstr(i);
+	InstrAddress* vn = instr->getValueNumber();
+
+	as.bind(instrLabel[i]);
+
+	if (trees.foldedInto(i) >= 0) {
+		// computed by the root of its tree
+		return;
+	}
+	if (trees.getRootClass(i) >= 0) {
+		genTree(i);
+		return;
+	}
+
+	switch (instr->getOp()) {
+		case copyOpr:
+			if (instr->getOperand2() != NULL) {
+				genCopy(instr->getOperand1(), instr->getOperand2());
+			}
+			if (vnRead[i]) {
+				genCopy(vn, instr->getOperand1());
+			}
+			break;
+		case addOpr:
+		case mulOpr:
+		case divOpr:
+			genArith(instr);
+			break;
+		case offsetOpr: { /* temp = op1[k] */
+			int k = fieldIndex(instr->getOperand2());
+			// the front end only generates constant field offsets
+			assert(k == 0 || k == 4);
+
+			Operand d = locOf(instr->getTemp(), 0);
+			moveGP(d, locOf(instr->getOperand1(), k));
+			if (vnRead[i]) {
+				moveGP(locOf(vn, 0), d);
+			}
+			break;
+		}
+		case indexCopyOpr: { /* temp[k] = op2 */
+			int k = fieldIndex(instr->getOperand1());
+			assert(k == 0 || k == 4);
+
+			Operand d = locOf(instr->getTemp(), k);
+			if (d.isReg()) {
+				toGP(d.reg, instr->getOperand2());
+			} else if (typeOf(instr->getOperand2()) != floatType) {
+				moveGP(d, locOf(instr->getOperand2(), 0));
+			} else {
+				toGP(X86Encoder::rax, instr->getOperand2());
+				moveGP(d, Operand::r(X86Encoder::rax));
+			}
+			break;
+		}
+		case jmpOpr:
+			as.jmp(instrLabel[instr->getDestInstr()->getIndex()]);
+			break;
+		case eq1condJmpOpr:
+		case eq2condJmpOpr:
+		case neCondJmpOpr:
+		case ltCondJmpOpr:
+		case leCondJmpOpr:
+		case gtCondJmpOpr:
+		case geCondJmpOpr:
+			genCondJump(instr, instrLabel[instr->getDestInstr()->getIndex()]);
+			break;
+		case jmpTableOpr: {
+			// straight to where the gotos that follow go
+			vector<int> targets;
+			for (int k = 1; k <= instr->tableSize(); k++) {
+				targets.push_back(instrLabel[code->getInstr(i + k)->getDestInstr()->getIndex()]);
+			}
+			toGP(X86Encoder::rax, instr->getOperand1());
+			as.cmp(Operand::r(X86Encoder::rax), Operand::imm(instr->tableSize()));
+			as.jcc(X86Encoder::condAE, instrLabel[instr->getDestInstr()->getIndex()]);
+			as.jmpTable(X86Encoder::rax, targets);
+			break;
+		}
+		case readOpr:
+			genRead(i);
+			break;
+		case printOpr:
+			genPrint(i);
+			break;
+		case haltOpr:
+			genStoreBack(-1);
+			as.mov(Operand::r(X86Encoder::rax), Operand::imm(0));
+			as.jmp(exitLabel);
+			break;
+		default:
+			// "stat" does nothing
+			break;
+	}
+}
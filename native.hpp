@@ -0,0 +1,444 @@
+#ifndef NATIVE_HPP_
+#define NATIVE_HPP_
+
+/**
+* @file native.hpp
+* @brief This header file contains the native x86-64 backend of tinycomp:
+* an encoder for the machine instructions it needs, a tree-pattern instruction
+* selector, a linear-scan register allocator, and the code generator turning
+* the 3-addr code into a function which runs in-process, directly on Memory.
+*
+* The backend implements the following semantics for the 3-addr code:
+* - every value has the type of its variable or constant; temporaries and
+*   valuenumbers have the type inferred by TypeMap;
+* - a copy converts the value to the type of its destination: an int or a float
+*   becomes the fraction v|1, a float becomes an int by truncation, and a fraction
+*   used where a scalar is expected yields its numerator;
+* - arithmetic is done in float if either operand is a float, in int otherwise;
+*   an int division by zero stops the program with an error;
+* - x[i] and x[i] = y access the 4-byte int field at byte offset i of x;
+* - "==" and "=" compare scalars by value; for fractions, "=" compares the fields
+*   and "==" compares the rational numbers;
+* - "!=", "<", "<=", ">" and ">=" compare scalars by value (as floats if either
+*   is one, a NaN being neither smaller, larger nor equal), and fractions by
+*   cross-multiplying in 64 bits, n1 * d2 against n2 * d1;
+* - "goto table[x] of n else d" goes where the (x + 1)-th of the n gotos that
+*   follow it goes if 0 <= x < n (x converted to int), and to d otherwise.
+*/
+
+#include <string>
+#include <vector>
+#include "tinycomp.hpp"
+#include "optimizer.hpp"
+
+using namespace std;
+
+/* **********/
+/*  ENCODER */
+/* **********/
+
+/** An operand of a machine instruction: a register, a memory location [base + disp]
+ *  or [rip + disp], or an immediate value.
+ */
+class Operand {
+public:
+	enum Kind { regKind, memKind, ripKind, immKind };
+
+	Kind kind;
+	int reg;	/*!< register number (for regKind) or base register (for memKind) */
+	int disp;	/*!< displacement (for memKind) or value (for immKind) */
+
+	/** Returns a register operand */
+	static Operand r(int reg);
+
+	/** Returns a memory operand */
+	static Operand m(int base, int disp);
+
+	/** Returns a memory operand relative to the next instruction */
+	static Operand rip(int disp);
+
+	/** Returns an immediate operand */
+	static Operand imm(int value);
+
+	bool isReg() const;
+	bool isMem() const;	/*!< true for both [base + disp] and [rip + disp] */
+	bool isImm() const;
+};
+
+/** An assembler for the x86-64 instructions needed by the backend.
+ *  General purpose registers are numbered as in the instruction encoding
+ *  (rax = 0, ..., r15 = 15), and so are XMM registers (xmm0 = 0, ..., xmm15 = 15).
+ *  Unless noted otherwise, integer instructions work on 32-bit values.
+ *  Jumps refer to labels, which are resolved by finish().
+ */
+class X86Encoder {
+private:
+	vector<unsigned char> bytes;
+
+	vector<int> labels;
+	vector< pair<int, int> > fixups;	// (position of a rel32, label)
+	vector< pair<int, pair<int, int> > > entries;	// (position of a table entry, (label, table label))
+
+	void byte(int b);
+	void dword(int d);
+
+	/* emits [prefix] [REX] opcode [opcode2] ModRM [SIB] [disp32] */
+	void emit(int prefix, bool wide, int opcode, int opcode2, int reg, const Operand& rm);
+
+	/* emits an arithmetic instruction with an immediate, in its shortest form */
+	void group1(int ext, const Operand& rm, int value);
+
+public:
+	/** Condition codes for jcc */
+	enum Cond {
+		condB = 0x2, condAE = 0x3, condE = 0x4, condNE = 0x5, condBE = 0x6, condA = 0x7,	// unsigned, and ucomiss
+		condP = 0xA, condL = 0xC, condGE = 0xD, condLE = 0xE, condG = 0xF	// parity, signed
+	};
+
+	static const int rax = 0, rcx = 1, rdx = 2, rbx = 3, rsp = 4, rbp = 5, rsi = 6, rdi = 7;
+	static const int r8 = 8, r9 = 9, r10 = 10, r11 = 11, r12 = 12, r13 = 13, r14 = 14, r15 = 15;
+
+	/** Returns the machine code emitted so far */
+	const vector<unsigned char>& getBytes() const;
+
+	/** Returns the current position in the code */
+	int size() const;
+
+	/** Creates a new, unbound label */
+	int newLabel();
+
+	/** Binds a label to the current position */
+	void bind(int label);
+
+	/** Returns the position of a bound label */
+	int labelPos(int label) const;
+
+	/** Resolves the jumps to labels, and the entries of jump tables */
+	void finish();
+
+	/* integer moves and arithmetic */
+	void mov(const Operand& dst, const Operand& src);
+	void add(int reg, const Operand& src);
+	void add(const Operand& dst, const Operand& src);
+	void imul(int reg, const Operand& src);
+	void imul(int reg, const Operand& src, int value);
+	void cmp(const Operand& a, const Operand& b);
+	void cdq();
+	void idiv(int reg);
+	void neg(int reg);
+	void test(int reg1, int reg2);
+
+	/* 64-bit operations */
+	void lea(int reg, const Operand& src);
+	void movsxd(int reg, int src);
+	void imul64(int reg, int src);
+	void cmp64(int reg1, int reg2);
+	void mov64(int dst, int src);
+	void movabs(int reg, long long value);	/*!< the only instruction with a 64-bit immediate */
+	void push(int reg);
+	void pop(int reg);
+
+	/* scalar single precision floats; the xmm operand is always a register */
+	void movss(const Operand& dst, const Operand& src);
+	void addss(int xmm, const Operand& src);
+	void mulss(int xmm, const Operand& src);
+	void divss(int xmm, const Operand& src);
+	void ucomiss(int xmm, const Operand& src);
+	void cvtsi2ss(int xmm, const Operand& src);
+	void cvttss2si(int reg, const Operand& src);
+	void movdToXmm(int xmm, int reg);
+	void cvtss2sd(int xmm, const Operand& src);
+
+	/* control flow */
+	void jmp(int label);
+	void jcc(Cond cond, int label);
+	void call(int label);
+	void callRel32();	/*!< a call whose displacement is left to a relocation */
+	void callReg(int reg);	/*!< a call to the address held in a register */
+
+	/** Jumps to the reg-th label of targets; reg (64 bits) must be in range. The table
+	 *  follows the jump, as 32-bit offsets from its start; rcx is clobbered. */
+	void jmpTable(int reg, const vector<int>& targets);
+	void ret();
+};
+
+/* ************************/
+/*  INSTRUCTION SELECTION */
+/* ************************/
+
+/** A node of an expression tree, as matched by the instruction selector.
+ *  Leaves are operands of the 3-addr code (constants, variables, temporaries, valuenumbers)
+ *  and fields x[k] of a fraction; inner nodes are int or float additions and multiplications.
+ *  Labeling fills in, for each goal, the cost (in instructions) of reducing the node to it,
+ *  and for inner nodes the rule reaching goalReg at that cost.
+ */
+class ExprNode {
+public:
+	enum Kind { leafNode, fieldNode, addNode, mulNode };
+
+	/** Goals (the nonterminals of the tree grammar):
+	 *  an immediate, a register or memory operand, a value computed into a register */
+	enum Goal { goalImm, goalRM, goalReg, numGoals };
+
+	/** Rules for inner nodes: which kid is computed into the register first, and whether
+	 *  the 3-operand "imul reg, rm, imm" is used */
+	enum Rule { ruleLeftFirst, ruleRightFirst, ruleMulImmLeft, ruleMulImmRight };
+
+	Kind kind;
+	bool isFloat;	/*!< the node computes a float (for leaves, the type of the operand) */
+	bool asFloat;	/*!< the node is used as a float by its parent */
+	Address* addr;	/*!< leafNode: the operand; fieldNode: the fraction */
+	int field;		/*!< fieldNode: byte offset of the field */
+	ExprNode* kids[2];
+
+	int cost[numGoals];
+	int rule;
+	int need;		/*!< scratch registers needed to compute the node (Sethi-Ullman number) */
+
+	/** Constructor: creates a node without kids */
+	ExprNode(Kind kind, bool isFloat, bool asFloat);
+
+	/** Destructor: deletes the kids too */
+	~ExprNode();
+
+	/** Returns true for leaves and fields */
+	bool isLeaf() const;
+
+private:
+	// Stop the compiler from generating methods of copy the object
+	ExprNode(ExprNode const& copy);            // Not to be implemented
+	ExprNode& operator=(ExprNode const& copy); // Not to be implemented
+};
+
+/** Rebuilds the expression trees hidden in the 3-addr code.
+ *  An instruction computing a value (a constant field load, an int or float addition or
+ *  multiplication, a copy into a temporary) is folded into the instruction reading it when:
+ *  - that is the only read of its result, through its temporary or its valuenumber,
+ *    and it happens later in the same basic block;
+ *  - the operands of the folded instructions are not written in between;
+ *  - the tree computes values of a single class (int or float; leaves may be converted)
+ *    and fits in the scratch registers of the code generator.
+ *  Folded instructions generate no code: their consumer, the root of the tree, computes them.
+ *  Roots are the copies, int and float arithmetic, field stores and conditional jumps whose
+ *  operands are all scalars; the other instructions are generated one by one.
+ */
+class TreeBuilder {
+private:
+	TargetCode* code;
+	const CellMap* cells;
+	const TypeMap* types;
+
+	vector<int> rootClass;	// 0 for int roots, 1 for float roots, -1 if not a root
+	vector<int> into;		// into[i]: instruction i is folded into, or -1
+	vector<int> kids;		// kids[2 * j + p - 1]: instruction folded as operand p of j, or -1
+
+	int folded;
+	int trees;
+
+	int scalarClass(Address* a) const;
+	int classOf(TacInstr* instr) const;
+	int producerClass(int i) const;
+	bool isValueOperand(TacInstr* instr, int p) const;
+	Address* operand(TacInstr* instr, int p) const;
+
+	int producerOf(int j, int p, const FlowGraph& fg) const;
+	bool singleUse(int i, const FlowGraph& fg, const Liveness& live, const vector<int>& vnReads) const;
+	bool stable(int i, int j) const;
+	void leafCells(int i, vector<int>& out) const;
+	int operandNeed(int j, int p) const;
+	int treeNeed(int j) const;
+
+public:
+	/** Constructor: finds the trees of the code; if enabled is false there are none,
+	 *  and every instruction is generated on its own */
+	TreeBuilder(TargetCode* code, const CellMap& cells, const TypeMap& types, bool enabled);
+
+	/** Returns 0 (int) or 1 (float) if instruction j is generated as a tree, -1 otherwise */
+	int getRootClass(int j) const;
+
+	/** Returns the instruction which instruction i is folded into, or -1 */
+	int foldedInto(int i) const;
+
+	/** Returns the instruction folded as operand p (1 or 2) of instruction j, or -1 */
+	int kidOf(int j, int p) const;
+
+	/** Prints a one-line summary of the trees */
+	void printReport() const;
+};
+
+/* ***********************/
+/*  REGISTER ALLOCATION  */
+/* ***********************/
+
+/** Linear-scan register allocation (Poletto and Sarkar) over the cells of the code.
+ *  Every int (or fraction field) cell and every float cell read by the code gets a live interval,
+ *  spanning from its first to its last live position in the code array. Intervals are visited by
+ *  increasing start and get a free register of their class (general purpose or XMM); when none is
+ *  left, the interval ending last is spilled, i.e. it lives in its home location for its whole
+ *  lifetime: its Memory offset for variables and temporaries, its slot for valuenumbers.
+ *  Cells whose type is unknown, fraction valuenumbers and fields accessed with a variable index
+ *  always stay home. The operands of instructions folded into a tree are read at its root.
+ */
+class RegisterAllocator {
+public:
+	/** Register classes */
+	enum RegClass { noClass, gpClass, xmmClass };
+
+	/** Registers returned by regOf(): general purpose registers are numbered 0-15,
+	 *  XMM registers xmmBase + 0-15 */
+	static const int xmmBase = 16;
+
+private:
+	vector<int> cellClass;
+	vector<int> reg;
+	vector<int> start;
+	vector<int> end;
+
+	int values;
+	int spilled;
+	int gpUsed;
+	int xmmUsed;
+
+	void classify(TargetCode* code, const CellMap& cells, const TypeMap& types);
+
+public:
+	/** Constructor: allocates registers to the cells of the code, as it is generated according
+	 *  to the given trees; if enabled is false, everything is left in memory
+	 */
+	RegisterAllocator(TargetCode* code, const CellMap& cells, const TypeMap& types,
+		const TreeBuilder& trees, bool enabled);
+
+	/** Returns the register assigned to a cell, or -1 if it lives in memory */
+	int regOf(int cell) const;
+
+	/** Returns the position where the live interval of a cell begins (-1 if it has none) */
+	int startOf(int cell) const;
+
+	/** Returns the position where the live interval of a cell ends (-1 if it has none) */
+	int endOf(int cell) const;
+
+	/** Prints a one-line summary of the allocation */
+	void printReport() const;
+};
+
+/* *****************/
+/*  CODE GENERATOR */
+/* *****************/
+
+/** The 3-addr code compiled to x86-64 machine code.
+ *  The generated function has the C signature int f(unsigned char* memory, long long* slots):
+ *  r15 holds the address of Memory, r14 the address of the valuenumber slots (8 bytes each).
+ *  It returns 0 when the program reaches HALT, 1 if it stops because of a division by zero.
+ *  "read" and "print" call the functions of InputReader and OutputWriter, whose addresses are
+ *  part of the code: it runs only in the process which generated it.
+ *  The code may have a second entry, with the same signature, at the header of a loop: it
+ *  loads the registers live there from Memory and the slots, so that a program started
+ *  elsewhere (see Interpreter::runTiered) can go on natively from that point (on-stack
+ *  replacement).
+ */
+class NativeCode {
+private:
+	TargetCode* code;
+	CellMap cells;
+	TypeMap types;
+	TreeBuilder trees;
+	RegisterAllocator regs;
+	X86Encoder as;
+
+	/* vnRead[i] is true if the valuenumber of instruction i is read by some instruction */
+	vector<bool> vnRead;
+
+	vector<int> instrLabel;
+	int divZeroLabel;
+	int exitLabel;
+	int osrLabel;
+
+	/* the divisions by zero: where they jump to, and the instruction they are in */
+	vector< pair<int, int> > divZeroStops;
+
+	bool allocate;
+	bool select;
+
+	/* the executable copy of the machine code, NULL if it could not be made */
+	void* exec;
+	size_t execSize;
+
+	/* the reason why the code is not executable, if it is not */
+	string error;
+
+	/* scratch registers not in use by the tree being generated, general purpose and XMM */
+	vector<int> scratch[2];
+
+	typeName typeOf(Address* a) const;
+	Operand homeOf(int cell) const;
+	Operand locOf(Address* a, int field) const;
+
+	void moveGP(const Operand& dst, const Operand& src);
+	void moveXMM(const Operand& dst, const Operand& src);
+	void toGP(int reg, Address* a);
+	void toXMM(int xmm, Address* a);
+	Operand fractionField(int reg, Address* a, int field);
+
+	void genCopy(Address* dst, Address* src);
+	void genArith(TacInstr* instr);
+	void genCondJump(TacInstr* instr, int target);
+	void genBranch(oprEnum relation, bool isFloat, int target);
+	void genInstr(int i);
+	void genStoreBack(int at);
+	void genEntry(int at);
+	void genSaveLive(int i, vector<int>& saved);
+	void genReload(const vector<int>& cellList);
+	void genCall(long long function);
+	void genRead(int i);
+	void genPrint(int i);
+
+	/* instruction selection */
+	ExprNode* buildTree(int j, int p, bool asFloat);
+	void label(ExprNode* n);
+	Operand leafOperand(ExprNode* n) const;
+	int immValue(ExprNode* n) const;
+	bool readsReg(ExprNode* n, int reg, bool isFloat) const;
+	bool safeTarget(ExprNode* n, int reg) const;
+	int takeScratch(bool isFloat);
+	void reduceToReg(ExprNode* n, int reg);
+	Operand reduceToOperand(ExprNode* n, int& taken);
+	void genAssign(const Operand& dst, ExprNode* tree, Address* vn);
+	void genCompare(oprEnum relation, ExprNode* a, ExprNode* b, int target);
+	void genTree(int j);
+
+public:
+	/** Constructor: compiles the code; allocate tells whether to use the register allocator,
+	 *  select whether to match expression trees or to generate instructions one by one;
+	 *  osrEntry, if not -1, is the first instruction of a loop header to add an entry at */
+	NativeCode(TargetCode* code, bool allocate, bool select, int osrEntry = -1);
+
+	~NativeCode();
+
+	/** Returns the machine code */
+	const vector<unsigned char>& getBytes() const;
+
+	/** Returns the address of the executable copy of the machine code */
+	const unsigned char* getEntry() const;
+
+	/** Returns the offset in the machine code where instruction i begins; for i equal
+	 *  to the number of instructions, where the epilogue begins */
+	int offsetOf(int i) const;
+
+	/** Prints the summaries of instruction selection and register allocation, if enabled */
+	void printReport() const;
+
+	/** Returns true if the machine code has been copied to executable memory, and can run */
+	bool ok() const;
+
+	/** Returns the reason why the machine code cannot run */
+	const string& getError() const;
+
+	/** Runs the program on Memory; returns 0 on success, 1 on a division by zero */
+	int run();
+
+	/** Runs the program on Memory from the loop header given to the constructor, with the
+	 *  valuenumbers computed so far in slots (8 bytes each, one per instruction); returns as run() */
+	int runFrom(long long* slots);
+};
+
+#endif //NATIVE_HPP_
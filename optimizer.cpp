@@ -0,0 +1,2558 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <assert.h>
+
+using namespace std;
+
+#include "optimizer.hpp"
+#include "timer.hpp"
+
+/************/
+/* BIT SETS */
+/************/
+
+BitSet::BitSet(int size, bool full) {
+	bits = size;
+	words.assign((size + 63) / 64, full ? ~0ULL : 0ULL);
+
+	// the bits past the size of the universe stay clear, so that whole words can be compared
+	if (full && size % 64 != 0) {
+		words.back() = (1ULL << (size % 64)) - 1;
+	}
+}
+
+int BitSet::size() const {
+	return bits;
+}
+
+bool BitSet::test(int i) const {
+	return (words[i / 64] >> (i % 64)) & 1;
+}
+
+void BitSet::set(int i) {
+	words[i / 64] |= 1ULL << (i % 64);
+}
+
+void BitSet::reset(int i) {
+	words[i / 64] &= ~(1ULL << (i % 64));
+}
+
+bool BitSet::unite(const BitSet& other) {
+	bool grown = false;
+	for (size_t w = 0; w < words.size(); w++) {
+		unsigned long long u = words[w] | other.words[w];
+		if (u != words[w]) {
+			words[w] = u;
+			grown = true;
+		}
+	}
+	return grown;
+}
+
+void BitSet::intersect(const BitSet& other) {
+	for (size_t w = 0; w < words.size(); w++) {
+		words[w] &= other.words[w];
+	}
+}
+
+void BitSet::subtract(const BitSet& other) {
+	for (size_t w = 0; w < words.size(); w++) {
+		words[w] &= ~other.words[w];
+	}
+}
+
+int BitSet::next(int i) const {
+	if (i >= bits) {
+		return -1;
+	}
+
+	size_t w = i / 64;
+	unsigned long long rest = words[w] & (~0ULL << (i % 64));
+	while (rest == 0) {
+		if (++w == words.size()) {
+			return -1;
+		}
+		rest = words[w];
+	}
+	return w * 64 + __builtin_ctzll(rest);
+}
+
+bool BitSet::operator==(const BitSet& other) const {
+	return bits == other.bits && words == other.words;
+}
+
+bool BitSet::operator!=(const BitSet& other) const {
+	return !(*this == other);
+}
+
+/*************************/
+/* DEFINITIONS AND USES  */
+/*************************/
+
+CellMap::CellMap(TargetCode* code) {
+	this->code = code;
+	memCells = (Memory::getInstance().getUsed() + 3) / 4;
+
+	isVar.assign(memCells, false);
+
+	// only variables actually referenced by the code are of interest
+	for (int i = 0; i < code->getNextInstr(); i++) {
+		TacInstr* instr = code->getInstr(i);
+		Address* ops[2] = { instr->getOperand1(), instr->getOperand2() };
+
+		for (int k = 0; k < 2; k++) {
+			VarAddress* v = dynamic_cast<VarAddress*>(ops[k]);
+			if (v != NULL) {
+				for (int off = v->getOffset(); off < v->getOffset() + v->getWidth(); off += 4) {
+					isVar[memCell(off)] = true;
+				}
+			}
+		}
+	}
+}
+
+int CellMap::count() const {
+	return memCells + code->getNextInstr();
+}
+
+int CellMap::memCell(int offset) const {
+	assert(offset / 4 < memCells);
+	return offset / 4;
+}
+
+int CellMap::vnCell(int i) const {
+	return memCells + i;
+}
+
+bool CellMap::isVarCell(int cell) const {
+	return cell < memCells && isVar[cell];
+}
+
+void CellMap::cellsOf(Address* a, vector<int>& out) const {
+	if (VarAddress* v = dynamic_cast<VarAddress*>(a)) {
+		for (int off = v->getOffset(); off < v->getOffset() + v->getWidth(); off += 4) {
+			out.push_back(memCell(off));
+		}
+	} else if (TempAddress* t = dynamic_cast<TempAddress*>(a)) {
+		for (int off = t->getOffset(); off < t->getOffset() + t->getWidth(); off += 4) {
+			out.push_back(memCell(off));
+		}
+	} else if (InstrAddress* ia = dynamic_cast<InstrAddress*>(a)) {
+		out.push_back(vnCell(ia->getIndex()));
+	}
+	// constants (and NULL) have no cell
+}
+
+/* Returns the memory offset of a (var or temp) address, or -1 */
+static int offsetOf(Address* a) {
+	if (VarAddress* v = dynamic_cast<VarAddress*>(a)) {
+		return v->getOffset();
+	}
+	if (TempAddress* t = dynamic_cast<TempAddress*>(a)) {
+		return t->getOffset();
+	}
+	return -1;
+}
+
+/* Returns the constant int index of x[i] or x[i] = y, or -1 if it is not a constant */
+static int constIndex(Address* a) {
+	ConstAddress* c = dynamic_cast<ConstAddress*>(a);
+	if (c != NULL && c->getType() == intType) {
+		return c->getIntVal();
+	}
+	return -1;
+}
+
+/* Returns the number of bytes of the value denoted by an address (0 if unknown) */
+static int widthOf(TargetCode* code, Address* a) {
+	if (ConstAddress* c = dynamic_cast<ConstAddress*>(a)) {
+		return c->getType() == fractionType ? 8 : 4;
+	}
+	if (VarAddress* v = dynamic_cast<VarAddress*>(a)) {
+		return v->getWidth();
+	}
+	if (TempAddress* t = dynamic_cast<TempAddress*>(a)) {
+		return t->getWidth();
+	}
+	if (InstrAddress* ia = dynamic_cast<InstrAddress*>(a)) {
+		TacInstr* instr = code->getInstr(ia->getIndex());
+
+		if (instr->getOp() == copyOpr) {
+			// either the destination of the copy, or the value copied into the valuenumber
+			return widthOf(code, instr->getOperand1());
+		}
+		if (instr->getTemp() != NULL && instr->getOp() != indexCopyOpr) {
+			return instr->getTemp()->getWidth();
+		}
+	}
+	return 0;
+}
+
+/* Returns true if two addresses surely denote the same value */
+static bool sameValue(Address* a, Address* b) {
+	if (a == b) {
+		return true;
+	}
+
+	ConstAddress* ca = dynamic_cast<ConstAddress*>(a);
+	ConstAddress* cb = dynamic_cast<ConstAddress*>(b);
+	if (ca != NULL && cb != NULL && ca->getType() == cb->getType()) {
+		switch (ca->getType()) {
+			case intType:
+				return ca->getIntVal() == cb->getIntVal();
+			case floatType:
+				return ca->getFloatVal() == cb->getFloatVal();
+			case fractionType:
+				return ca->getFractionVal().num == cb->getFractionVal().num
+					&& ca->getFractionVal().denom == cb->getFractionVal().denom;
+			default:
+				return false;
+		}
+	}
+
+	InstrAddress* ia = dynamic_cast<InstrAddress*>(a);
+	InstrAddress* ib = dynamic_cast<InstrAddress*>(b);
+	return ia != NULL && ib != NULL && ia->getIndex() == ib->getIndex();
+}
+
+/* Replaces the operands of instr that read "from" with "to"; returns true if anything changed.
+ * Only operands that are read are considered: destinations and bases of x[i] are left alone. */
+static bool replaceUses(TacInstr* instr, Address* from, Address* to) {
+	bool changed = false;
+
+	switch (instr->getOp()) {
+		case copyOpr:
+			if (instr->getOperand2() != NULL) {
+				if (sameValue(instr->getOperand2(), from)) {
+					instr->setOperand2(to);
+					changed = true;
+				}
+			} else if (sameValue(instr->getOperand1(), from)) {
+				instr->setOperand1(to);
+				changed = true;
+			}
+			break;
+		case addOpr:
+		case mulOpr:
+		case divOpr:
+		case eq1condJmpOpr:
+		case eq2condJmpOpr:
+		case neCondJmpOpr:
+		case ltCondJmpOpr:
+		case leCondJmpOpr:
+		case gtCondJmpOpr:
+		case geCondJmpOpr:
+		case jmpTableOpr:
+			if (sameValue(instr->getOperand1(), from)) {
+				instr->setOperand1(to);
+				changed = true;
+			}
+			if (sameValue(instr->getOperand2(), from)) {
+				instr->setOperand2(to);
+				changed = true;
+			}
+			break;
+		case indexCopyOpr:
+			if (sameValue(instr->getOperand2(), from)) {
+				instr->setOperand2(to);
+				changed = true;
+			}
+			break;
+		case printOpr:
+			if (sameValue(instr->getOperand1(), from)) {
+				instr->setOperand1(to);
+				changed = true;
+			}
+			break;
+		default:
+			break;
+	}
+
+	return changed;
+}
+
+void CellMap::defs(TacInstr* instr, vector<int>& out) const {
+	int self = instr->getValueNumber()->getIndex();
+
+	switch (instr->getOp()) {
+		case copyOpr:
+			if (instr->getOperand2() != NULL) {
+				cellsOf(instr->getOperand1(), out);
+			}
+			out.push_back(vnCell(self));
+			break;
+		case addOpr:
+		case mulOpr:
+		case divOpr:
+		case offsetOpr:
+			cellsOf(instr->getTemp(), out);
+			out.push_back(vnCell(self));
+			break;
+		case indexCopyOpr: /* temp[op1] = op2; only a constant index is a sure definition */
+			if (constIndex(instr->getOperand1()) >= 0) {
+				out.push_back(memCell(instr->getTemp()->getOffset() + constIndex(instr->getOperand1())));
+			}
+			break;
+		case readOpr: /* read x: x only, the valuenumber holds nothing */
+			cellsOf(instr->getOperand1(), out);
+			break;
+		default:
+			break;
+	}
+}
+
+void CellMap::uses(TacInstr* instr, vector<int>& out) const {
+	switch (instr->getOp()) {
+		case copyOpr:
+			if (instr->getOperand2() != NULL) {
+				cellsOf(instr->getOperand2(), out);
+			} else {
+				cellsOf(instr->getOperand1(), out);
+			}
+			break;
+		case addOpr:
+		case mulOpr:
+		case divOpr:
+		case eq1condJmpOpr:
+		case eq2condJmpOpr:
+		case neCondJmpOpr:
+		case ltCondJmpOpr:
+		case leCondJmpOpr:
+		case gtCondJmpOpr:
+		case geCondJmpOpr:
+		case jmpTableOpr:
+			cellsOf(instr->getOperand1(), out);
+			cellsOf(instr->getOperand2(), out);
+			break;
+		case offsetOpr: /* temp = op1[op2]: a constant index reads a single field */
+			if (offsetOf(instr->getOperand1()) >= 0 && constIndex(instr->getOperand2()) >= 0) {
+				out.push_back(memCell(offsetOf(instr->getOperand1()) + constIndex(instr->getOperand2())));
+			} else {
+				cellsOf(instr->getOperand1(), out);
+			}
+			break;
+		case indexCopyOpr: /* temp[op1] = op2 */
+			cellsOf(instr->getOperand2(), out);
+			if (constIndex(instr->getOperand1()) < 0) {
+				cellsOf(instr->getTemp(), out);
+			}
+			break;
+		case printOpr:
+			cellsOf(instr->getOperand1(), out);
+			break;
+		case haltOpr:
+			// the final value of the variables is the output of the program
+			for (int c = 0; c < memCells; c++) {
+				if (isVar[c]) {
+					out.push_back(c);
+				}
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+/**********************/
+/* CONTROL FLOW GRAPH */
+/**********************/
+
+FlowGraph::FlowGraph(TargetCode* code) {
+	this->code = code;
+
+	int n = code->getNextInstr();
+
+	/* find the leaders */
+	vector<bool> leader(n + 1, false);
+	leader[0] = true;
+
+	for (int i = 0; i < n; i++) {
+		TacInstr* instr = code->getInstr(i);
+
+		if (instr->isJump()) {
+			leader[instr->getDestInstr()->getIndex()] = true;
+			leader[i + 1] = true;
+		} else if (instr->getOp() == haltOpr) {
+			leader[i + 1] = true;
+		}
+	}
+
+	/* split the code in blocks */
+	blockOf.assign(n, -1);
+	for (int i = 0; i < n; i++) {
+		if (leader[i]) {
+			BasicBlock b;
+			b.first = i;
+			blocks.push_back(b);
+		}
+		blocks.back().last = i;
+		blockOf[i] = blocks.size() - 1;
+	}
+
+	/* connect them */
+	for (size_t b = 0; b < blocks.size(); b++) {
+		TacInstr* instr = code->getInstr(blocks[b].last);
+		int next = blocks[b].last + 1;
+
+		if (instr->isJump()) {
+			blocks[b].succs.push_back(blockOf[instr->getDestInstr()->getIndex()]);
+		}
+		// a jump table goes on to each of the gotos that follow it
+		for (int k = 0; k < instr->tableSize(); k++) {
+			if (find(blocks[b].succs.begin(), blocks[b].succs.end(), blockOf[next + k]) == blocks[b].succs.end()) {
+				blocks[b].succs.push_back(blockOf[next + k]);
+			}
+		}
+		if ((!instr->isJump() || instr->isCondJump()) && instr->getOp() != haltOpr && next < n) {
+			if (blocks[b].succs.empty() || blocks[b].succs[0] != blockOf[next]) {
+				blocks[b].succs.push_back(blockOf[next]);
+			}
+		}
+
+		for (size_t s = 0; s < blocks[b].succs.size(); s++) {
+			blocks[blocks[b].succs[s]].preds.push_back(b);
+		}
+	}
+
+	computeDominators();
+}
+
+void FlowGraph::computeDominators() {
+	int nb = blocks.size();
+
+	/* reachability from the entry block */
+	reachable.assign(nb, false);
+	if (nb == 0) {
+		return;
+	}
+
+	vector<int> stack(1, 0);
+	reachable[0] = true;
+	while (!stack.empty()) {
+		int b = stack.back();
+		stack.pop_back();
+
+		for (size_t s = 0; s < blocks[b].succs.size(); s++) {
+			if (!reachable[blocks[b].succs[s]]) {
+				reachable[blocks[b].succs[s]] = true;
+				stack.push_back(blocks[b].succs[s]);
+			}
+		}
+	}
+
+	/* the classic iterative algorithm; blocks are visited in layout order,
+	 * which for structured code converges in a couple of rounds */
+	dom.assign(nb, BitSet(nb, true));
+	dom[0] = BitSet(nb);
+	dom[0].set(0);
+
+	bool changed = true;
+	while (changed) {
+		changed = false;
+
+		for (int b = 1; b < nb; b++) {
+			if (!reachable[b]) {
+				continue;
+			}
+
+			BitSet d(nb, true);
+			for (size_t p = 0; p < blocks[b].preds.size(); p++) {
+				int pred = blocks[b].preds[p];
+				if (reachable[pred]) {
+					d.intersect(dom[pred]);
+				}
+			}
+			d.set(b);
+
+			if (d != dom[b]) {
+				dom[b] = d;
+				changed = true;
+			}
+		}
+	}
+}
+
+int FlowGraph::numBlocks() const {
+	return blocks.size();
+}
+
+const BasicBlock& FlowGraph::getBlock(int b) const {
+	return blocks[b];
+}
+
+int FlowGraph::getBlockOf(int i) const {
+	return blockOf[i];
+}
+
+bool FlowGraph::dominates(int d, int b) const {
+	return dom[b].test(d);
+}
+
+bool FlowGraph::isReachable(int b) const {
+	return reachable[b];
+}
+
+/* Loops with fewer blocks are nested in (or disjoint from) larger ones */
+static bool innerFirst(const Loop& a, const Loop& b) {
+	if (a.blocks.size() != b.blocks.size()) {
+		return a.blocks.size() < b.blocks.size();
+	}
+	return a.header < b.header;
+}
+
+vector<Loop> FlowGraph::findLoops() const {
+	int nb = blocks.size();
+	vector<Loop> loops;
+
+	for (int n = 0; n < nb; n++) {
+		if (!reachable[n]) {
+			continue;
+		}
+
+		for (size_t s = 0; s < blocks[n].succs.size(); s++) {
+			int h = blocks[n].succs[s];
+			if (!dominates(h, n)) {
+				continue;
+			}
+
+			/* n -> h is a back edge: merge it with the loop of h, if we already have one */
+			size_t l = 0;
+			while (l < loops.size() && loops[l].header != h) {
+				l++;
+			}
+			if (l == loops.size()) {
+				Loop loop;
+				loop.header = h;
+				loop.inLoop.assign(nb, false);
+				loop.inLoop[h] = true;
+				loop.depth = 0;
+				loops.push_back(loop);
+			}
+			loops[l].latches.push_back(n);
+
+			/* the body: everything reaching n without going through h */
+			vector<int> stack;
+			if (!loops[l].inLoop[n]) {
+				loops[l].inLoop[n] = true;
+				stack.push_back(n);
+			}
+			while (!stack.empty()) {
+				int b = stack.back();
+				stack.pop_back();
+
+				for (size_t p = 0; p < blocks[b].preds.size(); p++) {
+					int pred = blocks[b].preds[p];
+					if (reachable[pred] && !loops[l].inLoop[pred]) {
+						loops[l].inLoop[pred] = true;
+						stack.push_back(pred);
+					}
+				}
+			}
+		}
+	}
+
+	for (size_t l = 0; l < loops.size(); l++) {
+		for (int b = 0; b < nb; b++) {
+			if (loops[l].inLoop[b]) {
+				loops[l].blocks.push_back(b);
+			}
+		}
+	}
+	for (size_t l = 0; l < loops.size(); l++) {
+		for (size_t m = 0; m < loops.size(); m++) {
+			if (loops[m].inLoop[loops[l].header]) {
+				loops[l].depth++;
+			}
+		}
+	}
+
+	sort(loops.begin(), loops.end(), innerFirst);
+
+	return loops;
+}
+
+/************/
+/* LIVENESS */
+/************/
+
+Liveness::Liveness(TargetCode* code, const FlowGraph& fg, const CellMap& cells) {
+	int nb = fg.numBlocks();
+	int nc = cells.count();
+
+	/* local information: cells used before being defined (gen), and defined (kill) */
+	vector<BitSet> gen(nb, BitSet(nc));
+	vector<BitSet> kill(nb, BitSet(nc));
+
+	for (int b = 0; b < nb; b++) {
+		const BasicBlock& bb = fg.getBlock(b);
+
+		for (int i = bb.last; i >= bb.first; i--) {
+			vector<int> d, u;
+			cells.defs(code->getInstr(i), d);
+			cells.uses(code->getInstr(i), u);
+
+			for (size_t k = 0; k < d.size(); k++) {
+				kill[b].set(d[k]);
+				gen[b].reset(d[k]);
+			}
+			for (size_t k = 0; k < u.size(); k++) {
+				gen[b].set(u[k]);
+			}
+		}
+	}
+
+	liveIn.assign(nb, BitSet(nc));
+	liveOut.assign(nb, BitSet(nc));
+
+	bool changed = true;
+	while (changed) {
+		changed = false;
+
+		for (int b = nb - 1; b >= 0; b--) {
+			const BasicBlock& bb = fg.getBlock(b);
+
+			for (size_t s = 0; s < bb.succs.size(); s++) {
+				liveOut[b].unite(liveIn[bb.succs[s]]);
+			}
+
+			/* in = gen + (out - kill) */
+			BitSet in = liveOut[b];
+			in.subtract(kill[b]);
+			in.unite(gen[b]);
+			changed = liveIn[b].unite(in) || changed;
+		}
+	}
+}
+
+bool Liveness::isLiveIn(int b, int cell) const {
+	return liveIn[b].test(cell);
+}
+
+bool Liveness::isLiveOut(int b, int cell) const {
+	return liveOut[b].test(cell);
+}
+
+const BitSet& Liveness::getLiveOut(int b) const {
+	return liveOut[b];
+}
+
+/************/
+/* TYPE MAP */
+/************/
+
+TypeMap::TypeMap(TargetCode* code) {
+	this->code = code;
+	vnType.assign(code->getNextInstr(), -1);
+
+	/* the type of a temporary may depend on temporaries computed later in the code array
+	 * (e.g. across a loop), so iterate until nothing changes; types only go from unknown
+	 * to known to mixed, which guarantees termination */
+	bool changed = true;
+	while (changed) {
+		changed = false;
+
+		for (int i = 0; i < code->getNextInstr(); i++) {
+			TacInstr* instr = code->getInstr(i);
+			int t = -1;
+
+			switch (instr->getOp()) {
+				case addOpr:
+				case mulOpr:
+				case divOpr: {
+					int t1 = typeCode(instr->getOperand1());
+					int t2 = typeCode(instr->getOperand2());
+					if (t1 == floatType || t2 == floatType) {
+						t = floatType;
+					} else if (t1 == intType && t2 == intType) {
+						t = intType;
+					}
+					changed = record(instr->getTemp(), t) || changed;
+					break;
+				}
+				case offsetOpr:
+					t = intType;
+					changed = record(instr->getTemp(), t) || changed;
+					break;
+				case copyOpr:
+					if (instr->getOperand2() != NULL) {
+						// a temporary takes the type of what is copied into it
+						changed = record(instr->getOperand1(), typeCode(instr->getOperand2())) || changed;
+					}
+					t = typeCode(instr->getOperand1());
+					break;
+				default:
+					break;
+			}
+
+			if (t != vnType[i]) {
+				vnType[i] = t;
+				changed = true;
+			}
+		}
+	}
+}
+
+int TypeMap::typeCode(Address* a) const {
+	if (ConstAddress* c = dynamic_cast<ConstAddress*>(a)) {
+		return c->getType();
+	}
+	if (VarAddress* v = dynamic_cast<VarAddress*>(a)) {
+		return v->getType();
+	}
+	if (TempAddress* tmp = dynamic_cast<TempAddress*>(a)) {
+		if (tmp->getWidth() == 8) {
+			return fractionType;
+		}
+		map<TempAddress*, int>::const_iterator it = tempType.find(tmp);
+		return it == tempType.end() ? -1 : it->second;
+	}
+	if (InstrAddress* ia = dynamic_cast<InstrAddress*>(a)) {
+		return vnType[ia->getIndex()];
+	}
+	return -1;
+}
+
+bool TypeMap::record(Address* a, int t) {
+	TempAddress* tmp = dynamic_cast<TempAddress*>(a);
+	if (tmp == NULL || tmp->getWidth() == 8 || t == -1) {
+		return false;
+	}
+
+	map<TempAddress*, int>::iterator it = tempType.find(tmp);
+	if (it == tempType.end()) {
+		tempType[tmp] = t;
+		return true;
+	}
+	if (it->second != t && it->second != -2) {
+		it->second = -2;
+		return true;
+	}
+	return false;
+}
+
+bool TypeMap::typeOf(Address* a, typeName& t) const {
+	int tc = typeCode(a);
+	if (tc < 0) {
+		return false;
+	}
+	t = (typeName)tc;
+	return true;
+}
+
+bool TypeMap::sameType(Address* a, Address* b) const {
+	typeName ta, tb;
+	return typeOf(a, ta) && typeOf(b, tb) && ta == tb;
+}
+
+/* Removes the candidate instructions whose results are never read, until none is left.
+ * Returns the number of removed instructions. */
+static int removeUnused(TargetCode* code, const map<TacInstr*, bool>& candidates) {
+	int removed = 0;
+	bool progress = true;
+
+	while (progress) {
+		FlowGraph fg(code);
+		CellMap cells(code);
+		Liveness live(code, fg, cells);
+
+		int n = code->getNextInstr();
+		vector<bool> dead(n, false);
+		progress = false;
+
+		for (int b = 0; b < fg.numBlocks(); b++) {
+			const BasicBlock& bb = fg.getBlock(b);
+
+			BitSet alive = live.getLiveOut(b);
+
+			for (int i = bb.last; i >= bb.first; i--) {
+				TacInstr* instr = code->getInstr(i);
+
+				vector<int> d, u;
+				cells.defs(instr, d);
+				cells.uses(instr, u);
+
+				if (candidates.count(instr) && !d.empty()) {
+					bool needed = false;
+					for (size_t k = 0; k < d.size(); k++) {
+						needed = needed || alive.test(d[k]);
+					}
+					if (!needed) {
+						dead[i] = true;
+						progress = true;
+						removed++;
+						continue;
+					}
+				}
+
+				for (size_t k = 0; k < d.size(); k++) {
+					alive.reset(d[k]);
+				}
+				for (size_t k = 0; k < u.size(); k++) {
+					alive.set(u[k]);
+				}
+			}
+		}
+
+		if (progress) {
+			vector<TacInstr*> layout;
+			for (int i = 0; i < n; i++) {
+				if (!dead[i]) {
+					layout.push_back(code->getInstr(i));
+				}
+			}
+			code->relayout(layout);
+		}
+	}
+
+	return removed;
+}
+
+/**********************************/
+/* LOOP-INVARIANT CODE MOTION     */
+/**********************************/
+
+const char* LoopInvariantCodeMotion::getName() const {
+	return "licm";
+}
+
+int LoopInvariantCodeMotion::hoistable(TargetCode* code, const FlowGraph& fg, const CellMap& cells,
+		const Liveness& live, const Loop& loop, vector<bool>& hoisted) {
+	int first = fg.getBlock(loop.header).first;
+	hoisted.assign(code->getNextInstr(), false);
+
+	/* The pre-header goes right before the header: we cannot do that if something
+	 * in the loop falls through into the header from above.
+	 */
+	if (first > 0 && loop.inLoop[fg.getBlockOf(first - 1)]) {
+		oprEnum op = code->getInstr(first - 1)->getOp();
+		if (op != jmpOpr && op != haltOpr) {
+			return 0;
+		}
+	}
+
+	/* the blocks leaving the loop, and the blocks they lead to */
+	vector<int> exits, exitTargets;
+	for (size_t k = 0; k < loop.blocks.size(); k++) {
+		const BasicBlock& bb = fg.getBlock(loop.blocks[k]);
+		for (size_t s = 0; s < bb.succs.size(); s++) {
+			if (!loop.inLoop[bb.succs[s]]) {
+				exits.push_back(loop.blocks[k]);
+				exitTargets.push_back(bb.succs[s]);
+			}
+		}
+	}
+
+	/* the instructions of the loop, and who defines what in there */
+	vector<int> body;
+	vector<int> defCount(cells.count(), 0);
+	vector<int> defBy(cells.count(), -1);
+
+	for (size_t k = 0; k < loop.blocks.size(); k++) {
+		const BasicBlock& bb = fg.getBlock(loop.blocks[k]);
+		for (int i = bb.first; i <= bb.last; i++) {
+			body.push_back(i);
+
+			vector<int> d;
+			cells.defs(code->getInstr(i), d);
+			for (size_t j = 0; j < d.size(); j++) {
+				defCount[d[j]]++;
+				defBy[d[j]] = i;
+			}
+		}
+	}
+
+	int count = 0;
+
+	bool changed = true;
+	while (changed) {
+		changed = false;
+
+		for (size_t k = 0; k < body.size(); k++) {
+			int i = body[k];
+			TacInstr* instr = code->getInstr(i);
+			oprEnum op = instr->getOp();
+
+			if (hoisted[i]) {
+				continue;
+			}
+			if (op != offsetOpr && op != addOpr && op != mulOpr && op != divOpr && op != indexCopyOpr
+					&& !(op == copyOpr && instr->getOperand2() == NULL)) {
+				continue;
+			}
+			if (op == indexCopyOpr && constIndex(instr->getOperand1()) < 0) {
+				continue;
+			}
+
+			int b = fg.getBlockOf(i);
+
+			/* is it executed on every iteration, and before leaving the loop? */
+			bool everyIteration = true;
+			for (size_t e = 0; e < exits.size(); e++) {
+				everyIteration = everyIteration && fg.dominates(b, exits[e]);
+			}
+			for (size_t l = 0; l < loop.latches.size(); l++) {
+				everyIteration = everyIteration && fg.dominates(b, loop.latches[l]);
+			}
+
+			/* a division may trap: never execute it where it would not be executed before */
+			if (op == divOpr && !everyIteration) {
+				ConstAddress* c = dynamic_cast<ConstAddress*>(instr->getOperand2());
+				if (c == NULL || c->getType() != intType || c->getIntVal() == 0) {
+					continue;
+				}
+			}
+
+			/* operands: defined outside the loop, or by a single instruction we already hoisted */
+			vector<int> u;
+			cells.uses(instr, u);
+
+			bool invariant = true;
+			for (size_t j = 0; j < u.size() && invariant; j++) {
+				invariant = defCount[u[j]] == 0 || (defCount[u[j]] == 1 && hoisted[defBy[u[j]]]);
+			}
+			if (!invariant) {
+				continue;
+			}
+
+			/* result: only defined here, and not needed before this point or, unless
+			 * the instruction runs on every iteration, after the loop */
+			vector<int> d;
+			cells.defs(instr, d);
+
+			bool movable = true;
+			for (size_t j = 0; j < d.size() && movable; j++) {
+				movable = defCount[d[j]] == 1 && !live.isLiveIn(loop.header, d[j]);
+
+				for (size_t e = 0; e < exitTargets.size() && movable && !everyIteration; e++) {
+					movable = !live.isLiveIn(exitTargets[e], d[j]);
+				}
+			}
+			if (!movable) {
+				continue;
+			}
+
+			hoisted[i] = true;
+			count++;
+			changed = true;
+		}
+	}
+
+	return count;
+}
+
+bool LoopInvariantCodeMotion::run(TargetCode* code) {
+	bool changed = false;
+	bool progress = true;
+
+	/* every transformation invalidates the analyses: start over until nothing moves */
+	while (progress) {
+		progress = false;
+
+		FlowGraph fg(code);
+		vector<Loop> loops = fg.findLoops();
+		if (loops.empty()) {
+			break;
+		}
+
+		CellMap cells(code);
+		Liveness live(code, fg, cells);
+
+		/* Loops come innermost first, so an instruction ends up leaving the outermost loop it
+		 * is invariant in. Moving instructions to the pre-header of an inner loop changes neither
+		 * what the outer loops define nor what is live at their boundaries, and the dominators
+		 * of the original position are a conservative answer for the pre-header: the analyses
+		 * stay valid for every loop of the graph.
+		 */
+		int n = code->getNextInstr();
+		vector<int> movedOutOf(n, -1);
+		vector<int> count(loops.size(), 0);
+
+		for (size_t l = 0; l < loops.size(); l++) {
+			vector<bool> hoisted;
+			count[l] = hoistable(code, fg, cells, live, loops[l], hoisted);
+
+			for (int i = 0; i < n; i++) {
+				if (hoisted[i]) {
+					movedOutOf[i] = l;
+				}
+			}
+			progress = progress || count[l] > 0;
+		}
+		if (!progress) {
+			break;
+		}
+
+		/* build the pre-headers; headerAt[i] is the loop whose (non-empty) pre-header goes
+		 * right before instruction i */
+		vector< vector<TacInstr*> > preheader(loops.size());
+		vector<int> headerAt(n, -1);
+
+		for (int i = 0; i < n; i++) {
+			if (movedOutOf[i] >= 0) {
+				preheader[movedOutOf[i]].push_back(code->getInstr(i));
+			}
+		}
+		for (size_t l = 0; l < loops.size(); l++) {
+			if (!preheader[l].empty()) {
+				headerAt[fg.getBlock(loops[l].header).first] = l;
+			}
+		}
+
+		/* Entering a loop now means entering its pre-header; jumps to an instruction
+		 * that has been moved away go to whatever followed it, falling into the pre-header
+		 * of the loop found there, if any.
+		 */
+		for (int j = 0; j < n; j++) {
+			TacInstr* instr = code->getInstr(j);
+			if (!instr->isJump()) {
+				continue;
+			}
+
+			int dest = instr->getDestInstr()->getIndex();
+			TacInstr* target = NULL;
+
+			for (int d = dest; target == NULL; d++) {
+				int l = headerAt[d];
+				if (l >= 0 && (d > dest || !loops[l].inLoop[fg.getBlockOf(j)])) {
+					target = preheader[l][0];
+				} else if (movedOutOf[d] < 0) {
+					target = code->getInstr(d);
+				}
+			}
+			if (target != code->getInstr(dest)) {
+				instr->patch(target);
+			}
+		}
+
+		vector<TacInstr*> layout;
+		for (int i = 0; i < n; i++) {
+			if (headerAt[i] >= 0) {
+				layout.insert(layout.end(), preheader[headerAt[i]].begin(), preheader[headerAt[i]].end());
+			}
+			if (movedOutOf[i] < 0) {
+				layout.push_back(code->getInstr(i));
+			}
+		}
+
+		for (size_t l = 0; l < loops.size(); l++) {
+			if (count[l] > 0) {
+				cerr << "licm: loop at " << fg.getBlock(loops[l].header).first << " (depth " << loops[l].depth
+					 << "): " << count[l] << " instruction(s) per iteration removed" << endl;
+			}
+		}
+
+		code->relayout(layout);
+		changed = true;
+	}
+
+	return changed;
+}
+
+/*******************************/
+/* STORE-TO-LOAD FORWARDING    */
+/*******************************/
+
+/* Returns y if instr is "t[k] = y" with y an int-sized value, storing into cell the field written;
+ * NULL otherwise */
+static Address* storedValue(TargetCode* code, const CellMap& cells, TacInstr* instr, int& cell) {
+	if (instr->getOp() != indexCopyOpr || constIndex(instr->getOperand1()) < 0
+			|| widthOf(code, instr->getOperand2()) != 4) {
+		return NULL;
+	}
+
+	Address* y = instr->getOperand2();
+	ConstAddress* c = dynamic_cast<ConstAddress*>(y);
+	VarAddress* v = dynamic_cast<VarAddress*>(y);
+	if ((c != NULL && c->getType() != intType) || (v != NULL && v->getType() != intType)) {
+		return NULL;
+	}
+
+	cell = cells.memCell(instr->getTemp()->getOffset() + constIndex(instr->getOperand1()));
+	return y;
+}
+
+/* The fields "t[k] = y" may store into, numbered from 0, and the ones to look at when a cell
+ * is written: the field itself, and the fields some y read from that cell was stored into */
+class StoreKeys {
+public:
+	vector<int> keyOf;
+	vector< vector<int> > killers;
+	int count;
+
+	StoreKeys(TargetCode* code, const CellMap& cells) : keyOf(cells.count(), -1), killers(cells.count()), count(0) {
+		for (int i = 0; i < code->getNextInstr(); i++) {
+			int cell;
+			Address* y = storedValue(code, cells, code->getInstr(i), cell);
+			if (y == NULL) {
+				continue;
+			}
+
+			if (keyOf[cell] < 0) {
+				keyOf[cell] = count++;
+				killers[cell].push_back(keyOf[cell]);
+			}
+
+			vector<int> yc;
+			cells.cellsOf(y, yc);
+			for (size_t k = 0; k < yc.size(); k++) {
+				if (find(killers[yc[k]].begin(), killers[yc[k]].end(), keyOf[cell]) == killers[yc[k]].end()) {
+					killers[yc[k]].push_back(keyOf[cell]);
+				}
+			}
+		}
+	}
+};
+
+/* The fields whose content is known: for each of the StoreKeys, the value last stored
+ * in it by "t[k] = y" (or NULL), and the instruction that stored it. */
+class StoredFields {
+public:
+	vector<Address*> val;
+	vector<TacInstr*> by;
+
+	StoredFields(int n = 0) : val(n, (Address*)NULL), by(n, (TacInstr*)NULL) {}
+
+	/* Keeps only the fields known to hold the same value in both states */
+	void meet(const StoredFields& other) {
+		for (size_t c = 0; c < val.size(); c++) {
+			if (val[c] != NULL && (other.val[c] == NULL || !sameValue(val[c], other.val[c]))) {
+				val[c] = NULL;
+				by[c] = NULL;
+			}
+		}
+	}
+
+	bool operator!=(const StoredFields& other) const {
+		return val != other.val;
+	}
+};
+
+/* Updates the known fields after the execution of instr */
+static void storeTransfer(TargetCode* code, const CellMap& cells, const StoreKeys& keys, TacInstr* instr,
+		StoredFields& state) {
+	vector<int> d;
+	cells.defs(instr, d);
+
+	/* forget the fields overwritten, and those holding a value that just changed */
+	for (size_t k = 0; k < d.size(); k++) {
+		const vector<int>& watched = keys.killers[d[k]];
+
+		for (size_t w = 0; w < watched.size(); w++) {
+			int key = watched[w];
+			if (state.val[key] == NULL) {
+				continue;
+			}
+
+			vector<int> vc;
+			cells.cellsOf(state.val[key], vc);
+			if (keys.keyOf[d[k]] == key || find(vc.begin(), vc.end(), d[k]) != vc.end()) {
+				state.val[key] = NULL;
+				state.by[key] = NULL;
+			}
+		}
+	}
+
+	int cell;
+	Address* y = storedValue(code, cells, instr, cell);
+	if (y != NULL) {
+		state.val[keys.keyOf[cell]] = y;
+		state.by[keys.keyOf[cell]] = instr;
+	}
+}
+
+const char* StoreToLoadForwarding::getName() const {
+	return "slf";
+}
+
+bool StoreToLoadForwarding::run(TargetCode* code) {
+	FlowGraph fg(code);
+	CellMap cells(code);
+
+	StoreKeys keys(code, cells);
+
+	int nb = fg.numBlocks();
+	int nk = keys.count;
+
+	/* forward dataflow: the fields known at the end of each block */
+	vector<StoredFields> in(nb, StoredFields(nk));
+	vector<StoredFields> out(nb, StoredFields(nk));
+	vector<bool> done(nb, false);
+
+	bool changed = true;
+	while (changed) {
+		changed = false;
+
+		for (int b = 0; b < nb; b++) {
+			const BasicBlock& bb = fg.getBlock(b);
+
+			StoredFields state(nk);
+			bool first = true;
+
+			// nothing is known when the program starts
+			for (size_t p = 0; p < bb.preds.size() && b != 0; p++) {
+				if (!done[bb.preds[p]]) {
+					continue;
+				}
+				if (first) {
+					state = out[bb.preds[p]];
+					first = false;
+				} else {
+					state.meet(out[bb.preds[p]]);
+				}
+			}
+			in[b] = state;
+
+			for (int i = bb.first; i <= bb.last; i++) {
+				storeTransfer(code, cells, keys, code->getInstr(i), state);
+			}
+
+			if (!done[b] || state != out[b]) {
+				out[b] = state;
+				done[b] = true;
+				changed = true;
+			}
+		}
+	}
+
+	/* rewrite "x = t[k]" as "x = y" and pass y along to the users of x */
+	map<TacInstr*, bool> touched;
+	int forwarded = 0;
+
+	for (int b = 0; b < nb; b++) {
+		const BasicBlock& bb = fg.getBlock(b);
+		StoredFields state = in[b];
+
+		for (int i = bb.first; i <= bb.last; i++) {
+			TacInstr* instr = code->getInstr(i);
+
+			if (instr->getOp() == offsetOpr && offsetOf(instr->getOperand1()) >= 0
+					&& constIndex(instr->getOperand2()) >= 0 && instr->getTemp()->getWidth() == 4) {
+				int cell = cells.memCell(offsetOf(instr->getOperand1()) + constIndex(instr->getOperand2()));
+				int key = keys.keyOf[cell];
+				Address* y = key >= 0 ? state.val[key] : NULL;
+
+				if (y != NULL) {
+					TempAddress* x = instr->getTemp();
+
+					touched[instr] = true;
+					touched[state.by[key]] = true;
+					forwarded++;
+
+					instr->setOp(copyOpr);
+					instr->setOperand1(x);
+					instr->setOperand2(y);
+					instr->setTemp(NULL);
+
+					/* the users in the same block read y directly, as long as neither x nor y change */
+					vector<int> watched;
+					cells.cellsOf(x, watched);
+					cells.cellsOf(y, watched);
+
+					for (int j = i + 1; j <= bb.last; j++) {
+						TacInstr* user = code->getInstr(j);
+
+						replaceUses(user, x, y);
+						replaceUses(user, instr->getValueNumber(), y);
+
+						vector<int> d;
+						cells.defs(user, d);
+
+						bool stop = false;
+						for (size_t k = 0; k < d.size() && !stop; k++) {
+							stop = find(watched.begin(), watched.end(), d[k]) != watched.end();
+						}
+						if (stop) {
+							break;
+						}
+					}
+				}
+			}
+
+			storeTransfer(code, cells, keys, instr, state);
+		}
+	}
+
+	/* drop the forwarded loads and the stores nobody reads anymore */
+	int removed = forwarded > 0 ? removeUnused(code, touched) : 0;
+
+	if (forwarded > 0) {
+		cerr << "slf: " << forwarded << " load(s) forwarded, " << removed << " dead instruction(s) removed" << endl;
+	}
+
+	return forwarded > 0;
+}
+
+/**********************************/
+/* SCALAR REPLACEMENT OF FRACTIONS */
+/**********************************/
+
+ScalarReplacement::ScalarReplacement(bool splitVars) {
+	this->splitVars = splitVars;
+}
+
+const char* ScalarReplacement::getName() const {
+	return splitVars ? "sroa-vars" : "sroa";
+}
+
+/* Returns true for the addresses that hold a whole fraction in memory */
+static bool isAggregate(Address* a) {
+	if (TempAddress* t = dynamic_cast<TempAddress*>(a)) {
+		return t->getWidth() == 8;
+	}
+	if (VarAddress* v = dynamic_cast<VarAddress*>(a)) {
+		return v->getType() == fractionType;
+	}
+	return false;
+}
+
+/* The scalar standing for field k (0 or 4) of a split aggregate */
+static Address* fieldOf(map<Address*, Address*>* fields, Address* a, int k) {
+	Address*& f = fields[k / 4][a];
+
+	if (f == NULL) {
+		if (VarAddress* v = dynamic_cast<VarAddress*>(a)) {
+			f = v->getField(k);
+		} else {
+			f = Memory::getInstance().getFieldTemp((TempAddress*)a, k);
+		}
+	}
+	return f;
+}
+
+/* Turns instr into "dst = src" */
+static void makeCopy(TacInstr* instr, Address* dst, Address* src) {
+	instr->setOp(copyOpr);
+	instr->setOperand1(dst);
+	instr->setOperand2(src);
+	instr->setTemp(NULL);
+}
+
+bool ScalarReplacement::run(TargetCode* code) {
+	int n = code->getNextInstr();
+
+	FlowGraph fg(code);
+	CellMap cells(code);
+
+	/* the candidates: all fraction temporaries and, if requested, all fraction variables */
+	map<Address*, bool> split;
+	for (int i = 0; i < n; i++) {
+		TacInstr* instr = code->getInstr(i);
+		Address* ops[3] = { instr->getOperand1(), instr->getOperand2(), instr->getTemp() };
+
+		for (int k = 0; k < 3; k++) {
+			if (isAggregate(ops[k]) && (splitVars || dynamic_cast<TempAddress*>(ops[k]) != NULL)) {
+				split[ops[k]] = true;
+			}
+		}
+	}
+
+	/* who reads each valuenumber */
+	vector< vector<int> > users(n);
+	for (int i = 0; i < n; i++) {
+		TacInstr* instr = code->getInstr(i);
+		Address* ops[2] = { instr->getOperand1(), instr->getOperand2() };
+
+		for (int k = 0; k < 2; k++) {
+			if (InstrAddress* ia = dynamic_cast<InstrAddress*>(ops[k])) {
+				users[ia->getIndex()].push_back(i);
+			}
+		}
+	}
+
+	/* Escape analysis: drop the candidates used as a whole where fields are not enough.
+	 * Dropping one may make another escape (when copied into it), hence the iteration.
+	 */
+	bool changed = true;
+	while (changed) {
+		changed = false;
+
+		for (int i = 0; i < n; i++) {
+			TacInstr* instr = code->getInstr(i);
+			Address* op1 = instr->getOperand1();
+			Address* op2 = instr->getOperand2();
+			vector<Address*> escaping;
+
+			switch (instr->getOp()) {
+				case indexCopyOpr: /* temp[op1] = op2 */
+					if (constIndex(op1) != 0 && constIndex(op1) != 4) {
+						escaping.push_back(instr->getTemp());
+					}
+					// a fraction stored as a field is read as an int: that is its numerator
+					break;
+				case offsetOpr: /* temp = op1[op2] */
+					if (constIndex(op2) != 0 && constIndex(op2) != 4) {
+						escaping.push_back(op1);
+					}
+					break;
+				case copyOpr:
+					if (op2 != NULL) {
+						/* a whole copy can be done field by field only towards another split aggregate */
+						if (!split.count(op1)) {
+							escaping.push_back(op2);
+						}
+					} else if (split.count(op1)) {
+						/* "tN = a": fine as long as (N) is only used right away, for its fields
+						 * or to be copied into another split aggregate */
+						vector<int> watched;
+						cells.cellsOf(op1, watched);
+
+						for (size_t u = 0; u < users[i].size(); u++) {
+							int j = users[i][u];
+							TacInstr* user = code->getInstr(j);
+
+							bool ok = fg.getBlockOf(j) == fg.getBlockOf(i) && j > i;
+							for (int k = i + 1; k < j && ok; k++) {
+								vector<int> d;
+								cells.defs(code->getInstr(k), d);
+								for (size_t c = 0; c < d.size() && ok; c++) {
+									ok = find(watched.begin(), watched.end(), d[c]) == watched.end();
+								}
+							}
+
+							if (user->getOp() == offsetOpr) {
+								ok = ok && (constIndex(user->getOperand2()) == 0 || constIndex(user->getOperand2()) == 4);
+							} else if (user->getOp() == copyOpr && user->getOperand2() != NULL) {
+								ok = ok && sameValue(user->getOperand2(), instr->getValueNumber()) && split.count(user->getOperand1());
+							} else {
+								ok = false;
+							}
+
+							if (!ok) {
+								escaping.push_back(op1);
+							}
+						}
+					}
+					break;
+				default:
+					escaping.push_back(op1);
+					escaping.push_back(op2);
+					break;
+			}
+
+			for (size_t k = 0; k < escaping.size(); k++) {
+				if (escaping[k] != NULL && split.count(escaping[k])) {
+					split.erase(escaping[k]);
+					changed = true;
+				}
+			}
+		}
+	}
+
+	if (split.empty()) {
+		return false;
+	}
+
+	/* the aggregate read by each "tN = a" that disappears */
+	map<int, Address*> through;
+	for (int i = 0; i < n; i++) {
+		TacInstr* instr = code->getInstr(i);
+		if (instr->getOp() == copyOpr && instr->getOperand2() == NULL && split.count(instr->getOperand1())) {
+			through[i] = instr->getOperand1();
+		}
+	}
+
+	/* rewrite */
+	map<Address*, Address*> fields[2];
+	vector<TacInstr*> layout;
+
+	for (int i = 0; i < n; i++) {
+		TacInstr* instr = code->getInstr(i);
+		Address* op1 = instr->getOperand1();
+		Address* op2 = instr->getOperand2();
+
+		if (through.count(i)) {
+			continue;
+		}
+		layout.push_back(instr);
+
+		switch (instr->getOp()) {
+			case indexCopyOpr:
+				if (split.count(op2)) {
+					op2 = fieldOf(fields, op2, 0);
+					instr->setOperand2(op2);
+				}
+				if (split.count(instr->getTemp())) {
+					makeCopy(instr, fieldOf(fields, instr->getTemp(), constIndex(op1)), op2);
+				}
+				break;
+			case offsetOpr: {
+				Address* a = op1;
+				InstrAddress* ia = dynamic_cast<InstrAddress*>(op1);
+				if (ia != NULL && through.count(ia->getIndex())) {
+					a = through[ia->getIndex()];
+				}
+				if (split.count(a)) {
+					makeCopy(instr, instr->getTemp(), fieldOf(fields, a, constIndex(op2)));
+				}
+				break;
+			}
+			case copyOpr: {
+				if (op2 == NULL || !split.count(op1)) {
+					break;
+				}
+
+				Address* src = op2;
+				InstrAddress* ia = dynamic_cast<InstrAddress*>(op2);
+				if (ia != NULL && through.count(ia->getIndex())) {
+					src = through[ia->getIndex()];
+				}
+
+				Address* num = fieldOf(fields, op1, 0);
+				Address* den = fieldOf(fields, op1, 4);
+				ConstAddress* c = dynamic_cast<ConstAddress*>(src);
+
+				if (split.count(src)) {
+					makeCopy(instr, num, fieldOf(fields, src, 0));
+					layout.push_back(new TacInstr(copyOpr, den, fieldOf(fields, src, 4), NULL));
+				} else if (c != NULL && c->getType() == fractionType) {
+					makeCopy(instr, num, new ConstAddress(c->getFractionVal().num));
+					layout.push_back(new TacInstr(copyOpr, den, new ConstAddress(c->getFractionVal().denom), NULL));
+				} else if (widthOf(code, src) == 4) {
+					/* an int promoted to a fraction */
+					makeCopy(instr, num, src);
+					layout.push_back(new TacInstr(copyOpr, den, new ConstAddress(1), NULL));
+				} else {
+					/* a fraction kept in memory: load its fields */
+					Memory& mem = Memory::getInstance();
+					TempAddress* tnum = dynamic_cast<TempAddress*>(num) ? (TempAddress*)num : mem.getNewTemp(4);
+					TempAddress* tden = dynamic_cast<TempAddress*>(den) ? (TempAddress*)den : mem.getNewTemp(4);
+
+					instr->setOp(offsetOpr);
+					instr->setOperand1(src);
+					instr->setOperand2(new ConstAddress(0));
+					instr->setTemp(tnum);
+					layout.push_back(new TacInstr(offsetOpr, src, new ConstAddress(4), tden));
+
+					if (tnum != num) {
+						layout.push_back(new TacInstr(copyOpr, num, tnum, NULL));
+						layout.push_back(new TacInstr(copyOpr, den, tden, NULL));
+					}
+				}
+				break;
+			}
+			default:
+				break;
+		}
+	}
+
+	int temps = 0, vars = 0;
+	for (map<Address*, bool>::iterator it = split.begin(); it != split.end(); ++it) {
+		if (dynamic_cast<VarAddress*>(it->first) != NULL) {
+			vars++;
+		} else {
+			temps++;
+		}
+	}
+	cerr << getName() << ": " << temps << " fraction temporaries and " << vars
+		 << " fraction variables split into scalars" << endl;
+
+	code->relayout(layout);
+
+	return true;
+}
+
+/***************************/
+/* DEAD CODE ELIMINATION   */
+/***************************/
+
+const char* DeadCodeElimination::getName() const {
+	return "dce";
+}
+
+/* Returns true if instr may stop the program: an int division, unless by a nonzero constant
+ * (a float division by zero gives an infinity or a NaN) */
+static bool mayTrap(TacInstr* instr, const TypeMap& types) {
+	if (instr->getOp() != divOpr) {
+		return false;
+	}
+
+	typeName t;
+	if ((types.typeOf(instr->getOperand1(), t) && t == floatType) || (types.typeOf(instr->getOperand2(), t) && t == floatType)) {
+		return false;
+	}
+
+	ConstAddress* c = dynamic_cast<ConstAddress*>(instr->getOperand2());
+	return c == NULL || c->getType() != intType || c->getIntVal() == 0;
+}
+
+bool DeadCodeElimination::run(TargetCode* code) {
+	int n = code->getNextInstr();
+	if (n == 0) {
+		return false;
+	}
+
+	FlowGraph fg(code);
+	CellMap cells(code);
+	int nb = fg.numBlocks();
+	int nc = cells.count();
+
+	/* Reaching definitions. A definition is an (instruction, cell) pair, since a fraction
+	 * may be written as a whole and then partially overwritten field by field.
+	 */
+	vector<int> defInstr, defCell;
+	vector< vector<int> > defsOfCell(nc);
+	vector< vector<int> > defsOfInstr(n);
+
+	for (int i = 0; i < n; i++) {
+		vector<int> d;
+		cells.defs(code->getInstr(i), d);
+
+		for (size_t k = 0; k < d.size(); k++) {
+			defsOfCell[d[k]].push_back(defInstr.size());
+			defsOfInstr[i].push_back(defInstr.size());
+			defInstr.push_back(i);
+			defCell.push_back(d[k]);
+		}
+	}
+
+	int nd = defInstr.size();
+
+	/* local information: the definitions surviving at the end of each block (gen),
+	 * and all the definitions of the cells it writes (kill) */
+	vector<BitSet> gen(nb, BitSet(nd));
+	vector<BitSet> kill(nb, BitSet(nd));
+
+	for (int b = 0; b < nb; b++) {
+		const BasicBlock& bb = fg.getBlock(b);
+
+		for (int i = bb.first; i <= bb.last; i++) {
+			for (size_t k = 0; k < defsOfInstr[i].size(); k++) {
+				int cell = defCell[defsOfInstr[i][k]];
+				for (size_t j = 0; j < defsOfCell[cell].size(); j++) {
+					kill[b].set(defsOfCell[cell][j]);
+					gen[b].reset(defsOfCell[cell][j]);
+				}
+			}
+			for (size_t k = 0; k < defsOfInstr[i].size(); k++) {
+				gen[b].set(defsOfInstr[i][k]);
+			}
+		}
+	}
+
+	vector<BitSet> in(nb, BitSet(nd));
+	vector<BitSet> out(nb, BitSet(nd));
+
+	bool changed = true;
+	while (changed) {
+		changed = false;
+
+		for (int b = 0; b < nb; b++) {
+			const BasicBlock& bb = fg.getBlock(b);
+
+			BitSet state(nd);
+			for (size_t p = 0; p < bb.preds.size(); p++) {
+				state.unite(out[bb.preds[p]]);
+			}
+			in[b] = state;
+
+			/* out = gen + (in - kill) */
+			state.subtract(kill[b]);
+			state.unite(gen[b]);
+
+			if (state != out[b]) {
+				out[b] = state;
+				changed = true;
+			}
+		}
+	}
+
+	/* Mark: start from what is always needed, in reachable blocks
+	 * (HALT stays anyway, as the program must have it, and so does the last instruction,
+	 * which the code must not run past) */
+	vector<bool> marked(n, false);
+	vector<int> worklist;
+	TypeMap types(code);
+
+	for (int i = 0; i < n; i++) {
+		oprEnum op = code->getInstr(i)->getOp();
+		// "read" consumes input even when the value is not needed; "print" produces output,
+		// and a division by zero stops the program
+		bool critical = code->getInstr(i)->isJump() || op == haltOpr || op == readOpr || op == printOpr || op == fakeOpr
+			|| mayTrap(code->getInstr(i), types);
+
+		if (critical && fg.isReachable(fg.getBlockOf(i))) {
+			marked[i] = true;
+			worklist.push_back(i);
+		}
+	}
+	for (int i = 0; i < n; i++) {
+		marked[i] = marked[i] || code->getInstr(i)->getOp() == haltOpr;
+	}
+	marked[n - 1] = true;
+
+	while (!worklist.empty()) {
+		int i = worklist.back();
+		worklist.pop_back();
+
+		int b = fg.getBlockOf(i);
+		const BasicBlock& bb = fg.getBlock(b);
+
+		vector<int> u;
+		cells.uses(code->getInstr(i), u);
+
+		for (size_t k = 0; k < u.size(); k++) {
+			int cell = u[k];
+
+			/* the closest definition in the same block, if any, hides all the others */
+			int local = -1;
+			for (int j = i - 1; j >= bb.first && local < 0; j--) {
+				for (size_t d = 0; d < defsOfInstr[j].size(); d++) {
+					if (defCell[defsOfInstr[j][d]] == cell) {
+						local = j;
+					}
+				}
+			}
+
+			vector<int> reaching;
+			if (local >= 0) {
+				reaching.push_back(local);
+			} else {
+				for (size_t d = 0; d < defsOfCell[cell].size(); d++) {
+					if (in[b].test(defsOfCell[cell][d])) {
+						reaching.push_back(defInstr[defsOfCell[cell][d]]);
+					}
+				}
+			}
+
+			for (size_t r = 0; r < reaching.size(); r++) {
+				if (!marked[reaching[r]]) {
+					marked[reaching[r]] = true;
+					worklist.push_back(reaching[r]);
+				}
+			}
+		}
+	}
+
+	/* Sweep */
+	int dead = 0, unreachable = 0;
+	vector<TacInstr*> layout;
+
+	for (int i = 0; i < n; i++) {
+		if (marked[i]) {
+			layout.push_back(code->getInstr(i));
+		} else if (fg.isReachable(fg.getBlockOf(i))) {
+			dead++;
+		} else {
+			unreachable++;
+		}
+	}
+
+	if (dead + unreachable == 0) {
+		return false;
+	}
+
+	cerr << "dce: " << dead << " dead and " << unreachable << " unreachable instruction(s) removed" << endl;
+
+	code->relayout(layout);
+
+	return true;
+}
+
+/***************************/
+/* COPY PROPAGATION        */
+/***************************/
+
+const char* CopyPropagation::getName() const {
+	return "copyprop";
+}
+
+/* The cells an instruction may write: those it surely defines, plus the whole temporary
+ * for "t[i] = y" with a non-constant index */
+static void mayDefs(const CellMap& cells, TacInstr* instr, vector<int>& out) {
+	cells.defs(instr, out);
+	if (instr->getOp() == indexCopyOpr && constIndex(instr->getOperand1()) < 0) {
+		cells.cellsOf(instr->getTemp(), out);
+	}
+}
+
+int CopyPropagation::propagate(TargetCode* code) {
+	FlowGraph fg(code);
+	CellMap cells(code);
+	TypeMap types(code);
+
+	int n = code->getNextInstr();
+	int nb = fg.numBlocks();
+
+	/* The copies "dst = src": a copy instruction stores src both into its destination (if any)
+	 * and into its valuenumber. Each of them holds as long as no cell of dst or src is written. */
+	vector<Address*> dst, src;
+	vector< vector<int> > genAt(n);
+	vector< vector<int> > watchers(cells.count());	// copies to forget when a cell is written
+	vector< vector<int> > readers(cells.count());	// copies whose destination includes a cell
+
+	for (int i = 0; i < n; i++) {
+		TacInstr* instr = code->getInstr(i);
+		if (instr->getOp() != copyOpr) {
+			continue;
+		}
+
+		Address* from = instr->getOperand2() != NULL ? instr->getOperand2() : instr->getOperand1();
+		Address* to[2] = { instr->getOperand2() != NULL ? instr->getOperand1() : NULL, instr->getValueNumber() };
+
+		for (int k = 0; k < 2; k++) {
+			if (to[k] == NULL || sameValue(to[k], from)) {
+				continue;
+			}
+
+			int f = dst.size();
+			dst.push_back(to[k]);
+			src.push_back(from);
+			genAt[i].push_back(f);
+
+			vector<int> dc, sc;
+			cells.cellsOf(to[k], dc);
+			cells.cellsOf(from, sc);
+			for (size_t c = 0; c < dc.size(); c++) {
+				watchers[dc[c]].push_back(f);
+				readers[dc[c]].push_back(f);
+			}
+			for (size_t c = 0; c < sc.size(); c++) {
+				watchers[sc[c]].push_back(f);
+			}
+		}
+	}
+
+	int nf = dst.size();
+	if (nf == 0) {
+		return 0;
+	}
+
+	/* local information: the copies executed and still valid at the end of each block (gen),
+	 * and the copies invalidated in there (kill) */
+	vector<BitSet> gen(nb, BitSet(nf));
+	vector<BitSet> kill(nb, BitSet(nf));
+
+	for (int b = 0; b < nb; b++) {
+		const BasicBlock& bb = fg.getBlock(b);
+
+		for (int i = bb.first; i <= bb.last; i++) {
+			vector<int> d;
+			mayDefs(cells, code->getInstr(i), d);
+			for (size_t k = 0; k < d.size(); k++) {
+				for (size_t w = 0; w < watchers[d[k]].size(); w++) {
+					kill[b].set(watchers[d[k]][w]);
+					gen[b].reset(watchers[d[k]][w]);
+				}
+			}
+			for (size_t k = 0; k < genAt[i].size(); k++) {
+				gen[b].set(genAt[i][k]);
+			}
+		}
+	}
+
+	/* forward dataflow (available copies): a copy is available at a point if it is executed,
+	 * and not invalidated afterwards, along every path reaching that point */
+	vector<BitSet> in(nb, BitSet(nf, true));
+	vector<BitSet> out(nb, BitSet(nf, true));
+	in[0] = BitSet(nf);
+
+	bool changed = true;
+	while (changed) {
+		changed = false;
+
+		for (int b = 0; b < nb; b++) {
+			const BasicBlock& bb = fg.getBlock(b);
+
+			BitSet state = in[b];
+			if (b != 0) {
+				for (size_t p = 0; p < bb.preds.size(); p++) {
+					state.intersect(out[bb.preds[p]]);
+				}
+				in[b] = state;
+			}
+
+			/* out = gen + (in - kill) */
+			state.subtract(kill[b]);
+			state.unite(gen[b]);
+
+			if (state != out[b]) {
+				out[b] = state;
+				changed = true;
+			}
+		}
+	}
+
+	/* rewrite the uses of the destinations of the available copies */
+	int rewritten = 0;
+
+	for (int b = 0; b < nb; b++) {
+		const BasicBlock& bb = fg.getBlock(b);
+		BitSet state = in[b];
+
+		for (int i = bb.first; i <= bb.last; i++) {
+			TacInstr* instr = code->getInstr(i);
+
+			vector<int> u;
+			cells.uses(instr, u);
+			if (instr->getOp() == offsetOpr) {
+				cells.cellsOf(instr->getOperand1(), u);
+			}
+
+			for (size_t k = 0; k < u.size(); k++) {
+				for (size_t r = 0; r < readers[u[k]].size(); r++) {
+					int f = readers[u[k]][r];
+					if (!state.test(f) || !types.sameType(dst[f], src[f])
+							|| widthOf(code, dst[f]) != widthOf(code, src[f])) {
+						continue;
+					}
+
+					if (replaceUses(instr, dst[f], src[f])) {
+						rewritten++;
+					}
+					/* the base of x[i] must stay in Memory */
+					if (instr->getOp() == offsetOpr && sameValue(instr->getOperand1(), dst[f])
+							&& offsetOf(src[f]) >= 0) {
+						instr->setOperand1(src[f]);
+						rewritten++;
+					}
+				}
+			}
+
+			vector<int> d;
+			mayDefs(cells, instr, d);
+			for (size_t k = 0; k < d.size(); k++) {
+				for (size_t w = 0; w < watchers[d[k]].size(); w++) {
+					state.reset(watchers[d[k]][w]);
+				}
+			}
+			for (size_t k = 0; k < genAt[i].size(); k++) {
+				state.set(genAt[i][k]);
+			}
+		}
+	}
+
+	return rewritten;
+}
+
+/* Orders temporaries by their location in Memory */
+static bool lowerOffset(TempAddress* a, TempAddress* b) {
+	return a->getOffset() < b->getOffset();
+}
+
+int CopyPropagation::coalesce(TargetCode* code, int& slots, int& saved) {
+	int n = code->getNextInstr();
+
+	/* the temporaries referenced by the code, in order of appearance */
+	vector<TempAddress*> temps;
+	map<TempAddress*, int> id;
+
+	for (int i = 0; i < n; i++) {
+		TacInstr* instr = code->getInstr(i);
+		Address* ops[3] = { instr->getOperand1(), instr->getOperand2(), instr->getTemp() };
+
+		for (int k = 0; k < 3; k++) {
+			TempAddress* t = dynamic_cast<TempAddress*>(ops[k]);
+			if (t != NULL && id.count(t) == 0) {
+				id[t] = temps.size();
+				temps.push_back(t);
+			}
+		}
+	}
+
+	int nt = temps.size();
+	slots = nt;
+	saved = 0;
+
+	FlowGraph fg(code);
+	CellMap cells(code);
+	TypeMap types(code);
+	Liveness live(code, fg, cells);
+
+	/* the temporary owning each memory cell; temporaries sharing memory are left alone */
+	vector<int> owner(cells.count(), -1);
+	for (int t = 0; t < nt; t++) {
+		vector<int> tc;
+		cells.cellsOf(temps[t], tc);
+		for (size_t c = 0; c < tc.size(); c++) {
+			if (owner[tc[c]] >= 0) {
+				return 0;
+			}
+			owner[tc[c]] = t;
+		}
+	}
+
+	/* Interference graph: a temporary written while another one is live cannot share its slot,
+	 * unless it is written with a plain copy of it */
+	vector< vector<int> > adj(nt);
+	vector< vector<int> > related(nt);
+
+	for (int b = 0; b < fg.numBlocks(); b++) {
+		const BasicBlock& bb = fg.getBlock(b);
+
+		vector<int> liveCells(nt, 0);
+		set<int> liveTemps;
+		BitSet alive = live.getLiveOut(b);
+
+		for (int c = alive.next(0); c >= 0; c = alive.next(c + 1)) {
+			if (owner[c] >= 0 && liveCells[owner[c]]++ == 0) {
+				liveTemps.insert(owner[c]);
+			}
+		}
+
+		for (int i = bb.last; i >= bb.first; i--) {
+			TacInstr* instr = code->getInstr(i);
+
+			vector<int> d, u;
+			mayDefs(cells, instr, d);
+			cells.uses(instr, u);
+
+			int copied = -1;
+			if (instr->getOp() == copyOpr && instr->getOperand2() != NULL
+					&& types.sameType(instr->getOperand1(), instr->getOperand2())) {
+				TempAddress* s = dynamic_cast<TempAddress*>(instr->getOperand2());
+				if (s != NULL) {
+					copied = id[s];
+				}
+			}
+
+			for (size_t k = 0; k < d.size(); k++) {
+				int t = owner[d[k]];
+				if (t < 0) {
+					continue;
+				}
+				for (set<int>::iterator it = liveTemps.begin(); it != liveTemps.end(); ++it) {
+					if (*it != t && *it != copied) {
+						adj[t].push_back(*it);
+						adj[*it].push_back(t);
+					}
+				}
+				if (copied >= 0 && copied != t) {
+					related[t].push_back(copied);
+					related[copied].push_back(t);
+				}
+			}
+
+			for (size_t k = 0; k < d.size(); k++) {
+				if (alive.test(d[k])) {
+					alive.reset(d[k]);
+					if (owner[d[k]] >= 0 && --liveCells[owner[d[k]]] == 0) {
+						liveTemps.erase(owner[d[k]]);
+					}
+				}
+			}
+			for (size_t k = 0; k < u.size(); k++) {
+				if (!alive.test(u[k])) {
+					alive.set(u[k]);
+					if (owner[u[k]] >= 0 && liveCells[owner[u[k]]]++ == 0) {
+						liveTemps.insert(owner[u[k]]);
+					}
+				}
+			}
+		}
+	}
+
+	for (int t = 0; t < nt; t++) {
+		sort(adj[t].begin(), adj[t].end());
+	}
+
+	/* Greedy coloring, in order of appearance: a temporary joins the slot of a copy-related one
+	 * if possible, otherwise the first slot of the same type it does not interfere with, so that
+	 * every temporary keeps a single type */
+	vector<int> slotOf(nt, -1);
+	vector< vector<int> > members;
+
+	for (int t = 0; t < nt; t++) {
+		vector<int> candidates;
+		for (size_t r = 0; r < related[t].size(); r++) {
+			if (slotOf[related[t][r]] >= 0) {
+				candidates.push_back(slotOf[related[t][r]]);
+			}
+		}
+		for (size_t s = 0; s < members.size(); s++) {
+			candidates.push_back(s);
+		}
+
+		for (size_t c = 0; c < candidates.size() && slotOf[t] < 0; c++) {
+			int s = candidates[c];
+			bool fits = temps[members[s][0]]->getWidth() == temps[t]->getWidth()
+				&& types.sameType(temps[members[s][0]], temps[t]);
+
+			for (size_t m = 0; m < members[s].size() && fits; m++) {
+				fits = !binary_search(adj[t].begin(), adj[t].end(), members[s][m]);
+			}
+			if (fits) {
+				slotOf[t] = s;
+				members[s].push_back(t);
+			}
+		}
+
+		if (slotOf[t] < 0) {
+			slotOf[t] = members.size();
+			members.push_back(vector<int>(1, t));
+		}
+	}
+
+	slots = members.size();
+
+	/* each slot is represented by its first temporary */
+	vector<TempAddress*> rep(slots);
+	for (int s = 0; s < slots; s++) {
+		rep[s] = temps[members[s][0]];
+	}
+
+	for (int i = 0; i < n; i++) {
+		TacInstr* instr = code->getInstr(i);
+
+		if (TempAddress* t = dynamic_cast<TempAddress*>(instr->getOperand1())) {
+			instr->setOperand1(rep[slotOf[id[t]]]);
+		}
+		if (TempAddress* t = dynamic_cast<TempAddress*>(instr->getOperand2())) {
+			instr->setOperand2(rep[slotOf[id[t]]]);
+		}
+		if (TempAddress* t = instr->getTemp()) {
+			instr->setTemp(rep[slotOf[id[t]]]);
+		}
+	}
+
+	/* copies turned into "t = t" are gone, unless their valuenumber is read */
+	vector<bool> readVn(n, false);
+	for (int i = 0; i < n; i++) {
+		TacInstr* instr = code->getInstr(i);
+		Address* ops[2] = { instr->getOperand1(), instr->getOperand2() };
+
+		for (int k = 0; k < 2; k++) {
+			if (InstrAddress* ia = dynamic_cast<InstrAddress*>(ops[k])) {
+				readVn[ia->getIndex()] = true;
+			}
+		}
+	}
+
+	vector<TacInstr*> layout;
+	for (int i = 0; i < n; i++) {
+		TacInstr* instr = code->getInstr(i);
+		if (instr->getOp() != copyOpr || instr->getOperand2() == NULL
+				|| instr->getOperand1() != instr->getOperand2() || readVn[i]) {
+			layout.push_back(instr);
+		}
+	}
+	if ((int)layout.size() < n) {
+		code->relayout(layout);
+	}
+
+	/* lay the slots out again, in their original order; the memory of the temporaries
+	 * no longer referenced is reclaimed as well */
+	sort(rep.begin(), rep.end(), lowerOffset);
+
+	Memory& mem = Memory::getInstance();
+	int oldUsed = mem.getUsed();
+	mem.reallocTemps(rep);
+	saved = oldUsed - mem.getUsed();
+
+	return nt - slots;
+}
+
+bool CopyPropagation::run(TargetCode* code) {
+	int rewritten = 0, round;
+
+	/* each round follows the copies one more step along a chain */
+	while ((round = propagate(code)) > 0) {
+		rewritten += round;
+	}
+
+	/* the copies into temporaries and valuenumbers may have lost all their readers */
+	map<TacInstr*, bool> copies;
+	for (int i = 0; i < code->getNextInstr(); i++) {
+		TacInstr* instr = code->getInstr(i);
+		if (instr->getOp() == copyOpr
+				&& (instr->getOperand2() == NULL || dynamic_cast<TempAddress*>(instr->getOperand1()) != NULL)) {
+			copies[instr] = true;
+		}
+	}
+	int before = code->getNextInstr();
+	removeUnused(code, copies);
+
+	int slots, saved;
+	int merged = coalesce(code, slots, saved);
+	int removed = before - code->getNextInstr();
+
+	if (rewritten + merged + saved == 0 && removed == 0) {
+		return false;
+	}
+
+	cerr << "copyprop: " << rewritten << " use(s) rewritten, " << removed << " copies removed, "
+		<< merged << " temporaries merged into " << slots << " slots (" << saved << " bytes of Memory saved)" << endl;
+
+	return true;
+}
+
+/***************************/
+/* BLOCK LAYOUT            */
+/***************************/
+
+const char* BlockLayout::getName() const {
+	return "layout";
+}
+
+/* Returns the negated operator of a conditional jump, or UNKNOWNOpr if it cannot be negated:
+ * a float ordering, or an operand whose type is unknown */
+static oprEnum negation(TacInstr* instr, const TypeMap& types) {
+	typeName t1, t2;
+	bool known = types.typeOf(instr->getOperand1(), t1) && types.typeOf(instr->getOperand2(), t2);
+	bool ordered = known && t1 != floatType && t2 != floatType;
+
+	switch (instr->getOp()) {
+		case eq1condJmpOpr:
+			return neCondJmpOpr;
+		case eq2condJmpOpr:
+			// "=" compares fractions field by field, "!=" as numbers
+			return known && t1 != fractionType && t2 != fractionType ? neCondJmpOpr : UNKNOWNOpr;
+		case neCondJmpOpr:
+			return eq1condJmpOpr;
+		case ltCondJmpOpr:
+			return ordered ? geCondJmpOpr : UNKNOWNOpr;
+		case leCondJmpOpr:
+			return ordered ? gtCondJmpOpr : UNKNOWNOpr;
+		case gtCondJmpOpr:
+			return ordered ? leCondJmpOpr : UNKNOWNOpr;
+		case geCondJmpOpr:
+			return ordered ? ltCondJmpOpr : UNKNOWNOpr;
+		default:
+			return UNKNOWNOpr;
+	}
+}
+
+bool BlockLayout::run(TargetCode* code) {
+	int n = code->getNextInstr();
+
+	FlowGraph fg(code);
+	int nb = fg.numBlocks();
+
+	/* the gotos of the jump tables, which must stay where they are */
+	vector<bool> entry(n, false);
+	for (int i = 0; i < n; i++) {
+		for (int k = 1; k <= code->getInstr(i)->tableSize(); k++) {
+			entry[i + k] = true;
+		}
+	}
+
+	/* a hinted branch starts a block of its own; the entry block always stays first,
+	 * and the gotos of a jump table go with it */
+	vector<int> order;
+	vector<bool> cold(nb, false);
+	for (int b = 0; b < nb; b++) {
+		cold[b] = b > 0 && code->getInstr(fg.getBlock(b).first)->isCold();
+		if (entry[fg.getBlock(b).first]) {
+			cold[b] = cold[b - 1];
+		}
+		if (!cold[b]) {
+			order.push_back(b);
+		}
+	}
+	int hot = order.size();
+	for (int b = 0; b < nb; b++) {
+		if (cold[b]) {
+			order.push_back(b);
+		}
+	}
+
+	if (hot == nb) {
+		return false;
+	}
+
+	TypeMap types(code);
+	int inverted = 0, added = 0;
+	vector<TacInstr*> layout;
+
+	/* the gotos removed, each with the instruction it jumped to */
+	map<TacInstr*, TacInstr*> dropped;
+
+	for (int k = 0; k < nb; k++) {
+		const BasicBlock& bb = fg.getBlock(order[k]);
+		TacInstr* last = code->getInstr(bb.last);
+		int next = k + 1 < nb ? fg.getBlock(order[k + 1]).first : -1;
+
+		for (int i = bb.first; i < bb.last; i++) {
+			layout.push_back(code->getInstr(i));
+		}
+
+		if (last->getOp() == jmpOpr && last->getDestInstr()->getIndex() == next && !entry[bb.last]) {
+			dropped[last] = code->getInstr(next);
+			continue;
+		}
+		layout.push_back(last);
+
+		/* the instruction the block used to fall through to, if any */
+		bool fallsThrough = (!last->isJump() || last->isCondJump()) && last->getOp() != haltOpr;
+		int follower = bb.last + 1;
+		if (!fallsThrough || follower >= n || follower == next) {
+			continue;
+		}
+
+		if (last->isCondJump() && last->getDestInstr()->getIndex() == next
+				&& negation(last, types) != UNKNOWNOpr) {
+			last->setOp(negation(last, types));
+			last->patch(code->getInstr(follower));
+			inverted++;
+		} else {
+			TacInstr* jump = new TacInstr(jmpOpr, NULL, NULL, NULL);
+			jump->patch(code->getInstr(follower));
+			layout.push_back(jump);
+			added++;
+		}
+	}
+
+	bool moved = false;
+	for (int k = 0; k < nb; k++) {
+		moved = moved || order[k] != k;
+	}
+	if (!moved && inverted + added + dropped.size() == 0) {
+		// already laid out, e.g. by an earlier run
+		return false;
+	}
+
+	/* a jump to a removed goto goes straight where the goto went */
+	for (size_t i = 0; i < layout.size(); i++) {
+		if (layout[i]->isJump()) {
+			TacInstr* target = code->getInstr(layout[i]->getDestInstr()->getIndex());
+			while (dropped.count(target)) {
+				target = dropped[target];
+			}
+			layout[i]->patch(target);
+		}
+	}
+
+	cerr << "layout: " << nb - hot << " cold block(s) moved after HALT, " << inverted << " branch(es) inverted, "
+		<< added << " goto(s) added, " << dropped.size() << " removed" << endl;
+
+	code->relayout(layout);
+
+	return true;
+}
+
+/*****************/
+/* PASS MANAGER  */
+/*****************/
+
+/* The passes, in the order they are run, and the optimization level enabling each of them */
+static const struct {
+	const char* name;
+	int level;
+} registry[] = {
+	{ "sroa", 2 },
+	{ "sroa-vars", 3 },	// never enabled by a level
+	{ "slf", 1 },
+	{ "licm", 2 },
+	{ "dce", 1 },
+	{ "copyprop", 1 },
+	{ "layout", 1 }
+};
+
+static const int numRegistered = sizeof(registry) / sizeof(registry[0]);
+
+PassManager::PassManager() {
+	timePasses = false;
+}
+
+PassManager::~PassManager() {
+	for (size_t p = 0; p < passes.size(); p++) {
+		delete passes[p];
+	}
+}
+
+Pass* PassManager::createPass(const string& name) {
+	if (name == "sroa") {
+		return new ScalarReplacement(false);
+	}
+	if (name == "sroa-vars") {
+		return new ScalarReplacement(true);
+	}
+	if (name == "slf") {
+		return new StoreToLoadForwarding();
+	}
+	if (name == "licm") {
+		return new LoopInvariantCodeMotion();
+	}
+	if (name == "dce") {
+		return new DeadCodeElimination();
+	}
+	if (name == "copyprop") {
+		return new CopyPropagation();
+	}
+	if (name == "layout") {
+		return new BlockLayout();
+	}
+	return NULL;
+}
+
+string PassManager::passNames() {
+	string names;
+	for (int r = 0; r < numRegistered; r++) {
+		names += (r > 0 ? ", " : "") + string(registry[r].name);
+	}
+	return names;
+}
+
+void PassManager::add(Pass* pass) {
+	passes.push_back(pass);
+}
+
+void PassManager::addLevel(int level, const vector<string>& enabled) {
+	bool splitVars = find(enabled.begin(), enabled.end(), "sroa-vars") != enabled.end();
+
+	for (int r = 0; r < numRegistered; r++) {
+		string name = registry[r].name;
+
+		bool wanted = level >= registry[r].level
+			|| find(enabled.begin(), enabled.end(), name) != enabled.end();
+
+		// sroa-vars does everything sroa does
+		if (wanted && !(name == "sroa" && splitVars)) {
+			add(createPass(name));
+		}
+	}
+}
+
+void PassManager::setTimePasses(bool on) {
+	timePasses = on;
+}
+
+bool PassManager::run(TargetCode* code) {
+	Memory& mem = Memory::getInstance();
+	bool changed = false;
+
+	/* one line per pass: name, time, size of the code and of Memory afterwards */
+	vector<string> names;
+	vector<double> millis;
+	vector<int> instrs(1, code->getNextInstr());
+	vector<int> bytes(1, mem.getUsed());
+
+#ifndef NDEBUG
+	string error;
+	{
+		TimeScope t("verify");
+		error = verify(code);
+	}
+	if (!error.empty()) {
+		cerr << "IR verification failed before optimizing: " << error << endl;
+		abort();
+	}
+#endif
+
+	for (size_t p = 0; p < passes.size(); p++) {
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+		{
+			TimeScope t(passes[p]->getName());
+			changed = passes[p]->run(code) || changed;
+		}
+
+		chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+
+		names.push_back(passes[p]->getName());
+		millis.push_back(elapsed.count());
+		instrs.push_back(code->getNextInstr());
+		bytes.push_back(mem.getUsed());
+
+#ifndef NDEBUG
+		TimeScope t("verify");
+		error = verify(code);
+		if (!error.empty()) {
+			cerr << "IR verification failed after " << passes[p]->getName() << ": " << error << endl;
+			abort();
+		}
+#endif
+	}
+
+	if (timePasses) {
+		double total = 0;
+
+		cerr << "===== Pass execution timing report =====" << endl;
+		cerr << left << setw(12) << "pass" << right << setw(12) << "time (ms)" << setw(10) << "instrs"
+			<< setw(8) << "delta" << setw(10) << "memory" << setw(8) << "delta" << endl;
+
+		for (size_t p = 0; p < names.size(); p++) {
+			total += millis[p];
+			cerr << left << setw(12) << names[p] << right << fixed << setprecision(3) << setw(12) << millis[p]
+				<< setw(10) << instrs[p + 1] << setw(8) << showpos << instrs[p + 1] - instrs[p] << noshowpos
+				<< setw(10) << bytes[p + 1] << setw(8) << showpos << bytes[p + 1] - bytes[p] << noshowpos << endl;
+		}
+
+		cerr << left << setw(12) << "total" << right << fixed << setprecision(3) << setw(12) << total
+			<< setw(10) << instrs.back() << setw(8) << showpos << instrs.back() - instrs.front() << noshowpos
+			<< setw(10) << bytes.back() << setw(8) << showpos << bytes.back() - bytes.front() << noshowpos << endl;
+	}
+
+	return changed;
+}
+
+string PassManager::verify(TargetCode* code) {
+	int n = code->getNextInstr();
+	int used = Memory::getInstance().getUsed();
+	ostringstream error;
+
+	if (n == 0 || (code->getInstr(n - 1)->getOp() != haltOpr && code->getInstr(n - 1)->getOp() != jmpOpr)) {
+		return "the code does not end with HALT or a goto";
+	}
+
+	int halts = 0;
+
+	for (int i = 0; i < n; i++) {
+		TacInstr* instr = code->getInstr(i);
+
+		if (instr->getValueNumber()->getIndex() != i) {
+			error << "instruction " << i << " has valuenumber " << instr->getValueNumber()->getIndex();
+			return error.str();
+		}
+
+		if (instr->getOp() == haltOpr && ++halts > 1) {
+			error << "a second HALT at " << i;
+			return error.str();
+		}
+
+		if (instr->isJump()) {
+			InstrAddress* dest = instr->getDestInstr();
+			if (dest == NULL) {
+				error << "jump at " << i << " has not been patched";
+				return error.str();
+			}
+			if (dest->getIndex() < 0 || dest->getIndex() >= n) {
+				error << "jump at " << i << " goes to " << dest->getIndex() << ", out of the code";
+				return error.str();
+			}
+		}
+
+		if (instr->getOp() == jmpTableOpr) {
+			int size = instr->tableSize();
+			bool gotos = dynamic_cast<ConstAddress*>(instr->getOperand2()) != NULL && size >= 0 && i + size < n;
+			for (int k = 1; k <= size && gotos; k++) {
+				gotos = code->getInstr(i + k)->getOp() == jmpOpr;
+			}
+			if (!gotos) {
+				error << "the jump table at " << i << " is not followed by its " << size << " goto(s)";
+				return error.str();
+			}
+		}
+
+		Address* ops[3] = { instr->getOperand1(), instr->getOperand2(), instr->getTemp() };
+		for (int k = 0; k < 3; k++) {
+			if (InstrAddress* ia = dynamic_cast<InstrAddress*>(ops[k])) {
+				if (ia->getIndex() < 0 || ia->getIndex() >= n) {
+					error << "instruction " << i << " reads valuenumber " << ia->getIndex() << ", out of the code";
+					return error.str();
+				}
+			}
+
+			int offset = offsetOf(ops[k]);
+			if (offset >= 0 && offset + widthOf(code, ops[k]) > used) {
+				error << "instruction " << i << " accesses " << ops[k] << " at offset " << offset
+					<< ", outside of the " << used << " bytes of Memory in use";
+				return error.str();
+			}
+		}
+	}
+
+	if (halts == 0) {
+		return "the code has no HALT";
+	}
+
+	return "";
+}
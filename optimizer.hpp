@@ -0,0 +1,417 @@
+#ifndef OPTIMIZER_HPP_
+#define OPTIMIZER_HPP_
+
+/**
+* @file optimizer.hpp
+* @brief This header file contains the machine-independent optimizer
+* of tinycomp: the analyses it needs (control flow graph, dominators,
+* natural loops, liveness) and the passes transforming the 3-addr code.
+*/
+
+#include <map>
+#include <string>
+#include <vector>
+#include "tinycomp.hpp"
+
+using namespace std;
+
+/* ***********/
+/*  BIT SETS */
+/* ***********/
+
+/** A fixed-size set of small integers, packed 64 per word.
+ *  The dataflow problems below are solved on sets of blocks, cells or definitions:
+ *  packing them lets unions and intersections work on whole words at a time.
+ */
+class BitSet {
+private:
+	vector<unsigned long long> words;
+	int bits;
+
+public:
+	/** Constructor: a set of the integers in [0, size), either empty or full */
+	BitSet(int size = 0, bool full = false);
+
+	/** Returns the size of the universe of the set */
+	int size() const;
+
+	/** Returns true if i belongs to the set */
+	bool test(int i) const;
+
+	/** Adds i to the set */
+	void set(int i);
+
+	/** Removes i from the set */
+	void reset(int i);
+
+	/** Adds the elements of other to the set; returns true if the set has grown */
+	bool unite(const BitSet& other);
+
+	/** Removes the elements not in other from the set */
+	void intersect(const BitSet& other);
+
+	/** Removes the elements of other from the set */
+	void subtract(const BitSet& other);
+
+	/** Returns the smallest element not lower than i, or -1 if there is none */
+	int next(int i) const;
+
+	bool operator==(const BitSet& other) const;
+	bool operator!=(const BitSet& other) const;
+};
+
+/* ***********************/
+/*  DEFINITIONS AND USES */
+/* ***********************/
+
+/** Dataflow facts are tracked per "cell". A cell is either:
+ * - a 4-byte slot of Memory; an int or float occupies one cell, a fraction two of them
+ *   (numerator first, then denominator), which lets us follow single fraction fields;
+ * - the value computed by an instruction, i.e. its valuenumber.
+ * Variables and temporaries never overlap in Memory, so there is no aliasing to worry about.
+ */
+class CellMap {
+private:
+	TargetCode* code;
+	int memCells;
+
+	/* isVar[c] is true for the memory cells holding a variable */
+	vector<bool> isVar;
+
+public:
+	/** Constructor: sizes the map for the current code and Memory */
+	CellMap(TargetCode* code);
+
+	/** Returns the total number of cells */
+	int count() const;
+
+	/** Returns the cell holding the 4 bytes at the given Memory offset */
+	int memCell(int offset) const;
+
+	/** Returns the cell holding the value computed by instruction i */
+	int vnCell(int i) const;
+
+	/** Returns true if the cell belongs to a variable of the symbol table */
+	bool isVarCell(int cell) const;
+
+	/** Appends to out the cells read when an address is used as an operand.
+	 *  Constants have no cell. */
+	void cellsOf(Address* a, vector<int>& out) const;
+
+	/** Appends to out the cells (always) written by an instruction */
+	void defs(TacInstr* instr, vector<int>& out) const;
+
+	/** Appends to out the cells read by an instruction */
+	void uses(TacInstr* instr, vector<int>& out) const;
+};
+
+/* *********************/
+/*  CONTROL FLOW GRAPH */
+/* *********************/
+
+/** A basic block: a maximal sequence of consecutive instructions [first, last]
+ *  which can only be entered at the first one and left at the last one.
+ */
+class BasicBlock {
+public:
+	int first;
+	int last;
+
+	vector<int> succs;
+	vector<int> preds;
+};
+
+/** A natural loop, identified by its header block and by the blocks it contains.
+ */
+class Loop {
+public:
+	int header;
+
+	/** inLoop[b] is true if block b belongs to the loop */
+	vector<bool> inLoop;
+
+	/** The blocks of the loop, in increasing order (i.e. in layout order) */
+	vector<int> blocks;
+
+	/** The sources of the back edges to the header */
+	vector<int> latches;
+
+	/** Nesting depth; outermost loops have depth 1 */
+	int depth;
+};
+
+/** The control flow graph of the code, together with dominator information.
+ *  It is a snapshot: any change to the code invalidates it.
+ */
+class FlowGraph {
+private:
+	TargetCode* code;
+
+	vector<BasicBlock> blocks;
+	vector<int> blockOf;
+
+	/* dom[b] holds the blocks dominating b */
+	vector<BitSet> dom;
+	vector<bool> reachable;
+
+	void computeDominators();
+
+public:
+	/** Constructor: splits the code in basic blocks and computes dominators */
+	FlowGraph(TargetCode* code);
+
+	/** Returns the number of basic blocks */
+	int numBlocks() const;
+
+	/** Returns basic block b */
+	const BasicBlock& getBlock(int b) const;
+
+	/** Returns the basic block containing instruction i */
+	int getBlockOf(int i) const;
+
+	/** Returns true if block d dominates block b */
+	bool dominates(int d, int b) const;
+
+	/** Returns true if block b can be reached from the entry of the code */
+	bool isReachable(int b) const;
+
+	/** Returns the natural loops of the code, innermost ones first.
+	 *  Back edges sharing the same header are merged into a single loop.
+	 */
+	vector<Loop> findLoops() const;
+};
+
+/** Live cells at the boundaries of each basic block.
+ *  Variables are considered live at HALT, as their final value is the output of the program.
+ */
+class Liveness {
+private:
+	vector<BitSet> liveIn;
+	vector<BitSet> liveOut;
+
+public:
+	/** Constructor: solves the (backward) dataflow problem on the given graph */
+	Liveness(TargetCode* code, const FlowGraph& fg, const CellMap& cells);
+
+	/** Returns true if the cell is live at the beginning of block b */
+	bool isLiveIn(int b, int cell) const;
+
+	/** Returns true if the cell is live at the end of block b */
+	bool isLiveOut(int b, int cell) const;
+
+	/** Returns the cells live at the end of block b */
+	const BitSet& getLiveOut(int b) const;
+};
+
+/** The types of the values flowing through the code.
+ *  Variables and constants carry their own type, while temporaries and valuenumbers are untyped:
+ *  their type is inferred from the instructions computing them. 8-byte temporaries always hold
+ *  fractions; a 4-byte temporary written with values of different types has no single type.
+ */
+class TypeMap {
+private:
+	TargetCode* code;
+
+	/* type of each valuenumber and of each 4-byte temporary; -1 if unknown, -2 if mixed */
+	vector<int> vnType;
+	map<TempAddress*, int> tempType;
+
+	int typeCode(Address* a) const;
+
+	/* merges type t into the type of temporary a; returns true if it changed */
+	bool record(Address* a, int t);
+
+public:
+	/** Constructor: infers the types of the temporaries and valuenumbers of the code */
+	TypeMap(TargetCode* code);
+
+	/** Returns true if the type of a is known, storing it into t */
+	bool typeOf(Address* a, typeName& t) const;
+
+	/** Returns true if a and b are surely of the same type */
+	bool sameType(Address* a, Address* b) const;
+};
+
+/* *********/
+/*  PASSES */
+/* *********/
+
+/** An abstract optimization pass over the 3-addr code.
+ */
+class Pass {
+public:
+	virtual ~Pass() {}
+
+	/** Returns the short name of the pass */
+	virtual const char* getName() const = 0;
+
+	/** Runs the pass over the code.
+	 *  Returns true if the code has been changed.
+	 */
+	virtual bool run(TargetCode* code) = 0;
+};
+
+/** Loop-invariant code motion.
+ *  Instructions of a "while" loop whose operands do not change inside the loop
+ *  (field loads, arithmetic, stores of invariant values into temporaries) are moved
+ *  to a pre-header, inserted right before the loop header, so that they are executed once.
+ *  All the loops of the code are analyzed together, innermost first: an instruction
+ *  invariant in several nested loops goes straight to the pre-header of the outermost one.
+ */
+class LoopInvariantCodeMotion: public Pass {
+private:
+	/* Marks in hoisted the instructions that can leave a single loop; returns how many they are.
+	 * The analyses are shared by all the loops of the same graph. */
+	int hoistable(TargetCode* code, const FlowGraph& fg, const CellMap& cells, const Liveness& live,
+			const Loop& loop, vector<bool>& hoisted);
+
+public:
+	const char* getName() const;
+
+	bool run(TargetCode* code);
+};
+
+/** Store-to-load forwarding.
+ *  A field stored with "t[k] = y" and read back with "x = t[k]" (as it happens when promoting
+ *  an int to a fraction) does not need the round-trip through memory: y is forwarded straight
+ *  to the instructions using x. Since variables and temporaries never alias, the analysis is
+ *  exact on (base, constant offset) pairs. Stores and loads left useless are then removed.
+ */
+class StoreToLoadForwarding: public Pass {
+public:
+	const char* getName() const;
+
+	bool run(TargetCode* code);
+};
+
+/** Scalar replacement of fraction aggregates.
+ *  A fraction temporary which is only accessed field by field (i.e. it does not escape as a
+ *  whole) is split into two int temporaries, one for the numerator and one for the denominator;
+ *  field loads and stores become plain copies. Optionally, fraction variables are split as well,
+ *  which in turn lets the temporaries copied into them be split.
+ *  The fields keep the memory locations of the original aggregate.
+ */
+class ScalarReplacement: public Pass {
+private:
+	bool splitVars;
+
+public:
+	/** Constructor: splitVars tells whether fraction variables should be split too */
+	ScalarReplacement(bool splitVars);
+
+	const char* getName() const;
+
+	bool run(TargetCode* code);
+};
+
+/** Global dead code and dead store elimination (mark and sweep).
+ *  Jumps, HALT, "read", "print" and "stat" are always needed, and so is an int division that may divide by zero,
+ *  since it stops the program; an instruction is needed if it defines something
+ *  read by a needed instruction. Since HALT reads all variables, a store to a variable is kept
+ *  only if it can reach a later read, or the end of the program.
+ *  Unreachable blocks are removed as well, and the code array is compacted.
+ */
+class DeadCodeElimination: public Pass {
+public:
+	const char* getName() const;
+
+	bool run(TargetCode* code);
+};
+
+/** Copy propagation and coalescing of temporaries.
+ *  After "x = y", the uses of x reached by that copy only (neither x nor y being redefined in
+ *  between) read y instead, provided x and y have the same type, so that the copy converts
+ *  nothing; the copies into temporaries and valuenumbers left useless are removed.
+ *  Then temporaries whose lifetimes do not overlap are coalesced into the same Memory slot,
+ *  preferring the ones related by a copy (which then becomes a no-op), and the temporaries
+ *  are laid out again in Memory.
+ */
+class CopyPropagation: public Pass {
+private:
+	/* Rewrites the uses of copies; returns the number of rewritten operands */
+	int propagate(TargetCode* code);
+
+	/* Merges non-interfering temporaries; returns the number of merged ones */
+	int coalesce(TargetCode* code, int& slots, int& saved);
+
+public:
+	const char* getName() const;
+
+	bool run(TargetCode* code);
+};
+
+/** Block layout driven by the "likely"/"unlikely" hints of the program.
+ *  The blocks of a branch hinted as rarely taken (its instructions are cold) are moved to the end
+ *  of the code, after HALT, keeping their order, so that the hot code runs straight through.
+ *  Where a block no longer falls through to its old successor, a conditional jump to the block
+ *  now following it is negated, so that the likely successor is the fall-through one; otherwise
+ *  a goto is added. Gotos left jumping to the next instruction are removed. Float <, <=, >, >=
+ *  are never negated, since "not <" is no relation once a NaN is involved.
+ */
+class BlockLayout: public Pass {
+public:
+	const char* getName() const;
+
+	bool run(TargetCode* code);
+};
+
+/* ***************/
+/*  PASS MANAGER */
+/* ***************/
+
+/** Runs a pipeline of passes over the code, in the order they were added.
+ *  In debug builds (i.e. unless NDEBUG is defined, as for assert) the code is verified before
+ *  the first pass and after each of them, and the compiler aborts as soon as a pass breaks it.
+ *  On request, a report with the time spent in each pass and its effect on the size of the
+ *  code and of Memory is printed on stderr.
+ */
+class PassManager {
+private:
+	vector<Pass*> passes;
+	bool timePasses;
+
+	// Stop the compiler from generating methods of copy the object
+	PassManager(PassManager const& copy);            // Not to be implemented
+	PassManager& operator=(PassManager const& copy); // Not to be implemented
+
+public:
+	/** Constructor: creates an empty pipeline */
+	PassManager();
+
+	/** Destructor: deletes the passes of the pipeline */
+	~PassManager();
+
+	/** Creates the pass with the given name, or returns NULL if there is no such pass */
+	static Pass* createPass(const string& name);
+
+	/** Returns the names of all the passes, comma separated, in pipeline order */
+	static string passNames();
+
+	/** Adds a pass at the end of the pipeline; the pass manager takes ownership of it */
+	void add(Pass* pass);
+
+	/** Adds the passes of an optimization level, in their standard order:
+	 *  - 0: no pass;
+	 *  - 1: the cheap, local cleanups (slf, dce, copyprop) and the layout of the hinted branches;
+	 *  - 2: all of them, except sroa-vars which changes the layout of the variables.
+	 *  The passes named in "enabled" are added as well, whatever the level.
+	 */
+	void addLevel(int level, const vector<string>& enabled);
+
+	/** Enables the per-pass timing report */
+	void setTimePasses(bool on);
+
+	/** Runs the pipeline; returns true if the code has been changed */
+	bool run(TargetCode* code);
+
+	/** Checks the invariants the passes rely on: every jump is patched to an existing
+	 *  instruction, valuenumbers refer to existing instructions, variables and temporaries lie
+	 *  within the allocated Memory, a jump table is followed by its gotos, there is a single
+	 *  HALT, and the code cannot run past its end (it ends with HALT, or with a goto once cold
+	 *  blocks have been moved after HALT).
+	 *  Returns an empty string if the code is well formed, or a description of the first problem.
+	 */
+	static string verify(TargetCode* code);
+};
+
+#endif //OPTIMIZER_HPP_
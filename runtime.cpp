@@ -0,0 +1,440 @@
+#include <iostream>
+
+#include <climits>
+#include <cmath>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace std;
+
+#include "runtime.hpp"
+
+int InputReader::fd = 0;
+char* InputReader::buffer = NULL;
+char* InputReader::pos = NULL;
+char* InputReader::end = NULL;
+bool InputReader::eof = false;
+long long InputReader::values = 0;
+long long InputReader::bytes = 0;
+
+int OutputWriter::fd = 1;
+char* OutputWriter::buffer = NULL;
+char* OutputWriter::pos = NULL;
+long long OutputWriter::values = 0;
+long long OutputWriter::bytes = 0;
+long long OutputWriter::writes = 0;
+
+/*********/
+/* INPUT */
+/*********/
+
+/* The powers of ten that are exact as doubles */
+static const double exactPow10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/* White space: ' ', '\t', '\n', '\v', '\f', '\r' (the NUL at the end of the data is not) */
+static bool isSpace(char c) {
+	return c == ' ' || (unsigned char)(c - '\t') < 5;
+}
+
+static bool isDigit(char c) {
+	return (unsigned char)(c - '0') < 10;
+}
+
+/* A float converted to int as cvttss2si does: truncated, and INT_MIN if it does not fit */
+static int truncate(float f) {
+	return f > -2147483904.0f && f < 2147483648.0f ? (int)f : INT_MIN;
+}
+
+/* Parses an int at p, wrapping around; returns false, leaving p alone, if there is none */
+static bool parseInt(const char*& p, int& value) {
+	const char* q = p;
+	bool negative = *q == '-';
+	if (*q == '-' || *q == '+') {
+		q++;
+	}
+	if (!isDigit(*q)) {
+		return false;
+	}
+
+	unsigned v = 0;
+	while (isDigit(*q)) {
+		v = v * 10 + (*q++ - '0');
+	}
+	value = negative ? (int)(0u - v) : (int)v;
+	p = q;
+	return true;
+}
+
+/* Returns true if the int just parsed goes on as a float */
+static bool floatFollows(const char* p) {
+	return *p == '.' || *p == 'e' || *p == 'E';
+}
+
+/* Parses a float at p, correctly rounded; returns false, leaving p alone, if there is none */
+bool InputReader::parseFloat(const char*& p, float& f) {
+	const char* q = p;
+	bool negative = *q == '-';
+	if (*q == '-' || *q == '+') {
+		q++;
+	}
+
+	/* the value is mantissa * 10^scale; leading zeros do not count as digits */
+	unsigned long long mantissa = 0;
+	int digits = 0;
+	int scale = 0;
+	bool any = false;
+	bool dropped = false;
+
+	while (*q == '0') {
+		q++;
+		any = true;
+	}
+	for (; isDigit(*q); q++) {
+		if (digits < 19) {
+			mantissa = mantissa * 10 + (*q - '0');
+			digits++;
+		} else {
+			scale++;
+			dropped = dropped || *q != '0';
+		}
+		any = true;
+	}
+	if (*q == '.') {
+		for (q++; isDigit(*q); q++) {
+			if (digits == 0 && *q == '0') {
+				scale--;
+			} else if (digits < 19) {
+				mantissa = mantissa * 10 + (*q - '0');
+				digits++;
+				scale--;
+			} else {
+				dropped = dropped || *q != '0';
+			}
+			any = true;
+		}
+	}
+	if (!any) {
+		return false;
+	}
+
+	if (*q == 'e' || *q == 'E') {
+		const char* e = q + 1;
+		bool negativeExp = *e == '-';
+		if (*e == '-' || *e == '+') {
+			e++;
+		}
+		if (isDigit(*e)) {
+			int exp = 0;
+			for (; isDigit(*e); e++) {
+				// anything that large overflows or underflows anyway
+				if (exp < 100000) {
+					exp = exp * 10 + (*e - '0');
+				}
+			}
+			scale += negativeExp ? -exp : exp;
+			q = e;
+		}
+	}
+
+	/* mantissa and 10^scale are exact doubles, so their product or quotient is correctly rounded;
+	 * rounding it again to float is correct unless it falls right between two floats */
+	bool done = false;
+	if (!dropped && mantissa <= (1ULL << 53) && scale >= -22 && scale <= 22) {
+		double d = scale >= 0 ? (double)mantissa * exactPow10[scale] : (double)mantissa / exactPow10[-scale];
+		unsigned long long bits;
+		memcpy(&bits, &d, sizeof(bits));
+		if ((bits & 0x1FFFFFFF) != 0x10000000) {
+			f = (float)(negative ? -d : d);
+			done = true;
+		}
+	}
+	if (!done) {
+		// strtof reads the same digits, as the word ends with white space or the NUL after the data
+		f = strtof(p, NULL);
+	}
+
+	p = q;
+	return true;
+}
+
+bool InputReader::open(const char* file) {
+	fd = ::open(file, O_RDONLY);
+	return fd >= 0;
+}
+
+/* Moves what is left in the buffer to its beginning, then reads until there are
+ * lookahead bytes past pos, the buffer is full or the input ends */
+void InputReader::refill() {
+	if (buffer == NULL) {
+		buffer = new char[bufferSize + 1];
+		pos = end = buffer;
+	}
+
+	size_t left = end - pos;
+	memmove(buffer, pos, left);
+	pos = buffer;
+	end = buffer + left;
+
+	while (!eof && end - pos < lookahead) {
+		ssize_t n = ::read(fd, end, buffer + bufferSize - end);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			// an error ends the input as well
+			eof = true;
+			break;
+		}
+		end += n;
+		bytes += n;
+	}
+	*end = 0;
+}
+
+/* Skips white space; returns the beginning of the next word, with lookahead bytes of it
+ * in the buffer unless the input ends first, or NULL at the end of the input */
+const char* InputReader::nextWord() {
+	if (buffer == NULL) {
+		refill();
+	}
+
+	for (;;) {
+		while (isSpace(*pos)) {
+			pos++;
+		}
+		if (pos == end) {
+			if (eof) {
+				return NULL;
+			}
+			refill();
+		} else if (*pos == 0) {
+			// a NUL in the input separates words too
+			pos++;
+		} else {
+			if (end - pos < lookahead && !eof) {
+				refill();
+			}
+			return pos;
+		}
+	}
+}
+
+/* Skips the rest of the word that goes on at p */
+void InputReader::skipWord(const char* p) {
+	pos = (char*)p;
+	for (;;) {
+		while (*pos != 0 && !isSpace(*pos)) {
+			pos++;
+		}
+		if (pos < end || eof) {
+			return;
+		}
+		refill();
+	}
+}
+
+void InputReader::readInt(int* cell) {
+	int v = 0;
+	const char* p = nextWord();
+
+	if (p != NULL) {
+		const char* start = p;
+		if (!parseInt(p, v) || floatFollows(p)) {
+			float f;
+			p = start;
+			v = parseFloat(p, f) ? truncate(f) : 0;
+		}
+		skipWord(p);
+	}
+
+	*cell = v;
+	values++;
+}
+
+void InputReader::readFloat(int* cell) {
+	float f = 0;
+	const char* p = nextWord();
+
+	if (p != NULL) {
+		// for a fraction, this is its numerator
+		if (!parseFloat(p, f)) {
+			f = 0;
+		}
+		skipWord(p);
+	}
+
+	memcpy(cell, &f, sizeof(f));
+	values++;
+}
+
+void InputReader::readFraction(int* cell) {
+	int num = 0, denom = 1;
+	const char* p = nextWord();
+
+	if (p != NULL) {
+		const char* start = p;
+		if (!parseInt(p, num) || floatFollows(p)) {
+			float f;
+			p = start;
+			num = parseFloat(p, f) ? truncate(f) : 0;
+		} else if (*p == '|') {
+			const char* q = p + 1;
+			if (parseInt(q, denom)) {
+				p = q;
+			}
+		}
+		skipWord(p);
+	}
+
+	// the sign goes to the numerator, which the comparisons rely on
+	if (denom < 0) {
+		num = (int)(0u - num);
+		denom = (int)(0u - denom);
+	} else if (denom == 0) {
+		num = 0;
+		denom = 1;
+	}
+
+	cell[0] = num;
+	cell[1] = denom;
+	values++;
+}
+
+long long InputReader::valuesRead() {
+	return values;
+}
+
+void InputReader::printReport(ostream& out) {
+	out << "input: " << values << " values read, " << bytes << " bytes" << endl;
+}
+
+/**********/
+/* OUTPUT */
+/**********/
+
+/* "00", "01", ..., "99" */
+static const char digitPairs[] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+/* Writes the decimal digits of v at p; returns the position after them */
+static char* writeDigits(char* p, unsigned long long v) {
+	char digits[20];
+	char* d = digits + sizeof(digits);
+
+	while (v >= 100) {
+		int k = 2 * (v % 100);
+		v /= 100;
+		*--d = digitPairs[k + 1];
+		*--d = digitPairs[k];
+	}
+	if (v >= 10) {
+		*--d = digitPairs[2 * v + 1];
+		*--d = digitPairs[2 * v];
+	} else {
+		*--d = '0' + v;
+	}
+
+	size_t n = digits + sizeof(digits) - d;
+	memcpy(p, d, n);
+	return p + n;
+}
+
+/* Writes an int at p; returns the position after it */
+static char* writeInt(char* p, int value) {
+	unsigned v = value;
+	if (value < 0) {
+		*p++ = '-';
+		v = 0u - v;
+	}
+	return writeDigits(p, v);
+}
+
+bool OutputWriter::open(const char* file) {
+	fd = ::open(file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	return fd >= 0;
+}
+
+/* Returns where the next value goes, with room for the longest one */
+char* OutputWriter::reserve() {
+	if (buffer == NULL) {
+		buffer = new char[bufferSize];
+		pos = buffer;
+	}
+	if (buffer + bufferSize - pos < longestValue) {
+		flush();
+	}
+	values++;
+	return pos;
+}
+
+void OutputWriter::printInt(int value) {
+	char* p = writeInt(reserve(), value);
+	*p++ = '\n';
+	pos = p;
+}
+
+void OutputWriter::printFloat(float value) {
+	char* p = reserve();
+
+	/* value * 100 is exact as a double: rounding it to an integer (to even, on a tie)
+	 * is what printf does with two decimals */
+	double scaled = fabs((double)value) * 100;
+	if (scaled < 1e18) {
+		unsigned long long v = (unsigned long long)rint(scaled);
+		if (signbit(value)) {
+			*p++ = '-';
+		}
+		p = writeDigits(p, v / 100);
+		*p++ = '.';
+		*p++ = digitPairs[2 * (v % 100)];
+		*p++ = digitPairs[2 * (v % 100) + 1];
+		*p++ = '\n';
+	} else {
+		// huge, infinite or NaN
+		p += snprintf(p, longestValue, "%2.2f\n", value);
+	}
+	pos = p;
+}
+
+void OutputWriter::printFraction(int num, int denom) {
+	char* p = writeInt(reserve(), num);
+	*p++ = '|';
+	p = writeInt(p, denom);
+	*p++ = '\n';
+	pos = p;
+}
+
+void OutputWriter::flush() {
+	const char* p = buffer;
+	while (p < pos) {
+		ssize_t n = ::write(fd, p, pos - p);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			// nowhere to write: the output is lost, as it would be with stdio
+			break;
+		}
+		p += n;
+		bytes += n;
+		writes++;
+	}
+	pos = buffer;
+}
+
+long long OutputWriter::valuesPrinted() {
+	return values;
+}
+
+void OutputWriter::printReport(ostream& out) {
+	out << "output: " << values << " values printed, " << bytes << " bytes in " << writes << " writes" << endl;
+}
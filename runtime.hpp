@@ -0,0 +1,130 @@
+#ifndef RUNTIME_HPP_
+#define RUNTIME_HPP_
+
+/**
+* @file runtime.hpp
+* @brief This header file contains the runtime support of the programs run
+* by tinycomp: the input of the "read" statement (see --input) and the output
+* of the "print" statement (see --output).
+*
+* The input is a sequence of words separated by white space, each giving a
+* value: an int ("42", "-7"), a float ("2.5", "-1e-3", ".5") or a fraction
+* ("3|4"). "read x" takes the next word and stores its value in x, converted
+* to the type of x as the copy "x = value" would be (see native.hpp): a
+* float becomes an int by truncation, a fraction used as a scalar yields its
+* numerator, and a scalar becomes the fraction v|1. A fraction keeps its sign
+* in the numerator ("3|-4" is read as -3|4), and one with a zero denominator
+* is no value. Ints wrap around as the machine does. Whatever follows the
+* value in the word is ignored; a word with no value at all, and the end of
+* the input, give 0.
+*
+* The input is read with read(2) into a large buffer and parsed in place,
+* without going through stdio. Numbers are parsed by hand: ints and
+* fractions digit by digit, floats by scaling the decimal mantissa with an
+* exact power of ten when the result is sure to be correctly rounded (up to
+* 19 significant digits and 10^22, which is what nearly all inputs look
+* like), and with strtof otherwise.
+*
+* "print e" writes the value of e on a line of its own, in the type of e, as
+* the final values of the variables are printed: "42", "2.50" (two decimals,
+* rounded as printf does), "3|4". The text is formatted by hand into a large
+* buffer, which is written out with write(2) only when it is nearly full and
+* at the end of the run: a program printing in a loop makes a system call
+* every megabyte, not every value.
+*
+* The entry points are static functions taking the cell of the variable or
+* the value to print, so that the native code can call them directly.
+*/
+
+#include <iostream>
+
+using namespace std;
+
+/** The buffered reader of the input of the programs.
+ */
+class InputReader {
+private:
+	static const int bufferSize = 1 << 20;
+
+	/* a word is parsed only once this many bytes of it are in the buffer (or the input ends):
+	 * a longer value is parsed from its first lookahead bytes */
+	static const int lookahead = 4096;
+
+	static int fd;
+	static char* buffer;
+	static char* pos;
+	static char* end;	// the end of the data in the buffer, where a NUL is stored
+	static bool eof;
+
+	static long long values;
+	static long long bytes;
+
+	static void refill();
+	static const char* nextWord();
+	static void skipWord(const char* p);
+
+	static bool parseFloat(const char*& p, float& f);
+
+public:
+	/** Takes the input from a file instead of stdin; returns false if it cannot be opened */
+	static bool open(const char* file);
+
+	/** Reads the next value into an int variable */
+	static void readInt(int* cell);
+
+	/** Reads the next value into a float variable */
+	static void readFloat(int* cell);
+
+	/** Reads the next value into a fraction variable (two cells: numerator, denominator) */
+	static void readFraction(int* cell);
+
+	/** Returns the number of values read so far */
+	static long long valuesRead();
+
+	/** Prints the number of values and bytes read */
+	static void printReport(ostream& out);
+};
+
+/** The buffered writer of the output of the programs.
+ */
+class OutputWriter {
+private:
+	static const int bufferSize = 1 << 20;
+
+	/* the longest text of a value: the buffer is written out when less than this is left */
+	static const int longestValue = 64;
+
+	static int fd;
+	static char* buffer;
+	static char* pos;
+
+	static long long values;
+	static long long bytes;
+	static long long writes;
+
+	static char* reserve();
+
+public:
+	/** Sends the output to a file instead of stdout; returns false if it cannot be created */
+	static bool open(const char* file);
+
+	/** Prints an int */
+	static void printInt(int value);
+
+	/** Prints a float */
+	static void printFloat(float value);
+
+	/** Prints a fraction */
+	static void printFraction(int num, int denom);
+
+	/** Writes out what is in the buffer */
+	static void flush();
+
+	/** Returns the number of values printed so far */
+	static long long valuesPrinted();
+
+	/** Prints the number of values and bytes printed, and of the writes it took */
+	static void printReport(ostream& out);
+};
+
+#endif //RUNTIME_HPP_
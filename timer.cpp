@@ -0,0 +1,302 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+#include "timer.hpp"
+
+Phase::Phase(const char* name, Phase* parent) {
+	this->name = name;
+	this->parent = parent;
+	ticks = 0;
+	calls = 0;
+	for (int c = 0; c < numCounters; c++) {
+		counters[c] = 0;
+	}
+}
+
+bool PhaseTimer::enabled = false;
+bool PhaseTimer::counting = false;
+int PhaseTimer::counterGroup = -1;
+int PhaseTimer::counterIndex[numCounters];
+string PhaseTimer::counterError;
+unsigned long long PhaseTimer::startCounters[numCounters];
+Phase PhaseTimer::root("total", NULL);
+Phase* PhaseTimer::current = &PhaseTimer::root;
+unsigned long long PhaseTimer::startTicks = 0;
+double PhaseTimer::startMillis = 0;
+
+/* Returns the steady clock, in milliseconds */
+static double steadyMillis() {
+	return chrono::duration<double, milli>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Returns the peak resident set size of the process so far, in KB (0 if unknown) */
+static long peakRssKb() {
+	struct rusage usage;
+	return getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : 0;
+}
+
+/* The names of the counters, in the reports */
+static const char* counterNames[numCounters] = {
+	"cycles",
+	"instructions",
+	"branch_misses",
+	"l1d_misses",
+	"llc_misses"
+};
+
+bool PhaseTimer::enableCounters() {
+#ifdef __linux__
+	static const unsigned int types[numCounters] = {
+		PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE
+	};
+	static const unsigned long long configs[numCounters] = {
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_BRANCH_MISSES,
+		PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+		PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+	};
+
+	// a counter the CPU lacks is left out, but the group needs its leader: the cycles
+	int opened = 0;
+	for (int c = 0; c < numCounters; c++) {
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = types[c];
+		attr.config = configs[c];
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		int fd = syscall(SYS_perf_event_open, &attr, 0, -1, counterGroup, 0);
+		if (fd < 0) {
+			counterIndex[c] = -1;
+			if (c == cyclesCounter) {
+				counterError = string("perf_event_open: ") + strerror(errno);
+				if (errno == EACCES || errno == EPERM) {
+					counterError += " (see /proc/sys/kernel/perf_event_paranoid)";
+				}
+				return false;
+			}
+			continue;
+		}
+		if (counterGroup < 0) {
+			counterGroup = fd;
+		}
+		counterIndex[c] = opened++;
+	}
+
+	counting = true;
+	return true;
+#else
+	counterError = "hardware counters are only read on Linux";
+	return false;
+#endif
+}
+
+void PhaseTimer::readCounters(unsigned long long* values) {
+	// nr, time enabled, time running, then the counters of the group
+	unsigned long long buffer[3 + numCounters];
+	if (read(counterGroup, buffer, sizeof(buffer)) < (ssize_t)(3 * sizeof(unsigned long long))) {
+		buffer[2] = 0;
+	}
+
+	for (int c = 0; c < numCounters; c++) {
+		if (counterIndex[c] < 0 || buffer[2] == 0) {
+			values[c] = 0;
+		} else {
+			// scaled, should the group have been multiplexed with other events
+			values[c] = (unsigned long long)((double)buffer[3 + counterIndex[c]] * buffer[1] / buffer[2]);
+		}
+	}
+}
+
+void PhaseTimer::enable() {
+	enabled = true;
+	if (counting) {
+		readCounters(startCounters);
+	}
+	startMillis = steadyMillis();
+	startTicks = now();
+}
+
+double PhaseTimer::millisPerTick() {
+	unsigned long long ticks = now() - startTicks;
+	double millis = steadyMillis() - startMillis;
+	return ticks == 0 ? 0 : millis / ticks;
+}
+
+Phase* PhaseTimer::enter(const char* name) {
+	Phase* p = NULL;
+	for (size_t c = 0; c < current->children.size() && p == NULL; c++) {
+		if (strcmp(current->children[c]->name, name) == 0) {
+			p = current->children[c];
+		}
+	}
+	if (p == NULL) {
+		p = new Phase(name, current);
+		current->children.push_back(p);
+	}
+
+	current = p;
+	return p;
+}
+
+void PhaseTimer::leave(Phase* p, unsigned long long ticks, const unsigned long long* entryCounters) {
+	p->ticks += ticks;
+	p->calls++;
+	current = p->parent;
+
+	if (entryCounters != NULL) {
+		unsigned long long values[numCounters];
+		readCounters(values);
+		for (int c = 0; c < numCounters; c++) {
+			p->counters[c] += values[c] - entryCounters[c];
+		}
+	}
+}
+
+void PhaseTimer::stopRoot() {
+	root.ticks = now() - startTicks;
+	root.calls = 1;
+
+	if (counting) {
+		unsigned long long values[numCounters];
+		readCounters(values);
+		for (int c = 0; c < numCounters; c++) {
+			root.counters[c] = values[c] - startCounters[c];
+		}
+	}
+}
+
+void PhaseTimer::printNode(ostream& out, const Phase* p, int depth, double scale, double total) {
+	double millis = p->ticks * scale;
+	double self = millis;
+	for (size_t c = 0; c < p->children.size(); c++) {
+		self -= p->children[c]->ticks * scale;
+	}
+
+	string name = string(2 * depth, ' ') + p->name;
+	out << left << setw(28) << name << right << fixed << setprecision(3) << setw(12) << millis
+		<< setw(12) << self << setprecision(1) << setw(8) << (total > 0 ? 100 * millis / total : 0)
+		<< setw(10) << p->calls << endl;
+
+	for (size_t c = 0; c < p->children.size(); c++) {
+		printNode(out, p->children[c], depth + 1, scale, total);
+	}
+}
+
+/* Prints the events per 1000 instructions, or "-" if the counter was not read */
+static void printPerKilo(ostream& out, bool counted, unsigned long long events, unsigned long long instructions) {
+	if (!counted || instructions == 0) {
+		out << setw(13) << "-";
+	} else {
+		out << fixed << setprecision(2) << setw(13) << 1000.0 * events / instructions;
+	}
+}
+
+void PhaseTimer::printCounters(ostream& out, const Phase* p, int depth) {
+	const unsigned long long* n = p->counters;
+
+	string name = string(2 * depth, ' ') + p->name;
+	out << left << setw(28) << name << right << setw(14) << n[cyclesCounter];
+	if (counterIndex[instructionsCounter] < 0) {
+		out << setw(14) << "-" << setw(7) << "-";
+	} else {
+		out << setw(14) << n[instructionsCounter] << fixed << setprecision(2) << setw(7)
+			<< (n[cyclesCounter] > 0 ? (double)n[instructionsCounter] / n[cyclesCounter] : 0);
+	}
+	printPerKilo(out, counterIndex[branchMissesCounter] >= 0, n[branchMissesCounter], n[instructionsCounter]);
+	printPerKilo(out, counterIndex[l1dMissesCounter] >= 0, n[l1dMissesCounter], n[instructionsCounter]);
+	printPerKilo(out, counterIndex[llcMissesCounter] >= 0, n[llcMissesCounter], n[instructionsCounter]);
+	out << endl;
+
+	for (size_t c = 0; c < p->children.size(); c++) {
+		printCounters(out, p->children[c], depth + 1);
+	}
+}
+
+void PhaseTimer::printJson(ostream& out, const Phase* p, int depth, double scale) {
+	double millis = p->ticks * scale;
+	double self = millis;
+	for (size_t c = 0; c < p->children.size(); c++) {
+		self -= p->children[c]->ticks * scale;
+	}
+
+	string indent(2 * depth, ' ');
+	out << indent << "{\"name\": \"" << p->name << "\", \"ms\": " << fixed << setprecision(6) << millis
+		<< ", \"self_ms\": " << self << ", \"calls\": " << p->calls;
+	if (p == &root) {
+		out << ", \"peak_rss_kb\": " << peakRssKb();
+		if (!counterError.empty()) {
+			out << ", \"counters_error\": \"" << counterError << "\"";
+		}
+	}
+	if (counting) {
+		out << ", \"counters\": {";
+		const char* separator = "";
+		for (int c = 0; c < numCounters; c++) {
+			if (counterIndex[c] >= 0) {
+				out << separator << "\"" << counterNames[c] << "\": " << p->counters[c];
+				separator = ", ";
+			}
+		}
+		out << "}";
+	}
+	out << ", \"children\": [";
+
+	if (!p->children.empty()) {
+		out << endl;
+		for (size_t c = 0; c < p->children.size(); c++) {
+			printJson(out, p->children[c], depth + 1, scale);
+			out << (c + 1 < p->children.size() ? "," : "") << endl;
+		}
+		out << indent;
+	}
+	out << "]}";
+}
+
+void PhaseTimer::printReport(ostream& out) {
+	double scale = millisPerTick();
+	stopRoot();
+
+	out << "===== Compile phase timing report =====" << endl;
+	out << left << setw(28) << "phase" << right << setw(12) << "time (ms)" << setw(12) << "self (ms)"
+		<< setw(8) << "%" << setw(10) << "calls" << endl;
+	printNode(out, &root, 0, scale, root.ticks * scale);
+
+	if (counting) {
+		out << endl << "===== Hardware counters (user space) =====" << endl;
+		out << left << setw(28) << "phase" << right << setw(14) << "cycles" << setw(14) << "instructions"
+			<< setw(7) << "IPC" << setw(13) << "br-miss/ki" << setw(13) << "L1d-miss/ki" << setw(13) << "LLC-miss/ki"
+			<< endl;
+		printCounters(out, &root, 0);
+	} else if (!counterError.empty()) {
+		out << "hardware counters unavailable: " << counterError << endl;
+	}
+	out << "peak RSS: " << peakRssKb() << " KB" << endl;
+}
+
+void PhaseTimer::printJsonReport(ostream& out) {
+	double scale = millisPerTick();
+	stopRoot();
+
+	printJson(out, &root, 0, scale);
+	out << endl;
+}
@@ -0,0 +1,198 @@
+#ifndef TIMER_HPP_
+#define TIMER_HPP_
+
+/**
+* @file timer.hpp
+* @brief This header file contains the compile phase timers of tinycomp
+* (see --time-report).
+*
+* A phase is timed by a TimeScope object, which lives as long as the phase:
+* @code
+*   {
+*     TimeScope t("printout");
+*     ...
+*   }
+* @endcode
+* Phases nest as the scopes do, so that each phase is counted within the one
+* that encloses it, e.g. "lex" and "backpatch" within "parse". The same phase
+* may be entered many times (e.g. "lex", once per token): its time and
+* number of calls add up.
+*
+* Unless the report has been requested, a scope costs a test of a flag. When
+* it has, it reads the time stamp counter on entry and on exit (steady_clock
+* where there is no such counter), and the counts are turned into time
+* against steady_clock when the report is printed.
+*
+* With --counters, a scope also reads the hardware performance counters of
+* the process (cycles, instructions, branch misses, L1d and LLC read misses,
+* user space only) through perf_event_open, as one group, so that the report
+* can tell the IPC and the misses per 1000 instructions of each phase. A read
+* is a system call, which costs far more than the time stamp counter: the time
+* of small, frequent phases such as "lex" grows accordingly, but not their
+* counts. When the counters cannot be opened (no PMU, as in most virtual
+* machines, or a restrictive perf_event_paranoid) the report says why, and
+* is otherwise the same.
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+using namespace std;
+
+/** The hardware counters read by the phases, see PhaseTimer::enableCounters */
+enum Counter {
+	cyclesCounter,
+	instructionsCounter,
+	branchMissesCounter,
+	l1dMissesCounter,
+	llcMissesCounter,
+	numCounters
+};
+
+/** A node of the tree of the phases: its time is the sum of the ticks of all its calls,
+ *  and the same goes for its counters.
+ */
+class Phase {
+public:
+	const char* name;
+	Phase* parent;
+	vector<Phase*> children;
+
+	unsigned long long ticks;
+	long calls;
+	unsigned long long counters[numCounters];
+
+	/** Constructor: creates a phase never entered so far */
+	Phase(const char* name, Phase* parent);
+};
+
+/** The tree of the phases, and the report on their time.
+ */
+class PhaseTimer {
+private:
+	static bool enabled;
+	static bool counting;
+
+	/* the counter group: the file descriptor of its leader, the position of each
+	 * counter within the group (-1 if it could not be opened), and why not */
+	static int counterGroup;
+	static int counterIndex[numCounters];
+	static string counterError;
+	static unsigned long long startCounters[numCounters];
+
+	/* the whole compilation, and the innermost phase currently entered */
+	static Phase root;
+	static Phase* current;
+
+	/* the clocks when timing started, to convert ticks into time */
+	static unsigned long long startTicks;
+	static double startMillis;
+
+	/* Returns the number of milliseconds in a tick */
+	static double millisPerTick();
+
+	/* Sets the time and the counters of the whole compilation, up to now */
+	static void stopRoot();
+
+	static void printNode(ostream& out, const Phase* p, int depth, double scale, double total);
+	static void printCounters(ostream& out, const Phase* p, int depth);
+	static void printJson(ostream& out, const Phase* p, int depth, double scale);
+
+public:
+	/** Starts timing: scopes are only timed from now on */
+	static void enable();
+
+	/** Opens the hardware counters, before enable(); returns false if none can be
+	 *  counted, and the report then tells why */
+	static bool enableCounters();
+
+	/** Returns true if scopes are timed */
+	static bool isEnabled() {
+		return enabled;
+	}
+
+	/** Returns true if scopes read the hardware counters */
+	static bool isCounting() {
+		return counting;
+	}
+
+	/** Reads the current values of the hardware counters (0 for those not counted) */
+	static void readCounters(unsigned long long* values);
+
+	/** Returns the current value of the clock, in ticks */
+	static unsigned long long now() {
+#if defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		return chrono::duration_cast<chrono::nanoseconds>(
+				chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	/** Enters a phase, within the current one; returns the phase */
+	static Phase* enter(const char* name);
+
+	/** Leaves a phase, entered "ticks" ticks ago; its counters grow by their current
+	 *  values minus the given ones, read on entry (none if NULL) */
+	static void leave(Phase* p, unsigned long long ticks, const unsigned long long* entryCounters);
+
+	/** Prints the report: one line per phase, indented within its parent,
+	 *  with its total time, the time not spent in any of its children, its
+	 *  share of the whole compilation and its number of calls; then the
+	 *  counters of each phase, if read; then the peak memory of the process.
+	 */
+	static void printReport(ostream& out);
+
+	/** Prints the report as JSON: each phase is an object with "name", "ms",
+	 *  "self_ms", "calls", "counters" (if read: an object with "cycles",
+	 *  "instructions", "branch_misses", "l1d_misses" and "llc_misses", for those
+	 *  counted) and "children" (an array of phases); the root is the whole
+	 *  compilation, and also has "peak_rss_kb", and "counters_error" if the
+	 *  counters were requested and could not be read.
+	 */
+	static void printJsonReport(ostream& out);
+};
+
+/** Times a phase, from its construction to its destruction.
+ */
+class TimeScope {
+private:
+	Phase* phase;
+	unsigned long long start;
+	unsigned long long startCounters[numCounters];
+
+	// Stop the compiler from generating methods of copy the object
+	TimeScope(TimeScope const& copy);            // Not to be implemented
+	TimeScope& operator=(TimeScope const& copy); // Not to be implemented
+
+public:
+	/** Constructor: enters the phase with the given name, which must outlive the report */
+	TimeScope(const char* name) {
+		if (PhaseTimer::isEnabled()) {
+			phase = PhaseTimer::enter(name);
+			if (PhaseTimer::isCounting()) {
+				PhaseTimer::readCounters(startCounters);
+			}
+			start = PhaseTimer::now();
+		} else {
+			phase = NULL;
+		}
+	}
+
+	/** Destructor: leaves the phase */
+	~TimeScope() {
+		if (phase != NULL) {
+			unsigned long long ticks = PhaseTimer::now() - start;
+			PhaseTimer::leave(phase, ticks, PhaseTimer::isCounting() ? startCounters : NULL);
+		}
+	}
+};
+
+#endif //TIMER_HPP_
@@ -1,6 +1,9 @@
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
 #include <list>
+#include <map>
+#include <vector>
 
 #include <cstring>
 #include <stdio.h>
@@ -11,6 +14,7 @@
 using namespace std;
 
 #include "tinycomp.hpp"
+#include "timer.hpp"
 
 const char* opTable[] = {
 	"UNKNOWN",
@@ -24,6 +28,14 @@ const char* opTable[] = {
 	"goto",
 	"if==goto",
 	"if=goto",
+	"if!=goto",
+	"if<goto",
+	"if<=goto",
+	"if>goto",
+	"if>=goto",
+	"goto table",
+	"read",
+	"print",
 	"stat"
 };
 
@@ -56,6 +68,21 @@ typeName ConstAddress::getType() {
 	return type;
 }
 
+int ConstAddress::getIntVal() {
+	assert(type == intType);
+	return val.i;
+}
+
+float ConstAddress::getFloatVal() {
+	assert(type == floatType);
+	return val.f;
+}
+
+fraction ConstAddress::getFractionVal() {
+	assert(type == fractionType);
+	return val.frac;
+}
+
 
 const char* ConstAddress::toString() const {
 	char* str = (char*)malloc(10*sizeof(char));
@@ -97,6 +124,19 @@ VarAddress::VarAddress(char v, typeName t, int o) {
 	}
 
 	offset = o;
+
+	parent = NULL;
+	fields[0] = fields[1] = NULL;
+}
+
+VarAddress* VarAddress::getField(int o) {
+	assert(type == fractionType && (o == 0 || o == 4));
+
+	if (fields[o / 4] == NULL) {
+		fields[o / 4] = new VarAddress(lexeme, intType, offset + o);
+		fields[o / 4]->parent = this;
+	}
+	return fields[o / 4];
 }
 
 /** Returns the variable's type (as a typeName enum)
@@ -118,21 +158,34 @@ int VarAddress::getOffset() {
 }
 
 const char* VarAddress::toString() const {
-	char* str = (char*)malloc(2*sizeof(char));
+	char* str = (char*)malloc(8*sizeof(char));
 	str[0] = lexeme;
 	str[1] = '\0';
 
+	if (parent != NULL) {
+		strcat(str, offset == parent->offset ? ".num" : ".den");
+	}
+
 	return str;
 }
 
 
 /** Constructor: creates a temporary at the specified offset in memory
 	 */
-TempAddress::TempAddress(int offset) {
+TempAddress::TempAddress(int offset, int width) {
     // update the counter after using the old value as the "name" of this temporary
 	name = counter++;
 
 	this->offset = offset;
+	this->width = width;
+}
+
+TempAddress::TempAddress(int offset, int width, int name) {
+	this->name = name;
+	counter = max(counter, name + 1);
+
+	this->offset = offset;
+	this->width = width;
 }
 
 /** Returns the pointer to the memory location holding the temporary
@@ -141,12 +194,22 @@ int TempAddress::getOffset() {
 	return offset;
 }
 
+/** Returns the number of bytes reserved in memory for the temporary
+ */
+int TempAddress::getWidth() {
+	return width;
+}
+
+int TempAddress::getName() const {
+	return name;
+}
+
 /** Concrete method for printing a TempAddress;
  *  it's a concrete implementation of the corresponding abstract method in Address
  */
 const char* TempAddress::toString() const {
-	char* str = (char*)malloc(5*sizeof(char));;
-	sprintf(str, "t%d", name);
+	char* str = (char*)malloc(12*sizeof(char));
+	snprintf(str, 12, "t%d", name);
 
 	return str;
 }
@@ -159,10 +222,14 @@ InstrAddress::InstrAddress(int vn) {
 	arrayCodeIndex = vn;
 }
 
+int InstrAddress::getIndex() const {
+	return arrayCodeIndex;
+}
+
 const char* InstrAddress::toString() const {
-	char* str = (char*)malloc(10*sizeof(char));
+	char* str = (char*)malloc(14*sizeof(char));
 
-	snprintf(str, 10, "(%d)", arrayCodeIndex);
+	snprintf(str, 14, "(%d)", arrayCodeIndex);
 
 	return str;
 }
@@ -174,10 +241,26 @@ const char* InstrAddress::toString() const {
 /* Memory
  */
 Memory::Memory() {
-	storage = (unsigned char*)malloc(MEMSIZE * sizeof(unsigned char*) );
+	capacity = MEMSIZE * sizeof(unsigned char*);
+	storage = (unsigned char*)calloc(capacity, sizeof(unsigned char));
 	offset = 0;
 }
 
+void Memory::reserve(int bytes) {
+	if (bytes <= capacity) {
+		return;
+	}
+
+	int newCapacity = capacity;
+	while (newCapacity < bytes) {
+		newCapacity *= 2;
+	}
+
+	storage = (unsigned char*)realloc(storage, newCapacity);
+	memset(storage + capacity, 0, newCapacity - capacity);
+	capacity = newCapacity;
+}
+
 Memory& Memory::getInstance() {
 		// The only instance
 		// Guaranteed to be lazy initialized
@@ -189,6 +272,7 @@ Memory& Memory::getInstance() {
 int Memory::store(void* val, int width) {
 		/* offset tells us where free memory begins
 		 */
+		reserve(offset + width);
 		unsigned char* begin = storage + offset;
 
 		memcpy(begin, val, width);
@@ -204,10 +288,12 @@ void* Memory::retrieve(int offset) {
 }
 
 TempAddress* Memory::getNewTemp(int width) {
+	reserve(offset + width);
+
 	int oldoffset = offset;
 	offset += width;
 
-	TempAddress* temp = new TempAddress(oldoffset);
+	TempAddress* temp = new TempAddress(oldoffset, width);
 
 	/* keep track of temp for future printout */
 	temporaries.push_back(temp);
@@ -216,13 +302,82 @@ TempAddress* Memory::getNewTemp(int width) {
 	return temp;
 }
 
+int Memory::getUsed() {
+	return offset;
+}
+
+int Memory::getDumpSize() {
+	int size = (offset + 15) / 16 * 16;
+	if (size < MEMSIZE)
+		size = MEMSIZE;
+	reserve(size);
+	return size;
+}
+
+void Memory::reallocTemps(const vector<TempAddress*>& temps) {
+	/* temporaries begin where the first one was allocated */
+	for (list<TempAddress*>::iterator it = temporaries.begin(); it != temporaries.end(); ++it) {
+		offset = min(offset, (*it)->getOffset());
+	}
+
+	temporaries.clear();
+	tempwidths.clear();
+
+	for (size_t i = 0; i < temps.size(); i++) {
+		temps[i]->offset = offset;
+		offset += temps[i]->getWidth();
+
+		temporaries.push_back(temps[i]);
+		tempwidths.push_back(temps[i]->getWidth());
+	}
+}
+
+const list<TempAddress*>& Memory::getTemps() {
+	return temporaries;
+}
+
+TempAddress* Memory::restoreTemp(int o, int width, int name, bool listed) {
+	reserve(o + width);
+	offset = max(offset, o + width);
+
+	TempAddress* temp = new TempAddress(o, width, name);
+
+	if (listed) {
+		temporaries.push_back(temp);
+		tempwidths.push_back(width);
+	}
+
+	return temp;
+}
+
+void Memory::restore(const void* image, int size) {
+	reserve(size);
+	memcpy(storage, image, size);
+	if (size < offset) {
+		memset(storage + size, 0, offset - size);
+	}
+	offset = size;
+}
+
+TempAddress* Memory::getFieldTemp(TempAddress* t, int o) {
+	TempAddress* temp = new TempAddress(t->getOffset() + o, 4);
+
+	/* keep track of temp for future printout */
+	temporaries.push_back(temp);
+	tempwidths.push_back(4);
+
+	return temp;
+}
+
 void Memory::hexdump() {
+	int size = getDumpSize();
+
 	unsigned char *pc = storage;
 
 	unsigned char buff[17];
 
 	// Process every byte in the data.
-	for (int i = 0; i < MEMSIZE; i++) {
+	for (int i = 0; i < size; i++) {
 			// Multiple of 16 means new line (with line offset).
 
 			if ((i % 16) == 0) {
@@ -251,11 +406,8 @@ void Memory::hexdump() {
  * Very dirty implementation. It's only included for debugging purposes.
  */
 void Memory::printOut(SymTbl* tbl) {
-		Address* storedAddresses[Memory::MEMSIZE];
-
-		for (int i = 0; i < Memory::MEMSIZE; i++) {
-			storedAddresses[i] = NULL;
-		}
+		int size = getDumpSize();
+		vector<Address*> storedAddresses(size, (Address*)NULL);
 
 		// re-map all addresses
 		for (char c = 'a'; c <= 'z'; c++) {
@@ -284,7 +436,7 @@ void Memory::printOut(SymTbl* tbl) {
 		}
 
 
-		for (int i = 0; i < Memory::MEMSIZE; i++) {
+		for (int i = 0; i < size; i++) {
 				// Multiple of 16 means new line (with line offset).
 				if ((i % 16) == 0) {
 						// Just don't print ASCII for the zeroth line.
@@ -309,7 +461,14 @@ void Memory::printOut(SymTbl* tbl) {
 
 TacInstr* TargetCode::gen(TacInstr* instr) {
 	instr->setValueNumber(nextInstr);
-	codeArray[nextInstr] = instr;
+
+	if (current.firstLine > 0 && instr->location < 0) {
+		if (lineTable.empty() || !(lineTable.back() == current)) {
+			lineTable.push_back(current);
+		}
+		instr->location = lineTable.size() - 1;
+	}
+	codeArray.push_back(instr);
 
 	nextInstr++;
 
@@ -326,10 +485,12 @@ TacInstr* TargetCode::gen(oprEnum op, Address* operand1, Address* operand2, Addr
 
 TargetCode::TargetCode() {
 	nextInstr = 0;
+	lastTarget = -1;
+	setLocation(0, 0, 0, 0);
 }
 
 TacInstr* TargetCode::getInstr(int i) {
-	return codeArray[i];
+	return i < nextInstr ? codeArray[i] : NULL;
 }
 
 int TargetCode::getNextInstr() {
@@ -337,20 +498,165 @@ int TargetCode::getNextInstr() {
 }
 
 void TargetCode::backpatch(list<TacInstr*> l, TacInstr* i) {
+	TimeScope t("backpatch");
+
 	list<TacInstr*>::iterator it;
 	 for (it = l.begin(); it != l.end(); ++it) {
 	 	(*it)->patch(i);
 	 }
+	if (!l.empty()) {
+		lastTarget = max(lastTarget, i->getValueNumber()->getIndex());
+	}
 
 	return;
 }
 
+bool TargetCode::removeLast() {
+	if (nextInstr == 0 || lastTarget >= nextInstr - 1) {
+		return false;
+	}
+
+	// the index is reused by the next instruction generated
+	codeArray.pop_back();
+	nextInstr--;
+	return true;
+}
+
+void TargetCode::relayout(const vector<TacInstr*>& instrs) {
+	map<TacInstr*, bool> kept;
+	map<InstrAddress*, TacInstr*> owner;
+
+	for (int i = 0; i < nextInstr; i++) {
+		owner[codeArray[i]->getValueNumber()] = codeArray[i];
+	}
+	vector<bool> created(instrs.size(), false);
+	for (size_t i = 0; i < instrs.size(); i++) {
+		// newly created instructions get a valuenumber here; the actual index is set below
+		if (instrs[i]->valueNumber == NULL) {
+			instrs[i]->setValueNumber(-1);
+			created[i] = true;
+		}
+		owner[instrs[i]->valueNumber] = instrs[i];
+		kept[instrs[i]] = true;
+	}
+
+	/* First pass: resolve every reference to an instruction, while the old numbering still holds.
+	 * References end up pointing to the (shared) valuenumber of their target, so that
+	 * renumbering the valuenumbers is enough to keep them up to date.
+	 */
+	for (size_t i = 0; i < instrs.size(); i++) {
+		TacInstr* instr = instrs[i];
+
+		if (instr->destInstr != NULL) {
+			TacInstr* target = owner.count(instr->destInstr) ? owner[instr->destInstr] : NULL;
+			int d = (target != NULL && target->valueNumber->getIndex() >= 0)
+					? target->valueNumber->getIndex() : instr->destInstr->getIndex();
+
+			if (target == NULL || !kept.count(target)) {
+				// the destination is gone: fall through to the next surviving instruction
+				while (d < nextInstr && !kept.count(codeArray[d])) {
+					d++;
+				}
+				assert(d < nextInstr);
+				target = codeArray[d];
+			}
+			instr->destInstr = target->valueNumber;
+		}
+
+		Address** ops[2] = { &instr->operand1, &instr->operand2 };
+		for (int k = 0; k < 2; k++) {
+			InstrAddress* ia = dynamic_cast<InstrAddress*>(*ops[k]);
+			if (ia != NULL) {
+				TacInstr* target = owner.count(ia) ? owner[ia] : codeArray[ia->getIndex()];
+				// a valuenumber must not outlive the instruction computing it
+				assert(kept.count(target));
+				*ops[k] = target->valueNumber;
+			}
+		}
+	}
+
+	/* Second pass: lay out the new code */
+	for (size_t i = 0; i < instrs.size(); i++) {
+		instrs[i]->valueNumber->arrayCodeIndex = i;
+
+		// e.g. the second half of a copy split in two
+		if (instrs[i]->location < 0 && i > 0) {
+			instrs[i]->location = instrs[i - 1]->location;
+		}
+	}
+	for (size_t i = instrs.size(); i-- > 0; ) {
+		if (created[i] && i + 1 < instrs.size()) {
+			instrs[i]->cold = instrs[i + 1]->cold;
+		}
+	}
+	codeArray = instrs;
+	nextInstr = instrs.size();
+
+	// what was backpatched may have moved
+	lastTarget = -1;
+	for (int i = 0; i < nextInstr; i++) {
+		if (codeArray[i]->destInstr != NULL) {
+			lastTarget = max(lastTarget, codeArray[i]->destInstr->getIndex());
+		}
+	}
+}
+
+void TargetCode::rotate(int first, int middle) {
+	/* references by index to the instructions about to move must follow them: make them point
+	 * to the (shared) valuenumber of their target, like relayout() does */
+	for (int i = first; i < nextInstr; i++) {
+		TacInstr* instr = codeArray[i];
+
+		int d = instr->destInstr != NULL ? instr->destInstr->getIndex() : -1;
+		if (d >= first && d < nextInstr) {
+			instr->destInstr = codeArray[d]->valueNumber;
+		}
+
+		Address** ops[2] = { &instr->operand1, &instr->operand2 };
+		for (int k = 0; k < 2; k++) {
+			InstrAddress* ia = dynamic_cast<InstrAddress*>(*ops[k]);
+			if (ia != NULL && ia->getIndex() >= first && ia->getIndex() < nextInstr) {
+				*ops[k] = codeArray[ia->getIndex()]->valueNumber;
+			}
+		}
+	}
+
+	std::rotate(codeArray.begin() + first, codeArray.begin() + middle, codeArray.begin() + nextInstr);
+
+	// the targets before first have not moved, and the ones after it may have
+	lastTarget = min(lastTarget, first - 1);
+	for (int i = first; i < nextInstr; i++) {
+		codeArray[i]->valueNumber->arrayCodeIndex = i;
+	}
+	for (int i = first; i < nextInstr; i++) {
+		if (codeArray[i]->destInstr != NULL) {
+			lastTarget = max(lastTarget, codeArray[i]->destInstr->getIndex());
+		}
+	}
+}
+
 void TargetCode::printOut() {
-	for (int i=0; i< 999 && codeArray[i] != NULL; i++) {
+	for (int i=0; i < nextInstr; i++) {
 		cout << codeArray[i] << "\n";
 	}
 }
 
+void TargetCode::setLocation(int firstLine, int firstColumn, int lastLine, int lastColumn) {
+	current.firstLine = firstLine;
+	current.firstColumn = firstColumn;
+	current.lastLine = lastLine;
+	current.lastColumn = lastColumn;
+}
+
+const SourceRange& TargetCode::getRange(int location) const {
+	return lineTable[location];
+}
+
+bool SourceRange::operator==(const SourceRange& other) const {
+	return firstLine == other.firstLine && firstColumn == other.firstColumn
+		&& lastLine == other.lastLine && lastColumn == other.lastColumn;
+}
+
 /* An abstraction for the Symbol Table
  */
 // class SymTbl {
@@ -430,6 +736,29 @@ void SimpleArraySymTbl::put(char lexeme, typeName type) {
 	sym[index] = a;
 }
 
+void SimpleArraySymTbl::printValues() {
+	for (int i = 0; i < 26; ++i)
+	{
+		if (sym[i] != NULL) {
+			void* val = mem.retrieve(sym[i]->getOffset());
+
+			switch (sym[i]->getType()) {
+				case intType:
+					printf("%s = %d\n", sym[i]->toString(), *(int*)val);
+					break;
+				case floatType:
+					printf("%s = %2.2f\n", sym[i]->toString(), *(float*)val);
+					break;
+				case fractionType:
+					printf("%s = %d|%d\n", sym[i]->toString(), ((fraction*)val)->num, ((fraction*)val)->denom);
+					break;
+				default:
+					break;
+			}
+		}
+	}
+}
+
 void SimpleArraySymTbl::printOut() {
 	for (int i = 0; i < 26; ++i)
 	{
@@ -468,10 +797,18 @@ TacInstr::TacInstr(oprEnum op, Address* operand1, Address* operand2, Address* op
 	this->op = op;
 	this->operand1 = operand1;
 	this->operand2 = operand2;
+	this->location = -1;
+	this->cold = false;
 
 	switch (op) {
 		case jmpOpr:
 		case eq1condJmpOpr:
+		case neCondJmpOpr:
+		case ltCondJmpOpr:
+		case leCondJmpOpr:
+		case gtCondJmpOpr:
+		case geCondJmpOpr:
+		case jmpTableOpr:
 			this->temp = NULL;
 			this->destInstr = (InstrAddress*)operand3;
 			break;
@@ -492,13 +829,92 @@ InstrAddress* TacInstr::getValueNumber() {
 	return valueNumber;
 }
 
+Address* TacInstr::getOperand1() const {
+	return operand1;
+}
+
+Address* TacInstr::getOperand2() const {
+	return operand2;
+}
+
+TempAddress* TacInstr::getTemp() const {
+	return temp;
+}
+
+InstrAddress* TacInstr::getDestInstr() const {
+	return destInstr;
+}
+
+void TacInstr::setOp(oprEnum op) {
+	this->op = op;
+}
+
+void TacInstr::setOperand1(Address* a) {
+	operand1 = a;
+}
+
+void TacInstr::setOperand2(Address* a) {
+	operand2 = a;
+}
+
+void TacInstr::setTemp(TempAddress* t) {
+	temp = t;
+}
+
+bool TacInstr::isJump() const {
+	return op == jmpOpr || op == jmpTableOpr || isCondJump();
+}
+
+bool TacInstr::isCondJump() const {
+	return op == eq1condJmpOpr || op == eq2condJmpOpr || op == neCondJmpOpr
+			|| op == ltCondJmpOpr || op == leCondJmpOpr || op == gtCondJmpOpr || op == geCondJmpOpr;
+}
+
+int TacInstr::tableSize() const {
+	ConstAddress* n = dynamic_cast<ConstAddress*>(operand2);
+	return op == jmpTableOpr && n != NULL ? n->getIntVal() : 0;
+}
+
+const char* TacInstr::relationOf(oprEnum op) {
+	switch (op) {
+		case neCondJmpOpr:
+			return "!=";
+		case ltCondJmpOpr:
+			return "<";
+		case leCondJmpOpr:
+			return "<=";
+		case gtCondJmpOpr:
+			return ">";
+		case geCondJmpOpr:
+			return ">=";
+		default:
+			return "==";
+	}
+}
+
 // for backpathcing "goto"-like instructions
 void TacInstr::patch(TacInstr* i) {
-	assert(this->getOp() == jmpOpr  || this->getOp() == eq1condJmpOpr || this->getOp() == eq2condJmpOpr);
+	assert(this->isJump());
 
 	this->destInstr = i->getValueNumber();
 }
 
+bool TacInstr::isCold() const {
+	return cold;
+}
+
+void TacInstr::setCold(bool cold) {
+	this->cold = cold;
+}
+
+int TacInstr::getLocation() const {
+	return location;
+}
+
+void TacInstr::setLocation(int location) {
+	this->location = location;
+}
+
 
 /*******************************/
 /* ATTRIBUTES FOR NONTERMINALS */
@@ -546,14 +962,14 @@ typeName ExprAttr::getType() {
 */
 void BoolAttr::addTrue(TacInstr* instr) {
 	// check: must be a goto
-	assert(instr->getOp() == jmpOpr  || instr->getOp() == eq1condJmpOpr || instr->getOp() == eq2condJmpOpr);
+	assert(instr->isJump());
 
 	truelist.push_back(instr);
 }
 
 void BoolAttr::addFalse(TacInstr* instr) {
 	// check: must be a goto
-	assert(instr->getOp() == jmpOpr || instr->getOp() == eq1condJmpOpr || instr->getOp() == eq2condJmpOpr) ;
+	assert(instr->isJump());
 
 	falselist.push_back(instr);
 }
@@ -568,6 +984,14 @@ void BoolAttr::addFalse(list<TacInstr*> l) {
 	falselist.merge(l);
 }
 
+void BoolAttr::removeTrue(TacInstr* instr) {
+	truelist.remove(instr);
+}
+
+void BoolAttr::removeFalse(TacInstr* instr) {
+	falselist.remove(instr);
+}
+
 list<TacInstr*> BoolAttr::getTruelist() {
 	return truelist;
 }
@@ -586,10 +1010,36 @@ void StmtAttr::addNext(list<TacInstr*> l) {
 	nextlist.merge(l);
 }
 
+void StmtAttr::removeNext(TacInstr* instr) {
+	nextlist.remove(instr);
+}
+
 list<TacInstr*> StmtAttr::getNextlist() {
 	return nextlist;
 }
 
+/* SwitchAttr
+*/
+bool SwitchAttr::addCase(int value, int start) {
+	return cases.insert(make_pair(value, start)).second;
+}
+
+bool SwitchAttr::setDefault(int start) {
+	if (defaultStart >= 0) {
+		return false;
+	}
+	defaultStart = start;
+	return true;
+}
+
+const map<int, int>& SwitchAttr::getCases() const {
+	return cases;
+}
+
+int SwitchAttr::getDefault() const {
+	return defaultStart;
+}
+
 
 /********************/
 /* PRINTOUT METHODS */
@@ -638,8 +1088,24 @@ std::ostream& operator<<(std::ostream &out, const TacInstr *instr) {
 			assert(instr->operand1 != NULL && instr->operand2 != NULL && instr->destInstr != NULL);
 			return out << setw(4) << instr->valueNumber << ": " << "if " << instr->operand1 << " == " << instr->operand2 << " goto " << instr->destInstr;
 			break;
+		case neCondJmpOpr: /* the "if op1 != op2 goto instr" operator, and so on */
+		case ltCondJmpOpr:
+		case leCondJmpOpr:
+		case gtCondJmpOpr:
+		case geCondJmpOpr:
+			assert(instr->operand1 != NULL && instr->operand2 != NULL && instr->destInstr != NULL);
+			return out << setw(4) << instr->valueNumber << ": " << "if " << instr->operand1 << " " << TacInstr::relationOf(instr->op)
+					<< " " << instr->operand2 << " goto " << instr->destInstr;
+		case jmpTableOpr: /* the "goto table[op1] of op2 else instr" operator */
+			assert(instr->operand1 != NULL && instr->operand2 != NULL && instr->destInstr != NULL);
+			return out << setw(4) << instr->valueNumber << ": " << opTable[instr->op] << "[" << instr->operand1 << "] of "
+					<< instr->operand2 << " else " << instr->destInstr;
 		case haltOpr:
 			return out << setw(4) << instr->valueNumber << ": " << opTable[instr->op];
+		case readOpr: /* the "read x" operator */
+		case printOpr: /* the "print e" operator */
+			assert(instr->operand1 != NULL);
+			return out << setw(4) << instr->valueNumber << ": " << opTable[instr->op] << " " << instr->operand1;
 		case mulOpr: /* TBD */
 			return out << setw(4) << instr->valueNumber << ": " << instr->temp << " = " << instr->operand1 << " " << opTable[instr->op] << " " << instr->operand2;
 		case UNKNOWNOpr: /* TBD */
@@ -41,6 +41,14 @@ typedef enum {
 	jmpOpr, 	/*!< unconditional jump; the goto operator */
 	eq1condJmpOpr, /*!< == operator*/
 	eq2condJmpOpr, /*!< = operator*/
+	neCondJmpOpr,	/*!< != operator*/
+	ltCondJmpOpr,	/*!< < operator*/
+	leCondJmpOpr,	/*!< <= operator*/
+	gtCondJmpOpr,	/*!< > operator*/
+	geCondJmpOpr,	/*!< >= operator*/
+	jmpTableOpr,	/*!< jump table: goto the target of the op1-th of the op2 gotos that follow, or to the destination if op1 is out of range */
+	readOpr,	/*!< the input statement "read x": x = the next value of the input */
+	printOpr,	/*!< the output statement "print e": writes the value of e */
 	fakeOpr		/*!< a temporary "fake" operator for simulating the ones yet-to-be implemented */
 } oprEnum;
 
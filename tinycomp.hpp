@@ -13,6 +13,8 @@
 
 #include <iostream>
 #include <list>
+#include <map>
+#include <vector>
 #include "tinycomp.h"
 
 using namespace std;
@@ -64,6 +66,15 @@ public:
 	 */
 	typeName getType();
 
+	/** Returns the value of an int constant */
+	int getIntVal();
+
+	/** Returns the value of a float constant */
+	float getFloatVal();
+
+	/** Returns the value of a fraction constant */
+	fraction getFractionVal();
+
 	/** Concrete method for printing a ConstAddress;
 	 *  it's a concrete implementation of the corresponding abstract method in Address
 	 */
@@ -82,11 +93,21 @@ private:
 	/* pointer to the memory, where the var value is stored */
 	int offset;
 
+	/* for the fields of a fraction variable: the parent variable, and the two fields */
+	VarAddress* parent;
+	VarAddress* fields[2];
+
 public:
 	/** Constructor: creates a variable address from its id (assuming only 1-char id's).
 	 */
 	VarAddress(char v, typeName t, int offset);
 
+	/** Returns one of the two int fields of a fraction variable, as a variable on its own:
+	 *  offset 0 is the numerator, offset 4 the denominator.
+	 *  Fields share the memory of the fraction, and are always returned as the same object.
+	 */
+	VarAddress* getField(int offset);
+
 	/** Returns the variable's type (as a typeName enum)
 	 */
 	typeName getType();
@@ -116,17 +137,31 @@ private:
 	int name;
 
 	int offset;
+	int width;
 
 	friend Memory;
 
 	/** Constructor: creates a temporary at the specified offset in memory
 	 */
-	TempAddress(int offset);
+	TempAddress(int offset, int width);
+
+	/** Constructor: creates a temporary with a given name, e.g. 3 for t3;
+	 *  the names of later temporaries follow it
+	 */
+	TempAddress(int offset, int width, int name);
 public:
 	/** Returns the pointer to the memory location holding the temporary
 	 */
 	int getOffset();
 
+	/** Returns the number of bytes reserved in memory for the temporary
+	 */
+	int getWidth();
+
+	/** Returns the number in the name of the temporary, e.g. 3 for t3
+	 */
+	int getName() const;
+
 	/** Concrete method for printing a TempAddress;
 	 *  it's a concrete implementation of the corresponding abstract method in Address
 	 */
@@ -141,12 +176,18 @@ private:
 
 	friend std::ostream& operator<<(std::ostream &, const InstrAddress *);
 
+	/* the code array may be re-laid out by the optimizer, which renumbers instructions */
+	friend class TargetCode;
+
 public:
 	/** Constructor to initialize an InstrAddress from an index of the array code.
 	 *  @param vn The index of the TargetCode array, representing a valuenumber.
 	 */
 	InstrAddress(int vn);
 
+	/** Returns the index of the TargetCode array this address refers to */
+	int getIndex() const;
+
 	const char* toString() const;
 };
 
@@ -169,6 +210,12 @@ private:
 	TempAddress* temp;
 	InstrAddress* destInstr;
 
+	/* the source range the instruction comes from: an index into the line table of TargetCode */
+	int location;
+
+	/* the instruction belongs to a branch hinted as rarely taken */
+	bool cold;
+
 	void setValueNumber(int vn);
 	friend class TargetCode;
 
@@ -189,8 +236,60 @@ public:
 	/** Returns the InstrAddress representing the value number */
 	InstrAddress* getValueNumber();
 
+	/** Returns the first operand (may be NULL) */
+	Address* getOperand1() const;
+
+	/** Returns the second operand (may be NULL) */
+	Address* getOperand2() const;
+
+	/** Returns the temporary holding the result, for operators that need one (may be NULL) */
+	TempAddress* getTemp() const;
+
+	/** Returns the destination of a "goto"-like instruction (NULL for any other operator) */
+	InstrAddress* getDestInstr() const;
+
+	/** Replaces the operator; used by the optimizer when rewriting instructions.
+	 *  The operands must be adjusted accordingly by the caller. */
+	void setOp(oprEnum op);
+
+	/** Replaces the first operand; used by the optimizer when rewriting instructions */
+	void setOperand1(Address* a);
+
+	/** Replaces the second operand; used by the optimizer when rewriting instructions */
+	void setOperand2(Address* a);
+
+	/** Replaces the temporary holding the result */
+	void setTemp(TempAddress* t);
+
+	/** Returns true for "goto"-like instructions (i.e. those with a destination to be patched) */
+	bool isJump() const;
+
+	/** Returns true for conditional "goto"-like instructions, which may also fall through */
+	bool isCondJump() const;
+
+	/** Returns the number of gotos following a jump table, i.e. its constant second operand
+	 *  (0 for any other operator) */
+	int tableSize() const;
+
+	/** Returns the relation tested by a conditional "goto" operator, as printed ("==", "<", ...) */
+	static const char* relationOf(oprEnum op);
+
 	/** For backpathcing "goto"-like instructions */
 	void patch(TacInstr*);
+
+	/** Returns the source range of the instruction, as an index into the line table
+	 *  of TargetCode (-1 if unknown) */
+	int getLocation() const;
+
+	/** Sets the source range of the instruction */
+	void setLocation(int location);
+
+	/** Returns true if the instruction is on a path hinted as rarely executed, e.g. the "else"
+	 *  of an "if likely": the layout pass moves it out of the way of the hot code */
+	bool isCold() const;
+
+	/** Marks the instruction as (not) rarely executed */
+	void setCold(bool cold);
 };
 
 /* ***************************/
@@ -209,6 +308,12 @@ private:
 	/* the pointer to the next block of free memory */
 	int offset;
 
+	/* the number of bytes actually allocated for storage */
+	int capacity;
+
+	/* Grows the storage, if needed, so that it holds at least the given number of bytes */
+	void reserve(int bytes);
+
 	/* Convenience variables to keep track of temporaries
 	   and their 'width', in order to print them out */
 	list<TempAddress*> temporaries;
@@ -224,7 +329,7 @@ private:
 public:
 	/** The size of our memory in bytes.
 	 *  It's set to a very small value to keep visualization of the
-	 *  memory dump clean. Increase as needed.
+	 *  memory dump clean. Memory grows as needed beyond it.
 	 */
 	static const int MEMSIZE = 128;
 
@@ -256,6 +361,40 @@ public:
    */
   TempAddress* getNewTemp(int width);
 
+  /** Returns a new temporary for a 4-byte field of an existing temporary.
+   *  No memory is allocated: the new temporary shares the location of the field.
+   */
+  TempAddress* getFieldTemp(TempAddress* temp, int offset);
+
+  /** Returns the number of bytes allocated so far, to variables and temporaries alike.
+   */
+  int getUsed();
+
+  /** Returns the number of bytes shown by the memory dumps:
+   *  MEMSIZE, or all the memory in use (in whole lines of 16 bytes) if it is larger.
+   */
+  int getDumpSize();
+
+  /** Lays out again the given temporaries, one after the other, right after the variables;
+   *  the memory of all other temporaries is released.
+   *  Since declarations come first, temporaries are always allocated after the variables.
+   */
+  void reallocTemps(const vector<TempAddress*>& temps);
+
+  /** Returns the temporaries shown by printOut(), in the order they were allocated.
+   */
+  const list<TempAddress*>& getTemps();
+
+  /** Re-creates a temporary of a program compiled earlier, at its location and with its name
+   *  (see ir.hpp); the temporary is shown by printOut() only if listed is true.
+   */
+  TempAddress* restoreTemp(int offset, int width, int name, bool listed);
+
+  /** Replaces the memory in use with the image of a program compiled earlier,
+   *  i.e. the getUsed() bytes starting at retrieve(0).
+   */
+  void restore(const void* image, int size);
+
 	 /** Prints out a dump of the memory.
 	  *  It prints the content of each memory location in hex format.
 		*  Not very useful for you, since the memory will be filled only
@@ -268,21 +407,44 @@ public:
 };
 
 
+/** A range of the source program, from (firstLine, firstColumn) to (lastLine, lastColumn);
+ *  lines and columns start from 1.
+ */
+class SourceRange {
+public:
+	int firstLine;
+	int firstColumn;
+	int lastLine;
+	int lastColumn;
+
+	bool operator==(const SourceRange& other) const;
+};
+
 /** A simplified abstraction for representing our target code.
  *  Following the textbook, I'm using 3-addr code instructions
- *  and storing them in an actual array.
+ *  and storing them in an actual array, which grows as needed.
+ *  A line table maps the instructions back to the source: each instruction
+ *  records the index of its range in the table, where consecutive instructions
+ *  coming from the same range share the same entry.
  */
 class TargetCode {
 private:
-	TacInstr* codeArray[1000];
+	vector<TacInstr*> codeArray;
 	int nextInstr;
 
+	/* the highest instruction a list has been backpatched to (-1 if none) */
+	int lastTarget;
+
+	/* the line table, and the range given to the instructions generated from now on */
+	vector<SourceRange> lineTable;
+	SourceRange current;
+
 	TacInstr* gen(TacInstr* instr);
 public:
 	/** Basic constructor; it will initialize the internal array of TacInstr instructions */
 	TargetCode();
 
-	/** Returns the instruction stored at index i in the code array */
+	/** Returns the instruction stored at index i in the code array (NULL past the end of the code) */
 	TacInstr* getInstr(int i);
 
 	/** Implementation of "nextinstr" from the textbook */
@@ -307,8 +469,41 @@ public:
 	 */
 	void backpatch(list<TacInstr*> gotolist, TacInstr* instr);
 
+	/** Removes the last instruction generated: a "goto" made useless by the code which is
+	 *  going to follow it. Nothing is removed, and false returned, if some list has been
+	 *  backpatched to that instruction.
+	 */
+	bool removeLast();
+
+	/** Replaces the content of the code array with the given sequence of instructions.
+	 *  This is what the optimizer uses to insert, move or delete instructions: jump
+	 *  destinations and valuenumbers used as operands are first resolved against the current
+	 *  code array, and then renumbered to follow their instruction in the new layout.
+	 *  A jump to an instruction that is no longer in the sequence is redirected to the first
+	 *  surviving instruction that followed it in the old layout. A newly created instruction
+	 *  with no source range gets the range of the instruction before it, and is cold if the
+	 *  instruction after it is (e.g. the pre-header of a loop in a cold branch). Any
+	 *  instruction that is the destination of a jump is protected from removeLast().
+	 *  @param instrs the new code; it may contain both existing and newly created instructions
+	 */
+	void relayout(const vector<TacInstr*>& instrs);
+
+	/** Moves the instructions from index middle on in front of those from index first on,
+	 *  as a switch does with the dispatch generated after its cases. Unlike relayout(), only
+	 *  the instructions from first on are looked at and renumbered, which keeps generating
+	 *  code linear: none of the instructions before first may jump to the moved ones.
+	 */
+	void rotate(int first, int middle);
+
 	/** A convenience method to print out the entire code array */
 	void printOut();
+
+	/** Sets the source range of the instructions generated from now on;
+	 *  a range with firstLine 0 means an unknown location */
+	void setLocation(int firstLine, int firstColumn, int lastLine, int lastColumn);
+
+	/** Returns the source range at the given index of the line table (see TacInstr::getLocation) */
+	const SourceRange& getRange(int location) const;
 };
 
 /** An abstraction for the Symbol Table
@@ -374,6 +569,9 @@ public:
 	/** Prints out the symbl table */
 	void printOut();
 
+	/** Prints out the current value of each variable, as found in memory */
+	void printValues();
+
 	/** Prints out a logical view of the memory */
 	void printMemory();
 };
@@ -462,6 +660,12 @@ public:
 	 */
 	void addFalse(list<TacInstr*> l);
 
+	/** Removes an instruction from the truelist */
+	void removeTrue(TacInstr* instr);
+
+	/** Removes an instruction from the falselist */
+	void removeFalse(TacInstr* instr);
+
 	/** Returns the truelist. */
 	list<TacInstr*> getTruelist();
 
@@ -487,8 +691,36 @@ public:
      */
 	void addNext(list<TacInstr*> l);
 
+	/** Removes an instruction from the nextlist */
+	void removeNext(TacInstr* instr);
+
 	/** Returns the nextlist. */
 	list<TacInstr*> getNextlist();
 };
 
+/** Implementation of attribute for grammar symbol cases: the cases of a switch statement.
+ * - the value of each case, with the index of the first instruction of its statement list
+ * - the index of the first instruction of the default case (-1 if there is none)
+ * - S.nextlist, of the statement lists and of the gotos ending them
+ */
+class SwitchAttr: public StmtAttr {
+private:
+	map<int, int> cases;
+	int defaultStart;
+public:
+	SwitchAttr() : defaultStart(-1) {}
+
+	/** Adds a case; returns false if there already is one with the same value */
+	bool addCase(int value, int start);
+
+	/** Sets the default case; returns false if there already is one */
+	bool setDefault(int start);
+
+	/** Returns the first instruction of each case, by value */
+	const map<int, int>& getCases() const;
+
+	/** Returns the first instruction of the default case, or -1 */
+	int getDefault() const;
+};
+
 #endif //TINYCOMP_H_
@@ -1,6 +1,12 @@
 %{
 #include <iostream>
 #include <iomanip>
+#include <fstream>
+#include <algorithm>
+#include <set>
+#include <sstream>
+#include <string>
+#include <chrono>
 using namespace std;
 
 #include <stdio.h>
@@ -11,12 +17,45 @@ using namespace std;
 
 #include "tinycomp.h"
 #include "tinycomp.hpp"
+#include "optimizer.hpp"
+#include "native.hpp"
+#include "interpreter.hpp"
+#include "batch.hpp"
+#include "jitdump.hpp"
+#include "elf.hpp"
+#include "ir.hpp"
+#include "assembler.hpp"
+#include "runtime.hpp"
+#include "timer.hpp"
 
 /* Prototypes - for lex */
 int yylex(void);
+
+/* The scanner, timed as a phase of its own (see --time-report) */
+static int timedLex() {
+	TimeScope t("lex");
+	return yylex();
+}
+#define yylex timedLex
+extern FILE* yyin;
 void yyerror(const char *s);
 
 void printout();
+void optimize();
+void runNative();
+void runInterpreter();
+void runTiered();
+void runBatch();
+void writeObject();
+void writeIr();
+void finish(bool stmts);
+bool usesRuntime();
+BoolAttr* relation(oprEnum op, Attribute* e1, Attribute* e2);
+void fallThrough(Attribute* cond, bool onTrue);
+void markCold(int from, int to);
+StmtAttr* switchStmt(Attribute* e, int first, Attribute* c);
+void printTimeReport();
+FILE* keepSource(FILE* in);
 
 /* Mapping of types to their names */
 const char* typestrs[] = {
@@ -32,8 +71,68 @@ Memory& mem = Memory::getInstance();
 SimpleArraySymTbl *sym = new SimpleArraySymTbl();
 TargetCode *code = new TargetCode();
 
+/* The conditional jumps comparing floats with <, <=, > or >=, which cannot be negated */
+set<TacInstr*> floatOrderings;
+
+/* Command line options */
+int optLevel = 0;					/* -O0, -O1, -O2 */
+vector<string> optEnabled;			/* passes enabled one by one, e.g. --licm */
+const char* optPasses = NULL;		/* --passes=a,b,c: the exact pipeline, overriding the above */
+bool timePasses = false;			/* --time-passes: per-pass timing report */
+bool optNative = false;				/* --native: run the program, compiled to x86-64 */
+bool optRegAlloc = true;			/* --no-regalloc: keep all values in memory when running natively */
+bool optISel = true;				/* --no-isel: generate native instructions one by one, without trees */
+bool optPerfMap = false;			/* --perf-map: write the symbols of the native code to /tmp/perf-<pid>.map */
+bool optJitDump = false;			/* --jitdump: write them, with their code and lines, as a jitdump for perf */
+bool optInterpret = false;			/* --interpret: run the program with the 3-addr code interpreter */
+bool optProfile = false;			/* --profile: the same, counting executions and cycles per instruction */
+bool optTiered = false;				/* --tiered: interpret, then go on natively from the first hot loop */
+int osrThreshold = 10000;			/* --osr-threshold=<n>: the iterations making a loop hot */
+const char* batchFile = NULL;		/* --batch <file>: run the program once per line of the file, in SIMD lanes */
+bool optSimd = true;				/* --no-simd: run the batch with plain loops instead of the AVX2 kernels */
+bool optObject = false;				/* -c: write a relocatable object instead of printing the code */
+string objectFile;					/* -o <file>: the object written by -c */
+const char* irFile = NULL;			/* --emit-ir <file>: save the optimized program in binary form */
+const char* loadFile = NULL;		/* --load <file>: take the program from a file saved by --emit-ir */
+const char* tacFile = NULL;			/* --tac <file>: take the program from a 3-address code listing */
+const char* inputFile = NULL;		/* --input <file>: the input of "read"; stdin if none */
+const char* outputFile = NULL;		/* --output <file>: the output of "print"; stdout if none */
+bool timeReport = false;			/* --time-report: time spent in each phase of the compiler */
+bool timeReportJson = false;		/* --time-report=json: the same, as JSON */
+bool timeCounters = false;			/* --counters: add the hardware counters of each phase to the report */
+
+/* Set by the parser once the whole program has been parsed; the program has no statements
+ * if it consists of declarations only */
+bool parsed = false;
+bool noStmts = false;
+
+/* The source of the program, kept by --profile for its source-annotated view */
+string source;
+
+/* The name of the source file, for the line table of --jitdump */
+string sourceName = "<stdin>";
+
+/* The default computation of the location of a rule (@$), which also makes it the source
+ * range of the instructions generated by the rule's action: see TargetCode::setLocation */
+#define YYLLOC_DEFAULT(Current, Rhs, N) \
+	do { \
+		if (N) { \
+			(Current).first_line = YYRHSLOC(Rhs, 1).first_line; \
+			(Current).first_column = YYRHSLOC(Rhs, 1).first_column; \
+			(Current).last_line = YYRHSLOC(Rhs, N).last_line; \
+			(Current).last_column = YYRHSLOC(Rhs, N).last_column; \
+		} else { \
+			(Current).first_line = (Current).last_line = YYRHSLOC(Rhs, 0).last_line; \
+			(Current).first_column = (Current).last_column = YYRHSLOC(Rhs, 0).last_column; \
+		} \
+		code->setLocation((Current).first_line, (Current).first_column, \
+			(Current).last_line, (Current).last_column); \
+	} while (0)
+
 %}
 
+%locations
+
 /* This is the union that defines the type for var yylval,
  * which corresponds to 'lexval' in our textboox parlance.
  */
@@ -57,10 +156,12 @@ TargetCode *code = new TargetCode();
 
 %token TRUE FALSE
 
-%token WHILE IF PRINT THEN
+%token WHILE IF PRINT THEN READ LIKELY UNLIKELY SWITCH CASE DEFAULT
 %nonassoc ELSE
 
-%left OR AND
+%left OR
+%left AND
+%right '!'
 
 %left GE LE EQ NE '>' '<' 
 %left '+' '-'
@@ -71,24 +172,28 @@ TargetCode *code = new TargetCode();
 %type <attrs>stmt
 %type <attrs>stmt_list
 %type <attrs>cond
+%type <attrs>if_cond
+%type <attrs>jump
+%type <attrs>cases
+%type <inhAttr>hint
+%type <inhAttr>mark
 
 %%
 prog:	decls stmt_list 		{
-									// add the final 'halt' instruction
+									// add the final 'halt' instruction, at the end of the program
+									code->setLocation(@$.last_line, @$.last_column, @$.last_line, @$.last_column);
 									TacInstr *i = code->gen(haltOpr, NULL, NULL);
 									code->backpatch(((StmtAttr *)$2)->getNextlist(), i);
 
-									// print out the output IR, as well as some other info
-									// useful for debugging
-									printout();
+									// the program is optimized and printed once the parser is done: see main
+									parsed = true;
 								}
 		| decls { //This is a rule for if the program contains only declarations, as in test-fraction1
 									// add the final 'halt' instruction
-									TacInstr *i = code->gen(haltOpr, NULL, NULL);
+									code->gen(haltOpr, NULL, NULL);
 
-									// print out the output IR, as well as some other info
-									// useful for debugging
-									printout();
+									parsed = true;
+									noStmts = true;
 								}
 	;
 
@@ -100,9 +205,11 @@ decl: TYPE id_list ';'
 	;
 
 id_list:	id_list ',' ID 	{
+														TimeScope t("decl");
 														sym->put($3, $<typeLexeme>0);
 													}
 	   | 	ID 				{
+	   								TimeScope t("decl");
 	   								sym->put($1, $<typeLexeme>0);
 	   							}
 	;
@@ -126,6 +233,7 @@ stmt:
 				$$ = new StmtAttr();
 			}
 	| ID assign expr	{
+				TimeScope t("assign");
 				VarAddress* var = sym->get($1);
 				if(var != NULL)
 				{
@@ -172,14 +280,36 @@ stmt:
 				}
 				
 
+				$$ = new StmtAttr();
+			}
+	| PRINT expr	{
+				TimeScope t("print");
+
+				/* the value is printed in its own type (see OutputWriter) */
+				code->gen(printOpr, ((ExprAttr*)$2)->getAddr(), NULL);
+
+				$$ = new StmtAttr();
+			}
+	| READ ID	{
+				TimeScope t("read");
+				VarAddress* var = sym->get($2);
+				if (var == NULL) {
+					cout << "Variable not declared: " << $2 << endl;
+					return 0;
+				}
+
+				/* the value is converted to the type of the variable at run time (see InputReader) */
+				code->gen(readOpr, var, NULL);
+
 				$$ = new StmtAttr();
 			}
 
 	| WHILE '('
 	  {$<inhAttr>$ = code->getNextInstr();}
 	  cond ')'
-	  {$<inhAttr>$ = code->getNextInstr();}
+	  {fallThrough($4, true); $<inhAttr>$ = code->getNextInstr();}
 	  '{' stmt_list '}' {
+			TimeScope t("while");
 			/* This is the "while" production: stmt -> WHILE cond '{' stmt_list '}'
 			 * Since we're gonna need some backpatches, I'm using inherited attributes.
 			 * You should remember them from theory; however their main use here is to
@@ -197,8 +327,10 @@ stmt:
 				 */
 				code->backpatch(((BoolAttr *)$4)->getTruelist(), code->getInstr($<inhAttr>6));
 				
-				/* this generates a goto $3.nexinstr (i.e. "goto cond") */
-				TacInstr* i = code->gen(jmpOpr, NULL, NULL, code->getInstr($<inhAttr>3)->getValueNumber());
+				/* this generates a goto $3.nexinstr (i.e. "goto cond"); a cond which is always
+				 * true may have left no code at all, and then the loop starts at the goto itself */
+				TacInstr* i = code->gen(jmpOpr, NULL, NULL, NULL);
+				i->patch(code->getInstr($<inhAttr>3));
 
 				/* this backpatches stmt_list.nextlist to the beginning of instruction i
 				 * i.e. to the goto we've just generated.
@@ -214,39 +346,143 @@ stmt:
 
 				$$ = attrs;
 			}
-	| IF '(' 
-	{$<inhAttr>$ = code->getNextInstr();}
-	  cond ')' THEN
-	  {$<inhAttr>$ = code->getNextInstr();}
-	  '{' stmt_list '}' {
+	| IF hint '(' if_cond mark '{' stmt_list '}' {
+				TimeScope t("if");
 			
 				//Need to set the newt instr for the stmtlist to the nextlist of the condition
-				code->backpatch(((BoolAttr *)$4)->getTruelist(), code->getInstr($<inhAttr>7));
+				code->backpatch(((BoolAttr *)$4)->getTruelist(), code->getInstr($5));
+
+				/* "if unlikely": the statement list is the cold branch */
+				if ($2 < 0) {
+					markCold($5, code->getNextInstr());
+				}
 	
+				/* the statement is left from the end of stmt_list as well */
 				StmtAttr *attrs = new StmtAttr();
 				attrs->addNext(((BoolAttr *)$4)->getFalselist());
+				attrs->addNext(((StmtAttr *)$7)->getNextlist());
+
+				$$ = attrs;
+			}
+	| IF hint '(' if_cond mark '{' stmt_list '}' ELSE jump mark '{' stmt_list '}' {
+				TimeScope t("if");
+
+				/* The textbook "if-else" production: stmt -> IF cond M stmt_list N ELSE M stmt_list
+				 * the truelist of cond goes to the first M, its falselist to the second one,
+				 * and N is the goto skipping the "else" branch at the end of the "then" one.
+				 */
+				code->backpatch(((BoolAttr *)$4)->getTruelist(), code->getInstr($5));
+				code->backpatch(((BoolAttr *)$4)->getFalselist(), code->getInstr($11));
+
+				/* the hint tells which branch is cold, goto included */
+				if ($2 > 0) {
+					markCold($11, code->getNextInstr());
+				} else if ($2 < 0) {
+					markCold($5, $11);
+				}
+
+				StmtAttr *attrs = new StmtAttr();
+				attrs->addNext(((StmtAttr *)$7)->getNextlist());
+				attrs->addNext(((StmtAttr *)$10)->getNextlist());
+				attrs->addNext(((StmtAttr *)$13)->getNextlist());
+
+				$$ = attrs;
+			}
+	| SWITCH '(' expr ')' '{' mark cases '}' {
+				TimeScope t("switch");
+				if (((ExprAttr*)$3)->getType() != intType) {
+					cout << "Switch on a non-integer expression" << endl;
+					return 0;
+				}
+
+				$$ = switchStmt($3, $6, $7);
+			}
+	;
+
+/* The cases of a switch, in order; each one is left with a goto to the end of the switch,
+ * as control never falls through from a case to the next */
+cases:
+	/* empty */	{ $$ = new SwitchAttr(); }
+	| cases CASE INTEGER ':' mark stmt_list {
+				SwitchAttr *attrs = (SwitchAttr *)$1;
+				if (!attrs->addCase($3, $5)) {
+					cout << "Duplicate case: " << $3 << endl;
+					return 0;
+				}
+				attrs->addNext(((StmtAttr *)$6)->getNextlist());
+				attrs->addNext(code->gen(jmpOpr, NULL, NULL, NULL));
+
+				$$ = attrs;
+			}
+	| cases DEFAULT ':' mark stmt_list {
+				SwitchAttr *attrs = (SwitchAttr *)$1;
+				if (!attrs->setDefault($4)) {
+					cout << "Duplicate default case" << endl;
+					return 0;
+				}
+				attrs->addNext(((StmtAttr *)$5)->getNextlist());
+				attrs->addNext(code->gen(jmpOpr, NULL, NULL, NULL));
 
 				$$ = attrs;
 			}
+	;
+
+/* The branch an "if" is expected to take: 1 for "likely" (the cond is usually true),
+ * -1 for "unlikely", 0 if there is no hint */
+hint:
+	/* empty */	{ $$ = 0; }
+	| LIKELY	{ $$ = 1; }
+	| UNLIKELY	{ $$ = -1; }
+	;
+
+/* The cond of an "if", falling through to the "then" branch */
+if_cond:
+	cond ')' THEN	{
+				fallThrough($1, true);
+				$$ = $1;
+			}
+	;
+
+/* The textbook M marker: the index of the next instruction */
+mark:
+	/* empty */	{ $$ = code->getNextInstr(); }
+	;
+
+/* The textbook N marker: a goto, to be backpatched through the nextlist */
+jump:
+	/* empty */	{
+				StmtAttr *attrs = new StmtAttr();
+				attrs->addNext(code->gen(jmpOpr, NULL, NULL, NULL));
+				$$ = attrs;
+			}
+	;
 
 
 expr:
 	INTEGER {
+				TimeScope t("expr");
 				ConstAddress *ia = new ConstAddress($1);
 
 				$$ = new ExprAttr(ia);
 			}
 	| FLOAT {
+				TimeScope t("expr");
 				ConstAddress *ia = new ConstAddress($1);
 
 				$$ = new ExprAttr(ia);
 			}
 	| ID 	{
+				TimeScope t("expr");
 				VarAddress *ia = sym->get($1);
 
 				$$ = new ExprAttr(ia);
 			}
 	| FRACTION {
+				TimeScope t("expr");
+				if ($1.denom == 0) {
+					cout << "Fraction with a zero denominator" << endl;
+					return 0;
+				}
 				ConstAddress *ia1 = new ConstAddress($1);
 
 				$$ = new ExprAttr(ia1);
@@ -254,6 +490,7 @@ expr:
 				}
 
 	| expr '+' expr {
+				TimeScope t("expr");
 				// Note: I'm not handling all cases of type checking here; needs to be completed
 
 				if ( ((ExprAttr*)$1)->getType() == intType && ((ExprAttr*)$3)->getType() == intType ) {
@@ -268,6 +505,7 @@ expr:
 				}
 			}
 	| expr '*' expr {
+		TimeScope t("expr");
 		if ( ((ExprAttr*)$1)->getType() == intType && ((ExprAttr*)$3)->getType() == intType ) {
 			TempAddress* temp = mem.getNewTemp(sizeof(int));
 
@@ -376,6 +614,7 @@ expr:
 
 cond:
 	TRUE 	{
+				TimeScope t("cond");
 				BoolAttr* attrs = new BoolAttr();
 				
 				TacInstr* i = code->gen(jmpOpr, NULL, NULL);
@@ -384,6 +623,7 @@ cond:
 				$$ = attrs;
 			}
 	| FALSE {
+				TimeScope t("cond");
 				BoolAttr* attrs = new BoolAttr();
 
 				TacInstr* i = code->gen(jmpOpr, NULL, NULL);
@@ -391,7 +631,8 @@ cond:
 
 				$$ = attrs;
 			}
-	| cond OR {$<inhAttr>$ = code->getNextInstr();} cond {
+	| cond OR {fallThrough($1, false); $<inhAttr>$ = code->getNextInstr();} cond {
+				TimeScope t("cond");
 				code->backpatch(((BoolAttr *)$1)->getFalselist(), code->getInstr($<inhAttr>3));
 
 				BoolAttr* attrs = new BoolAttr();
@@ -402,85 +643,34 @@ cond:
 
 				$$ = attrs;
 			}
-	| expr EQ expr { /** the "if op1 == op2 goto instr" operator */
-	 		 		BoolAttr* attrs = new BoolAttr();
-	 				if ( ((ExprAttr*)$1)->getType() == intType && ((ExprAttr*)$3)->getType() == intType ) {
-	 						TacInstr* i1 = code->gen(eq1condJmpOpr, ((ExprAttr*)$1)->getAddr(), ((ExprAttr*)$3)->getAddr(), NULL);
-	 						TacInstr* i2 = code->gen(jmpOpr, NULL, NULL, new InstrAddress(code->getNextInstr()+1));
-	 						attrs->addTrue(i1);
-	 						attrs->addFalse(i2);
-	 				} 
-					else if ( ((ExprAttr*)$1)->getType() == floatType && ((ExprAttr*)$3)->getType() == floatType ) {
-	 						TacInstr* i1 = code->gen(eq1condJmpOpr, ((ExprAttr*)$1)->getAddr(), ((ExprAttr*)$3)->getAddr(), NULL);
-	 						TacInstr* i2 = code->gen(jmpOpr, NULL, NULL, new InstrAddress(code->getNextInstr()+1));
-	 						attrs->addTrue(i1);
-	 						attrs->addFalse(i2);
-	 				} 
-					else if (((ExprAttr*)$1)->getType() == fractionType && ((ExprAttr*)$3)->getType() == fractionType) {
-						/* The idea is to have temps for the num and denom, and then store the resulting rational
-						  * in another temp, and then compare the two to see if they result in the same rational
-						  * number.
-						*/
-							TempAddress* num1 = mem.getNewTemp(4);
-							TempAddress* num2 = mem.getNewTemp(4);
-							TempAddress* den1 = mem.getNewTemp(4);
-							TempAddress* den2 = mem.getNewTemp(4);
-							TempAddress* r1 = mem.getNewTemp(4);
-							TempAddress* r2 = mem.getNewTemp(4);
-							
-							code->gen(offsetOpr, ((ExprAttr*)$1)->getAddr(),new ConstAddress(0),num1);
-							code->gen(offsetOpr, ((ExprAttr*)$3)->getAddr(),new ConstAddress(0),num2);
-							code->gen(offsetOpr, ((ExprAttr*)$1)->getAddr(),new ConstAddress(4),den1);
-							code->gen(offsetOpr, ((ExprAttr*)$3)->getAddr(),new ConstAddress(4),den2);
-
-
-							code->gen(divOpr, num1, den1, r1);
-							code->gen(divOpr, num2, den2, r2);
-						
-							TacInstr* i1 = code->gen(eq1condJmpOpr, r1, r2, NULL);
-							TacInstr* i2 = code->gen(jmpOpr, NULL, NULL, new InstrAddress(code->getNextInstr()+1));
-							attrs->addTrue(i1);
-							attrs->addFalse(i2);
-					}
-					else if (((ExprAttr*)$1)->getType() == fractionType && ((ExprAttr*)$3)->getType() == intType) {
-							TempAddress* num1 = mem.getNewTemp(4);
-							TempAddress* den1 = mem.getNewTemp(4);
-							TempAddress* r1 = mem.getNewTemp(4);
-
-							code->gen(offsetOpr, ((ExprAttr*)$1)->getAddr(),new ConstAddress(0),num1);
-							code->gen(offsetOpr, ((ExprAttr*)$1)->getAddr(),new ConstAddress(4),den1);
-
-							code->gen(divOpr, num1, den1, r1);
-
-							TacInstr* i1 = code->gen(eq1condJmpOpr, r1, ((ExprAttr*)$3)->getAddr(), NULL);
-							TacInstr* i2 = code->gen(jmpOpr, NULL, NULL, new InstrAddress(code->getNextInstr()+1));
-							attrs->addTrue(i1);
-							attrs->addFalse(i2);
+	| cond AND {fallThrough($1, true); $<inhAttr>$ = code->getNextInstr();} cond {
+				TimeScope t("cond");
+				/* the right cond is only evaluated if the left one is true */
+				code->backpatch(((BoolAttr *)$1)->getTruelist(), code->getInstr($<inhAttr>3));
 
-					}
-					else if (((ExprAttr*)$1)->getType() == intType && ((ExprAttr*)$3)->getType() == fractionType) {
-							TempAddress* num1 = mem.getNewTemp(4);
-							TempAddress* den1 = mem.getNewTemp(4);
-							TempAddress* r1 = mem.getNewTemp(4);
-
-							code->gen(offsetOpr, ((ExprAttr*)$3)->getAddr(),new ConstAddress(0),num1);
-							code->gen(offsetOpr, ((ExprAttr*)$3)->getAddr(),new ConstAddress(4),den1);
-
-							code->gen(divOpr, num1, den1, r1);
+				BoolAttr* attrs = new BoolAttr();
+				attrs->addTrue(((BoolAttr *)$4)->getTruelist());
 
-							TacInstr* i1 = code->gen(eq1condJmpOpr, r1, ((ExprAttr*)$1)->getAddr(), NULL);
-							TacInstr* i2 = code->gen(jmpOpr, NULL, NULL, new InstrAddress(code->getNextInstr()+1));
-							attrs->addTrue(i1);
-							attrs->addFalse(i2);
-					}
-					else {
-	 					assert(false);
-	 				}
+				attrs->addFalse(((BoolAttr *)$1)->getFalselist());
+				attrs->addFalse(((BoolAttr *)$4)->getFalselist());
 
-	 				$$ = attrs;
+				$$ = attrs;
+			}
+	| '!' cond {
+				TimeScope t("cond");
+				/* no code: the jumps taken when cond is true are those taken when !cond is false */
+				BoolAttr* attrs = new BoolAttr();
+				attrs->addTrue(((BoolAttr *)$2)->getFalselist());
+				attrs->addFalse(((BoolAttr *)$2)->getTruelist());
 
-	}	
+				$$ = attrs;
+			}
+	| '(' cond ')' {
+				$$ = $2;
+			}
+	| expr EQ expr	{ TimeScope t("cond"); $$ = relation(eq1condJmpOpr, $1, $3); }
 	|expr EXACT expr	{ /** the op1 = op2 operator (Exact match) */
+			TimeScope t("cond");
 			BoolAttr* attrs = new BoolAttr();
 			if ( ((ExprAttr*)$1)->getType() == intType && ((ExprAttr*)$3)->getType() == intType ) {
 					TacInstr* i1 = code->gen(eq2condJmpOpr, ((ExprAttr*)$1)->getAddr(), ((ExprAttr*)$3)->getAddr(), NULL);
@@ -506,12 +696,13 @@ cond:
 					code->gen(offsetOpr, ((ExprAttr*)$3)->getAddr(),new ConstAddress(4),den2);
 
 					TacInstr* i2 = code->gen(eq2condJmpOpr, num1, num2, new InstrAddress(code->getNextInstr()+2));
-					TacInstr* i4 = code->gen(jmpOpr, NULL, NULL, new InstrAddress(code->getNextInstr()+2));
+					TacInstr* i4 = code->gen(jmpOpr, NULL, NULL, NULL);
 					TacInstr* i1 = code->gen(eq2condJmpOpr, den1, den2, NULL);
 					TacInstr* i3 = code->gen(jmpOpr, NULL, NULL, NULL);
 
 					attrs->addTrue(i1);
 					attrs->addFalse(i3);
+					attrs->addFalse(i4);
 
 			}
 			else if (((ExprAttr*)$1)->getType() == intType && ((ExprAttr*)$3)->getType() == fractionType) {
@@ -532,11 +723,12 @@ cond:
 					code->gen(offsetOpr, tmp,new ConstAddress(4),den2);
 
 					TacInstr* i2 = code->gen(eq2condJmpOpr, num1, num2, new InstrAddress(code->getNextInstr()+2));
-					TacInstr* i4 = code->gen(jmpOpr, NULL, NULL, new InstrAddress(code->getNextInstr()+2));
+					TacInstr* i4 = code->gen(jmpOpr, NULL, NULL, NULL);
 					TacInstr* i1 = code->gen(eq2condJmpOpr, den1, den2, NULL);
 					TacInstr* i3 = code->gen(jmpOpr, NULL, NULL, NULL);
 					attrs->addTrue(i1);
 					attrs->addFalse(i3);
+					attrs->addFalse(i4);
 			}
 			else if (((ExprAttr*)$3)->getType() == intType && ((ExprAttr*)$1)->getType() == fractionType) {
 					TempAddress* tmp = mem.getNewTemp(8);
@@ -556,20 +748,27 @@ cond:
 					code->gen(offsetOpr, tmp,new ConstAddress(4),den2);
 
 					TacInstr* i2 = code->gen(eq2condJmpOpr, num1, num2, new InstrAddress(code->getNextInstr()+2));
-					TacInstr* i4 = code->gen(jmpOpr, NULL, NULL, new InstrAddress(code->getNextInstr()+2));
+					TacInstr* i4 = code->gen(jmpOpr, NULL, NULL, NULL);
 					TacInstr* i1 = code->gen(eq2condJmpOpr, den1, den2, NULL);
 					TacInstr* i3 = code->gen(jmpOpr, NULL, NULL, NULL);
 					attrs->addTrue(i1);
 					attrs->addFalse(i3);
+					attrs->addFalse(i4);
 			}
 
 			$$ = attrs;
 	} 
-	
+	| expr NE expr	{ TimeScope t("cond"); $$ = relation(neCondJmpOpr, $1, $3); }
+	| expr '<' expr	{ TimeScope t("cond"); $$ = relation(ltCondJmpOpr, $1, $3); }
+	| expr LE expr	{ TimeScope t("cond"); $$ = relation(leCondJmpOpr, $1, $3); }
+	| expr '>' expr	{ TimeScope t("cond"); $$ = relation(gtCondJmpOpr, $1, $3); }
+	| expr GE expr	{ TimeScope t("cond"); $$ = relation(geCondJmpOpr, $1, $3); }
 	;
 
 %%
 void printout() {
+	TimeScope t("printout");
+
 	/* ====== */
 	cout << "*********" << endl;
 	cout << "Size of int: " << sizeof(int) << endl;
@@ -578,23 +777,800 @@ void printout() {
 	cout << "*********" << endl;
 	cout << endl;
 	cout << "== Symbol Table ==" << endl;
-	sym->printOut();
+	{
+		TimeScope t("symbol table");
+		sym->printOut();
+	}
 	cout << endl;
 	cout << "== Memory Dump ==" << endl;
 	// mem.hexdump();
-	mem.printOut(sym);
+	{
+		TimeScope t("memory dump");
+		mem.printOut(sym);
+	}
 	cout << endl;
 	cout << endl;
 	cout << "== Output (3-addr code) ==" << endl;
-	code->printOut();
+	{
+		TimeScope t("3-addr code");
+		code->printOut();
+	}
 	/* ====== */
 }
 
 
+/* Optimizes the program, just parsed or loaded, and produces the output requested on
+ * the command line; a program with no statements (stmts is false) is neither optimized nor run */
+void finish(bool stmts) {
+	// run the optimizations requested on the command line
+	if (stmts) {
+		optimize();
+	}
+
+	if (irFile != NULL) {
+		writeIr();
+	}
+
+	if (optObject) {
+		writeObject();
+		return;
+	}
+
+	// print out the output IR, as well as some other info
+	// useful for debugging
+	printout();
+
+	// the listing goes out before what the program prints
+	fflush(stdout);
+
+	if (stmts && optNative) {
+		runNative();
+	}
+	if (stmts && optInterpret) {
+		runInterpreter();
+	}
+	if (stmts && optTiered) {
+		runTiered();
+	}
+	if (stmts && batchFile != NULL) {
+		runBatch();
+	}
+	if (InputReader::valuesRead() > 0) {
+		InputReader::printReport(cerr);
+	}
+	if (OutputWriter::valuesPrinted() > 0) {
+		OutputWriter::printReport(cerr);
+	}
+}
+
+/* The "if op1 < op2 goto instr" operator, and the other relations but =: a single conditional
+ * jump, to be patched through the truelist, followed by the "goto" of the falselist. The operands
+ * keep their types: ints and floats are compared as floats, and a fraction with another fraction
+ * (or an int n, as n|1) by cross-multiplying, n1 * d2 < n2 * d1, which is the order of the
+ * fractions as long as their denominators are positive (a fraction read or given as a constant
+ * keeps its sign in the numerator, and none has a zero denominator); == and != compare them
+ * the same way, so that 1|2 == 2|4 */
+BoolAttr* relation(oprEnum op, Attribute* e1, Attribute* e2) {
+	BoolAttr* attrs = new BoolAttr();
+
+	TacInstr* i1 = code->gen(op, ((ExprAttr*)e1)->getAddr(), ((ExprAttr*)e2)->getAddr(), NULL);
+	TacInstr* i2 = code->gen(jmpOpr, NULL, NULL, NULL);
+	attrs->addTrue(i1);
+	attrs->addFalse(i2);
+
+	if (op != eq1condJmpOpr && op != neCondJmpOpr && (((ExprAttr*)e1)->getType() == floatType || ((ExprAttr*)e2)->getType() == floatType)) {
+		floatOrderings.insert(i1);
+	}
+
+	return attrs;
+}
+
+/* Returns the conditional jump taken exactly when instr is not, or UNKNOWNOpr if there is none:
+ * the grammar only compares scalars with "=", which is "==" on them, and a NaN is neither
+ * smaller nor larger than a float, so that "not <" is no relation of its own */
+static oprEnum negation(TacInstr* instr) {
+	if (floatOrderings.count(instr)) {
+		return UNKNOWNOpr;
+	}
+	switch (instr->getOp()) {
+		case eq1condJmpOpr:
+		case eq2condJmpOpr:
+			return neCondJmpOpr;
+		case neCondJmpOpr:
+			return eq1condJmpOpr;
+		case ltCondJmpOpr:
+			return geCondJmpOpr;
+		case leCondJmpOpr:
+			return gtCondJmpOpr;
+		case gtCondJmpOpr:
+			return leCondJmpOpr;
+		case geCondJmpOpr:
+			return ltCondJmpOpr;
+		default:
+			return UNKNOWNOpr;
+	}
+}
+
+/* Makes the code of cond fall through to the instruction generated next when cond is true
+ * (onTrue) or false, as the code of the statement, or of the cond, going on from there does:
+ * cond ends with the goto of one of its lists, which is dropped if that list is the one going
+ * to the next instruction anyway. If it is the other list, the conditional jump right before
+ * the goto is negated to take its place: "if a < b goto T; goto F; T:" becomes
+ * "if a >= b goto F; T:". Either way, the cond no longer jumps just to go on. */
+void fallThrough(Attribute* cond, bool onTrue) {
+	BoolAttr* attrs = (BoolAttr*)cond;
+	list<TacInstr*> next = onTrue ? attrs->getTruelist() : attrs->getFalselist();
+	list<TacInstr*> other = onTrue ? attrs->getFalselist() : attrs->getTruelist();
+
+	int n = code->getNextInstr();
+	TacInstr* last = code->getInstr(n - 1);
+	TacInstr* before = n >= 2 ? code->getInstr(n - 2) : NULL;
+	if (last == NULL || last->getOp() != jmpOpr) {
+		return;
+	}
+
+	if (find(next.begin(), next.end(), last) != next.end()) {
+		if (code->removeLast()) {
+			if (onTrue) {
+				attrs->removeTrue(last);
+			} else {
+				attrs->removeFalse(last);
+			}
+		}
+	} else if (find(other.begin(), other.end(), last) != other.end() && before != NULL
+			&& find(next.begin(), next.end(), before) != next.end() && negation(before) != UNKNOWNOpr) {
+		if (code->removeLast()) {
+			before->setOp(negation(before));
+			if (onTrue) {
+				attrs->removeFalse(last);
+				attrs->removeTrue(before);
+				attrs->addFalse(before);
+			} else {
+				attrs->removeTrue(last);
+				attrs->removeFalse(before);
+				attrs->addTrue(before);
+			}
+		}
+	}
+}
+
+/* Marks the instructions in [from, to) as cold: they are a branch hinted as rarely taken,
+ * which the layout pass moves out of the way of the hot code */
+void markCold(int from, int to) {
+	for (int i = from; i < to; i++) {
+		code->getInstr(i)->setCold(true);
+	}
+}
+
+/* The cases of a switch, sorted by value, grouped for the dispatch: a run of cases dense
+ * enough for a jump table, or a single case, compared on its own */
+class CaseCluster {
+public:
+	int low, high;
+	vector<TacInstr*> targets;	// by value - low; NULL for the values with no case
+};
+
+/* A jump table takes at least this many cases, and at least half of the values in its range */
+const int minTableCases = 4;
+
+static vector<CaseCluster> clusterCases(const map<int, TacInstr*>& cases) {
+	vector<int> values;
+	vector<TacInstr*> targets;
+	for (map<int, TacInstr*>::const_iterator it = cases.begin(); it != cases.end(); ++it) {
+		values.push_back(it->first);
+		targets.push_back(it->second);
+	}
+
+	vector<CaseCluster> clusters;
+	for (size_t i = 0; i < values.size(); ) {
+		// the longest run from i which is dense enough
+		size_t j = i;
+		for (size_t k = i + 1; k < values.size(); k++) {
+			if ((long long)values[k] - values[i] + 1 <= 2 * (long long)(k - i + 1)) {
+				j = k;
+			}
+		}
+		if (j - i + 1 < (size_t)minTableCases) {
+			j = i;
+		}
+
+		CaseCluster c;
+		c.low = values[i];
+		c.high = values[j];
+		c.targets.assign(c.high - c.low + 1, NULL);
+		for (size_t k = i; k <= j; k++) {
+			c.targets[values[k] - c.low] = targets[k];
+		}
+		clusters.push_back(c);
+		i = j + 1;
+	}
+	return clusters;
+}
+
+/* Generates the dispatch of a switch on x among the clusters lo..hi: the jump table of a
+ * single dense cluster, a compare for each of up to 3 single cases, or else a compare with
+ * the first value of the middle cluster, going on with either half (a balanced binary search).
+ * The jumps to the default case are added to toDefault. */
+static void dispatch(Address* x, const vector<CaseCluster>& clusters, int lo, int hi, list<TacInstr*>& toDefault) {
+	bool singles = hi - lo < 3;
+	for (int c = lo; c <= hi && singles; c++) {
+		singles = clusters[c].low == clusters[c].high;
+	}
+
+	if (singles) {
+		for (int c = lo; c <= hi; c++) {
+			code->gen(eq1condJmpOpr, x, new ConstAddress(clusters[c].low), NULL)->patch(clusters[c].targets[0]);
+		}
+		toDefault.push_back(code->gen(jmpOpr, NULL, NULL, NULL));
+		return;
+	}
+
+	if (lo == hi) {
+		// the table is indexed from 0
+		Address* index = x;
+		if (clusters[lo].low != 0) {
+			TempAddress* temp = mem.getNewTemp(sizeof(int));
+			index = code->gen(addOpr, x, new ConstAddress(-clusters[lo].low), temp)->getValueNumber();
+		}
+
+		const vector<TacInstr*>& targets = clusters[lo].targets;
+		toDefault.push_back(code->gen(jmpTableOpr, index, new ConstAddress((int)targets.size()), NULL));
+		for (size_t k = 0; k < targets.size(); k++) {
+			TacInstr* entry = code->gen(jmpOpr, NULL, NULL, NULL);
+			if (targets[k] != NULL) {
+				entry->patch(targets[k]);
+			} else {
+				toDefault.push_back(entry);
+			}
+		}
+		return;
+	}
+
+	int mid = (lo + hi + 1) / 2;
+	TacInstr* upper = code->gen(geCondJmpOpr, x, new ConstAddress(clusters[mid].low), NULL);
+	dispatch(x, clusters, lo, mid - 1, toDefault);
+	int right = code->getNextInstr();
+	dispatch(x, clusters, mid, hi, toDefault);
+	upper->patch(code->getInstr(right));
+}
+
+/* The switch statement on the value of e: its cases c have been generated from instruction
+ * first on, so the dispatch, generated after them, is then moved in front of them, where
+ * the statement starts. The case last in the source falls through to the end of the switch,
+ * and the dispatch into the case after it, if that is where it would go anyway. */
+StmtAttr* switchStmt(Attribute* e, int first, Attribute* c) {
+	SwitchAttr* cases = (SwitchAttr*)c;
+	Address* x = ((ExprAttr*)e)->getAddr();
+	int end = code->getNextInstr();
+
+	// where the cases start, as they are about to move
+	map<int, TacInstr*> targets;
+	for (map<int, int>::const_iterator it = cases->getCases().begin(); it != cases->getCases().end(); ++it) {
+		targets[it->first] = code->getInstr(it->second);
+	}
+	TacInstr* otherwise = cases->getDefault() >= 0 ? code->getInstr(cases->getDefault()) : NULL;
+
+	list<TacInstr*> toDefault;
+	vector<CaseCluster> clusters = clusterCases(targets);
+	if (clusters.empty()) {
+		toDefault.push_back(code->gen(jmpOpr, NULL, NULL, NULL));
+	} else {
+		dispatch(x, clusters, 0, clusters.size() - 1, toDefault);
+	}
+
+	StmtAttr* attrs = new StmtAttr();
+	attrs->addNext(cases->getNextlist());
+	if (otherwise == NULL) {
+		attrs->addNext(toDefault);
+	} else {
+		code->backpatch(toDefault, otherwise);
+
+		// the last goto of the dispatch, unless it is in a jump table, may go to the default case first
+		TacInstr* last = code->getInstr(code->getNextInstr() - 1);
+		bool inTable = !clusters.empty() && clusters.back().low != clusters.back().high;
+		if (!inTable && otherwise == code->getInstr(first) && last->getOp() == jmpOpr) {
+			code->removeLast();
+		}
+	}
+
+	int n = code->getNextInstr();
+	code->rotate(first, end);
+
+	TacInstr* last = code->getInstr(n - 1);
+	if (end > first && last->getOp() == jmpOpr && last->getDestInstr() == NULL && code->removeLast()) {
+		attrs->removeNext(last);
+	}
+
+	return attrs;
+}
+
+/* Returns true if the program has a "read" or "print" statement */
+bool usesRuntime() {
+	for (int i = 0; i < code->getNextInstr(); i++) {
+		oprEnum op = code->getInstr(i)->getOp();
+		if (op == readOpr || op == printOpr) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void optimize() {
+	TimeScope t("optimize");
+	PassManager pm;
+
+	if (optPasses != NULL) {
+		// the names have already been checked by main
+		stringstream names(optPasses);
+		string name;
+		while (getline(names, name, ',')) {
+			pm.add(PassManager::createPass(name));
+		}
+	} else {
+		pm.addLevel(optLevel, optEnabled);
+	}
+
+	pm.setTimePasses(timePasses);
+	pm.run(code);
+}
+
+void runNative() {
+	TimeScope t("native");
+	NativeCode native(code, optRegAlloc, optISel);
+	native.printReport();
+	if (!native.ok()) {
+		cerr << "native: " << native.getError() << ", running the interpreter instead" << endl;
+		runInterpreter();
+		return;
+	}
+
+	// the symbols must be in place before the code runs, and the jitdump stay mapped while it does
+	PerfSymbols* symbols = NULL;
+	if (optPerfMap || optJitDump) {
+		symbols = new PerfSymbols(code, native);
+		string written = optPerfMap ? symbols->writePerfMap() : "";
+		if (optPerfMap) {
+			cerr << (written.empty() ? "perf map: cannot be written" : "perf map: " + written) << endl;
+		}
+		written = optJitDump ? symbols->writeJitDump(sourceName) : "";
+		if (optJitDump) {
+			cerr << (written.empty() ? "jitdump: cannot be written" : "jitdump: " + written) << endl;
+		}
+	}
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	int status;
+	{
+		TimeScope t("run");
+		status = native.run();
+		OutputWriter::flush();
+	}
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+
+	cout << endl << "== Native run ==" << endl;
+	sym->printValues();
+	if (status != 0) {
+		cout << "stopped: division by zero" << endl;
+	}
+
+	cerr << "native: " << native.getBytes().size() << " bytes of code, run in " << elapsed.count() << " ms" << endl;
+	if (symbols != NULL) {
+		cerr << "symbols: " << symbols->size() << endl;
+		delete symbols;
+	}
+}
+
+void runInterpreter() {
+	TimeScope t("interpret");
+	Interpreter interpreter(code);
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	int status;
+	{
+		TimeScope t("run");
+		status = interpreter.run(optProfile);
+		OutputWriter::flush();
+	}
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+
+	cout << endl << "== Interpreter run ==" << endl;
+	sym->printValues();
+	if (status != 0) {
+		cout << "stopped: division by zero" << endl;
+	}
+
+	cerr << "interpreter: " << interpreter.size() << " operations, run in " << elapsed.count() << " ms" << endl;
+	if (optProfile) {
+		interpreter.printProfile(cerr);
+		if (!source.empty()) {
+			vector<string> lines;
+			istringstream in(source);
+			for (string line; getline(in, line); ) {
+				lines.push_back(line);
+			}
+			cerr << endl;
+			interpreter.printSourceProfile(cerr, lines);
+		}
+	}
+}
+
+void runTiered() {
+	TimeScope t("tiered");
+	Interpreter interpreter(code);
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	int status;
+	{
+		TimeScope t("run");
+		status = interpreter.runTiered(osrThreshold, optRegAlloc, optISel);
+		OutputWriter::flush();
+	}
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+
+	cout << endl << "== Tiered run ==" << endl;
+	sym->printValues();
+	if (status != 0) {
+		cout << "stopped: division by zero" << endl;
+	}
+
+	cerr << "tiered: run in " << elapsed.count() << " ms" << endl;
+	interpreter.printTierReport(cerr);
+}
+
+/* Reads the instances of --batch into images, one Memory image per line: the line assigns
+ * values to variables, e.g. "x=3 y=2.5 z=1|3", and the other variables keep their initial
+ * values; empty lines and lines starting with # are skipped. Exits on an error. */
+void readBatch(const char* file, int cells, vector<int>& images) {
+	ifstream in(file);
+	if (!in) {
+		cerr << "Cannot read " << file << endl;
+		exit(1);
+	}
+
+	vector<int> base(cells, 0);
+	memcpy(&base[0], mem.retrieve(0), mem.getUsed());
+
+	string line;
+	for (int number = 1; getline(in, line); number++) {
+		istringstream words(line);
+		string word;
+		if (!(words >> word) || word[0] == '#') {
+			continue;
+		}
+
+		size_t image = images.size();
+		images.insert(images.end(), base.begin(), base.end());
+		do {
+			VarAddress* var = NULL;
+			if (word.size() > 2 && word[1] == '=' && word[0] >= 'a' && word[0] <= 'z') {
+				var = sym->get(word[0]);
+			}
+			if (var == NULL) {
+				cerr << file << ":" << number << ": not an assignment to a variable: " << word << endl;
+				exit(1);
+			}
+
+			const char* value = word.c_str() + 2;
+			char* end;
+			int* cell = &images[image + var->getOffset() / 4];
+			if (var->getType() == floatType) {
+				float f = strtof(value, &end);
+				memcpy(cell, &f, sizeof(f));
+			} else {
+				cell[0] = strtol(value, &end, 10);
+				if (var->getType() == fractionType) {
+					cell[1] = *end == '|' ? strtol(end + 1, &end, 10) : 1;
+					// the comparisons of fractions rely on a positive denominator
+					if (cell[1] < 0) {
+						cell[0] = (int)(0u - cell[0]);
+						cell[1] = (int)(0u - cell[1]);
+					}
+				}
+			}
+			if (*end != 0 || (var->getType() == fractionType && cell[1] == 0)) {
+				cerr << file << ":" << number << ": not a value of type " << typestrs[var->getType()] << ": " << word << endl;
+				exit(1);
+			}
+		} while (words >> word);
+	}
+}
+
+void runBatch() {
+	TimeScope t("batch");
+	if (usesRuntime()) {
+		cerr << "--batch cannot run a program with read or print: its instances take their values from " << batchFile << endl;
+		exit(1);
+	}
+
+	Interpreter interpreter(code);
+	BatchInterpreter batch(interpreter, optSimd);
+
+	vector<int> images;
+	readBatch(batchFile, batch.imageCells(), images);
+	vector<int> scalarImages(images);
+
+	vector<int> status;
+	{
+		TimeScope t("run");
+		batch.run(images, status);
+	}
+	vector<int> scalarStatus;
+	{
+		TimeScope t("scalar");
+		batch.runScalar(scalarImages, scalarStatus);
+	}
+
+	cout << endl << "== Batch run ==" << endl;
+	int differ = 0;
+	for (size_t k = 0; k < status.size(); k++) {
+		int cells = batch.imageCells();
+		memcpy(mem.retrieve(0), &images[k * cells], mem.getUsed());
+		cout << "instance " << k + 1 << ":" << endl;
+		sym->printValues();
+		if (status[k] != 0) {
+			cout << "stopped: division by zero" << endl;
+		}
+		if (status[k] != scalarStatus[k] || memcmp(&images[k * cells], &scalarImages[k * cells], mem.getUsed()) != 0) {
+			differ++;
+		}
+	}
+
+	batch.printReport(cerr);
+	if (differ > 0) {
+		cerr << "batch: " << differ << " instances differ from the scalar run" << endl;
+	}
+}
+
+/* Reads the whole program, keeping it in source, and returns a stream over the copy for the scanner */
+FILE* keepSource(FILE* in) {
+	char buffer[65536];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+		source.append(buffer, n);
+	}
+	if (in != stdin) {
+		fclose(in);
+	}
+
+	// an empty buffer cannot be opened: an empty stream will do
+	return source.empty() ? fopen("/dev/null", "r") : fmemopen(&source[0], source.size(), "r");
+}
+
+void writeObject() {
+	TimeScope t("object");
+	if (usesRuntime()) {
+		// the native code calls the runtime of the compiler itself
+		cerr << "-c cannot compile a program with read or print: run it with --native instead" << endl;
+		exit(1);
+	}
+
+	ElfObject object(code, sym, optRegAlloc, optISel);
+
+	if (!object.write(objectFile.c_str())) {
+		cerr << "Cannot write " << objectFile << endl;
+		exit(1);
+	}
+}
+
+void writeIr() {
+	TimeScope t("emit-ir");
+	IrWriter ir(code, sym);
+
+	if (!ir.write(irFile)) {
+		cerr << "Cannot write " << irFile << endl;
+		exit(1);
+	}
+}
+
+/* Returns true if all the comma-separated names in list are names of passes */
+bool validPasses(const char* list) {
+	stringstream names(list);
+	string name;
+	while (getline(names, name, ',')) {
+		Pass* pass = PassManager::createPass(name);
+		if (pass == NULL) {
+			cerr << "Unknown pass: " << name << " (available: " << PassManager::passNames() << ")" << endl;
+			return false;
+		}
+		delete pass;
+	}
+	return true;
+}
+
+void printTimeReport() {
+	if (timeReportJson) {
+		PhaseTimer::printJsonReport(cerr);
+	} else {
+		PhaseTimer::printReport(cerr);
+	}
+}
+
 void yyerror(const char *s) {
     fprintf(stderr, "%s\n", s);
 }
 
-int main(void) {
-    yyparse();
+int main(int argc, char** argv) {
+	const char* input = NULL;		/* the program; stdin if none */
+
+	for (int i = 1; i < argc; i++) {
+		Pass* pass = strncmp(argv[i], "--", 2) == 0 ? PassManager::createPass(argv[i] + 2) : NULL;
+
+		if (strcmp(argv[i], "-O0") == 0 || strcmp(argv[i], "-O1") == 0 || strcmp(argv[i], "-O2") == 0) {
+			optLevel = argv[i][2] - '0';
+		} else if (strncmp(argv[i], "--passes=", 9) == 0) {
+			optPasses = argv[i] + 9;
+			if (!validPasses(optPasses)) {
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--time-passes") == 0) {
+			timePasses = true;
+		} else if (strcmp(argv[i], "--time-report") == 0 || strcmp(argv[i], "--time-report=json") == 0) {
+			timeReport = true;
+			timeReportJson = argv[i][13] == '=';
+		} else if (strcmp(argv[i], "--counters") == 0) {
+			timeReport = true;
+			timeCounters = true;
+		} else if (strcmp(argv[i], "--native") == 0) {
+			optNative = true;
+		} else if (strcmp(argv[i], "--no-regalloc") == 0) {
+			optRegAlloc = false;
+		} else if (strcmp(argv[i], "--no-isel") == 0) {
+			optISel = false;
+		} else if (strcmp(argv[i], "--perf-map") == 0) {
+			optPerfMap = true;
+		} else if (strcmp(argv[i], "--jitdump") == 0) {
+			optJitDump = true;
+		} else if (strcmp(argv[i], "--tiered") == 0) {
+			optTiered = true;
+		} else if (strncmp(argv[i], "--osr-threshold=", 16) == 0 && atoi(argv[i] + 16) > 0) {
+			osrThreshold = atoi(argv[i] + 16);
+		} else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+			batchFile = argv[++i];
+		} else if (strcmp(argv[i], "--no-simd") == 0) {
+			optSimd = false;
+		} else if (strcmp(argv[i], "--interpret") == 0) {
+			optInterpret = true;
+		} else if (strcmp(argv[i], "--profile") == 0) {
+			optInterpret = true;
+			optProfile = true;
+		} else if (strcmp(argv[i], "-c") == 0) {
+			optObject = true;
+		} else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			objectFile = argv[++i];
+		} else if (strcmp(argv[i], "--emit-ir") == 0 && i + 1 < argc) {
+			irFile = argv[++i];
+		} else if (strcmp(argv[i], "--load") == 0 && i + 1 < argc) {
+			loadFile = argv[++i];
+		} else if (strcmp(argv[i], "--tac") == 0 && i + 1 < argc) {
+			tacFile = argv[++i];
+		} else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+			inputFile = argv[++i];
+		} else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+			outputFile = argv[++i];
+		} else if (argv[i][0] != '-' && input == NULL) {
+			input = argv[i];
+		} else if (pass != NULL) {
+			// --<pass name> enables a single pass
+			optEnabled.push_back(argv[i] + 2);
+		} else {
+			cerr << "Unknown option: " << argv[i] << endl;
+			cerr << "Usage: " << argv[0] << " [-O0 | -O1 | -O2] [--<pass>...] [--passes=<pass>,...] [--time-passes] [--time-report[=json]] [--counters] [--native [--no-regalloc] [--no-isel] [--perf-map] [--jitdump] | --interpret | --profile | --tiered [--osr-threshold=<n>] | --batch <file> [--no-simd]] [-c [-o <file>]] [--emit-ir <file>] [--load <file> | --tac <file> | program] [--input <file>] [--output <file>]" << endl;
+			cerr << "Passes: " << PassManager::passNames() << endl;
+			return 1;
+		}
+
+		delete pass;
+	}
+
+	if (timeReport) {
+		// the report is printed however the compiler exits; it tells why, should there be no counters
+		if (timeCounters) {
+			PhaseTimer::enableCounters();
+		}
+		PhaseTimer::enable();
+		atexit(printTimeReport);
+	}
+
+	if (optNative + optInterpret + optTiered + (batchFile != NULL) > 1) {
+		// they would all run on the same Memory
+		cerr << "Only one of --native, --interpret (or --profile), --tiered and --batch can be given" << endl;
+		return 1;
+	}
+
+	if ((optPerfMap || optJitDump) && !optNative) {
+		cerr << "--perf-map and --jitdump need --native" << endl;
+		return 1;
+	}
+
+	if ((input != NULL) + (loadFile != NULL) + (tacFile != NULL) > 1) {
+		cerr << "Only one of a program, --load and --tac can be given" << endl;
+		return 1;
+	}
+
+	// the input of read is stdin, unless the program is there: it must then come from a file
+	if (inputFile != NULL && !InputReader::open(inputFile)) {
+		cerr << "Cannot read " << inputFile << endl;
+		return 1;
+	}
+	if (outputFile != NULL && !OutputWriter::open(outputFile)) {
+		cerr << "Cannot write " << outputFile << endl;
+		return 1;
+	}
+
+	if (input != NULL) {
+		yyin = fopen(input, "r");
+		if (yyin == NULL) {
+			cerr << "Cannot read " << input << endl;
+			return 1;
+		}
+
+		// perf looks the source up by this name, from wherever it runs
+		char* path = realpath(input, NULL);
+		sourceName = path != NULL ? path : input;
+		free(path);
+	}
+
+	if (optObject && objectFile.empty()) {
+		// dir/prog.tc compiles to prog.o, in the current directory
+		string name = input != NULL ? input : (loadFile != NULL ? loadFile : (tacFile != NULL ? tacFile : "a"));
+		if (name.rfind('/') != string::npos) {
+			name.erase(0, name.rfind('/') + 1);
+		}
+		if (name.rfind('.') != string::npos && name.rfind('.') > 0) {
+			name.erase(name.rfind('.'));
+		}
+		objectFile = name + ".o";
+	}
+
+	if (loadFile != NULL) {
+		// the parser is not involved at all: the program is decoded from the file as it was saved
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		IrReader ir(loadFile, code, sym);
+		chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+
+		if (!ir.ok()) {
+			cerr << "Cannot load " << loadFile << ": " << ir.getError() << endl;
+			return 1;
+		}
+		cerr << "load: " << code->getNextInstr() << " instructions in " << elapsed.count() << " ms" << endl;
+
+		finish(true);
+		return 0;
+	}
+
+	if (tacFile != NULL) {
+		TacAssembler tac(tacFile, code, sym);
+
+		if (!tac.ok()) {
+			cerr << tacFile << ": " << tac.getError() << endl;
+			return 1;
+		}
+
+		// hand-written code may be well formed line by line, and still not be a program
+		string problem = PassManager::verify(code);
+		if (!problem.empty()) {
+			cerr << tacFile << ": " << problem << endl;
+			return 1;
+		}
+
+		finish(true);
+		return 0;
+	}
+
+	if (optProfile) {
+		yyin = keepSource(yyin != NULL ? yyin : stdin);
+	}
+
+	int status;
+	{
+		TimeScope t("parse");
+		status = yyparse();
+	}
+
+	if (status == 0 && parsed) {
+		finish(!noStmts);
+	}
+
+	// only a failed -c tells so with its exit status, as it produces no object
+	return optObject && status != 0 ? 1 : 0;
 }